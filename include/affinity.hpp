@@ -0,0 +1,24 @@
+#ifndef AFFINITY_HPP
+#define AFFINITY_HPP
+
+#include <string>
+
+namespace Affinity {
+
+// CPU topology as seen by this process: NUMA nodes and the CPUs we may run on.
+// Read once on first use; falls back to a single node when the OS does not say.
+int node_count();
+int cpu_count();
+
+// CPU for the idx-th search thread: nodes are filled round-robin so that
+// pairs of threads land on different sockets, then cores within a node.
+int cpu_for_thread(int idx);
+int node_of_cpu(int cpu);
+
+bool bind_current_thread(int cpu);
+
+std::string describe();
+
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef ANALYSIS_HPP
+#define ANALYSIS_HPP
+
+#include "search.hpp"
+#include <sstream>
+#include <string>
+
+namespace Analysis {
+
+// Offline analysis of an EPD set for throughput: every worker owns a Search
+// and a TT and takes whole positions from a shared queue, so workers never
+// touch each other's memory and scaling follows the core count rather than
+// Lazy SMP's. Results are written in input order as EPD with ce/acd/acn/acs/pv.
+struct AnalysisConfig {
+    std::string epd_path;
+    std::string output_path;
+    SearchLimits limits;
+    int threads = 1;
+    int hash_mb = 16;           // Per worker
+    bool bind_threads = true;
+};
+
+struct AnalysisStats {
+    size_t positions = 0;
+    size_t with_answer = 0;     // Positions carrying bm or am
+    size_t solved = 0;
+    U64 nodes = 0;
+    int64_t time_ms = 0;
+};
+
+bool run(const AnalysisConfig& config, AnalysisStats& stats);
+AnalysisConfig parse_config(std::istringstream& is);
+
+// SAN for a legal move, without check or annotation suffixes.
+std::string move_to_san(const Board& board, Move m);
+
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include "perfcounters.hpp"
+#include "types.hpp"
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Bench {
+
+// The fixed position set shared by the text bench and the JSON suite.
+const std::vector<std::string>& positions();
+
+struct Config {
+    int depth = 13;
+    int threads = 1;
+    int runs = 1;
+    std::string engine;
+    std::string sliders;
+};
+
+struct PositionSample {
+    U64 nodes = 0;
+    int64_t timeUs = 0;
+    int selDepth = 0;
+    U64 ttProbes = 0;
+    U64 ttHits = 0;
+    PerfCounters::Sample perf;
+};
+
+using Run = std::vector<PositionSample>;
+
+// Searches every position once at config.depth on the global TT, which the
+// caller has sized; each run starts from a cleared TT and cleared histories
+// so single-threaded node counts repeat exactly. Hardware counters follow
+// the searching thread and are only collected when threads == 1.
+Run run_once(const Config& config, PerfCounters::Group* perf);
+
+// One JSON document holding per-position results and, across runs, the
+// mean and variance of time and NPS for each position and for the total.
+void write_json(std::ostream& os, const Config& config, const std::vector<Run>& runs);
+
+}
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef BITBASE_HPP
+#define BITBASE_HPP
+
+#include "types.hpp"
+
+namespace Bitbase {
+
+// King and pawn against king, solved by retrograde analysis into one bit per
+// position (24 KB) the first time it is probed, which takes a few
+// milliseconds, so processes that never reach the ending never pay for it.
+// White is the side with the pawn; callers flip the board for Black.
+
+// True when White wins with best play. The pawn may stand on any file.
+bool probe_kpk(Square wksq, Square wpsq, Square bksq, Color stm);
+
+}
+
+#endif
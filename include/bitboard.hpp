@@ -2,6 +2,7 @@
 #define BITBOARD_HPP
 
 #include "types.hpp"
+#include <array>
 #include <string>
 
 using Bitboard = U64;
@@ -32,15 +33,19 @@ constexpr Bitboard NOT_FILE_H_BB = ~FILE_H_BB;
 constexpr Bitboard NOT_FILE_AB_BB = ~(FILE_A_BB | FILE_B_BB);
 constexpr Bitboard NOT_FILE_GH_BB = ~(FILE_G_BB | FILE_H_BB);
 
-extern Bitboard FileBB[FILE_NB];
-extern Bitboard RankBB[RANK_NB];
-extern Bitboard SquareBB[SQUARE_NB];
-extern Bitboard BetweenBB[SQUARE_NB][SQUARE_NB];
-extern Bitboard LineBB[SQUARE_NB][SQUARE_NB];
+using SquareBoards = std::array<Bitboard, SQUARE_NB>;
 
-extern Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
-extern Bitboard KnightAttacks[SQUARE_NB];
-extern Bitboard KingAttacks[SQUARE_NB];
+// Computed at compile time into read-only data: nothing to set up at
+// startup, and the pages are shared by every running copy of the engine.
+extern const std::array<Bitboard, FILE_NB> FileBB;
+extern const std::array<Bitboard, RANK_NB> RankBB;
+extern const SquareBoards SquareBB;
+extern const std::array<SquareBoards, SQUARE_NB> BetweenBB;
+extern const std::array<SquareBoards, SQUARE_NB> LineBB;
+
+extern const std::array<SquareBoards, COLOR_NB> PawnAttacks;
+extern const SquareBoards KnightAttacks;
+extern const SquareBoards KingAttacks;
 
 constexpr Bitboard square_bb(Square s) {
     return 1ULL << s;
@@ -195,7 +200,6 @@ inline bool aligned(Square s1, Square s2, Square s3) {
 }
 
 namespace Bitboards {
-    void init();
     std::string pretty(Bitboard b);
 }
 
@@ -6,6 +6,7 @@
 #include "magic.hpp"
 #include "zobrist.hpp"
 #include "move.hpp"
+#include "nnue.hpp"
 #include <string>
 #include <vector>
 
@@ -13,6 +14,7 @@ struct StateInfo {
     Key positionKey;
     Key pawnKey;
     Key materialKey;
+    Key polyglotKey;  // Pieces, castling and side to move; no en passant term
     EvalScore psqtScore[COLOR_NB];
     CastlingRights castling;
     Square enPassant;
@@ -25,6 +27,10 @@ struct StateInfo {
     Bitboard checkSquares[PIECE_TYPE_NB];
     int repetition;
     StateInfo* previous;
+
+    // Not copied by do_move(); everything above dirtyPiece is.
+    NNUE::DirtyPiece dirtyPiece;
+    NNUE::Accumulator accumulator;
 };
 
 class Board {
@@ -74,12 +80,26 @@ public:
     Key key() const { return st->positionKey; }
     Key pawn_key() const { return st->pawnKey; }
     Key material_key() const { return st->materialKey; }
+    Key polyglot_key() const { return st->polyglotKey; }
+    // The key do_move(m) will produce, so its TT cluster can be prefetched
+    // before the move is made.
+    Key key_after(Move m) const;
+    // The same for the pawn key; equal to pawn_key() unless m moves,
+    // promotes or captures a pawn.
+    Key pawn_key_after(Move m) const;
 
     EvalScore psqt_score(Color c) const { return st->psqtScore[c]; }
 
+    StateInfo* state() const { return st; }
+
     bool is_draw(int ply) const;
     bool has_repeated() const;
+    bool has_game_cycle(int ply) const;
 
+    // Current-occupancy attacks of the piece on s (empty squares attack
+    // nothing) and of everything on s. Served from the incremental attack
+    // map when built with USE_ATTACK_MAP (make ATTACKMAP=yes).
+    Bitboard attacks_from(Square s) const;
     Bitboard attackers_to(Square s) const;
     Bitboard attackers_to(Square s, Bitboard occupied) const;
 
@@ -109,9 +129,13 @@ private:
     void set_check_info();
     void set_state(StateInfo* si);
 
+    Bitboard stale_attacks(Bitboard changed) const;
+    void refresh_attacks(Bitboard squares);
+
     Key compute_key() const;
     Key compute_pawn_key() const;
     Key compute_material_key() const;
+    Key compute_polyglot_key() const;
 
     Piece board[SQUARE_NB];
     Bitboard byTypeBB[PIECE_TYPE_NB];
@@ -129,10 +153,36 @@ private:
     StateInfo startState;
 
     CastlingRights castlingRightsMask[SQUARE_NB];
+
+#ifdef USE_ATTACK_MAP
+    // attacksFrom[s] is what the piece on s hits; attackersTo[s] is the
+    // transpose. Both follow the current occupancy.
+    Bitboard attacksFrom[SQUARE_NB];
+    Bitboard attackersTo[SQUARE_NB];
+#endif
 };
 
-namespace Position {
-    void init();
+inline Bitboard piece_attacks_bb(Piece pc, Square s, Bitboard occupied) {
+    return type_of(pc) == PAWN ? pawn_attacks_bb(color_of(pc), s)
+                               : attacks_bb(type_of(pc), s, occupied);
+}
+
+#ifdef USE_ATTACK_MAP
+inline Bitboard Board::attacks_from(Square s) const {
+    return attacksFrom[s];
 }
 
+inline Bitboard Board::attackers_to(Square s) const {
+    return attackersTo[s];
+}
+#else
+inline Bitboard Board::attacks_from(Square s) const {
+    return empty(s) ? EMPTY_BB : piece_attacks_bb(piece_on(s), s, pieces());
+}
+
+inline Bitboard Board::attackers_to(Square s) const {
+    return attackers_to(s, pieces());
+}
+#endif
+
 #endif
@@ -3,11 +3,9 @@
 
 #include "board.hpp"
 #include "move.hpp"
+#include <cstdlib>
 #include <string>
 #include <vector>
-#include <fstream>
-#include <random>
-#include <algorithm>
 
 namespace Book {
 
@@ -16,63 +14,31 @@ extern const U64* PolyglotRandomCastling;
 extern const U64* PolyglotRandomEnPassant;
 extern const U64 PolyglotRandomTurn;
 
+// Pawn..king map to 0..5; each takes two slots, black first.
 inline int polyglot_piece(Piece pc) {
     if (pc == NO_PIECE) return -1;
+    return 2 * (type_of(pc) - PAWN) + (color_of(pc) == WHITE ? 1 : 0);
+}
 
-    PieceType pt = type_of(pc);
-    Color c = color_of(pc);
-
-    int base = 0;
-    switch (pt) {
-        case PAWN:   base = 0; break;
-        case KNIGHT: base = 1; break;
-        case BISHOP: base = 2; break;
-        case ROOK:   base = 3; break;
-        case QUEEN:  base = 4; break;
-        case KING:   base = 5; break;
-        default:     return -1;
-    }
+inline U64 polyglot_piece_key(Piece pc, Square s) {
+    return PolyglotRandomPiece[64 * polyglot_piece(pc) + s];
+}
 
-    return base * 2 + (c == WHITE ? 1 : 0);
+// Our CastlingRights bits are laid out like Polyglot's castling index.
+inline U64 polyglot_castling_key(CastlingRights cr) {
+    return PolyglotRandomCastling[cr];
 }
 
+// Board keeps pieces, castling and side to move in StateInfo; only the en
+// passant term is added here, because Polyglot counts it only when a pawn
+// of the side to move can actually capture.
 inline U64 polyglot_key(const Board& board) {
-    U64 key = 0;
-
-    for (Square s = SQ_A1; s <= SQ_H8; ++s) {
-        Piece pc = board.piece_on(s);
-        if (pc != NO_PIECE) {
-            int poly_piece = polyglot_piece(pc);
-            if (poly_piece >= 0) {
-                key ^= PolyglotRandomPiece[64 * poly_piece + s];
-            }
-        }
-    }
-
-    int castling = 0;
-    CastlingRights cr = board.castling_rights();
-    if (cr & WHITE_OO)  castling |= 1;
-    if (cr & WHITE_OOO) castling |= 2;
-    if (cr & BLACK_OO)  castling |= 4;
-    if (cr & BLACK_OOO) castling |= 8;
-    key ^= PolyglotRandomCastling[castling];
+    U64 key = board.polyglot_key();
 
     Square ep = board.en_passant_square();
-    if (ep != SQ_NONE) {
-        File f = file_of(ep);
-        Bitboard pawns = board.pieces(board.side_to_move(), PAWN);
-        Bitboard canCapture = 0;
-        int offset = (board.side_to_move() == WHITE) ? -8 : 8;
-        if (f > FILE_A) canCapture |= square_bb(Square(int(ep) - 1 + offset));
-        if (f < FILE_H) canCapture |= square_bb(Square(int(ep) + 1 + offset));
-
-        if (pawns & canCapture) {
-            key ^= PolyglotRandomEnPassant[f];
-        }
-    }
-
-    if (board.side_to_move() == WHITE) {
-        key ^= PolyglotRandomTurn;
+    if (ep != SQ_NONE
+        && (pawn_attacks_bb(~board.side_to_move(), ep) & board.pieces(board.side_to_move(), PAWN))) {
+        key ^= PolyglotRandomEnPassant[file_of(ep)];
     }
 
     return key;
@@ -118,136 +84,48 @@ struct BookEntry {
     BookEntry() : key(0), move(0), weight(0), learn(0) {}
 };
 
+// Polyglot files are arrays of sorted 16-byte big-endian records. The book
+// maps the file read-only and binary-searches the records in place, so load()
+// does no parsing and every engine process on the host shares the same pages.
 class OpeningBook {
 public:
-    OpeningBook() : loaded(false), variety(true) {}
-
-    bool load(const std::string& filename) {
-        std::ifstream file(filename, std::ios::binary);
-        if (!file.is_open()) {
-            return false;
-        }
-
-        entries.clear();
-
-        while (file) {
-            BookEntry entry;
+    static constexpr size_t RECORD_SIZE = 16;
 
-            U64 key = 0;
-            for (int i = 0; i < 8; ++i) {
-                char c;
-                if (!file.get(c)) break;
-                key = (key << 8) | static_cast<unsigned char>(c);
-            }
-            if (!file) break;
-            entry.key = key;
+    OpeningBook() = default;
+    ~OpeningBook() { close(); }
 
-            char buf[2];
-            file.read(buf, 2);
-            if (!file) break;
-            entry.move = (static_cast<unsigned char>(buf[0]) << 8) |
-                          static_cast<unsigned char>(buf[1]);
+    OpeningBook(const OpeningBook&) = delete;
+    OpeningBook& operator=(const OpeningBook&) = delete;
 
-            file.read(buf, 2);
-            if (!file) break;
-            entry.weight = (static_cast<unsigned char>(buf[0]) << 8) |
-                            static_cast<unsigned char>(buf[1]);
-            char learn_buf[4];
-            file.read(learn_buf, 4);
-            if (!file) break;
-
-            entries.push_back(entry);
-        }
-
-        std::sort(entries.begin(), entries.end(),
-            [](const BookEntry& a, const BookEntry& b) {
-                return a.key < b.key;
-            });
-
-        loaded = !entries.empty();
-        return loaded;
-    }
+    bool load(const std::string& filename);
+    void close();
 
-    bool is_loaded() const { return loaded; }
+    bool is_loaded() const { return count > 0; }
+    bool is_mapped() const { return mapped; }
 
-    size_t size() const { return entries.size(); }
+    size_t size() const { return count; }
     void set_variety(bool v) { variety = v; }
 
-    Move probe(const Board& board) const {
-        if (!loaded) return MOVE_NONE;
+    BookEntry entry(size_t i) const;
 
-        U64 key = polyglot_key(board);
-        auto lower = std::lower_bound(entries.begin(), entries.end(), key,
-            [](const BookEntry& e, U64 k) { return e.key < k; });
-
-        if (lower == entries.end() || lower->key != key) {
-            return MOVE_NONE;
-        }
-
-        std::vector<std::pair<Move, int>> moves;
-        for (auto it = lower; it != entries.end() && it->key == key; ++it) {
-            Move m = decode_polyglot_move(board, it->move);
-            if (m != MOVE_NONE) {
-                moves.push_back({m, it->weight});
-            }
-        }
-
-        if (moves.empty()) {
-            return MOVE_NONE;
-        }
-
-        if (variety && moves.size() > 1) {
-            int totalWeight = 0;
-            for (const auto& mv : moves) {
-                totalWeight += mv.second;
-            }
-
-            static std::random_device rd;
-            static std::mt19937 gen(rd());
-            std::uniform_int_distribution<> dis(0, totalWeight - 1);
-
-            int pick = dis(gen);
-            int cumulative = 0;
-            for (const auto& mv : moves) {
-                cumulative += mv.second;
-                if (pick < cumulative) {
-                    return mv.first;
-                }
-            }
-        }
-
-        auto best = std::max_element(moves.begin(), moves.end(),
-            [](const auto& a, const auto& b) { return a.second < b.second; });
-
-        return best->first;
-    }
-
-    std::vector<std::pair<Move, int>> get_moves(const Board& board) const {
-        std::vector<std::pair<Move, int>> moves;
-        if (!loaded) return moves;
-
-        U64 key = polyglot_key(board);
-
-        auto lower = std::lower_bound(entries.begin(), entries.end(), key,
-            [](const BookEntry& e, U64 k) { return e.key < k; });
-
-        for (auto it = lower; it != entries.end() && it->key == key; ++it) {
-            Move m = decode_polyglot_move(board, it->move);
-            if (m != MOVE_NONE) {
-                moves.push_back({m, it->weight});
-            }
-        }
-
-        std::sort(moves.begin(), moves.end(),
-            [](const auto& a, const auto& b) { return a.second > b.second; });
-
-        return moves;
-    }
+    Move probe(const Board& board) const;
+    std::vector<std::pair<Move, int>> get_moves(const Board& board) const;
 
 private:
-    std::vector<BookEntry> entries;
-    bool loaded;
-    bool variety;
+    size_t lower_bound(U64 key) const;
+    U64 key_at(size_t i) const;
+
+    const unsigned char* data = nullptr;
+    size_t count = 0;
+    size_t bytes = 0;
+    bool mapped = false;
+    bool variety = true;
+
+    // Used only where the file cannot be mapped.
+    std::vector<unsigned char> buffer;
+#ifdef _WIN32
+    void* mapping = nullptr;
+#endif
 };
 
 extern OpeningBook book;
@@ -9,8 +9,12 @@
 #include <vector>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
 #include <fstream>
 #include <cstdint>
+#include <cstdio>
 
 namespace DataGen {
 
@@ -33,9 +37,23 @@ constexpr uint8_t PTYPE_EMPTY = 0;
 constexpr uint8_t PTYPE_WP = 1, PTYPE_WN = 2, PTYPE_WB = 3, PTYPE_WR = 4, PTYPE_WQ = 5, PTYPE_WK = 6;
 constexpr uint8_t PTYPE_BP = 7, PTYPE_BN = 8, PTYPE_BB = 9, PTYPE_BR = 10, PTYPE_BQ = 11, PTYPE_BK = 12;
 
+// raw: one 40-byte TrainingEntry per position. chain: a file header, then one
+// record per game holding the start position, each move as an index into the
+// sorted legal move list, a bit per ply marking recorded positions, and
+// varint score deltas; readers replay the game to rebuild the entries.
+enum class BinpackFormat {
+    raw,
+    chain
+};
+
+BinpackFormat detect_format(const std::string& path);
+
 struct DataGenConfig {
     int threads = 2;
-    int hash_mb = 64;
+    int hash_mb = 64;            // Split evenly into one private TT per worker
+    uint64_t seed = 0;           // 0 picks one from the clock
+    int shard_index = 0;         // shard=<i>/<n>: this machine's share of a multi-node run
+    int shard_count = 1;
 
     int depth = 8;
     int nodes = 0;
@@ -62,7 +80,9 @@ struct DataGenConfig {
     int search_margin = 70;
 
     std::string output = "data/training.binpack";
-    int flush_interval = 10000;
+    BinpackFormat format = BinpackFormat::raw;
+    int flush_interval = 4096;  // Raw entries' worth of bytes a worker batches per hand-off
+    int sync_mb = 0;            // fdatasync after this many MB written; 0 leaves it to the OS
 
     bool use_book = true;
     std::string book_path = "book/Perfect2023.bin";
@@ -101,6 +121,90 @@ enum class GameResult {
     draw = 3
 };
 
+// Every move a datagen game played from its start position, and the ply at
+// which each recorded entry was taken (the position before that ply's move).
+struct GameRecord {
+    std::vector<Move> moves;
+    std::vector<int> recorded_plies;
+
+    void clear() { moves.clear(); recorded_plies.clear(); }
+};
+
+// Appends one chained game record for entries taken from record's game,
+// which must start from the standard start position.
+void encode_chain_game(const std::vector<TrainingEntry>& entries, const GameRecord& record,
+                       std::vector<uint8_t>& out);
+
+// Output side of datagen. Each worker owns a slot: it appends finished games
+// to a private buffer and, once a batch is full, passes the buffer to the
+// writer thread through a single-producer ring; the writer hands empty
+// buffers back through a second ring. Workers never lock or wait for I/O:
+// if the writer falls behind they keep filling the buffer they have.
+class BinpackWriter {
+public:
+    BinpackWriter() = default;
+    ~BinpackWriter() { close(); }
+
+    BinpackWriter(const BinpackWriter&) = delete;
+    BinpackWriter& operator=(const BinpackWriter&) = delete;
+
+    bool open(const std::string& path, int producers, size_t batch_bytes, size_t sync_bytes);
+
+    // Drains every slot, then joins the writer. Producers must have stopped.
+    // Returns false if any write, sync or the final close failed.
+    bool close();
+
+    bool is_open() const { return file != nullptr; }
+    bool failed() const { return ioError.load(std::memory_order_relaxed); }
+    uint64_t bytes_written() const { return written.load(std::memory_order_relaxed); }
+
+    void append(int producer, const void* data, size_t size);
+
+    // Hands over a partly filled batch; waits only if the ring is full.
+    void flush(int producer);
+
+private:
+    using Buffer = std::vector<uint8_t>;
+    static constexpr size_t RING_SIZE = 8;
+    // A producer whose ring is full keeps filling its buffer up to this
+    // many batches, then waits for the writer.
+    static constexpr size_t MAX_FILL_BATCHES = 4;
+
+    struct Ring {
+        Buffer* items[RING_SIZE] = {};
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+
+        bool push(Buffer* b);
+        Buffer* pop();
+    };
+
+    struct alignas(64) Slot {
+        Buffer* filling = nullptr;
+        Ring full;
+        Ring empty;
+    };
+
+    bool hand_over(Slot& slot);
+    void wait_hand_over(Slot& slot);
+    size_t drain();
+    void report_error(const char* what);
+    void writer_loop();
+
+    std::FILE* file = nullptr;
+    std::vector<std::unique_ptr<Slot>> slots;
+    size_t batchBytes = 0;
+    size_t syncBytes = 0;
+    size_t unsynced = 0;
+    std::atomic<uint64_t> written{0};
+    std::atomic<bool> ioError{false};
+
+    std::thread writer;
+    std::atomic<bool> closing{false};
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+};
+
 class DataGenerator {
 public:
     DataGenerator(const DataGenConfig& config);
@@ -119,11 +223,10 @@ private:
     std::atomic<bool> running{false};
     std::atomic<bool> stop_requested{false};
 
-    std::ofstream m_output;
-    std::mutex m_output_mutex;
+    BinpackWriter m_output;
 
     void worker_thread(int thread_id);
-    GameResult play_game(std::vector<TrainingEntry>& entries, int thread_id);
+    GameResult play_game(std::vector<TrainingEntry>& entries, GameRecord& record, int thread_id);
 
     TrainingEntry encode_position(const Board& board, int score, GameResult result);
 
@@ -132,15 +235,84 @@ private:
 
     bool should_record_position(Board& board, int static_eval, int search_score, int ply, Move best_move, int thread_id);
 
-    void write_entries(const std::vector<TrainingEntry>& entries);
-    void flush_output();
 
+    void begin_game(int thread_id, uint64_t game_num);
+
+    // Games this shard plays out of the run's global game numbers.
+    uint64_t shard_games() const {
+        uint64_t n = uint64_t(m_config.shard_count), i = uint64_t(m_config.shard_index);
+        return (uint64_t(m_config.games) + n - 1 - i) / n;
+    }
+
+    uint64_t m_base_seed = 0;
     std::vector<uint64_t> m_random_seeds;
     uint64_t rand_next(int thread_id);
     int rand_int(int thread_id, int max);
+    std::vector<std::unique_ptr<TranspositionTable>> m_tables;
     std::vector<std::unique_ptr<Search>> m_searchers;
 };
 
+// Read-only memory mapping of a binpack file. Entries are addressed in place,
+// so tools can walk files far larger than RAM in constant memory.
+class BinpackView {
+public:
+    BinpackView() = default;
+    explicit BinpackView(const std::string& path) { open(path); }
+    ~BinpackView() { close(); }
+
+    BinpackView(const BinpackView&) = delete;
+    BinpackView& operator=(const BinpackView&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    bool is_open() const { return opened; }
+    size_t size() const { return count; }
+    size_t file_size() const { return bytes; }
+
+    const TrainingEntry& operator[](size_t i) const { return entries[i]; }
+    const TrainingEntry* begin() const { return entries; }
+    const TrainingEntry* end() const { return entries + count; }
+
+    const uint8_t* data() const { return reinterpret_cast<const uint8_t*>(entries); }
+
+private:
+    const TrainingEntry* entries = nullptr;
+    size_t count = 0;
+    size_t bytes = 0;
+    bool opened = false;
+#ifdef _WIN32
+    void* mapping = nullptr;
+#endif
+};
+
+// Streams the entries of a file in either BinpackFormat, in file order.
+class BinpackReader {
+public:
+    explicit BinpackReader(const std::string& path);
+
+    bool is_open() const { return view.is_open(); }
+    BinpackFormat format() const { return fileFormat; }
+    size_t file_size() const { return view.file_size(); }
+
+    // Entries in the whole file; chained files are counted from their
+    // record headers without decoding any moves.
+    uint64_t count_entries() const;
+
+    bool next(TrainingEntry& entry);
+
+private:
+    bool decode_game();
+
+    BinpackView view;
+    BinpackFormat fileFormat = BinpackFormat::raw;
+    size_t pos = 0;
+
+    std::vector<TrainingEntry> game;
+    size_t gameIndex = 0;
+    std::vector<StateInfo> states;
+};
+
 void to_marlinformat(const TrainingEntry& entry, std::vector<uint8_t>& output);
 
 void start(const DataGenConfig& config);
@@ -153,6 +325,7 @@ DataGenConfig parse_config(std::istringstream& is);
 bool read_binpack_file(const std::string& path, std::vector<TrainingEntry>& entries, size_t max_entries = 0);
 void view_binpack_file(const std::string& path, size_t count = 10, size_t offset = 0);
 bool convert_to_epd(const std::string& binpack_path, const std::string& epd_path, size_t max_entries = 0);
+bool export_features(const std::string& binpack_path, const std::string& csv_path, size_t max_entries = 0);
 
 struct FileStats {
     size_t total_entries = 0;
@@ -162,6 +335,8 @@ struct FileStats {
     int64_t total_score = 0;
     int min_score = 0;
     int max_score = 0;
+    size_t file_size = 0;
+    bool chained = false;
 };
 bool get_file_stats(const std::string& path, FileStats& stats);
 
@@ -197,6 +372,28 @@ struct FilterStats {
 bool filter_binpack(const FilterConfig& config, FilterStats& stats);
 FilterConfig parse_filter_config(std::istringstream& is);
 
+// Streams any number of binpacks (either format) into one raw file: inputs
+// are interleaved at random, repeated positions are dropped through a
+// fixed-size table of position hashes, and a shuffle buffer decorrelates
+// neighbouring entries. Memory is bounded by dedup_mb plus the buffer.
+struct MergeConfig {
+    std::vector<std::string> inputs;
+    std::string output_path;
+    size_t shuffle_size = 1 << 20;
+    bool dedup = true;
+    size_t dedup_mb = 256;
+    uint64_t seed = 0;
+};
+
+struct MergeStats {
+    size_t total_read = 0;
+    size_t duplicates = 0;
+    size_t written = 0;
+};
+
+bool merge_binpacks(const MergeConfig& config, MergeStats& stats);
+MergeConfig parse_merge_config(std::istringstream& is);
+
 }
 
 #endif
@@ -5,13 +5,17 @@
 #include "magic.hpp"
 #include <algorithm>
 #include <cstring>
+#include <vector>
 #include "tuning.hpp"
+#include "tt.hpp"
 
 namespace Eval {
 
 constexpr int ATTACK_PIECE_TYPES = PIECE_TYPE_NB + 1;
 constexpr int ALL_PIECES = PIECE_TYPE_NB;
 
+struct PawnEntry;
+
 struct EvalContext {
     Bitboard attackedBy[COLOR_NB][ATTACK_PIECE_TYPES];
     Bitboard attackedBy2[COLOR_NB];
@@ -24,6 +28,7 @@ struct EvalContext {
     int innerRingAttacks[COLOR_NB];
     int outerRingAttacks[COLOR_NB];
     Bitboard mobilityArea[COLOR_NB];
+    const PawnEntry* pawns;
     bool initialized;
 
     EvalContext() : initialized(false) { clear(); }
@@ -44,21 +49,51 @@ struct EvalContext {
             outerRingAttacks[c] = 0;
             mobilityArea[c] = 0;
         }
+        pawns = nullptr;
         initialized = false;
     }
 };
 
-void init_eval_context(EvalContext& ctx, const Board& board);
+// The Tuning:: terms counted by an eval trace.
+enum TraceTerm {
+    TRACE_PAWN_VALUE,
+    TRACE_KNIGHT_VALUE,
+    TRACE_BISHOP_VALUE,
+    TRACE_ROOK_VALUE,
+    TRACE_QUEEN_VALUE,
+    TRACE_BISHOP_PAIR,
+    TRACE_ROOK_OPEN_FILE,
+    TRACE_ROOK_SEMI_OPEN_FILE,
+    TRACE_ROOK_ON_SEVENTH,
+    TRACE_KNIGHT_OUTPOST,
+    TRACE_ISOLATED_PAWN,
+    TRACE_DOUBLED_PAWN,
+    TRACE_BACKWARD_PAWN,
+    TRACE_CONNECTED_PAWN,
+    TRACE_PHALANX,
+    TRACE_TERM_NB
+};
+
+extern const char* const TraceTermNames[TRACE_TERM_NB];
+
+// Filled by the Trace instantiation of the evaluation: how many times each
+// term was added for each colour, and the king danger that KingSafetyWeight
+// scales (mg only). The eval is linear in the terms, weighted by phase.
+struct EvalTrace {
+    int terms[TRACE_TERM_NB][COLOR_NB];
+    int kingDanger[COLOR_NB];
+    int phase;
+};
+
+// Helpers taking a Trace flag record into the trace only when it is true;
+// the default instantiation is the plain evaluation.
+void init_eval_context(EvalContext& ctx, const Board& board, const PawnEntry* pawns = nullptr);
+template<bool Trace = false>
 EvalScore eval_pieces_with_context(const Board& board, Color c, EvalContext& ctx);
+template<bool Trace = false>
 EvalScore eval_king_safety_with_context(const Board& board, Color c, EvalContext& ctx);
 EvalScore eval_threats_with_context(const Board& board, Color c, EvalContext& ctx);
 
-using Tuning::PawnValue;
-using Tuning::KnightValue;
-using Tuning::BishopValue;
-using Tuning::RookValue;
-using Tuning::QueenValue;
-
 constexpr int PhaseValue[PIECE_TYPE_NB] = {
     0,
     0,
@@ -166,12 +201,6 @@ constexpr EvalScore ConnectedPassedBonus[8] = {
     S( 25,  45), S( 40,  70), S( 60, 100), S(  0,   0)
 };
 
-using Tuning::IsolatedPawnPenalty;
-using Tuning::DoubledPawnPenalty;
-using Tuning::BackwardPawnPenalty;
-using Tuning::ConnectedPawnBonus;
-using Tuning::PhalanxBonus;
-
 constexpr EvalScore CandidatePassedBonus[8] = {
     S(  0,   0), S(  3,   5), S(  5,  10), S( 10,  20),
     S( 20,  40), S( 35,  60), S( 50,  90), S(  0,   0)
@@ -203,12 +232,6 @@ constexpr EvalScore BackwardOnHalfOpen = S(-10, -5);
 constexpr EvalScore KingSemiOpenFilePenalty = S( 15, 0);
 constexpr EvalScore KingOpenFilePenalty     = S( 25, 0);
 
-using Tuning::BishopPairBonus;
-using Tuning::RookOpenFileBonus;
-using Tuning::RookSemiOpenFileBonus;
-using Tuning::RookOnSeventhBonus;
-using Tuning::KnightOutpostBonus;
-
 constexpr EvalScore KnightMobility[9] = {
     S(-30, -40), S(-15, -20), S( -5, -10), S(  0,  0),
     S(  5,   5), S( 10,  10), S( 15,  15), S( 18, 18),
@@ -397,6 +420,7 @@ Square pawn_push(Color c, Square s);
 bool is_backward_pawn(Color c, Square s, Bitboard ourPawns, Bitboard theirPawns);
 
 EvalScore eval_material_pst(const Board& board, Color c);
+template<bool Trace = false>
 EvalScore eval_pawn_structure(const Board& board, Color c);
 EvalScore eval_pieces(const Board& board, Color c);
 EvalScore eval_king_safety(const Board& board, Color c);
@@ -418,12 +442,14 @@ inline EvalScore piece_pst_score(Piece pc, Square sq) {
     PieceType pt = type_of(pc);
     Square psq = c == WHITE ? sq : Square(sq ^ 56);
 
+    const Tuning::Params& params = Tuning::active();
+
     switch (pt) {
-        case PAWN:   return PawnValue + PawnPST[psq];
-        case KNIGHT: return KnightValue + KnightPST[psq];
-        case BISHOP: return BishopValue + BishopPST[psq];
-        case ROOK:   return RookValue + RookPST[psq];
-        case QUEEN:  return QueenValue + QueenPST[psq];
+        case PAWN:   return params.PawnValue + PawnPST[psq];
+        case KNIGHT: return params.KnightValue + KnightPST[psq];
+        case BISHOP: return params.BishopValue + BishopPST[psq];
+        case ROOK:   return params.RookValue + RookPST[psq];
+        case QUEEN:  return params.QueenValue + QueenPST[psq];
         case KING:   return EvalScore(KingPSTMG[psq], KingPSTEG[psq]);
         default:     return EvalScore(0, 0);
     }
@@ -432,35 +458,182 @@ inline EvalScore piece_pst_score(Piece pc, Square sq) {
 struct PawnEntry {
     Key key;
     EvalScore score;
+    Bitboard passedPawns[COLOR_NB];
+    Bitboard pawnAttacks[COLOR_NB];
+    U8 semiopenFiles[COLOR_NB];
 
     bool match(Key k) const { return key == k; }
+
+    bool semiopen_file(Color c, File f) const { return semiopenFiles[c] & (1 << f); }
 };
 
 class PawnTable {
 public:
-    static constexpr int SIZE = 16384;
-    static constexpr int MASK = SIZE - 1;
+    static constexpr int DEFAULT_SIZE_MB = 2;
+
+    PawnTable() { resize(DEFAULT_SIZE_MB); }
+
+    void resize(size_t mb) {
+        size_t count = std::max<size_t>(1, mb * 1024 * 1024 / sizeof(PawnEntry));
+        size_t size = 1;
+        while (size * 2 <= count) size *= 2;
+        table.assign(size, empty_entry());
+        mask = size - 1;
+    }
 
     void clear() {
-        for (int i = 0; i < SIZE; ++i) {
-            table[i].key = 0;
-            table[i].score = S(0, 0);
-        }
+        std::fill(table.begin(), table.end(), empty_entry());
     }
 
     PawnEntry* probe(Key key) {
+        return &table[key & mask];
+    }
+
+    void prefetch(Key key) const {
+        #if defined(_MM_HINT_T0)
+        _mm_prefetch((const char*)&table[key & mask], _MM_HINT_T0);
+        #elif defined(__GNUC__)
+        __builtin_prefetch(&table[key & mask]);
+        #endif
+    }
+
+    size_t size() const { return table.size(); }
+
+private:
+    // Key 0 is the pawn key of a pawnless position, so an empty slot must
+    // already describe one: no pawns and every file semi-open.
+    static PawnEntry empty_entry() {
+        PawnEntry e{};
+        e.semiopenFiles[WHITE] = e.semiopenFiles[BLACK] = 0xFF;
+        return e;
+    }
+
+    std::vector<PawnEntry> table;
+    size_t mask = 0;
+};
+
+PawnEntry* probe_pawns(const Board& board, PawnTable& pawns);
+
+enum MaterialDraw : U8 {
+    MATERIAL_DRAW_NONE,
+    MATERIAL_DRAW_ALWAYS,
+    MATERIAL_DRAW_OPPOSITE_BISHOPS
+};
+
+// Endings scored exactly (or by a dedicated rule) instead of by the eval.
+enum MaterialEndgame : U8 {
+    ENDGAME_NONE,
+    ENDGAME_KPK,
+    ENDGAME_KBNK,
+    ENDGAME_KXK
+};
+
+// Below the tablebase range, so a known win never passes for a proven one.
+constexpr int VALUE_KNOWN_WIN = 10000;
+
+struct MaterialEntry {
+    Key key;
+    EvalScore imbalance;
+    U8 phase;
+    U8 scaleFactor;
+    MaterialDraw draw;
+    MaterialEndgame endgame;
+    Color strongSide;
+
+    bool match(Key k) const { return key == k; }
+
+    bool is_draw(const Board& board) const {
+        if (draw == MATERIAL_DRAW_NONE) return false;
+        if (draw == MATERIAL_DRAW_ALWAYS) return true;
+        Square wb = lsb(board.pieces(WHITE, BISHOP));
+        Square bb = lsb(board.pieces(BLACK, BISHOP));
+        return ((file_of(wb) + rank_of(wb)) % 2) != ((file_of(bb) + rank_of(bb)) % 2);
+    }
+};
+
+class MaterialTable {
+public:
+    static constexpr int SIZE = 8192;
+    static constexpr int MASK = SIZE - 1;
+
+    MaterialTable() : table(SIZE) { clear(); }
+
+    void clear() {
+        std::fill(table.begin(), table.end(), MaterialEntry{});
+    }
+
+    MaterialEntry* probe(Key key) {
         return &table[key & MASK];
     }
 
 private:
-    PawnEntry table[SIZE];
+    std::vector<MaterialEntry> table;
+};
+
+MaterialEntry* probe_material(const Board& board, MaterialTable& material);
+
+// Score of a material.endgame position for the side to move.
+int evaluate_endgame(const Board& board, const MaterialEntry& material);
+
+struct EvalCacheEntry {
+    U32 key32;
+    S32 score;
+};
+
+class EvalCache {
+public:
+    static constexpr int DEFAULT_SIZE_MB = 2;
+
+    EvalCache() { resize(DEFAULT_SIZE_MB); }
+
+    void resize(size_t mb) {
+        size_t count = std::max<size_t>(1, mb * 1024 * 1024 / sizeof(EvalCacheEntry));
+        size_t size = 1;
+        while (size * 2 <= count) size *= 2;
+        table.assign(size, EvalCacheEntry{0, VALUE_NONE});
+        mask = size - 1;
+    }
+
+    void clear() {
+        std::fill(table.begin(), table.end(), EvalCacheEntry{0, VALUE_NONE});
+    }
+
+    bool probe(Key key, int& score) const {
+        const EvalCacheEntry& e = table[key & mask];
+        if (e.key32 != U32(key >> 32) || e.score == VALUE_NONE) return false;
+        score = e.score;
+        return true;
+    }
+
+    void store(Key key, int score) {
+        table[key & mask] = EvalCacheEntry{U32(key >> 32), score};
+    }
+
+private:
+    std::vector<EvalCacheEntry> table;
+    size_t mask = 0;
 };
 
-extern PawnTable pawnTable;
+struct LazyStats {
+    U64 exits = 0;
+    U64 spotChecks = 0;
+    U64 spotCheckMisses = 0;
+
+    void reset() {
+        exits = 0;
+        spotChecks = 0;
+        spotCheckMisses = 0;
+    }
+};
 
+int evaluate(const Board& board, PawnTable& pawns, const MaterialEntry& material,
+             int alpha, int beta, LazyStats& lazy);
 int evaluate(const Board& board, int alpha, int beta);
 int evaluate(const Board& board);
+template<bool Trace = false>
 int evaluate_no_cache(const Board& board);
+// evaluate_no_cache() that also fills in the coefficients of every tuned term.
+int trace(const Board& board, EvalTrace& trace);
 int material_balance(const Board& board);
 
 }
@@ -0,0 +1,29 @@
+#ifndef IO_HPP
+#define IO_HPP
+
+#include <functional>
+#include <string>
+
+namespace IO {
+
+// Routes std::cout through a queue drained by a writer thread. Each thread
+// assembles its own lines and hands over only finished ones (or whatever it
+// has on an explicit flush), so lines from different threads never mix and
+// printing costs a lock instead of a write; the writer passes everything
+// queued since its last wake to the OS in one write. Stopped at exit.
+void start_output();
+void stop_output();
+
+// Reads stdin on a thread of its own. on_line runs there for every line as
+// it arrives, before the line is queued for read_line, so commands such as
+// stop take effect even while the command loop is busy. The reader ends
+// after "quit" or at end of input.
+void start_input(std::function<void(const std::string&)> on_line);
+
+// Blocks for the next line; false once input has ended and all lines are
+// consumed.
+bool read_line(std::string& line);
+
+}
+
+#endif
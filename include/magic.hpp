@@ -2,23 +2,32 @@
 #define MAGIC_HPP
 
 #include "bitboard.hpp"
-
-#ifdef USE_PEXT
 #include "pext.hpp"
-#endif
+#include <string>
+
+namespace Magics {
+
+enum Backend { BLACK_MAGIC, PEXT };
+
+// Picked by init() from the CPU we run on; the lookup branches on it, which
+// predicts perfectly because it never changes during a search.
+extern Backend backend;
+
+}
 
 struct Magic {
     Bitboard  mask;
     Bitboard  magic;
-    Bitboard* attacks;
+    const Bitboard* attacks;
     int       shift;
 
+    // Black magics multiply (occupied | ~mask), which lets the per-square
+    // tables overlap in one shared array.
     unsigned index(Bitboard occupied) const {
-#ifdef USE_PEXT
-        return static_cast<unsigned>(pext(occupied, mask));
-#else
-        return static_cast<unsigned>(((occupied & mask) * magic) >> shift);
-#endif
+        if (Magics::backend == Magics::PEXT) {
+            return static_cast<unsigned>(pext(occupied, mask));
+        }
+        return static_cast<unsigned>(((occupied | ~mask) * magic) >> shift);
     }
 };
 
@@ -49,7 +58,16 @@ inline Bitboard attacks_bb(PieceType pt, Square s, Bitboard occupied) {
 }
 
 namespace Magics {
+    // PEXT when the CPU has BMI2 and executes it in hardware (not the
+    // microcoded PEXT of AMD before Zen 3), black magics otherwise.
     void init();
+    void init(Backend b);
+
+    bool pext_supported();
+    bool pext_fast();
+
+    // Backend in use plus the size of its attack table, for bench and info.
+    std::string describe();
 }
 
 #endif
@@ -0,0 +1,38 @@
+#ifndef MICROBENCH_HPP
+#define MICROBENCH_HPP
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace MicroBench {
+
+// Replays a fixed corpus through one kernel at a time (make/unmake, move
+// generation, SEE, evaluation) so a slowdown can be pinned on a hot path
+// rather than read off end-to-end NPS. Each kernel gets a warm-up pass and
+// then several timed samples; the fastest sample is the baseline, the
+// median shows how noisy the machine was.
+struct Config {
+    std::vector<std::string> files;   // Empty: every tests/*.epd
+    std::vector<std::string> kernels; // Empty: all of them
+    int samples = 7;
+    int sampleMs = 20;
+};
+
+struct Result {
+    std::string kernel;
+    uint64_t opsPerPass = 0;
+    double nsPerOp = 0;               // Fastest sample
+    double medianNsPerOp = 0;
+    double ticksPerOp = 0;            // Time-stamp counter ticks, fastest sample
+};
+
+std::vector<Result> run(const Config& config);
+void print(const std::vector<Result>& results);
+
+Config parse_config(std::istringstream& is);
+
+}
+
+#endif
@@ -23,6 +23,15 @@ public:
     static void generate_checking_moves(const Board& board, MoveList& moves);
     static void generate_legal(const Board& board, MoveList& moves);
 
+    // Strictly legal generation from the check mask and pin rays: nothing it
+    // returns needs is_legal(). Type is CAPTURES, QUIETS or LEGAL; in check
+    // every type is restricted to evasions.
+    template<GenType Type>
+    static void generate(const Board& board, MoveList& moves);
+
+    // Leaf nodes at depth, counting the last ply from the list size.
+    static U64 perft(Board& board, int depth);
+
     static bool is_pseudo_legal(const Board& board, Move m);
     static bool is_legal(const Board& board, Move m);
     static bool gives_check(const Board& board, Move m);
@@ -41,6 +50,12 @@ private:
     template<Color Us>
     static void generate_castling(const Board& board, MoveList& moves);
 
+    template<Color Us>
+    static void generate_legal_pawns(const Board& board, MoveList& moves, Bitboard pawns, Bitboard target);
+
+    template<Color Us, GenType Type>
+    static void generate_legal_moves(const Board& board, MoveList& moves);
+
     static void add_pawn_moves(MoveList& moves, Square from, Square to, bool is_capture);
     static void add_promotions(MoveList& moves, Square from, Square to);
 };
@@ -5,6 +5,7 @@
 #include "move.hpp"
 #include "tt.hpp"
 #include "search_constants.hpp"
+#include "optimize.hpp"
 
 // ============================================================================
 // Move Ordering Scores (using int32_t for efficient range)
@@ -26,6 +27,10 @@ constexpr int32_t SCORE_COUNTER        = 8000000;
 constexpr int32_t SCORE_HISTORY_MAX    = 7000000;
 constexpr int32_t SCORE_LOSING_CAP     = -10000000;
 
+// Quiets scoring at least this (times depth) are insertion-sorted up front;
+// the rest are picked lazily since they are usually pruned before use.
+constexpr int32_t QUIET_SORT_LIMIT_PER_DEPTH = -3560;
+
 constexpr int32_t EQUAL_CAP_QUEEN_BONUS  = 5000;
 constexpr int32_t EQUAL_CAP_ROOK_BONUS   = 3000;
 constexpr int32_t EQUAL_CAP_BISHOP_BONUS = 1500;
@@ -60,8 +65,10 @@ public:
     static bool see_ge(const Board& board, Move m, int threshold = 0);
 
 private:
-    static PieceType min_attacker(const Board& board, Color side, Square sq,
-                                  Bitboard occupied, Bitboard& attackers);
+    // Least valuable attacker of `side` among `attackers`; removes it from
+    // `occupied` and adds the sliders it was hiding.
+    static PieceType min_attacker(const Board& board, Color side, Square to,
+                                  Bitboard& occupied, Bitboard& attackers);
 };
 
 // ============================================================================
@@ -209,6 +216,15 @@ private:
 // Uses butterfly boards: indexed by [color][from_square][to_square]
 // ============================================================================
 
+// Quiet-move histories are stored as S16, halving their cache footprint.
+// The gravity update keeps every value within +-MAX_HISTORY as long as no
+// single bonus exceeds it, so bonuses are clamped to that and the sums are
+// formed in int.
+inline void update_history(S16& entry, int bonus, int maxHistory) {
+    bonus = std::clamp(bonus, -maxHistory, maxHistory);
+    entry = S16(entry + bonus - entry * std::abs(bonus) / maxHistory);
+}
+
 // Cache-aligned History Table (butterfly boards)
 class alignas(64) HistoryTable {
 public:
@@ -251,11 +267,15 @@ public:
         return table[c][m.from()][m.to()];
     }
 
+    const S16* entry(Color c, Move m) const {
+        return &table[c][m.from()][m.to()];
+    }
+
 private:
-    alignas(64) int table[COLOR_NB][SQUARE_NB][SQUARE_NB];
+    alignas(64) S16 table[COLOR_NB][SQUARE_NB][SQUARE_NB];
 
-    void update_score(int& entry, int bonus) {
-        entry += bonus - entry * std::abs(bonus) / MAX_HISTORY;
+    void update_score(S16& entry, int bonus) {
+        update_history(entry, bonus, MAX_HISTORY);
     }
 };
 
@@ -279,9 +299,12 @@ public:
         return table[pt][to];
     }
 
+    const S16* entry(PieceType pt, Square to) const {
+        return &table[pt][to];
+    }
+
     void update(PieceType pt, Square to, int bonus) {
-        int& entry = table[pt][to];
-        entry += bonus - entry * std::abs(bonus) / MAX_HISTORY;
+        update_history(table[pt][to], bonus, MAX_HISTORY);
     }
 
     void update_with_depth(PieceType pt, Square to, int depth, bool isCutoff, int weight = 1) {
@@ -291,17 +314,22 @@ public:
         } else {
             bonus = -std::min(80 + 145 * depth + 8 * depth * depth, 1900);
         }
-        bonus = bonus * weight;
-        int& entry = table[pt][to];
-        entry += bonus - entry * std::abs(bonus) / MAX_HISTORY;
+        update_history(table[pt][to], bonus * weight, MAX_HISTORY);
     }
 
-    int& operator()(PieceType pt, Square to) {
+    S16& operator()(PieceType pt, Square to) {
         return table[pt][to];
     }
 
+    // The entry's lines, ahead of the child node's move scoring.
+    void prefetch() const {
+        for (size_t offset = 0; offset < sizeof(table); offset += 64) {
+            PREFETCH_READ(reinterpret_cast<const char*>(table) + offset);
+        }
+    }
+
 private:
-    alignas(64) int table[PIECE_TYPE_NB][SQUARE_NB];
+    alignas(64) S16 table[PIECE_TYPE_NB][SQUARE_NB];
 };
 
 class alignas(64) ContinuationHistory {
@@ -530,13 +558,17 @@ public:
                const HistoryTable& ht, Move prevMove,
                const ContinuationHistoryEntry* contHist1 = nullptr,
                const ContinuationHistoryEntry* contHist2 = nullptr,
-               const CaptureHistory* captHist = nullptr);
+               const CaptureHistory* captHist = nullptr, int depth = 0);
 
     MovePicker(const Board& b, const Move* ttMoves, int ttMoveCount, const HistoryTable& ht);
 
     MovePicker(const Board& b, const Move* ttMoves, int ttMoveCount, const HistoryTable& ht,
                const CaptureHistory* captHist);
 
+    ~MovePicker();
+    MovePicker(const MovePicker&) = delete;
+    MovePicker& operator=(const MovePicker&) = delete;
+
     Move next_move();
 
 private:
@@ -548,17 +580,23 @@ private:
     const ContinuationHistoryEntry* contHist2ply;
     const CaptureHistory* captureHist;
 
-    Move ttMoves[3];
+    Move ttMoves[MAX_TT_MOVES];
     int ttMoveCount;
     int ttMoveIdx;
 
     Move killer1, killer2;
     Move counterMove;
 
-    MoveList moves;
-    MoveList badCaptures;
-    MoveList equalCaptures;
-    MoveList quietChecks;
+    // One buffer, borrowed from a per-thread stack, holds every stage:
+    //   captures, then bad-capture copies, then quiet checks; once the quiet
+    //   stage starts it is repacked as equal captures, bad captures, quiets.
+    MoveList& moves;
+    int captureEnd;
+    int badBegin, badEnd;
+    int checkBegin, checkEnd;
+    int equalEnd;
+    int quietBegin;
+    int sortedEnd;
 
     static constexpr int MAX_QUIET_CHECKS = 32;
     Move quietCheckMoves[MAX_QUIET_CHECKS];
@@ -569,13 +607,15 @@ private:
     int quietCheckIdx;
     int badCaptureIdx;
     int ply;
+    int depth;
 
     MovePickStage stage;
 
     void score_captures();
     void score_quiets();
     void score_quiet_checks();
-    Move pick_best();
+    Move pick_best(int end);
+    void partial_insertion_sort(int begin, int end, int limit);
     bool is_tt_move(Move m) const;
     bool is_quiet_check(Move m) const;
 };
@@ -0,0 +1,53 @@
+#ifndef NNUE_HPP
+#define NNUE_HPP
+
+#include "types.hpp"
+#include <cstdint>
+#include <string>
+
+class Board;
+
+namespace NNUE {
+
+// (768 -> HIDDEN_SIZE) x 2 -> 1 perspective network with clipped ReLU.
+// Network files are the raw little-endian int16 dump used by bullet's
+// "simple" layout: feature weights, feature bias, output weights, output bias.
+constexpr int INPUT_SIZE = 768;
+constexpr int HIDDEN_SIZE = 256;
+constexpr int QA = 255;
+constexpr int QB = 64;
+constexpr int SCALE = 400;
+
+struct DirtyPiece {
+    int count;
+    Piece piece[3];
+    Square from[3];
+    Square to[3];
+
+    void add(Piece pc, Square f, Square t) {
+        piece[count] = pc;
+        from[count] = f;
+        to[count] = t;
+        ++count;
+    }
+};
+
+struct Accumulator {
+    alignas(64) int16_t values[COLOR_NB][HIDDEN_SIZE];
+    bool computed;
+};
+
+bool load(const std::string& path);
+bool load_embedded();
+bool has_embedded();
+bool is_loaded();
+const std::string& network_name();
+
+void set_enabled(bool on);
+bool enabled();
+
+int evaluate(const Board& board);
+
+}
+
+#endif
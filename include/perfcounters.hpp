@@ -0,0 +1,48 @@
+#ifndef PERFCOUNTERS_HPP
+#define PERFCOUNTERS_HPP
+
+#include <cstdint>
+
+namespace PerfCounters {
+
+enum Event : int {
+    CYCLES,
+    INSTRUCTIONS,
+    L1D_MISSES,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    EVENT_NB
+};
+
+struct Sample {
+    uint64_t values[EVENT_NB] = {};
+    bool valid[EVENT_NB] = {};
+
+    bool any() const;
+    double ipc() const;
+};
+
+// Hardware counters of the calling thread, user space only, read through
+// perf_event_open on Linux. Events the kernel or CPU refuses (containers,
+// VMs, perf_event_paranoid > 2) are left invalid; elsewhere nothing opens.
+// Multiplexed counters are scaled by their enabled/running time.
+class Group {
+public:
+    Group();
+    ~Group();
+
+    Group(const Group&) = delete;
+    Group& operator=(const Group&) = delete;
+
+    bool available() const;
+
+    void start();
+    Sample stop();
+
+private:
+    int fds[EVENT_NB];
+};
+
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef PERFT_HPP
+#define PERFT_HPP
+
+#include "board.hpp"
+#include "move.hpp"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace Perft {
+
+// Subtree counts keyed by (position key, depth). Each slot holds the key
+// XOR-ed with its data word, so a slot torn by two racing writers fails the
+// check and reads as a miss; no locks are needed between perft threads.
+class PerftTable {
+public:
+    void resize(size_t mb);
+    bool enabled() const { return slots != nullptr; }
+
+    bool probe(Key key, int depth, U64& nodes) const;
+    void store(Key key, int depth, U64 nodes);
+
+private:
+    struct Slot {
+        std::atomic<U64> check{0};
+        std::atomic<U64> data{0};
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+};
+
+struct RootCount {
+    Move move;
+    U64 nodes;
+};
+
+// Leaf count at depth, split over root moves on `threads` threads. hashMB
+// of zero runs without a table; the last ply is always bulk-counted from the
+// legal move list. With divide set, the per-root-move counts are returned
+// in generation order.
+U64 perft(const Board& board, int depth, int threads = 1, size_t hashMB = 0,
+          std::vector<RootCount>* divide = nullptr);
+
+}
+
+#endif
@@ -3,34 +3,38 @@
 
 #include "types.hpp"
 
-#ifdef USE_PEXT
+// pext() is only called once Magics::init() has confirmed fast BMI2 at run
+// time, so the instruction is emitted even when the compiler targets an
+// older ISA. Without an x86-64 instruction it falls back to a bit loop that
+// is never selected.
 
 #if defined(_MSC_VER) && defined(_M_X64)
     #include <immintrin.h>
-    #define HAS_PEXT_HARDWARE 1
-#elif defined(__GNUC__) && defined(__x86_64__) && defined(__BMI2__)
-    #include <x86intrin.h>
-    #define HAS_PEXT_HARDWARE 1
-#elif defined(__GNUC__) && defined(__x86_64__)
-    #include <x86intrin.h>
-    #if defined(__BMI2__)
-        #define HAS_PEXT_HARDWARE 1
-    #endif
-#endif
+    #define HAS_PEXT_INSTRUCTION 1
 
-#ifdef HAS_PEXT_HARDWARE
+inline U64 pext(U64 src, U64 mask) {
+    return _pext_u64(src, mask);
+}
+
+#elif defined(__BMI2__)
+    #include <immintrin.h>
+    #define HAS_PEXT_INSTRUCTION 1
 
 inline U64 pext(U64 src, U64 mask) {
     return _pext_u64(src, mask);
 }
 
-inline U64 pdep(U64 src, U64 mask) {
-    return _pdep_u64(src, mask);
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+    #define HAS_PEXT_INSTRUCTION 1
+
+inline U64 pext(U64 src, U64 mask) {
+    U64 result;
+    asm("pextq %2, %1, %0" : "=r"(result) : "r"(src), "r"(mask));
+    return result;
 }
 
 #else
 
-
 inline U64 pext(U64 src, U64 mask) {
     U64 result = 0;
     int count = 0;
@@ -44,34 +48,6 @@ inline U64 pext(U64 src, U64 mask) {
     return result;
 }
 
-inline U64 pdep(U64 src, U64 mask) {
-    U64 result = 0;
-    int count = 0;
-    while (mask) {
-        if (src & (1ULL << count)) {
-            result |= (mask & -mask);
-        }
-        mask &= mask - 1;
-        ++count;
-    }
-    return result;
-}
-
-#endif
-
-#endif
-
-#ifdef USE_PEXT
-
-struct PextEntry {
-    Bitboard  mask;
-    Bitboard* attacks;
-
-    unsigned index(Bitboard occupied) const {
-        return static_cast<unsigned>(pext(occupied, mask));
-    }
-};
-
 #endif
 
 #endif
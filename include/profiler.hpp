@@ -1,194 +1,130 @@
 #ifndef PROFILER_HPP
 #define PROFILER_HPP
 
-#include <chrono>
-#include <string>
-#include <unordered_map>
-#include <mutex>
+#include <cstdint>
 #include <iostream>
-#include <iomanip>
-#include <algorithm>
-#include <vector>
-#include <atomic>
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #else
+        #include <x86intrin.h>
+    #endif
+    #define PROFILER_HAS_TSC 1
+#else
+    #include <chrono>
+#endif
+
+// Counters and timers are fixed at compile time: a scope or counter is an
+// index into a flat per-thread block, so recording is a plain add with no
+// locks, strings or hashing. Blocks are merged only when stats are read.
+#define PROFILER_TIMERS(X)                            \
+    X(SEARCH,            "Search::search")            \
+    X(QSEARCH,           "Search::qsearch")           \
+    X(EVALUATE,          "evaluate")                  \
+    X(EVAL_FULL,         "Eval::evaluate")            \
+    X(GENERATE_ALL,      "generate_all")              \
+    X(GENERATE_CAPTURES, "generate_captures")         \
+    X(GENERATE_QUIETS,   "generate_quiets")           \
+    X(GENERATE_LEGAL,    "generate_legal")            \
+    X(SEE,               "SEE::evaluate")             \
+    X(SCORE_CAPTURES,    "score_captures")            \
+    X(SCORE_QUIETS,      "score_quiets")              \
+    X(NEXT_MOVE,         "next_move")                 \
+    X(TT_PROBE,          "TT::probe")
+
+#define PROFILER_COUNTERS(X) \
+    X(SEARCH_NODES)          \
+    X(QSEARCH_NODES)         \
+    X(TT_PROBES)             \
+    X(TT_HITS)               \
+    X(NMP_TRIES)             \
+    X(NMP_CUTOFFS)           \
+    X(LMR_SEARCHES)          \
+    X(LMR_RESEARCHES)        \
+    X(EVAL_CALLS)            \
+    X(EVAL_CACHE_HITS)
+
+// Scopes and counters are compiled in only by `make internal-profile`.
 #ifdef PROFILING
-    #define PROFILE_SCOPE(name) ProfilerScope __profiler_scope__(name)
-    #define PROFILE_FUNCTION() ProfilerScope __profiler_scope__(__FUNCTION__)
+    #define PROFILE_SCOPE(id) Profiler::Scope<Profiler::T_##id> profilerScope##id
 #else
-    #define PROFILE_SCOPE(name)
-    #define PROFILE_FUNCTION()
+    #define PROFILE_SCOPE(id)
 #endif
 
-struct ProfileData {
-    std::atomic<uint64_t> totalTimeNs{0};
-    std::atomic<uint64_t> callCount{0};
-    std::atomic<uint64_t> maxTimeNs{0};
-    std::atomic<uint64_t> minTimeNs{UINT64_MAX};
-};
+#ifdef PROFILING
+    #define PROFILE_COUNT(id) (++Profiler::local().counters[Profiler::C_##id])
+#else
+    #define PROFILE_COUNT(id) ((void)0)
+#endif
 
-class Profiler {
-public:
-    static Profiler& instance() {
-        static Profiler profiler;
-        return profiler;
-    }
+namespace Profiler {
 
-    void record(const std::string& name, uint64_t durationNs) {
-        std::lock_guard<std::mutex> lock(mutex_);
-
-        auto& data = profiles_[name];
-        data.totalTimeNs.fetch_add(durationNs, std::memory_order_relaxed);
-        data.callCount.fetch_add(1, std::memory_order_relaxed);
-
-        uint64_t currentMax = data.maxTimeNs.load(std::memory_order_relaxed);
-        while (durationNs > currentMax &&
-               !data.maxTimeNs.compare_exchange_weak(currentMax, durationNs,
-                   std::memory_order_relaxed, std::memory_order_relaxed)) {}
-        uint64_t currentMin = data.minTimeNs.load(std::memory_order_relaxed);
-        while (durationNs < currentMin &&
-               !data.minTimeNs.compare_exchange_weak(currentMin, durationNs,
-                   std::memory_order_relaxed, std::memory_order_relaxed)) {}
-    }
+#define PROFILER_ENUM(id, name) T_##id,
+enum Timer : int { PROFILER_TIMERS(PROFILER_ENUM) TIMER_NB };
+#undef PROFILER_ENUM
 
-    static void print_results() {
-        auto& profiler = instance();
-        std::lock_guard<std::mutex> lock(profiler.mutex_);
-
-        if (profiler.profiles_.empty()) {
-            std::cout << "\n[Profiler] No profiling data collected.\n";
-            std::cout << "Make sure PROFILING is defined and PROFILE_SCOPE/PROFILE_FUNCTION macros are used.\n";
-            return;
-        }
-
-        uint64_t totalTime = 0;
-        for (const auto& [name, data] : profiler.profiles_) {
-            totalTime += data.totalTimeNs.load();
-        }
-
-        std::vector<std::pair<std::string, ProfileData*>> sorted;
-        for (auto& [name, data] : profiler.profiles_) {
-            sorted.push_back({name, &data});
-        }
-        std::sort(sorted.begin(), sorted.end(),
-            [](const auto& a, const auto& b) {
-                return a.second->totalTimeNs.load() > b.second->totalTimeNs.load();
-            });
-
-        std::cout << "\n";
-        std::cout << "================================================================================\n";
-        std::cout << "                           PROFILING RESULTS\n";
-        std::cout << "================================================================================\n";
-        std::cout << std::left << std::setw(30) << "Function"
-                  << std::right << std::setw(10) << "% Time"
-                  << std::setw(12) << "Total(ms)"
-                  << std::setw(12) << "Calls"
-                  << std::setw(12) << "Avg(us)"
-                  << std::setw(12) << "Max(us)"
-                  << "\n";
-        std::cout << "--------------------------------------------------------------------------------\n";
-
-        for (const auto& [name, dataPtr] : sorted) {
-            uint64_t total = dataPtr->totalTimeNs.load();
-            uint64_t calls = dataPtr->callCount.load();
-            uint64_t maxNs = dataPtr->maxTimeNs.load();
-
-            double percent = totalTime > 0 ? (total * 100.0 / totalTime) : 0.0;
-            double totalMs = total / 1e6;
-            double avgUs = calls > 0 ? (total / 1000.0 / calls) : 0.0;
-            double maxUs = maxNs / 1000.0;
-
-            std::string displayName = name;
-            if (displayName.length() > 28) {
-                displayName = displayName.substr(0, 25) + "...";
-            }
-
-            std::cout << std::left << std::setw(30) << displayName
-                      << std::right << std::fixed << std::setprecision(1)
-                      << std::setw(9) << percent << "%"
-                      << std::setprecision(1) << std::setw(12) << totalMs
-                      << std::setw(12) << calls
-                      << std::setprecision(2) << std::setw(12) << avgUs
-                      << std::setprecision(1) << std::setw(12) << maxUs
-                      << "\n";
-        }
-
-        std::cout << "--------------------------------------------------------------------------------\n";
-        std::cout << "Total profiled time: " << std::fixed << std::setprecision(1)
-                  << (totalTime / 1e9) << " seconds\n";
-        std::cout << "================================================================================\n\n";
-    }
+#define PROFILER_ENUM(id) C_##id,
+enum Counter : int { PROFILER_COUNTERS(PROFILER_ENUM) COUNTER_NB };
+#undef PROFILER_ENUM
 
-    static void reset() {
-        auto& profiler = instance();
-        std::lock_guard<std::mutex> lock(profiler.mutex_);
-        profiler.profiles_.clear();
-    }
+struct alignas(64) Block {
+    uint64_t counters[COUNTER_NB];
+    uint64_t ticks[TIMER_NB];
+    uint64_t calls[TIMER_NB];
+    uint64_t maxTicks[TIMER_NB];
 
-private:
-    Profiler() = default;
-    std::unordered_map<std::string, ProfileData> profiles_;
-    std::mutex mutex_;
+    void clear();
+    void merge(const Block& other);
 };
 
-class ProfilerScope {
+// The calling thread's block, registered on first use.
+Block& local_slow();
+
+inline Block& local() {
+    static thread_local Block* block = nullptr;
+    if (!block) block = &local_slow();
+    return *block;
+}
+
+inline uint64_t now_ticks() {
+#ifdef PROFILER_HAS_TSC
+    return __rdtsc();
+#else
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+template <Timer T>
+class Scope {
 public:
-    explicit ProfilerScope(const char* name)
-        : name_(name)
-        , start_(std::chrono::high_resolution_clock::now()) {}
-
-    ~ProfilerScope() {
-        auto end = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start_).count();
-        Profiler::instance().record(name_, duration);
+    Scope() : start(now_ticks()) {}
+    ~Scope() {
+        uint64_t elapsed = now_ticks() - start;
+        Block& b = local();
+        b.ticks[T] += elapsed;
+        ++b.calls[T];
+        if (elapsed > b.maxTicks[T]) b.maxTicks[T] = elapsed;
     }
 
 private:
-    const char* name_;
-    std::chrono::high_resolution_clock::time_point start_;
+    uint64_t start;
 };
 
-namespace ProfilerAnalysis {
+// Sum of every thread's block. Call while no search is running.
+Block merged();
+void reset();
+
+void print_counters(std::ostream& os = std::cout);
+void print_results();
 
-inline void analyze_bottlenecks() {
-    std::cout << "\n";
-    std::cout << "================================================================================\n";
-    std::cout << "                         BOTTLENECK ANALYSIS\n";
-    std::cout << "================================================================================\n";
-    std::cout << "\n";
-    std::cout << "Key areas to check for chess engine bottlenecks:\n";
-    std::cout << "\n";
-    std::cout << "1. MOVE GENERATION (generate_*, movegen)\n";
-    std::cout << "   - Target: < 15% of total time\n";
-    std::cout << "   - If high: Consider lazy generation, incremental updates\n";
-    std::cout << "\n";
-    std::cout << "2. EVALUATION (evaluate, eval)\n";
-    std::cout << "   - Target: < 20% of total time\n";
-    std::cout << "   - If high: Implement lazy evaluation, NNUE, or simpler eval\n";
-    std::cout << "\n";
-    std::cout << "3. TRANSPOSITION TABLE (tt_probe, tt_store)\n";
-    std::cout << "   - Target: < 5% of total time\n";
-    std::cout << "   - If high: Check cache alignment, hash function efficiency\n";
-    std::cout << "\n";
-    std::cout << "4. MOVE ORDERING (score_moves, pick_move)\n";
-    std::cout << "   - Target: < 10% of total time\n";
-    std::cout << "   - If high: Use incremental scoring, avoid full sort\n";
-    std::cout << "\n";
-    std::cout << "5. POSITION UPDATES (do_move, undo_move)\n";
-    std::cout << "   - Target: < 10% of total time\n";
-    std::cout << "   - If high: Use incremental updates, copy-make vs make-unmake\n";
-    std::cout << "\n";
-    std::cout << "6. SEE (static_exchange_evaluation)\n";
-    std::cout << "   - Target: < 5% of total time\n";
-    std::cout << "   - If high: Cache SEE results, optimize attacker lookups\n";
-    std::cout << "\n";
-    std::cout << "Expected NPS for modern engines:\n";
-    std::cout << "   - Basic engine: 500K - 1M NPS\n";
-    std::cout << "   - Optimized: 1M - 5M NPS\n";
-    std::cout << "   - Top engines (Stockfish): 10M+ NPS\n";
-    std::cout << "\n";
-    std::cout << "================================================================================\n";
 }
 
+namespace ProfilerAnalysis {
+
+void analyze_bottlenecks();
+
 }
 
 #endif
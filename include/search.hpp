@@ -5,6 +5,7 @@
 #include "move.hpp"
 #include "moveorder.hpp"
 #include "tt.hpp"
+#include "eval.hpp"
 #include <algorithm>
 #include <atomic>
 #include <chrono>
@@ -26,19 +27,44 @@ struct SearchLimits {
     bool ponder = false;
 
     std::vector<Move> searchmoves;
+
+    // Set by the root tablebase probe: searchmoves then holds the moves
+    // that keep the root's DTZ outcome, and rootTBScore is their value.
+    bool rootInTB = false;
+    int rootTBScore = 0;
 };
 
 struct SearchStats {
-    U64 nodes = 0;
+    // Written only by the searching thread; pool threads take relaxed snapshots.
+    std::atomic<U64> nodes{0};
     U64 tbHits = 0;
+    U64 ttProbes = 0;
+    U64 ttHits = 0;
     int selDepth = 0;
     int hashfull = 0;
+    U64 evalCacheProbes = 0;
+    U64 evalCacheHits = 0;
+    U64 deferredMoves = 0;
+    Eval::LazyStats lazy;
 
     void reset() {
-        nodes = 0;
+        nodes.store(0, std::memory_order_relaxed);
         tbHits = 0;
+        ttProbes = 0;
+        ttHits = 0;
         selDepth = 0;
         hashfull = 0;
+        evalCacheProbes = 0;
+        evalCacheHits = 0;
+        deferredMoves = 0;
+        lazy.reset();
+    }
+
+    void count_node() { nodes.store(nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+    U64 node_count() const { return nodes.load(std::memory_order_relaxed); }
+
+    int eval_cache_hit_rate() const {
+        return evalCacheProbes ? int(evalCacheHits * 1000 / evalCacheProbes) : 0;
     }
 };
 
@@ -173,12 +199,32 @@ struct RootMove {
     }
 };
 
+enum NodeType { NON_PV, PV, ROOT };
+
 class Search {
 public:
-    Search();
+    // Searches share the global TT unless given their own, e.g. one per
+    // datagen worker so unrelated games never see each other's entries.
+    explicit Search(TranspositionTable& table = TT);
+
+    // A ThreadPool worker: it stops on the pool's flag, and only thread 0
+    // manages time and reports; the others vary their depths.
+    Search(TranspositionTable& table, std::atomic<bool>& stopFlag, int threadId);
 
     void start(Board& board, const SearchLimits& limits);
 
+    // Restricts limits.searchmoves to the root moves the tablebases keep and
+    // records their TB score; the search still runs over those moves.
+    static void filter_tablebase_root(Board& board, SearchLimits& limits, bool verbose);
+
+    // Pool entry points. The pool probes the book and tablebases and starts
+    // the TT generation itself; prepare_worker() runs before any worker
+    // starts, so the pool can read back the time limits it sets.
+    void prepare_worker(const Board& board, const SearchLimits& limits,
+                        std::chrono::steady_clock::time_point start, U64 checkMask,
+                        int groups = 1);
+    void run_worker(Board& board);
+
     void stop() { stopped = true; }
 
     void on_ponderhit();
@@ -194,6 +240,13 @@ public:
     Move ponder_move() const { return rootPonderMove; }
 
     const SearchStats& stats() const { return searchStats; }
+    int best_score() const { return rootMoves.empty() ? 0 : rootMoves[0].score; }
+    int optimum_time() const { return optimumTime; }
+    int maximum_time() const { return maximumTime; }
+
+    // Last completed iteration of the first PV line, filled in silent mode too
+    // so batch callers can read depth, score and PV without parsing output.
+    const SearchInfo& last_info() const { return lastInfo; }
 
     using InfoCallback = void(*)(const SearchInfo&);
     void set_info_callback(InfoCallback cb) { infoCallback = cb; }
@@ -201,7 +254,12 @@ public:
     void set_silent(bool silent) { silentMode = silent; }
     bool is_silent() const { return silentMode; }
 
+    void set_use_book(bool use) { useBook = use; }
+
+    TranspositionTable& table() const { return tt; }
+
     void clear_history();
+    void set_pawn_hash(size_t mb) { pawnTable.resize(mb); }
 
     int evaluate(const Board& board);
     int evaluate(const Board& board, int alpha, int beta);
@@ -209,17 +267,38 @@ public:
     int qsearch_score(Board& board);
 
 private:
+    void prefetch_child(const Board& board, Move m);
     void iterative_deepening(Board& board);
 
+    template <NodeType nt>
     int search(Board& board, int alpha, int beta, int depth, bool cutNode);
 
+    template <NodeType nt>
     int qsearch(Board& board, int alpha, int beta, int qsDepth = 0, Square recaptureSquare = SQ_NONE);
 
     void init_time_management(Color us);
     void check_time();
     bool should_stop() const;
 
+    bool is_helper() const { return threadId > 0; }
+    // Threads below rootGroups lead their group of a split MultiPV search.
+    bool is_group_main() const { return threadId < rootGroups; }
+    bool skip_depth(int depth);
+    U64 total_nodes() const;
+
     void report_info(Board& board, int depth, int score, const PVLine& pv, int multiPVIdx = 1);
+    void report_root_lines(Board& board);
+
+    // What time management judges the root by: this search's own lines, or
+    // for a split MultiPV search the merged lines over every root move.
+    struct RootView {
+        Move move = MOVE_NONE;
+        int score = VALUE_NONE;
+        int thirdScore = VALUE_NONE;
+        int moveCount = 0;
+        PVLine pv;
+    };
+    RootView root_view() const;
 
     KillerTable killers;
     MateKillerTable mateKillers;
@@ -229,13 +308,26 @@ private:
     CorrectionHistory corrHistory;
     CaptureHistory captureHist;
     MoveOrderStats moveOrderStats;
+    Eval::PawnTable pawnTable;
+    Eval::MaterialTable materialTable;
+    Eval::EvalCache evalCache;
 
-    std::atomic<bool> stopped;
+    std::atomic<bool> ownStop;
+    std::atomic<bool>& stopped;
     std::atomic<bool> searching;
     std::atomic<bool> isPondering;
     bool silentMode = false;
+    bool useBook = true;
+    TranspositionTable& tt;
     SearchLimits limits;
     SearchStats searchStats;
+    SearchInfo lastInfo;
+
+    // -1 for a standalone search, else the index in the ThreadPool.
+    int threadId = -1;
+    U64 nodeCheckMask = 16383;
+    int rootGroups = 1;
+    U64 randSeed = 1;
 
     Move rootBestMove;
     Move rootPonderMove;
@@ -244,6 +336,7 @@ private:
     int rootDepth;
     int rootPly;
     std::vector<RootMove> rootMoves;
+    int rootMoveCount = 0;
     int pvIdx;
 
     std::chrono::steady_clock::time_point startTime;
@@ -169,6 +169,12 @@ constexpr int POST_LMR_WORSENING_THRESHOLD = 2;  // LMR reduction must be >= 2 p
 constexpr int POST_LMR_WORSENING_REDUCTION = 1;  // Additional 1 ply reduction
 constexpr int POST_LMR_MIN_DEPTH = 3;            // Only apply at depth >= 3
 
+// ============================================================================
+// ABDADA (Lazy SMP move deferral)
+// ============================================================================
+
+constexpr int ABDADA_MIN_DEPTH = 5;              // Shallower nodes are cheaper to repeat
+
 // ============================================================================
 // Dynamic SEE Thresholds
 // ============================================================================
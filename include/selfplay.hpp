@@ -0,0 +1,67 @@
+#ifndef SELFPLAY_HPP
+#define SELFPLAY_HPP
+
+#include "search.hpp"
+#include "tuning.hpp"
+#include <sstream>
+#include <string>
+
+namespace SelfPlay {
+
+// In-process match between two Tuning parameter sets for SPRT and SPSA runs.
+// Every worker owns one Search and one TT per side and plays each opening
+// twice with colours swapped; the evaluation reads the mover's set through
+// Tuning::Active. Adjudication follows datagen's rules.
+struct SelfPlayConfig {
+    Tuning::Params paramsA;     // Both start from Tuning::Defaults
+    Tuning::Params paramsB;
+
+    int threads = 1;
+    int hash_mb = 16;           // Per side, per worker
+    bool bind_threads = true;
+    uint64_t seed = 0;          // 0 picks one from the clock
+
+    int games = 1000;           // Rounded up to whole opening pairs
+    int depth = 8;
+    int nodes = 5000;           // 0 searches to depth only
+
+    bool use_book = true;
+    std::string book_path = "book/Perfect2023.bin";
+    int book_depth = 12;
+    int random_plies = 0;       // After the book line; at least 8 without one
+
+    int max_ply = 400;
+    int adjudicate_score = 2500;
+    int adjudicate_count = 4;
+    int adjudicate_draw = 5;
+    int adjudicate_draw_count = 12;
+    int adjudicate_draw_ply = 80;
+
+    // SPRT of H0: elo = elo0 against H1: elo = elo1, in logistic Elo for A.
+    double elo0 = 0.0;
+    double elo1 = 5.0;
+    double alpha = 0.05;
+    double beta = 0.05;
+
+    int report_seconds = 10;
+};
+
+// Results from engine A's side.
+struct SelfPlayStats {
+    int wins = 0;
+    int losses = 0;
+    int draws = 0;
+
+    int games() const { return wins + losses + draws; }
+
+    double elo() const;
+    double elo_error() const;   // Half-width of the 95% interval
+    double llr(double elo0, double elo1) const;
+};
+
+bool run(const SelfPlayConfig& config, SelfPlayStats& stats);
+SelfPlayConfig parse_config(std::istringstream& is);
+
+}
+
+#endif
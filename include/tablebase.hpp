@@ -5,6 +5,7 @@
 #include "move.hpp"
 #include "tt.hpp"
 #include <string>
+#include <vector>
 
 namespace Tablebase {
 
@@ -24,26 +25,26 @@ struct TablebaseConfig {
     bool probeInSearch = true;
 };
 
+enum ProbeState {
+    PROBE_FAIL              =  0,
+    PROBE_OK                =  1,
+    PROBE_CHANGE_STM        = -1,
+    PROBE_ZEROING_BEST_MOVE =  2
+};
+
 class Tablebases {
 public:
     Tablebases() : initialized(false), maxPieces(0) {}
 
-    bool init(const std::string& path) {
-        tbPath = path;
-
-        if (!path.empty()) {
-            initialized = true;
-            maxPieces = 6;
-            return true;
-        }
-
-        return false;
-    }
+    bool init(const std::string& path);
+    void free();
 
     bool is_initialized() const { return initialized; }
 
     int max_pieces() const { return maxPieces; }
 
+    size_t table_count() const;
+
     bool can_probe(const Board& board) const {
         if (!initialized) return false;
 
@@ -55,27 +56,16 @@ public:
         return true;
     }
 
-    WDLScore probe_wdl(const Board& board) const {
-        if (!can_probe(board)) return WDL_NONE;
-        (void)board;
-        return WDL_NONE;
-    }
+    WDLScore probe_wdl(Board& board) const;
+    WDLScore probe_wdl(Board& board, ProbeState& state) const;
 
-    int probe_dtz(const Board& board, Move& bestMove) const {
-        if (!can_probe(board)) {
-            bestMove = MOVE_NONE;
-            return 0;
-        }
+    int probe_dtz(Board& board, Move& bestMove) const;
+    Move probe_root(Board& board) const;
 
-        (void)board;
-        bestMove = MOVE_NONE;
-        return 0;
-    }
-    Move probe_root(const Board& board) const {
-        Move bestMove = MOVE_NONE;
-        probe_dtz(board, bestMove);
-        return bestMove;
-    }
+    // Narrows the root moves to those that keep the root's DTZ outcome under
+    // the 50-move rule and sets score to their TB value. On a failed probe
+    // returns false and leaves moves alone.
+    bool filter_root_moves(Board& board, std::vector<Move>& moves, int& score) const;
 
     static int wdl_to_score(WDLScore wdl, int ply) {
         switch (wdl) {
@@ -88,6 +78,17 @@ public:
         }
     }
 
+    static int wdl_to_search_score(WDLScore wdl, int ply) {
+        switch (wdl) {
+            case WDL_WIN:         return VALUE_TB_WIN - ply;
+            case WDL_CURSED_WIN:  return 1;
+            case WDL_DRAW:        return 0;
+            case WDL_BLESSED_LOSS: return -1;
+            case WDL_LOSS:        return VALUE_TB_LOSS + ply;
+            default:              return 0;
+        }
+    }
+
 private:
     bool initialized;
     int maxPieces;
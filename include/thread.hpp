@@ -9,6 +9,7 @@
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <thread>
@@ -18,57 +19,35 @@ class ThreadPool;
 
 constexpr int MAX_THREADS = 256;
 
+// Best line found so far for every root move of a split MultiPV search,
+// merged from the thread groups that each search a share of the root moves.
+class SharedRootTable {
+public:
+    struct Line {
+        Move move;
+        int score;
+        int depth;
+        int group;
+        PVLine pv;
+    };
 
-struct alignas(64) ThreadStack {
-    int ply;
-    Move currentMove;
-    Move excludedMove;
-    Move killers[2];
-    int staticEval;
-    int moveCount;
-    int extensions;
-    bool inCheck;
-    bool ttPv;
-    bool ttHit;
-    bool nullMovePruned;
-    char padding[20];
-};
+    void clear();
+
+    // Replaces every line of the group with its current top `count` moves,
+    // so a move that dropped out of them leaves no stale line behind.
+    void publish(int group, const RootMove* moves, int count, int depth);
 
-struct ThreadPVLine {
-    int length = 0;
-    Move moves[MAX_PLY];
-
-    void clear() { length = 0; }
-
-    void update(Move m, const ThreadPVLine& child) {
-        moves[0] = m;
-        for (int i = 0; i < child.length && i + 1 < MAX_PLY; ++i) {
-            moves[i + 1] = child.moves[i];
-        }
-        length = child.length + 1;
-    }
-
-    std::string to_string() const {
-        std::string s;
-        for (int i = 0; i < length; ++i) {
-            if (i > 0) s += " ";
-            s += move_to_string(moves[i]);
-        }
-        return s;
-    }
-
-    Move first() const {
-        return length > 0 ? moves[0] : MOVE_NONE;
-    }
-
-    Move second() const {
-        return length > 1 ? moves[1] : MOVE_NONE;
-    }
+    // Best score first.
+    std::vector<Line> sorted() const;
+
+private:
+    mutable std::mutex mutex;
+    std::vector<Line> lines;
 };
 
 class alignas(64) SearchThread {
 public:
-    explicit SearchThread(int id);
+    SearchThread(int id, std::atomic<bool>& stopFlag, int cpu = -1);
     ~SearchThread();
 
     void start_searching();
@@ -76,36 +55,23 @@ public:
 
     int id() const { return threadId; }
     bool is_main() const { return threadId == 0; }
+    int cpu() const { return boundCpu; }
 
     alignas(64) std::atomic<bool> searching{false};
     std::atomic<bool> exit{false};
 
-    alignas(64) U64 nodes = 0;
-    U64 tbHits = 0;
-    int selDepth = 0;
-    int completedDepth = 0;
-    int bestScore = 0;
-    Move bestMove = MOVE_NONE;
-    Move ponderMove = MOVE_NONE;
+    Board* rootBoard = nullptr;
 
-    alignas(64) Board* rootBoard = nullptr;
-    int rootDepth = 0;
-    Move previousMove = MOVE_NONE;
-    U64 rand_seed;
+    // The full search, with its own copies of every history table.
+    std::unique_ptr<Search> search;
 
-    alignas(64) KillerTable killers;
-    alignas(64) MateKillerTable mateKillers;
-    alignas(64) CounterMoveTable counterMoves;
-    alignas(64) HistoryTable history;
-
-    alignas(64) ThreadStack stack[MAX_PLY + 4];
-    alignas(64) ThreadPVLine pvLines[MAX_PLY];
+    std::function<void()> job;
 
     void clear_history();
-    int rand_int(int max);
 
 private:
     int threadId;
+    int boundCpu;
     std::thread nativeThread;
     std::mutex mutex;
     std::condition_variable cv;
@@ -132,6 +98,10 @@ public:
 
     U64 total_nodes() const;
     U64 total_tb_hits() const;
+    U64 total_tt_probes() const;
+    U64 total_tt_hits() const;
+    int eval_cache_hit_rate() const;
+    U64 total_deferred_moves() const;
     int max_sel_depth() const;
     Move best_move() const;
     Move ponder_move() const;
@@ -139,37 +109,49 @@ public:
 
     std::atomic<bool> stop_flag{false};
     SearchLimits limits;
+    bool abdada = false;
+
+    // With MultiPV > 1, thread i searches only the root moves of group
+    // i % root_groups(), so the lines are searched side by side instead of
+    // one after another by every thread.
+    bool splitMultiPV = false;
+    int root_groups() const { return rootGroups; }
+    SharedRootTable rootTable;
+
+    // Returns once every group's leading thread has finished or the search
+    // is stopped.
+    void wait_for_root_groups();
 
     std::chrono::steady_clock::time_point startTime;
     int optimumTime = 0;
     int maximumTime = 0;
+    U64 nodeCheckMask = 1023;
 
-    void clear_all_history();
+    void clear_all_history(bool clearTT = true);
+    void clear_tt();
+    void set_pawn_hash(size_t mb);
+    void set_binding(bool on);
+    bool binding() const { return bindThreads; }
 
 private:
     std::vector<std::unique_ptr<SearchThread>> threads;
+    bool bindThreads = false;
 
-    void init_time_management(Color us);
-};
-
-extern ThreadPool Threads;
-
-namespace LazySMP {
-
-void search(SearchThread* thread, Board& board, int depth);
-void iterative_deepening(SearchThread* thread, Board& board);
-
-int alpha_beta(SearchThread* thread, Board& board, int alpha, int beta,
-               int depth, bool cutNode, int ply);
+    std::thread timerThread;
+    std::mutex timerMutex;
+    std::condition_variable timerCv;
+    bool timerExit = false;
 
-int qsearch(SearchThread* thread, Board& board, int alpha, int beta, int ply);
+    // Book or tablebase move played without starting the workers.
+    Move rootShortcut = MOVE_NONE;
+    int rootGroups = 1;
 
-int evaluate(const Board& board);
-
-bool should_stop(SearchThread* thread);
-
-void report_info(SearchThread* thread, int depth, int score);
+    void start_timer();
+    void stop_timer();
+    void timer_loop();
+    size_t pawnHashMB = Eval::PawnTable::DEFAULT_SIZE_MB;
+};
 
-}
+extern ThreadPool Threads;
 
 #endif
@@ -4,8 +4,10 @@
 #include "types.hpp"
 #include "zobrist.hpp"
 #include "move.hpp"
+#include <atomic>
 #include <cstring>
 #include <memory>
+#include <string>
 #include <xmmintrin.h>
 
 constexpr size_t CACHE_LINE_SIZE = 64;
@@ -17,64 +19,157 @@ enum Bound : U8 {
     BOUND_EXACT = 3
 };
 
-struct alignas(16) TTEntry {
-    U32 key32;
+// genBound8 packs the bound (bits 0-1), the PV flag (bit 2) and the search
+// generation (bits 3-7), so the generation steps by GENERATION_DELTA and
+// wraps every 32 searches.
+constexpr int GENERATION_BITS = 3;
+constexpr int GENERATION_DELTA = 1 << GENERATION_BITS;
+constexpr int GENERATION_CYCLE = 255 + GENERATION_DELTA;
+constexpr int GENERATION_MASK = (0xFF << GENERATION_BITS) & 0xFF;
+
+// At most this many distinct moves are returned by get_moves().
+constexpr int MAX_TT_MOVES = 3;
+
+// 10 bytes: the cluster index comes from the low key bits, so only the top
+// 16 bits are stored to tell positions in a cluster apart.
+struct TTEntry {
     U16 key16;
     U16 move16;
     S16 score16;
     S16 eval16;
     U8  depth8;
     U8  genBound8;
-    U8  isPv8;
-    U8  padding;
 
     Move move() const { return Move(move16); }
     int score() const { return score16; }
     int eval() const { return eval16; }
     int depth() const { return depth8; }
     Bound bound() const { return Bound(genBound8 & 0x3); }
-    U8 generation() const { return genBound8 >> 2; }
-    bool is_pv() const { return isPv8 != 0; }
+    U8 generation() const { return genBound8 & GENERATION_MASK; }
+    bool is_pv() const { return genBound8 & 0x4; }
+
+    // Searches since this entry was last written or hit, times GENERATION_DELTA.
+    int relative_age(U8 gen) const {
+        return (GENERATION_CYCLE + gen - genBound8) & GENERATION_MASK;
+    }
 
     void save(Key k, int s, int e, Bound b, int d, Move m, U8 gen, bool pv = false) {
         U16 k16 = static_cast<U16>(k >> 48);
-        U32 k32 = static_cast<U32>(k >> 16);
 
-        if (m || key16 != k16 || key32 != k32) {
+        if (m || key16 != k16) {
             move16 = m.raw();
         }
-        if (b == BOUND_EXACT || key16 != k16 || key32 != k32 || d + 4 > depth8) {
+        if (b == BOUND_EXACT || key16 != k16 || d + 4 > depth8 || relative_age(gen)) {
             key16 = k16;
-            key32 = k32;
             score16 = static_cast<S16>(s);
             eval16 = static_cast<S16>(e);
             depth8 = static_cast<U8>(d);
-            genBound8 = static_cast<U8>((gen << 2) | b);
-            isPv8 = pv ? 1 : 0;
+            genBound8 = static_cast<U8>(gen | (pv << 2) | b);
         }
         else if (pv) {
-            isPv8 = 1;
+            genBound8 |= 0x4;
         }
     }
 };
 
-static_assert(sizeof(TTEntry) == 16, "TTEntry size should be 16 bytes");
+static_assert(sizeof(TTEntry) == 10, "TTEntry size should be 10 bytes");
 
 struct alignas(CACHE_LINE_SIZE) TTCluster {
-    static constexpr int ENTRIES_PER_CLUSTER = 4;
+    static constexpr int ENTRIES_PER_CLUSTER = 6;
     TTEntry entries[ENTRIES_PER_CLUSTER];
+    char padding[CACHE_LINE_SIZE - ENTRIES_PER_CLUSTER * sizeof(TTEntry)];
 };
 
 static_assert(sizeof(TTCluster) == CACHE_LINE_SIZE, "TTCluster should be 64 bytes (1 cache line)");
 static_assert(alignof(TTCluster) == CACHE_LINE_SIZE, "TTCluster should be cache-line aligned");
 
+// Leads savehash dumps, mapped hash files and shared segments. One cache
+// line, so the cluster array that follows it in a mapping stays cache-line
+// aligned. generation and attached are only touched atomically while the
+// header is shared between processes.
+struct TTFileHeader {
+    char magic[8];
+    U64 clusterCount;
+    U32 entrySize;
+    U32 clusterSize;
+    U8  generation;
+    U8  reserved[3];
+    U32 attached;
+    U8  padding[CACHE_LINE_SIZE - 32];
+
+    static constexpr char MAGIC[8] = {'G', 'C', 'T', 'T', 'v', '1', 0, 0};
+
+    bool valid(size_t clusters) const {
+        return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0 && clusterCount == clusters
+            && entrySize == sizeof(TTEntry) && clusterSize == sizeof(TTCluster);
+    }
+};
+
+static_assert(sizeof(TTFileHeader) == CACHE_LINE_SIZE, "TTFileHeader should be 64 bytes");
+static_assert(sizeof(std::atomic<U8>) == 1 && std::atomic<U8>::is_always_lock_free,
+              "shared generation needs a lock-free byte");
+static_assert(sizeof(std::atomic<U32>) == 4 && std::atomic<U32>::is_always_lock_free,
+              "shared attach count needs a lock-free word");
+
+enum class TTAllocation : U8 {
+    NONE,
+    DEFAULT_PAGES,
+    TRANSPARENT_HUGE_PAGES,
+    HUGE_PAGES_2MB,
+    HUGE_PAGES_1GB,
+    LARGE_PAGES,
+    FILE_MAPPING,
+    SHARED_MEMORY
+};
+
 class TranspositionTable {
 public:
     TranspositionTable();
+    // Private tables (datagen, analysis and selfplay workers) are built at
+    // their final size instead of allocating the default 128 MB first.
+    explicit TranspositionTable(size_t mb);
     ~TranspositionTable();
 
-    void resize(size_t mb);
+    void resize(size_t mb, bool clearTable = true);
     void clear();
+    void clear_range(size_t idx, size_t count);
+    void reset_generation() { generation8 = 0; }
+
+    void set_large_pages(bool enabled) { largePages = enabled; }
+    bool large_pages() const { return largePages; }
+    TTAllocation allocation() const { return allocMode; }
+    const char* allocation_name() const;
+    size_t size_mb() const { return clusterCount * sizeof(TTCluster) >> 20; }
+
+    // With a hash file set, resize() maps the table from that file instead of
+    // allocating it, and the OS writes it back as pages get dirty. A file whose
+    // header matches the new size is reused as is: restored() is then true and
+    // the caller must not clear the table. A successful load() counts too.
+    void set_hash_file(const std::string& path) { hashFile = path; }
+    const std::string& hash_file() const { return hashFile; }
+    bool file_backed() const { return allocMode == TTAllocation::FILE_MAPPING; }
+    bool restored() const { return fileRestored; }
+    size_t hash_file_mb() const;
+
+    // With a shared name set, resize() attaches to the named shared-memory
+    // segment, creating it if this is the first process. Every attached
+    // process probes and stores into the same clusters without locks; a torn
+    // entry is caught like any other collision by key16 and the move
+    // legality check. Attaching to an existing segment counts as restored().
+    // The segment is removed when the last process detaches.
+    void set_shared_name(const std::string& name) { sharedName = name; }
+    const std::string& shared_name() const { return sharedName; }
+    bool shared() const { return allocMode == TTAllocation::SHARED_MEMORY; }
+    size_t shared_mb() const;
+
+    // Mapped tables outlive the process or are in use by others, so they
+    // are not cleared between games.
+    bool mapped() const { return file_backed() || shared(); }
+
+    // Dump/restore the cluster array and generation with large sequential
+    // I/O. load() resizes the table to the size stored in the file.
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
 
     void prefetch(Key key) {
         #if defined(_MM_HINT_T0)
@@ -92,7 +187,7 @@ public:
         #endif
     }
 
-    void new_search() { generation8 += 4; }
+    void new_search();
 
     TTEntry* probe(Key key, bool& found);
     void get_moves(Key key, Move* moves, int& count);
@@ -100,10 +195,27 @@ public:
     U8 generation() const { return generation8; }
 
 private:
+    bool allocate(size_t bytes);
+    bool map_file(size_t bytes);
+    bool map_shared(size_t bytes);
+    void free_table();
+
+    TTFileHeader* header() const {
+        return reinterpret_cast<TTFileHeader*>(reinterpret_cast<char*>(table) - sizeof(TTFileHeader));
+    }
+
     TTCluster* table;
     size_t clusterCount;
     size_t clusterMask;
     U8 generation8;
+    size_t allocBytes;
+    TTAllocation allocMode;
+    bool largePages;
+    std::string hashFile;
+    std::string sharedName;
+    std::string segmentName;
+    void* fileMapping;
+    bool fileRestored;
 
     TTEntry* first_entry(Key key) {
         return &table[key & clusterMask].entries[0];
@@ -9,29 +9,65 @@ namespace Tuning {
     // Tunable Parameters
     // ========================================================================
 
-    // Material Values
-    extern EvalScore PawnValue;
-    extern EvalScore KnightValue;
-    extern EvalScore BishopValue;
-    extern EvalScore RookValue;
-    extern EvalScore QueenValue;
-
-    // Piece Activity Bonuses
-    extern EvalScore BishopPairBonus;
-    extern EvalScore RookOpenFileBonus;
-    extern EvalScore RookSemiOpenFileBonus;
-    extern EvalScore RookOnSeventhBonus;
-    extern EvalScore KnightOutpostBonus;
-
-    // Pawn Structure
-    extern EvalScore IsolatedPawnPenalty;
-    extern EvalScore DoubledPawnPenalty;
-    extern EvalScore BackwardPawnPenalty;
-    extern EvalScore ConnectedPawnBonus;
-    extern EvalScore PhalanxBonus;
-
-    // King Safety
-    extern int KingSafetyWeight;  // Scale factor (percentage, default 83)
+    struct Params {
+        // Material Values
+        EvalScore PawnValue   = S(100, 100);
+        EvalScore KnightValue = S(320, 330);
+        EvalScore BishopValue = S(330, 340);
+        EvalScore RookValue   = S(500, 520);
+        EvalScore QueenValue  = S(950, 1000);
+
+        // Piece Activity Bonuses
+        EvalScore BishopPairBonus       = S(20, 50);
+        EvalScore RookOpenFileBonus     = S(40, 20);
+        EvalScore RookSemiOpenFileBonus = S(20, 10);
+        EvalScore RookOnSeventhBonus    = S(20, 40);
+        EvalScore KnightOutpostBonus    = S(30, 20);
+
+        // Pawn Structure
+        EvalScore IsolatedPawnPenalty   = S(-10, -20);
+        EvalScore DoubledPawnPenalty    = S(-10, -20);
+        EvalScore BackwardPawnPenalty   = S(-5,  -10);
+        EvalScore ConnectedPawnBonus    = S(15, 15);
+        EvalScore PhalanxBonus          = S(10, 20);
+
+        // King Safety
+        int KingSafetyWeight = 90;  // Scale factor (percentage)
+    };
+
+    // The engine's parameters, as changed by setoption and the tuner.
+    extern Params Defaults;
+
+    // The set the evaluation reads on this thread: Defaults unless a
+    // selfplay worker has switched it to one side's overrides.
+    extern thread_local const Params* Active;
+
+    inline const Params& active() { return *Active; }
+
+    // Defaults' fields under their historical names.
+    extern EvalScore& PawnValue;
+    extern EvalScore& KnightValue;
+    extern EvalScore& BishopValue;
+    extern EvalScore& RookValue;
+    extern EvalScore& QueenValue;
+
+    extern EvalScore& BishopPairBonus;
+    extern EvalScore& RookOpenFileBonus;
+    extern EvalScore& RookSemiOpenFileBonus;
+    extern EvalScore& RookOnSeventhBonus;
+    extern EvalScore& KnightOutpostBonus;
+
+    extern EvalScore& IsolatedPawnPenalty;
+    extern EvalScore& DoubledPawnPenalty;
+    extern EvalScore& BackwardPawnPenalty;
+    extern EvalScore& ConnectedPawnBonus;
+    extern EvalScore& PhalanxBonus;
+
+    extern int& KingSafetyWeight;
+
+    // Sets "<Name>MG", "<Name>EG" or "KingSafetyWeight" in params; false
+    // if no parameter has that name.
+    bool set_param(Params& params, const std::string& name, int value);
 
     // Initialization
     void init();
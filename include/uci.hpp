@@ -14,11 +14,14 @@ namespace UCI {
 
 struct EngineOptions {
     int hash = 256;
+    int pawnHash = 2;
     int threads = 2;
     int multiPV = 1;
     bool ponder = true;
     std::string bookPath = "";
     std::string syzygyPath = "";
+    bool useNNUE = NNUE::has_embedded();
+    std::string evalFile = "<embedded>";
     int moveOverhead = 10;
 
     int contempt = 20;
@@ -45,6 +48,7 @@ private:
     std::string ponderFen;
     Move expectedPonderMove;
     bool isPondering = false;
+    bool pooledSearch = false;
     void cmd_uci();
     void cmd_isready();
     void cmd_ucinewgame();
@@ -59,7 +63,14 @@ private:
     void cmd_d();
     void cmd_eval();
     void cmd_bench(std::istringstream& is);
+    void cmd_bench_json(std::istringstream& is);
     void cmd_datagen(std::istringstream& is);
+    void cmd_profile(std::istringstream& is);
+    void cmd_analyze(std::istringstream& is);
+    void cmd_selfplay(std::istringstream& is);
+    void cmd_microbench(std::istringstream& is);
+    void cmd_savehash(std::istringstream& is);
+    void cmd_loadhash(std::istringstream& is);
 
     void parse_moves(std::istringstream& is);
     void start_search(const SearchLimits& limits);
@@ -3,23 +3,27 @@
 
 #include "types.hpp"
 #include "bitboard.hpp"
+#include "move.hpp"
 
 using Key = U64;
 
 namespace Zobrist {
-extern Key PieceSquare[PIECE_NB][SQUARE_NB];
-extern Key Castling[CASTLING_RIGHT_NB];
-extern Key EnPassant[FILE_NB];
-extern Key SideToMove;
-}
-
-namespace Zobrist {
-extern Key PieceSquare[PIECE_NB][SQUARE_NB];
-extern Key Castling[CASTLING_RIGHT_NB];
-extern Key EnPassant[FILE_NB];
-extern Key SideToMove;
-
-void init();
+// Generated at compile time from fixed seeds, like the attack tables.
+extern const std::array<std::array<Key, SQUARE_NB>, PIECE_NB> PieceSquare;
+extern const std::array<Key, CASTLING_RIGHT_NB> Castling;
+extern const std::array<Key, FILE_NB> EnPassant;
+extern const Key SideToMove;
+
+// Cuckoo tables of every reversible move (no pawns, no captures) keyed by
+// the Zobrist difference it makes, side to move included. Board uses them
+// to spot a position that can repeat one move from now. Both orientations
+// of a move share one slot.
+constexpr int CUCKOO_SIZE = 8192;
+extern const std::array<Key, CUCKOO_SIZE> Cuckoo;
+extern const std::array<Move, CUCKOO_SIZE> CuckooMove;
+
+constexpr int cuckoo_h1(Key k) { return int(k & 0x1FFF); }
+constexpr int cuckoo_h2(Key k) { return int((k >> 16) & 0x1FFF); }
 
 inline Key piece_key(Piece pc, Square sq) {
     return PieceSquare[pc][sq];
@@ -0,0 +1,152 @@
+#include "affinity.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Affinity {
+
+namespace {
+
+struct Topology {
+    std::vector<std::vector<int>> nodes;
+    std::vector<int> cpuNode;
+};
+
+#if defined(__linux__)
+// Parses the kernel's cpulist format, e.g. "0-15,32-47".
+std::vector<int> parse_cpulist(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty()) continue;
+        size_t dash = range.find('-');
+        int lo = std::stoi(range.substr(0, dash));
+        int hi = dash == std::string::npos ? lo : std::stoi(range.substr(dash + 1));
+        for (int c = lo; c <= hi; ++c) cpus.push_back(c);
+    }
+    return cpus;
+}
+#endif
+
+Topology detect() {
+    Topology topo;
+
+#if defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool haveMask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    for (int node = 0; ; ++node) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!file) break;
+
+        std::string list;
+        std::getline(file, list);
+        std::vector<int> cpus;
+        for (int cpu : parse_cpulist(list)) {
+            if (cpu < CPU_SETSIZE && (!haveMask || CPU_ISSET(cpu, &allowed))) cpus.push_back(cpu);
+        }
+        if (!cpus.empty()) topo.nodes.push_back(cpus);
+    }
+
+    if (topo.nodes.empty()) {
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (haveMask ? CPU_ISSET(cpu, &allowed) : cpu < int(std::thread::hardware_concurrency()))
+                cpus.push_back(cpu);
+        }
+        topo.nodes.push_back(cpus);
+    }
+#elif defined(_WIN32)
+    ULONG highest = 0;
+    if (GetNumaHighestNodeNumber(&highest)) {
+        for (ULONG node = 0; node <= highest; ++node) {
+            ULONGLONG mask = 0;
+            if (!GetNumaNodeProcessorMask(UCHAR(node), &mask)) continue;
+            std::vector<int> cpus;
+            for (int cpu = 0; cpu < 64; ++cpu) {
+                if (mask & (1ULL << cpu)) cpus.push_back(cpu);
+            }
+            if (!cpus.empty()) topo.nodes.push_back(cpus);
+        }
+    }
+#endif
+
+    if (topo.nodes.empty() || topo.nodes[0].empty()) {
+        topo.nodes.assign(1, std::vector<int>());
+        int n = std::max(1, int(std::thread::hardware_concurrency()));
+        for (int cpu = 0; cpu < n; ++cpu) topo.nodes[0].push_back(cpu);
+    }
+
+    int maxCpu = 0;
+    for (const auto& cpus : topo.nodes) maxCpu = std::max(maxCpu, cpus.back());
+    topo.cpuNode.assign(maxCpu + 1, 0);
+    for (size_t n = 0; n < topo.nodes.size(); ++n) {
+        for (int cpu : topo.nodes[n]) topo.cpuNode[cpu] = int(n);
+    }
+
+    return topo;
+}
+
+const Topology& topology() {
+    static const Topology topo = detect();
+    return topo;
+}
+
+}
+
+int node_count() {
+    return int(topology().nodes.size());
+}
+
+int cpu_count() {
+    int total = 0;
+    for (const auto& cpus : topology().nodes) total += int(cpus.size());
+    return total;
+}
+
+int cpu_for_thread(int idx) {
+    const auto& nodes = topology().nodes;
+    const auto& cpus = nodes[idx % nodes.size()];
+    return cpus[(idx / nodes.size()) % cpus.size()];
+}
+
+int node_of_cpu(int cpu) {
+    const auto& cpuNode = topology().cpuNode;
+    return cpu >= 0 && cpu < int(cpuNode.size()) ? cpuNode[cpu] : 0;
+}
+
+bool bind_current_thread(int cpu) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+    return cpu < 64 && SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+std::string describe() {
+    std::ostringstream ss;
+    ss << cpu_count() << " CPUs on " << node_count() << " NUMA node" << (node_count() == 1 ? "" : "s");
+    return ss.str();
+}
+
+}
@@ -0,0 +1,321 @@
+#include "analysis.hpp"
+#include "affinity.hpp"
+#include "movegen.hpp"
+#include "testing.hpp"
+#include "tt.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Analysis {
+
+namespace {
+
+std::string strip_annotations(std::string san) {
+    while (!san.empty() && std::string("+#!?").find(san.back()) != std::string::npos) {
+        san.pop_back();
+    }
+    return san;
+}
+
+bool matches(const Board& board, Move m, const std::vector<std::string>& moves) {
+    std::string san = move_to_san(board, m);
+    std::string uci = move_to_string(m);
+    for (const std::string& expected : moves) {
+        std::string e = strip_annotations(expected);
+        if (e == san || e == uci) return true;
+        if ((e == "0-0" && san == "O-O") || (e == "0-0-0" && san == "O-O-O")) return true;
+    }
+    return false;
+}
+
+bool valid_position(const Board& board) {
+    return popcount(board.pieces(WHITE, KING)) == 1 && popcount(board.pieces(BLACK, KING)) == 1;
+}
+
+std::string epd_fields(const std::string& fen) {
+    std::istringstream is(fen);
+    std::string out, field;
+    for (int i = 0; i < 4 && is >> field; ++i) {
+        out += (i ? " " : "") + field;
+    }
+    return out;
+}
+
+// One analysed position as an EPD line. Mate scores use dm (moves to mate)
+// instead of ce, as the EPD standard does.
+std::string format_result(const TacticalPosition& pos, const Board& board, Move best,
+                          const SearchInfo& info, int64_t ms) {
+    std::ostringstream ss;
+    ss << epd_fields(pos.fen);
+
+    if (!pos.bestMoves.empty()) {
+        ss << " bm";
+        for (const std::string& m : pos.bestMoves) ss << " " << m;
+        ss << ";";
+    }
+    if (!pos.avoidMoves.empty()) {
+        ss << " am";
+        for (const std::string& m : pos.avoidMoves) ss << " " << m;
+        ss << ";";
+    }
+
+    if (best != MOVE_NONE) {
+        ss << " sm " << move_to_san(board, best) << ";";
+    }
+
+    if (info.isMate) {
+        int mateIn = info.score > 0 ? (VALUE_MATE - info.score + 1) / 2 : -(VALUE_MATE + info.score) / 2;
+        ss << " dm " << mateIn << ";";
+    } else {
+        ss << " ce " << info.score << ";";
+    }
+    ss << " acd " << info.depth << "; acn " << info.nodes << "; acs "
+       << std::fixed << std::setprecision(3) << ms / 1000.0 << ";";
+
+    if (info.pv.length > 0) {
+        ss << " pv";
+        Board b = board;
+        std::vector<StateInfo> states(info.pv.length);
+        for (int i = 0; i < info.pv.length; ++i) {
+            Move m = info.pv.moves[i];
+            if (m == MOVE_NONE || !MoveGen::is_pseudo_legal(b, m) || !MoveGen::is_legal(b, m)) break;
+            ss << " " << move_to_san(b, m);
+            b.do_move(m, states[i]);
+        }
+        ss << ";";
+    }
+
+    ss << " id \"" << pos.id << "\";";
+    return ss.str();
+}
+
+}
+
+std::string move_to_san(const Board& board, Move m) {
+    if (m.is_castling()) {
+        return file_of(m.to()) > file_of(m.from()) ? "O-O" : "O-O-O";
+    }
+
+    Square from = m.from(), to = m.to();
+    PieceType pt = type_of(board.piece_on(from));
+    bool capture = board.is_capture(m);
+    std::string san;
+
+    if (pt == PAWN) {
+        if (capture) {
+            san += char('a' + file_of(from));
+            san += 'x';
+        }
+        san += square_to_string(to);
+        if (m.is_promotion()) {
+            san += '=';
+            san += "NBRQ"[m.promotion_type() - KNIGHT];
+        }
+        return san;
+    }
+
+    san += " PNBRQK"[pt];
+
+    MoveList legal;
+    Board b = board;
+    MoveGen::generate_legal(b, legal);
+
+    bool ambiguous = false, sameFile = false, sameRank = false;
+    for (int i = 0; i < legal.size(); ++i) {
+        Move other = legal[i].move;
+        if (other == m || other.to() != to || other.from() == from) continue;
+        if (type_of(board.piece_on(other.from())) != pt) continue;
+        ambiguous = true;
+        sameFile |= file_of(other.from()) == file_of(from);
+        sameRank |= rank_of(other.from()) == rank_of(from);
+    }
+
+    if (ambiguous) {
+        if (!sameFile) {
+            san += char('a' + file_of(from));
+        } else if (!sameRank) {
+            san += char('1' + rank_of(from));
+        } else {
+            san += square_to_string(from);
+        }
+    }
+
+    if (capture) san += 'x';
+    san += square_to_string(to);
+    return san;
+}
+
+bool run(const AnalysisConfig& config, AnalysisStats& stats) {
+    stats = AnalysisStats{};
+
+    std::vector<TacticalPosition> positions = TacticalTest::load_epd(config.epd_path);
+    if (positions.empty()) {
+        std::cerr << "Error: No positions in " << config.epd_path << std::endl;
+        return false;
+    }
+
+    std::ofstream output;
+    if (!config.output_path.empty()) {
+        output.open(config.output_path);
+        if (!output.is_open()) {
+            std::cerr << "Error: Cannot open output file " << config.output_path << std::endl;
+            return false;
+        }
+    }
+
+    int threads = std::max(1, std::min<int>(config.threads, int(positions.size())));
+
+    std::cout << "\n=== Batch Analysis ===" << std::endl;
+    std::cout << "Positions : " << positions.size() << std::endl;
+    std::cout << "Threads   : " << threads << " (" << config.hash_mb << " MB hash each)" << std::endl;
+    std::cout << "Limit     : ";
+    if (config.limits.depth > 0) std::cout << "depth " << config.limits.depth;
+    else if (config.limits.nodes > 0) std::cout << "nodes " << config.limits.nodes;
+    else std::cout << "movetime " << config.limits.movetime << " ms";
+    std::cout << std::endl;
+    std::cout << "Output    : " << (config.output_path.empty() ? "stdout" : config.output_path) << std::endl;
+    std::cout << "======================\n" << std::endl;
+
+    std::vector<std::string> lines(positions.size());
+    std::vector<bool> done(positions.size(), false);
+    size_t nextToWrite = 0;
+    std::mutex outputMutex;
+
+    std::atomic<size_t> nextPosition{0};
+    std::atomic<size_t> solved{0}, withAnswer{0};
+    std::atomic<U64> totalNodes{0};
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Positions are cleared of TT and history state before each search, so a
+    // fixed-depth or fixed-node result does not depend on the thread count or
+    // on which worker happened to pick the position up.
+    auto worker = [&](int idx) {
+        if (config.bind_threads && threads > 1) {
+            Affinity::bind_current_thread(Affinity::cpu_for_thread(idx));
+        }
+
+        auto table = std::make_unique<TranspositionTable>(size_t(config.hash_mb));
+        auto searcher = std::make_unique<Search>(*table);
+        searcher->set_silent(true);
+        searcher->set_use_book(false);
+
+        StateInfo si;
+        while (true) {
+            size_t i = nextPosition.fetch_add(1);
+            if (i >= positions.size()) break;
+
+            const TacticalPosition& pos = positions[i];
+            Board board;
+            board.set(pos.fen, &si);
+
+            std::string line;
+            if (!valid_position(board)) {
+                line = epd_fields(pos.fen) + " c9 \"invalid position\"; id \"" + pos.id + "\";";
+            } else {
+                table->clear();
+                searcher->clear_history();
+
+                auto t0 = std::chrono::steady_clock::now();
+                Board root = board;
+                searcher->start(root, config.limits);
+                int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - t0).count();
+
+                Move best = searcher->best_move();
+                const SearchInfo& info = searcher->last_info();
+                totalNodes += searcher->stats().nodes;
+
+                if (best != MOVE_NONE && (!pos.bestMoves.empty() || !pos.avoidMoves.empty())) {
+                    withAnswer++;
+                    bool ok = (pos.bestMoves.empty() || matches(board, best, pos.bestMoves)) &&
+                              !matches(board, best, pos.avoidMoves);
+                    if (ok) solved++;
+                }
+
+                line = format_result(pos, board, best, info, ms);
+            }
+
+            std::lock_guard<std::mutex> lock(outputMutex);
+            lines[i] = std::move(line);
+            done[i] = true;
+            while (nextToWrite < positions.size() && done[nextToWrite]) {
+                (output.is_open() ? output : std::cout) << lines[nextToWrite] << "\n";
+                lines[nextToWrite].clear();
+                nextToWrite++;
+            }
+            if (output.is_open() && (nextToWrite % 100 == 0 || nextToWrite == positions.size())) {
+                std::cout << "  Analysed " << nextToWrite << "/" << positions.size() << "\r" << std::flush;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t) pool.emplace_back(worker, t);
+    for (std::thread& t : pool) t.join();
+
+    stats.positions = positions.size();
+    stats.with_answer = withAnswer;
+    stats.solved = solved;
+    stats.nodes = totalNodes;
+    stats.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    (output.is_open() ? output : std::cout) << std::flush;
+
+    int64_t elapsed = std::max<int64_t>(1, stats.time_ms);
+    std::cout << "\nPositions : " << stats.positions << std::endl;
+    if (stats.with_answer > 0) {
+        std::cout << "Solved    : " << stats.solved << "/" << stats.with_answer << std::endl;
+    }
+    std::cout << "Nodes     : " << stats.nodes << std::endl;
+    std::cout << "Time      : " << stats.time_ms << " ms" << std::endl;
+    std::cout << "NPS       : " << stats.nodes * 1000 / elapsed << std::endl;
+    std::cout << "Pos/s     : " << std::fixed << std::setprecision(2)
+              << stats.positions * 1000.0 / elapsed << std::defaultfloat << std::endl;
+
+    return true;
+}
+
+AnalysisConfig parse_config(std::istringstream& is) {
+    AnalysisConfig config;
+    std::string token;
+
+    if (is >> token) config.epd_path = token;
+
+    while (is >> token) {
+        if (token == "depth") {
+            is >> config.limits.depth;
+        } else if (token == "nodes") {
+            is >> config.limits.nodes;
+        } else if (token == "movetime") {
+            is >> config.limits.movetime;
+        } else if (token == "threads") {
+            is >> config.threads;
+        } else if (token == "hash") {
+            is >> config.hash_mb;
+        } else if (token == "output") {
+            is >> config.output_path;
+        } else if (token == "nobind") {
+            config.bind_threads = false;
+        }
+    }
+
+    if (config.limits.depth <= 0 && config.limits.nodes == 0 && config.limits.movetime <= 0) {
+        config.limits.depth = 10;
+    }
+    config.threads = std::max(1, config.threads);
+    config.hash_mb = std::max(1, config.hash_mb);
+
+    return config;
+}
+
+}
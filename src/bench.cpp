@@ -0,0 +1,249 @@
+#include "bench.hpp"
+#include "board.hpp"
+#include "search.hpp"
+#include "thread.hpp"
+#include "tt.hpp"
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+
+namespace Bench {
+
+namespace {
+
+const char* const PerfKeys[PerfCounters::EVENT_NB] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"
+};
+
+struct Moments {
+    double mean = 0;
+    double variance = 0;
+    double min = 0;
+    double max = 0;
+};
+
+// Sample variance (n - 1); zero for a single run.
+Moments moments(const std::vector<double>& xs) {
+    Moments m;
+    if (xs.empty()) return m;
+
+    m.min = m.max = xs[0];
+    for (double x : xs) {
+        m.mean += x;
+        m.min = std::min(m.min, x);
+        m.max = std::max(m.max, x);
+    }
+    m.mean /= xs.size();
+
+    if (xs.size() > 1) {
+        for (double x : xs) m.variance += (x - m.mean) * (x - m.mean);
+        m.variance /= xs.size() - 1;
+    }
+    return m;
+}
+
+double nps(U64 nodes, int64_t us) {
+    return us > 0 ? double(nodes) * 1e6 / double(us) : double(nodes);
+}
+
+double rate(U64 part, U64 whole) {
+    return whole > 0 ? double(part) / double(whole) : 0.0;
+}
+
+void write_moments(std::ostream& os, const Moments& m) {
+    os << "{\"mean\": " << m.mean << ", \"variance\": " << m.variance
+       << ", \"stddev\": " << std::sqrt(m.variance)
+       << ", \"min\": " << m.min << ", \"max\": " << m.max << "}";
+}
+
+// Mean over runs of each counter that every run managed to read.
+void write_perf(std::ostream& os, const std::vector<PerfCounters::Sample>& samples) {
+    bool any = false;
+    for (const auto& s : samples) any |= s.any();
+    if (!any) {
+        os << "null";
+        return;
+    }
+
+    PerfCounters::Sample mean;
+    for (int e = 0; e < PerfCounters::EVENT_NB; ++e) {
+        double sum = 0;
+        bool valid = true;
+        for (const auto& s : samples) {
+            valid &= s.valid[e];
+            sum += double(s.values[e]);
+        }
+        mean.valid[e] = valid;
+        mean.values[e] = valid ? uint64_t(sum / samples.size()) : 0;
+    }
+
+    os << "{";
+    bool first = true;
+    for (int e = 0; e < PerfCounters::EVENT_NB; ++e) {
+        if (!mean.valid[e]) continue;
+        os << (first ? "" : ", ") << "\"" << PerfKeys[e] << "\": " << mean.values[e];
+        first = false;
+    }
+    if (mean.valid[PerfCounters::CYCLES] && mean.valid[PerfCounters::INSTRUCTIONS]) {
+        os << (first ? "" : ", ") << "\"ipc\": " << mean.ipc();
+    }
+    os << "}";
+}
+
+PerfCounters::Sample sum_perf(const Run& run) {
+    PerfCounters::Sample total;
+    for (int e = 0; e < PerfCounters::EVENT_NB; ++e) total.valid[e] = !run.empty();
+    for (const PositionSample& p : run) {
+        for (int e = 0; e < PerfCounters::EVENT_NB; ++e) {
+            total.values[e] += p.perf.values[e];
+            total.valid[e] = total.valid[e] && p.perf.valid[e];
+        }
+    }
+    return total;
+}
+
+}
+
+const std::vector<std::string>& positions() {
+    static const std::vector<std::string> list = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r1bqk1nr/pppp1ppp/2n5/2b1p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+        "r1bqkbnr/pp1ppppp/2n5/2p5/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "rnbqkb1r/ppp2ppp/4pn2/3p4/2PP4/2N5/PP2PPPP/R1BQKBNR w KQkq - 2 4",
+        "r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4",
+        "r1bqkbnr/pppp1ppp/2n5/1B2p3/4P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 3 3",
+        "8/8/4k3/3p4/3P1K2/8/8/8 w - - 0 1",
+        "r1bqr1k1/pp1nbppp/2p2n2/3p2B1/3P4/2NBP3/PPQ1NPPP/R3K2R w KQ - 3 10",
+        "r1bq1rk1/ppppbppp/2n2n2/4p3/2P5/5NP1/PP1PPPBP/RNBQ1RK1 w - - 5 6"
+    };
+    return list;
+}
+
+Run run_once(const Config& config, PerfCounters::Group* perf) {
+    Run run;
+
+    Threads.clear_tt();
+    Searcher.clear_history();
+    Threads.clear_all_history();
+
+    for (const std::string& fen : positions()) {
+        StateInfo si;
+        Board board;
+        board.set(fen, &si);
+
+        SearchLimits limits;
+        limits.depth = config.depth;
+        limits.nodes = 100000000;
+
+        PositionSample sample;
+        if (perf) perf->start();
+        auto start = std::chrono::steady_clock::now();
+
+        if (config.threads > 1) {
+            limits.infinite = true;
+            Threads.start_thinking(board, limits);
+            Threads.wait_for_search_finished();
+            sample.nodes = Threads.total_nodes();
+            sample.selDepth = Threads.max_sel_depth();
+            sample.ttProbes = Threads.total_tt_probes();
+            sample.ttHits = Threads.total_tt_hits();
+        } else {
+            Searcher.start(board, limits);
+            sample.nodes = Searcher.stats().nodes;
+            sample.selDepth = Searcher.stats().selDepth;
+            sample.ttProbes = Searcher.stats().ttProbes;
+            sample.ttHits = Searcher.stats().ttHits;
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        if (perf) sample.perf = perf->stop();
+        sample.timeUs = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+        run.push_back(sample);
+    }
+
+    return run;
+}
+
+void write_json(std::ostream& os, const Config& config, const std::vector<Run>& runs) {
+    const std::vector<std::string>& fens = positions();
+    std::ios_base::fmtflags oldFlags = os.flags();
+    std::streamsize oldPrecision = os.precision();
+    os << std::fixed << std::setprecision(3);
+
+    os << "{\n";
+    os << "  \"engine\": \"" << config.engine << "\",\n";
+    os << "  \"depth\": " << config.depth << ",\n";
+    os << "  \"threads\": " << config.threads << ",\n";
+    os << "  \"sliders\": \"" << config.sliders << "\",\n";
+    os << "  \"runs\": " << runs.size() << ",\n";
+    os << "  \"positions\": [\n";
+
+    for (size_t i = 0; i < fens.size(); ++i) {
+        std::vector<double> ms, rates;
+        std::vector<PerfCounters::Sample> perf;
+        U64 probes = 0, hits = 0;
+        bool stable = true;
+        for (const Run& run : runs) {
+            const PositionSample& p = run[i];
+            ms.push_back(p.timeUs / 1000.0);
+            rates.push_back(nps(p.nodes, p.timeUs));
+            perf.push_back(p.perf);
+            probes += p.ttProbes;
+            hits += p.ttHits;
+            stable &= p.nodes == runs[0][i].nodes;
+        }
+        const PositionSample& first = runs[0][i];
+
+        os << "    {\"fen\": \"" << fens[i] << "\", "
+           << "\"nodes\": " << first.nodes << ", "
+           << "\"nodes_stable\": " << (stable ? "true" : "false") << ", "
+           << "\"seldepth\": " << first.selDepth << ", "
+           << "\"tt_hit_rate\": " << rate(hits, probes) << ",\n"
+           << "     \"time_ms\": ";
+        write_moments(os, moments(ms));
+        os << ",\n     \"nps\": ";
+        write_moments(os, moments(rates));
+        os << ",\n     \"perf\": ";
+        write_perf(os, perf);
+        os << "}" << (i + 1 < fens.size() ? "," : "") << "\n";
+    }
+    os << "  ],\n";
+
+    std::vector<double> ms, rates;
+    std::vector<PerfCounters::Sample> perf;
+    U64 nodes = 0, probes = 0, hits = 0;
+    for (const Run& run : runs) {
+        U64 runNodes = 0;
+        int64_t runUs = 0;
+        for (const PositionSample& p : run) {
+            runNodes += p.nodes;
+            runUs += p.timeUs;
+            probes += p.ttProbes;
+            hits += p.ttHits;
+        }
+        if (&run == &runs[0]) nodes = runNodes;
+        ms.push_back(runUs / 1000.0);
+        rates.push_back(nps(runNodes, runUs));
+        perf.push_back(sum_perf(run));
+    }
+
+    os << "  \"total\": {\"nodes\": " << nodes << ", "
+       << "\"tt_hit_rate\": " << rate(hits, probes) << ",\n"
+       << "    \"time_ms\": ";
+    write_moments(os, moments(ms));
+    os << ",\n    \"nps\": ";
+    write_moments(os, moments(rates));
+    os << ",\n    \"perf\": ";
+    write_perf(os, perf);
+    os << "}\n";
+    os << "}\n";
+
+    os.flags(oldFlags);
+    os.precision(oldPrecision);
+}
+
+}
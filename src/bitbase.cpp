@@ -0,0 +1,132 @@
+#include "bitbase.hpp"
+#include "bitboard.hpp"
+#include <algorithm>
+#include <bitset>
+#include <cstdlib>
+#include <vector>
+
+namespace Bitbase {
+
+namespace {
+
+// Pawn on files A-D and ranks 2-7, both kings anywhere, either side to move.
+constexpr int KPK_SIZE = 2 * 24 * 64 * 64;
+
+using KPKTable = std::bitset<KPK_SIZE>;
+
+unsigned kpk_index(Color stm, Square bksq, Square wksq, Square psq) {
+    return unsigned(wksq) | (unsigned(bksq) << 6) | (unsigned(stm) << 12)
+         | (unsigned(file_of(psq)) << 13) | (unsigned(RANK_7 - rank_of(psq)) << 15);
+}
+
+// Bit flags so the results of all moves can be or-ed together.
+enum Result : U8 {
+    INVALID = 0,
+    UNKNOWN = 1,
+    DRAW = 2,
+    WIN = 4
+};
+
+int distance(Square a, Square b) {
+    return std::max(std::abs(file_of(a) - file_of(b)), std::abs(rank_of(a) - rank_of(b)));
+}
+
+struct KPKPosition {
+    Color stm;
+    Square ksq[COLOR_NB];
+    Square psq;
+    Result result;
+
+    explicit KPKPosition(unsigned idx) {
+        ksq[WHITE] = Square(idx & 0x3F);
+        ksq[BLACK] = Square((idx >> 6) & 0x3F);
+        stm = Color((idx >> 12) & 0x01);
+        psq = make_square(File((idx >> 13) & 0x03), Rank(RANK_7 - ((idx >> 15) & 0x07)));
+
+        Square queening = psq + NORTH;
+        if (distance(ksq[WHITE], ksq[BLACK]) <= 1
+            || ksq[WHITE] == psq || ksq[BLACK] == psq
+            || (stm == WHITE && (pawn_attacks_bb(WHITE, psq) & square_bb(ksq[BLACK])))) {
+            result = INVALID;
+        } else if (stm == WHITE && rank_of(psq) == RANK_7
+                   && ksq[WHITE] != queening && ksq[BLACK] != queening
+                   && (distance(ksq[BLACK], queening) > 1 || distance(ksq[WHITE], queening) == 1)) {
+            // Promotes and the queen cannot be taken.
+            result = WIN;
+        } else if (stm == BLACK
+                   && (!(king_attacks_bb(ksq[BLACK]) & ~(king_attacks_bb(ksq[WHITE]) | pawn_attacks_bb(WHITE, psq)))
+                       || (king_attacks_bb(ksq[BLACK]) & ~king_attacks_bb(ksq[WHITE]) & square_bb(psq)))) {
+            // Stalemate, or the pawn falls.
+            result = DRAW;
+        } else {
+            result = UNKNOWN;
+        }
+    }
+
+    // The side to move wins (White) or holds (Black) if any move reaches
+    // such a position, and loses only when every move is known to.
+    Result classify(const std::vector<KPKPosition>& db) const {
+        const Result good = stm == WHITE ? WIN : DRAW;
+        const Result bad = stm == WHITE ? DRAW : WIN;
+        Color them = ~stm;
+
+        int r = INVALID;
+        Bitboard b = king_attacks_bb(ksq[stm]);
+        while (b) {
+            Square s = pop_lsb(b);
+            r |= stm == WHITE ? db[kpk_index(them, ksq[them], s, psq)].result
+                              : db[kpk_index(them, s, ksq[them], psq)].result;
+        }
+
+        if (stm == WHITE) {
+            if (rank_of(psq) < RANK_7) {
+                r |= db[kpk_index(them, ksq[them], ksq[WHITE], psq + NORTH)].result;
+            }
+            if (rank_of(psq) == RANK_2 && psq + NORTH != ksq[WHITE] && psq + NORTH != ksq[BLACK]) {
+                r |= db[kpk_index(them, ksq[them], ksq[WHITE], psq + NORTH + NORTH)].result;
+            }
+        }
+
+        return (r & good) ? good : (r & UNKNOWN) ? UNKNOWN : bad;
+    }
+};
+
+KPKTable solve_kpk() {
+    std::vector<KPKPosition> db;
+    db.reserve(KPK_SIZE);
+    for (unsigned idx = 0; idx < KPK_SIZE; ++idx) {
+        db.emplace_back(idx);
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (KPKPosition& pos : db) {
+            if (pos.result == UNKNOWN) {
+                pos.result = pos.classify(db);
+                changed |= pos.result != UNKNOWN;
+            }
+        }
+    }
+
+    // Positions still unknown cannot be forced to a win.
+    KPKTable wins;
+    for (unsigned idx = 0; idx < KPK_SIZE; ++idx) {
+        wins[idx] = db[idx].result == WIN;
+    }
+    return wins;
+}
+
+}
+
+bool probe_kpk(Square wksq, Square wpsq, Square bksq, Color stm) {
+    if (file_of(wpsq) > FILE_D) {
+        wksq = Square(wksq ^ 7);
+        wpsq = Square(wpsq ^ 7);
+        bksq = Square(bksq ^ 7);
+    }
+    static const KPKTable wins = solve_kpk();
+    return wins[kpk_index(stm, bksq, wksq, wpsq)];
+}
+
+}
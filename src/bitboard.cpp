@@ -2,19 +2,9 @@
 #include <iostream>
 #include <sstream>
 
-Bitboard FileBB[FILE_NB];
-Bitboard RankBB[RANK_NB];
-Bitboard SquareBB[SQUARE_NB];
-Bitboard BetweenBB[SQUARE_NB][SQUARE_NB];
-Bitboard LineBB[SQUARE_NB][SQUARE_NB];
-
-Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
-Bitboard KnightAttacks[SQUARE_NB];
-Bitboard KingAttacks[SQUARE_NB];
-
 namespace {
 
-Bitboard sliding_attack(PieceType pt, Square sq, Bitboard occupied) {
+constexpr Bitboard sliding_attack(PieceType pt, Square sq, Bitboard occupied) {
     Bitboard attacks = EMPTY_BB;
 
     Direction rook_directions[4] = {NORTH, SOUTH, EAST, WEST};
@@ -56,15 +46,42 @@ Bitboard sliding_attack(PieceType pt, Square sq, Bitboard occupied) {
     return attacks;
 }
 
-void init_pawn_attacks() {
+constexpr std::array<Bitboard, FILE_NB> make_files() {
+    std::array<Bitboard, FILE_NB> files{};
+    for (File f = FILE_A; f <= FILE_H; ++f) {
+        files[f] = FILE_A_BB << f;
+    }
+    return files;
+}
+
+constexpr std::array<Bitboard, RANK_NB> make_ranks() {
+    std::array<Bitboard, RANK_NB> ranks{};
+    for (Rank r = RANK_1; r <= RANK_8; ++r) {
+        ranks[r] = RANK_1_BB << (8 * r);
+    }
+    return ranks;
+}
+
+constexpr SquareBoards make_squares() {
+    SquareBoards squares{};
+    for (Square s = SQ_A1; s <= SQ_H8; ++s) {
+        squares[s] = 1ULL << s;
+    }
+    return squares;
+}
+
+constexpr std::array<SquareBoards, COLOR_NB> make_pawn_attacks() {
+    std::array<SquareBoards, COLOR_NB> attacks{};
     for (Square s = SQ_A1; s <= SQ_H8; ++s) {
         Bitboard sq_bb = square_bb(s);
-        PawnAttacks[WHITE][s] = shift<NORTH_WEST>(sq_bb) | shift<NORTH_EAST>(sq_bb);
-        PawnAttacks[BLACK][s] = shift<SOUTH_WEST>(sq_bb) | shift<SOUTH_EAST>(sq_bb);
+        attacks[WHITE][s] = shift<NORTH_WEST>(sq_bb) | shift<NORTH_EAST>(sq_bb);
+        attacks[BLACK][s] = shift<SOUTH_WEST>(sq_bb) | shift<SOUTH_EAST>(sq_bb);
     }
+    return attacks;
 }
 
-void init_knight_attacks() {
+constexpr SquareBoards make_knight_attacks() {
+    SquareBoards knight{};
     for (Square s = SQ_A1; s <= SQ_H8; ++s) {
         Bitboard attacks = EMPTY_BB;
         Bitboard sq_bb = square_bb(s);
@@ -78,27 +95,32 @@ void init_knight_attacks() {
         attacks |= (sq_bb & NOT_FILE_AB_BB) >> 10;
         attacks |= (sq_bb & NOT_FILE_GH_BB) >> 6;
 
-        KnightAttacks[s] = attacks;
+        knight[s] = attacks;
     }
+    return knight;
 }
 
-void init_king_attacks() {
+constexpr SquareBoards make_king_attacks() {
+    SquareBoards king{};
     for (Square s = SQ_A1; s <= SQ_H8; ++s) {
         Bitboard sq_bb = square_bb(s);
 
-        KingAttacks[s] = shift<NORTH>(sq_bb) | shift<SOUTH>(sq_bb) |
-                         shift<EAST>(sq_bb)  | shift<WEST>(sq_bb)  |
-                         shift<NORTH_EAST>(sq_bb) | shift<NORTH_WEST>(sq_bb) |
-                         shift<SOUTH_EAST>(sq_bb) | shift<SOUTH_WEST>(sq_bb);
+        king[s] = shift<NORTH>(sq_bb) | shift<SOUTH>(sq_bb) |
+                  shift<EAST>(sq_bb)  | shift<WEST>(sq_bb)  |
+                  shift<NORTH_EAST>(sq_bb) | shift<NORTH_WEST>(sq_bb) |
+                  shift<SOUTH_EAST>(sq_bb) | shift<SOUTH_WEST>(sq_bb);
     }
+    return king;
 }
 
-void init_between_line() {
+// Squares strictly between two aligned squares (Line = false), or the whole
+// line through them (Line = true); empty when they are not aligned.
+template<bool Line>
+constexpr std::array<SquareBoards, SQUARE_NB> make_between_line() {
+    std::array<SquareBoards, SQUARE_NB> table{};
+
     for (Square s1 = SQ_A1; s1 <= SQ_H8; ++s1) {
         for (Square s2 = SQ_A1; s2 <= SQ_H8; ++s2) {
-            BetweenBB[s1][s2] = EMPTY_BB;
-            LineBB[s1][s2] = EMPTY_BB;
-
             if (s1 == s2) continue;
 
             File f1 = file_of(s1), f2 = file_of(s2);
@@ -112,6 +134,13 @@ void init_between_line() {
 
             if (!aligned) continue;
 
+            if (Line) {
+                PieceType pt = (f1 == f2 || r1 == r2) ? ROOK : BISHOP;
+                table[s1][s2] = (sliding_attack(pt, s1, EMPTY_BB) &
+                                 sliding_attack(pt, s2, EMPTY_BB)) | s1 | s2;
+                continue;
+            }
+
             int step_f = (df > 0) ? 1 : (df < 0) ? -1 : 0;
             int step_r = (dr > 0) ? 1 : (dr < 0) ? -1 : 0;
 
@@ -125,41 +154,26 @@ void init_between_line() {
                 r = Rank(r + step_r);
             }
 
-            BetweenBB[s1][s2] = between;
-
-            if (f1 == f2 || r1 == r2) {
-                LineBB[s1][s2] = (sliding_attack(ROOK, s1, EMPTY_BB) &
-                                 sliding_attack(ROOK, s2, EMPTY_BB)) | s1 | s2;
-            } else if (df == dr || df == -dr) {
-                LineBB[s1][s2] = (sliding_attack(BISHOP, s1, EMPTY_BB) &
-                                 sliding_attack(BISHOP, s2, EMPTY_BB)) | s1 | s2;
-            }
+            table[s1][s2] = between;
         }
     }
-}
 
+    return table;
 }
 
-namespace Bitboards {
-
-void init() {
-    for (File f = FILE_A; f <= FILE_H; ++f) {
-        FileBB[f] = FILE_A_BB << f;
-    }
+}
 
-    for (Rank r = RANK_1; r <= RANK_8; ++r) {
-        RankBB[r] = RANK_1_BB << (8 * r);
-    }
+constexpr std::array<Bitboard, FILE_NB> FileBB = make_files();
+constexpr std::array<Bitboard, RANK_NB> RankBB = make_ranks();
+constexpr SquareBoards SquareBB = make_squares();
+constexpr std::array<SquareBoards, SQUARE_NB> BetweenBB = make_between_line<false>();
+constexpr std::array<SquareBoards, SQUARE_NB> LineBB = make_between_line<true>();
 
-    for (Square s = SQ_A1; s <= SQ_H8; ++s) {
-        SquareBB[s] = 1ULL << s;
-    }
+constexpr std::array<SquareBoards, COLOR_NB> PawnAttacks = make_pawn_attacks();
+constexpr SquareBoards KnightAttacks = make_knight_attacks();
+constexpr SquareBoards KingAttacks = make_king_attacks();
 
-    init_pawn_attacks();
-    init_knight_attacks();
-    init_king_attacks();
-    init_between_line();
-}
+namespace Bitboards {
 
 std::string pretty(Bitboard b) {
     std::ostringstream ss;
@@ -1,23 +1,16 @@
 #include "board.hpp"
 #include "eval.hpp"
+#include "book.hpp"
 #include <sstream>
 #include <iostream>
 #include <cstring>
+#include <cstddef>
 
 const std::string Board::StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 
 // Piece characters for FEN
 const char PieceToChar[] = " PNBRQK  pnbrqk";
 
-namespace Position {
-
-void init() {
-    Bitboards::init();
-    Magics::init();
-    Zobrist::init();
-}
-
-}
 
 Board::Board() {
     clear();
@@ -164,6 +157,7 @@ void Board::set(const std::string& fen, StateInfo* si) {
         gamePly = (std::stoi(token) - 1) * 2 + (sideToMove == BLACK);
     }
 
+    refresh_attacks(pieces());
     set_state(si);
 }
 
@@ -171,6 +165,7 @@ void Board::set_state(StateInfo* si) {
     si->positionKey = compute_key();
     si->pawnKey = compute_pawn_key();
     si->materialKey = compute_material_key();
+    si->polyglotKey = compute_polyglot_key();
 
     si->psqtScore[WHITE] = EvalScore(0, 0);
     si->psqtScore[BLACK] = EvalScore(0, 0);
@@ -262,6 +257,24 @@ Key Board::compute_key() const {
     return k;
 }
 
+Key Board::compute_polyglot_key() const {
+    Key k = 0;
+
+    Bitboard bb = pieces();
+    while (bb) {
+        Square s = pop_lsb(bb);
+        k ^= Book::polyglot_piece_key(piece_on(s), s);
+    }
+
+    k ^= Book::polyglot_castling_key(st->castling);
+
+    if (sideToMove == WHITE) {
+        k ^= Book::PolyglotRandomTurn;
+    }
+
+    return k;
+}
+
 Key Board::compute_pawn_key() const {
     Key k = 0;
 
@@ -289,10 +302,6 @@ Key Board::compute_material_key() const {
     return k;
 }
 
-Bitboard Board::attackers_to(Square s) const {
-    return attackers_to(s, pieces());
-}
-
 Bitboard Board::attackers_to(Square s, Bitboard occupied) const {
     return (pawn_attacks_bb(BLACK, s) & pieces(WHITE, PAWN))
          | (pawn_attacks_bb(WHITE, s) & pieces(BLACK, PAWN))
@@ -306,6 +315,41 @@ bool Board::is_attacked_by(Color c, Square s) const {
     return attackers_to(s) & pieces(c);
 }
 
+// Squares whose attacks go stale when the occupancy of `changed` changes:
+// the changed squares themselves plus every slider that currently sees one
+// of them. A slider that does not see any changed square is blocked short
+// of all of them and keeps its attacks.
+Bitboard Board::stale_attacks(Bitboard changed) const {
+#ifdef USE_ATTACK_MAP
+    Bitboard seers = EMPTY_BB;
+    Bitboard bb = changed;
+    while (bb) {
+        seers |= attackersTo[pop_lsb(bb)];
+    }
+    return changed | (seers & (pieces(BISHOP, QUEEN) | pieces(ROOK)));
+#else
+    (void)changed;
+    return EMPTY_BB;
+#endif
+}
+
+void Board::refresh_attacks(Bitboard squares) {
+#ifdef USE_ATTACK_MAP
+    Bitboard occupied = pieces();
+    while (squares) {
+        Square s = pop_lsb(squares);
+        Bitboard now = empty(s) ? EMPTY_BB : piece_attacks_bb(piece_on(s), s, occupied);
+        Bitboard diff = attacksFrom[s] ^ now;
+        attacksFrom[s] = now;
+        while (diff) {
+            attackersTo[pop_lsb(diff)] ^= square_bb(s);
+        }
+    }
+#else
+    (void)squares;
+#endif
+}
+
 Bitboard Board::slider_blockers(Bitboard sliders, Square s, Bitboard& pinners_out) const {
     Bitboard blockers = EMPTY_BB;
     pinners_out = EMPTY_BB;
@@ -394,6 +438,91 @@ std::string Board::pretty() const {
     return ss.str();
 }
 
+namespace {
+
+// Squares whose occupancy a move changes, in both directions.
+Bitboard changed_squares(Move m, Color us) {
+    Square from = m.from();
+    Square to = m.to();
+    Bitboard changed = square_bb(from) | square_bb(to);
+
+    if (m.is_enpassant()) {
+        changed |= square_bb(to - pawn_push(us));
+    } else if (m.is_castling()) {
+        changed |= to > from ? square_bb(Square(from + 3)) | square_bb(Square(from + 1))
+                             : square_bb(Square(from - 4)) | square_bb(Square(from - 1));
+    }
+    return changed;
+}
+
+}
+
+Key Board::key_after(Move m) const {
+    Color us = sideToMove;
+    Color them = ~us;
+    Square from = m.from();
+    Square to = m.to();
+    Piece pc = piece_on(from);
+    Key k = st->positionKey ^ Zobrist::side_key();
+
+    if (m.is_enpassant()) {
+        k ^= Zobrist::piece_key(make_piece(them, PAWN), to - pawn_push(us));
+    } else if (piece_on(to) != NO_PIECE) {
+        k ^= Zobrist::piece_key(piece_on(to), to);
+    }
+
+    CastlingRights castling = st->castling & castlingRightsMask[from] & castlingRightsMask[to];
+    k ^= Zobrist::castling_key(st->castling) ^ Zobrist::castling_key(castling);
+
+    if (st->enPassant != SQ_NONE) {
+        k ^= Zobrist::enpassant_key(file_of(st->enPassant));
+    }
+
+    if (m.is_castling()) {
+        Square rfrom = to > from ? Square(from + 3) : Square(from - 4);
+        Square rto = to > from ? Square(from + 1) : Square(from - 1);
+        Piece rook = piece_on(rfrom);
+        return k ^ Zobrist::piece_key(pc, from) ^ Zobrist::piece_key(pc, to)
+                 ^ Zobrist::piece_key(rook, rfrom) ^ Zobrist::piece_key(rook, rto);
+    }
+
+    if (m.is_promotion()) {
+        return k ^ Zobrist::piece_key(pc, from) ^ Zobrist::piece_key(make_piece(us, m.promotion_type()), to);
+    }
+
+    k ^= Zobrist::piece_key(pc, from) ^ Zobrist::piece_key(pc, to);
+
+    if (type_of(pc) == PAWN && std::abs(int(to) - int(from)) == 16) {
+        Square ep_sq = Square((from + to) / 2);
+        if (pawn_attacks_bb(us, ep_sq) & pieces(them, PAWN)) {
+            k ^= Zobrist::enpassant_key(file_of(ep_sq));
+        }
+    }
+
+    return k;
+}
+
+Key Board::pawn_key_after(Move m) const {
+    Color us = sideToMove;
+    Square from = m.from();
+    Square to = m.to();
+    Piece pc = piece_on(from);
+    Key k = st->pawnKey;
+
+    if (m.is_enpassant()) {
+        k ^= Zobrist::piece_key(make_piece(~us, PAWN), to - pawn_push(us));
+    } else if (type_of(piece_on(to)) == PAWN) {
+        k ^= Zobrist::piece_key(piece_on(to), to);
+    }
+
+    if (type_of(pc) == PAWN) {
+        k ^= Zobrist::piece_key(pc, from);
+        if (!m.is_promotion()) k ^= Zobrist::piece_key(pc, to);
+    }
+
+    return k;
+}
+
 void Board::do_move(Move m, StateInfo& newSt) {
     Color us = sideToMove;
     Color them = ~us;
@@ -401,12 +530,16 @@ void Board::do_move(Move m, StateInfo& newSt) {
     Square to = m.to();
     Piece pc = piece_on(from);
     Piece captured = m.is_enpassant() ? make_piece(them, PAWN) : piece_on(to);
+    Bitboard stale = stale_attacks(changed_squares(m, us));
 
-    std::memcpy(&newSt, st, sizeof(StateInfo));
+    std::memcpy(static_cast<void*>(&newSt), st, offsetof(StateInfo, dirtyPiece));
     newSt.previous = st;
+    newSt.dirtyPiece.count = 0;
+    newSt.accumulator.computed = false;
     st = &newSt;
 
     Key k = st->positionKey ^ Zobrist::side_key();
+    Key pk = st->polyglotKey ^ Book::PolyglotRandomTurn;
 
     if (captured != NO_PIECE) {
         Square capsq = to;
@@ -418,8 +551,11 @@ void Board::do_move(Move m, StateInfo& newSt) {
         st->psqtScore[them] -= Eval::piece_pst_score(captured, capsq);
 
         remove_piece(capsq);
+        st->dirtyPiece.add(captured, capsq, SQ_NONE);
 
         k ^= Zobrist::piece_key(captured, capsq);
+        pk ^= Book::polyglot_piece_key(captured, capsq);
+        st->materialKey ^= Zobrist::piece_key(captured, Square(pieceCount[captured]));
 
         if (type_of(captured) == PAWN) {
             st->pawnKey ^= Zobrist::piece_key(captured, capsq);
@@ -435,6 +571,7 @@ void Board::do_move(Move m, StateInfo& newSt) {
     CastlingRights oldCastling = st->castling;
     st->castling &= castlingRightsMask[from] & castlingRightsMask[to];
     k ^= Zobrist::castling_key(oldCastling) ^ Zobrist::castling_key(st->castling);
+    pk ^= Book::polyglot_castling_key(oldCastling) ^ Book::polyglot_castling_key(st->castling);
 
     if (st->enPassant != SQ_NONE) {
         k ^= Zobrist::enpassant_key(file_of(st->enPassant));
@@ -455,13 +592,17 @@ void Board::do_move(Move m, StateInfo& newSt) {
         st->psqtScore[us] += Eval::piece_pst_score(pc, to);
 
         k ^= Zobrist::piece_key(pc, from) ^ Zobrist::piece_key(pc, to);
+        pk ^= Book::polyglot_piece_key(pc, from) ^ Book::polyglot_piece_key(pc, to);
         move_piece(from, to);
+        st->dirtyPiece.add(pc, from, to);
 
         Piece rook = piece_on(rfrom);
         st->psqtScore[us] -= Eval::piece_pst_score(rook, rfrom);
         st->psqtScore[us] += Eval::piece_pst_score(rook, rto);
         k ^= Zobrist::piece_key(rook, rfrom) ^ Zobrist::piece_key(rook, rto);
+        pk ^= Book::polyglot_piece_key(rook, rfrom) ^ Book::polyglot_piece_key(rook, rto);
         move_piece(rfrom, rto);
+        st->dirtyPiece.add(rook, rfrom, rto);
 
     } else if (m.is_promotion()) {
         Piece promoted = make_piece(us, m.promotion_type());
@@ -470,10 +611,16 @@ void Board::do_move(Move m, StateInfo& newSt) {
         st->psqtScore[us] += Eval::piece_pst_score(promoted, to);
 
         k ^= Zobrist::piece_key(pc, from);
+        pk ^= Book::polyglot_piece_key(pc, from);
         remove_piece(from);
+        st->materialKey ^= Zobrist::piece_key(pc, Square(pieceCount[pc]));
 
         k ^= Zobrist::piece_key(promoted, to);
+        pk ^= Book::polyglot_piece_key(promoted, to);
+        st->materialKey ^= Zobrist::piece_key(promoted, Square(pieceCount[promoted]));
         put_piece(promoted, to);
+        st->dirtyPiece.add(pc, from, SQ_NONE);
+        st->dirtyPiece.add(promoted, SQ_NONE, to);
 
         st->pawnKey ^= Zobrist::piece_key(pc, from);
 
@@ -484,7 +631,9 @@ void Board::do_move(Move m, StateInfo& newSt) {
         st->psqtScore[us] += Eval::piece_pst_score(pc, to);
 
         k ^= Zobrist::piece_key(pc, from) ^ Zobrist::piece_key(pc, to);
+        pk ^= Book::polyglot_piece_key(pc, from) ^ Book::polyglot_piece_key(pc, to);
         move_piece(from, to);
+        st->dirtyPiece.add(pc, from, to);
 
         if (type_of(pc) == PAWN) {
             st->halfmoveClock = 0;
@@ -501,6 +650,7 @@ void Board::do_move(Move m, StateInfo& newSt) {
     }
 
     st->positionKey = k;
+    st->polyglotKey = pk;
     st->pliesFromNull++;
 
     st->repetition = 0;
@@ -519,6 +669,7 @@ void Board::do_move(Move m, StateInfo& newSt) {
     sideToMove = them;
     ++gamePly;
 
+    refresh_attacks(stale);
     set_check_info();
 }
 
@@ -528,6 +679,7 @@ void Board::undo_move(Move m) {
     Square from = m.from();
     Square to = m.to();
     Piece pc = piece_on(to);
+    Bitboard stale = stale_attacks(changed_squares(m, us));
 
     if (m.is_castling()) {
         Square rfrom, rto;
@@ -562,14 +714,18 @@ void Board::undo_move(Move m) {
         put_piece(captured, capsq);
     }
 
+    refresh_attacks(stale);
+
     st = st->previous;
     sideToMove = us;
     --gamePly;
 }
 
 void Board::do_null_move(StateInfo& newSt) {
-    std::memcpy(&newSt, st, sizeof(StateInfo));
+    std::memcpy(static_cast<void*>(&newSt), st, offsetof(StateInfo, dirtyPiece));
     newSt.previous = st;
+    newSt.dirtyPiece.count = 0;
+    newSt.accumulator.computed = false;
     st = &newSt;
     if (st->enPassant != SQ_NONE) {
         st->positionKey ^= Zobrist::enpassant_key(file_of(st->enPassant));
@@ -577,6 +733,7 @@ void Board::do_null_move(StateInfo& newSt) {
     }
 
     st->positionKey ^= Zobrist::side_key();
+    st->polyglotKey ^= Book::PolyglotRandomTurn;
     st->pliesFromNull = 0;
     st->halfmoveClock++;
 
@@ -650,3 +807,41 @@ bool Board::is_draw(int ply) const {
 bool Board::has_repeated() const {
     return st->repetition != 0;
 }
+
+// True if the side to move has a reversible move that reaches a position
+// seen earlier in this line, or one that lets the opponent's earlier
+// alternative repeat: the search can score such a node as a draw before
+// the repetition has happened (Marcel van Kervinck's cuckoo method).
+bool Board::has_game_cycle(int ply) const {
+    int end = std::min(st->halfmoveClock, st->pliesFromNull);
+    if (end < 3) return false;
+
+    Key originalKey = st->positionKey;
+    const StateInfo* stp = st->previous;
+
+    for (int i = 3; i <= end; i += 2) {
+        stp = stp->previous->previous;
+
+        Key moveKey = originalKey ^ stp->positionKey;
+        int j = Zobrist::cuckoo_h1(moveKey);
+        if (Zobrist::Cuckoo[j] != moveKey) {
+            j = Zobrist::cuckoo_h2(moveKey);
+            if (Zobrist::Cuckoo[j] != moveKey) continue;
+        }
+
+        Move move = Zobrist::CuckooMove[j];
+        Square s1 = move.from();
+        Square s2 = move.to();
+        if (between_bb(s1, s2) & pieces()) continue;
+
+        if (ply > i) return true;
+
+        // At or before the root only a repetition by our own move counts,
+        // and it needs the position to have occurred twice already. The
+        // table stores one orientation of the move, so pick the occupied end.
+        if (color_of(piece_on(empty(s1) ? s2 : s1)) != sideToMove) continue;
+        if (stp->repetition) return true;
+    }
+
+    return false;
+}
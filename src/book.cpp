@@ -1,40 +1,260 @@
 #include "book.hpp"
+#include <algorithm>
+#include <fstream>
+#include <random>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace Book {
 
 OpeningBook book;
 
-U64 PolyglotRandomPieceData[768];
-U64 PolyglotRandomCastlingData[16];
-U64 PolyglotRandomEnPassantData[8];
-U64 PolyglotRandomTurnData;
+namespace {
+    // std::mt19937_64, which is not constexpr, reimplemented so the keys can
+    // be generated at compile time.
+    class Mt19937_64 {
+    public:
+        constexpr explicit Mt19937_64(U64 seed) {
+            state[0] = seed;
+            for (int i = 1; i < N; ++i) {
+                state[i] = 6364136223846793005ULL * (state[i - 1] ^ (state[i - 1] >> 62)) + U64(i);
+            }
+        }
+
+        constexpr U64 operator()() {
+            if (index == N) twist();
+
+            U64 x = state[index++];
+            x ^= (x >> 29) & 0x5555555555555555ULL;
+            x ^= (x << 17) & 0x71D67FFFEDA60000ULL;
+            x ^= (x << 37) & 0xFFF7EEE000000000ULL;
+            return x ^ (x >> 43);
+        }
+
+    private:
+        static constexpr int N = 312;
+        static constexpr int M = 156;
+
+        constexpr void twist() {
+            for (int i = 0; i < N; ++i) {
+                U64 x = (state[i] & 0xFFFFFFFF80000000ULL) | (state[(i + 1) % N] & 0x7FFFFFFFULL);
+                U64 xA = x >> 1;
+                if (x & 1) xA ^= 0xB5026F5AA96619E9ULL;
+                state[i] = state[(i + M) % N] ^ xA;
+            }
+            index = 0;
+        }
+
+        U64 state[N] = {};
+        int index = N;
+    };
+
+    struct PolyglotKeys {
+        U64 piece[768] = {};
+        U64 castling[16] = {};
+        U64 enPassant[8] = {};
+    };
+
+    constexpr PolyglotKeys make_polyglot_keys() {
+        PolyglotKeys keys;
+        Mt19937_64 rng(0x1234567890ABCDEFULL);
 
-const U64* PolyglotRandomPiece = PolyglotRandomPieceData;
-const U64* PolyglotRandomCastling = PolyglotRandomCastlingData;
-const U64* PolyglotRandomEnPassant = PolyglotRandomEnPassantData;
+        for (int i = 0; i < 768; ++i) {
+            keys.piece[i] = rng();
+        }
+
+        for (int i = 1; i < 16; ++i) {
+            keys.castling[i] = rng();
+        }
+
+        for (int i = 0; i < 8; ++i) {
+            keys.enPassant[i] = rng();
+        }
+
+        return keys;
+    }
+
+    constexpr PolyglotKeys Keys = make_polyglot_keys();
+}
+
+const U64* PolyglotRandomPiece = Keys.piece;
+const U64* PolyglotRandomCastling = Keys.castling;
+const U64* PolyglotRandomEnPassant = Keys.enPassant;
 const U64 PolyglotRandomTurn = 0xF8D626AAAF278509ULL;
 
 namespace {
-    struct PolyglotInit {
-        PolyglotInit() {
-            std::mt19937_64 rng(0x1234567890ABCDEFULL);
+    U64 read_be(const unsigned char* p, int n) {
+        U64 v = 0;
+        for (int i = 0; i < n; ++i) v = (v << 8) | p[i];
+        return v;
+    }
+}
 
-            for (int i = 0; i < 768; ++i) {
-                PolyglotRandomPieceData[i] = rng();
-            }
+bool OpeningBook::load(const std::string& filename) {
+    close();
 
-            PolyglotRandomCastlingData[0] = 0ULL;
-            for (int i = 1; i < 16; ++i) {
-                PolyglotRandomCastlingData[i] = rng();
-            }
+#ifdef _WIN32
+    HANDLE fd = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (fd == INVALID_HANDLE_VALUE) return false;
 
-            for (int i = 0; i < 8; ++i) {
-                PolyglotRandomEnPassantData[i] = rng();
-            }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(fd, &size)) {
+        CloseHandle(fd);
+        return false;
+    }
+    bytes = static_cast<size_t>(size.QuadPart);
+
+    if (bytes >= RECORD_SIZE) {
+        HANDLE map = CreateFileMapping(fd, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* addr = map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (addr) {
+            mapping = map;
+            data = static_cast<const unsigned char*>(addr);
+            mapped = true;
+        } else if (map) {
+            CloseHandle(map);
+        }
+    }
+    CloseHandle(fd);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1) return false;
+
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) != 0) {
+        ::close(fd);
+        return false;
+    }
+    bytes = static_cast<size_t>(statbuf.st_size);
+
+    if (bytes >= RECORD_SIZE) {
+        void* addr = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED) {
+#ifdef MADV_RANDOM
+            madvise(addr, bytes, MADV_RANDOM);
+#endif
+            data = static_cast<const unsigned char*>(addr);
+            mapped = true;
+        }
+    }
+    ::close(fd);
+#endif
+
+    if (!mapped && bytes >= RECORD_SIZE) {
+        std::ifstream file(filename, std::ios::binary);
+        buffer.resize(bytes);
+        if (!file.read(reinterpret_cast<char*>(buffer.data()), std::streamsize(bytes))) {
+            close();
+            return false;
+        }
+        data = buffer.data();
+    }
+
+    count = data ? bytes / RECORD_SIZE : 0;
+    return count > 0;
+}
+
+void OpeningBook::close() {
+    if (mapped) {
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle(mapping);
+        mapping = nullptr;
+#else
+        munmap(const_cast<unsigned char*>(data), bytes);
+#endif
+    }
+    buffer.clear();
+    buffer.shrink_to_fit();
+    data = nullptr;
+    count = 0;
+    bytes = 0;
+    mapped = false;
+}
+
+U64 OpeningBook::key_at(size_t i) const {
+    return read_be(data + i * RECORD_SIZE, 8);
+}
+
+BookEntry OpeningBook::entry(size_t i) const {
+    const unsigned char* p = data + i * RECORD_SIZE;
+    BookEntry e;
+    e.key = read_be(p, 8);
+    e.move = uint16_t(read_be(p + 8, 2));
+    e.weight = uint16_t(read_be(p + 10, 2));
+    e.learn = uint32_t(read_be(p + 12, 4));
+    return e;
+}
 
-            PolyglotRandomTurnData = rng();
+size_t OpeningBook::lower_bound(U64 key) const {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (key_at(mid) < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+std::vector<std::pair<Move, int>> OpeningBook::get_moves(const Board& board) const {
+    std::vector<std::pair<Move, int>> moves;
+    if (!is_loaded()) return moves;
+
+    U64 key = polyglot_key(board);
+    for (size_t i = lower_bound(key); i < count && key_at(i) == key; ++i) {
+        BookEntry e = entry(i);
+        Move m = decode_polyglot_move(board, e.move);
+        if (m != MOVE_NONE) {
+            moves.push_back({m, e.weight});
+        }
+    }
+
+    std::stable_sort(moves.begin(), moves.end(),
+        [](const auto& a, const auto& b) { return a.second > b.second; });
+
+    return moves;
+}
+
+Move OpeningBook::probe(const Board& board) const {
+    std::vector<std::pair<Move, int>> moves = get_moves(board);
+    if (moves.empty()) {
+        return MOVE_NONE;
+    }
+
+    if (variety && moves.size() > 1) {
+        int totalWeight = 0;
+        for (const auto& mv : moves) {
+            totalWeight += mv.second;
         }
-    } polyglot_init;
+
+        if (totalWeight > 0) {
+            static std::random_device rd;
+            static std::mt19937 gen(rd());
+            std::uniform_int_distribution<> dis(0, totalWeight - 1);
+
+            int pick = dis(gen);
+            int cumulative = 0;
+            for (const auto& mv : moves) {
+                cumulative += mv.second;
+                if (pick < cumulative) {
+                    return mv.first;
+                }
+            }
+        }
+    }
+
+    return moves.front().first;
 }
 
 }
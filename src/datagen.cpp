@@ -13,6 +13,23 @@
 #include <sstream>
 #include <filesystem>
 #include <memory>
+#include <map>
+#include <condition_variable>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace DataGen {
 
@@ -20,6 +37,127 @@ static std::unique_ptr<DataGenerator> g_generator = nullptr;
 static std::mutex g_mutex;
 static std::mutex g_search_mutex;
 
+namespace {
+
+// 0xFF cannot start a raw file: the low nibble of packed_board[0] is a piece code.
+constexpr uint8_t CHAIN_MAGIC[8] = {0xFF, 'G', 'C', 'C', 'H', 'A', 'I', 'N'};
+
+void pack_board(const Board& board, TrainingEntry& entry) {
+    memset(&entry, 0, sizeof(entry));
+
+    for (Square sq = SQ_A1; sq <= SQ_H8; ++sq) {
+        Piece pc = board.piece_on(sq);
+
+        uint8_t piece_code = PTYPE_EMPTY;
+        if (pc != NO_PIECE) {
+            PieceType pt = type_of(pc);
+            Color c = color_of(pc);
+            piece_code = static_cast<uint8_t>(pt - PAWN + 1);
+            if (c == BLACK) {
+                piece_code += 6;
+            }
+        }
+
+        int sq_idx = static_cast<int>(sq);
+        int byte_idx = sq_idx / 2;
+        if (sq_idx % 2 == 0) {
+            entry.packed_board[byte_idx] = (entry.packed_board[byte_idx] & 0xF0) | piece_code;
+        } else {
+            entry.packed_board[byte_idx] = (entry.packed_board[byte_idx] & 0x0F) | (piece_code << 4);
+        }
+    }
+
+    entry.stm = board.side_to_move() == WHITE ? 0 : 1;
+
+    entry.castling = static_cast<uint8_t>(board.castling_rights());
+
+    Square ep = board.en_passant_square();
+    entry.ep_square = (ep == SQ_NONE) ? 64 : static_cast<uint8_t>(ep);
+
+    entry.rule50 = static_cast<uint8_t>(std::min(255, board.halfmove_clock()));
+}
+
+// Legal moves in raw-value order, so move indices do not depend on the
+// order the generator happens to emit them in.
+int sorted_legal_moves(const Board& board, uint16_t out[]) {
+    MoveList moves;
+    MoveGen::generate_legal(board, moves);
+    for (int i = 0; i < moves.size(); ++i) out[i] = moves[i].move.raw();
+    std::sort(out, out + moves.size());
+    return moves.size();
+}
+
+int index_bits(int n) {
+    int bits = 0;
+    while ((1 << bits) < n) ++bits;
+    return bits;
+}
+
+void put_varint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(uint8_t(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(uint8_t(v));
+}
+
+bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t b = *p++;
+        v |= uint64_t(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+uint64_t zigzag(int v) { return (uint64_t(int64_t(v)) << 1) ^ uint64_t(int64_t(v) >> 63); }
+int unzigzag(uint64_t v) { return int(int64_t(v >> 1) ^ -int64_t(v & 1)); }
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& o) : out(o) {}
+
+    void put(uint32_t value, int bits) {
+        for (int i = 0; i < bits; ++i) {
+            if (used == 0) out.push_back(0);
+            out.back() |= uint8_t(((value >> i) & 1) << used);
+            used = (used + 1) & 7;
+        }
+    }
+
+private:
+    std::vector<uint8_t>& out;
+    int used = 0;
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t* b, const uint8_t* e) : p(b), end(e) {}
+
+    bool get(int bits, uint32_t& value) {
+        value = 0;
+        for (int i = 0; i < bits; ++i) {
+            if (p == end) return false;
+            value |= uint32_t((*p >> used) & 1) << i;
+            if (++used == 8) {
+                used = 0;
+                ++p;
+            }
+        }
+        return true;
+    }
+
+    const uint8_t* position() const { return used ? p + 1 : p; }
+
+private:
+    const uint8_t* p;
+    const uint8_t* end;
+    int used = 0;
+};
+
+}
+
 void DataGenStats::print() const {
     uint64_t games = games_completed.load();
     uint64_t pos = positions_generated.load();
@@ -44,26 +182,27 @@ void DataGenStats::print() const {
 DataGenerator::DataGenerator(const DataGenConfig& config)
     : m_config(config) {
 
-    m_random_seeds.resize(config.threads);
-    uint64_t base_seed = std::chrono::steady_clock::now().time_since_epoch().count();
-    for (int i = 0; i < config.threads; ++i) {
-        m_random_seeds[i] = base_seed ^ (i * 0x9E3779B97F4A7C15ULL);
-    }
-
+    m_base_seed = config.seed ? config.seed : uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+    m_random_seeds.assign(config.threads, 0);
 
+    // Each worker searches with its own table, so games never share entries
+    // and the cache lines a worker touches are its own.
+    size_t table_mb = size_t(std::max(1, config.hash_mb / config.threads));
+    m_tables.reserve(config.threads);
     m_searchers.reserve(config.threads);
     for (int i = 0; i < config.threads; ++i) {
-        auto searcher = std::make_unique<Search>();
+        m_tables.push_back(std::make_unique<TranspositionTable>(table_mb));
+
+        auto searcher = std::make_unique<Search>(*m_tables.back());
         searcher->set_silent(true);
+        searcher->set_use_book(false);
         m_searchers.push_back(std::move(searcher));
     }
 }
 
 DataGenerator::~DataGenerator() {
     stop();
-    if (m_output.is_open()) {
-        m_output.close();
-    }
+    m_output.close();
 }
 
 void DataGenerator::run() {
@@ -85,8 +224,21 @@ void DataGenerator::run() {
     };
 
     create_output_dir(m_config.output);
-    m_output.open(m_config.output, std::ios::binary | std::ios::app);
-    if (!m_output.is_open()) {
+    bool chained = m_config.format == BinpackFormat::chain;
+    std::error_code ec;
+    bool fresh = !std::filesystem::exists(m_config.output, ec) || std::filesystem::file_size(m_config.output, ec) == 0;
+    if (!fresh && detect_format(m_config.output) != m_config.format) {
+        std::cerr << "Error: " << m_config.output << " already holds data in the other format" << std::endl;
+        running = false;
+        return;
+    }
+    if (fresh && chained) {
+        std::ofstream header(m_config.output, std::ios::binary);
+        header.write(reinterpret_cast<const char*>(CHAIN_MAGIC), sizeof(CHAIN_MAGIC));
+    }
+
+    size_t batch_bytes = size_t(std::max(1, m_config.flush_interval)) * sizeof(TrainingEntry);
+    if (!m_output.open(m_config.output, m_config.threads, batch_bytes, size_t(std::max(0, m_config.sync_mb)) << 20)) {
         std::cerr << "Error: Cannot open output file " << m_config.output << std::endl;
         running = false;
         return;
@@ -105,14 +257,21 @@ void DataGenerator::run() {
         }
     }
 
-    TT.resize(m_config.hash_mb);
-    TT.clear();
 
     std::cout << "\n=== Starting Data Generation ===" << std::endl;
     std::cout << "Threads       : " << m_config.threads << std::endl;
-    std::cout << "Hash          : " << m_config.hash_mb << " MB" << std::endl;
+    std::cout << "Hash          : " << std::max(1, m_config.hash_mb / m_config.threads) << " MB per thread" << std::endl;
+    std::cout << "Seed          : " << m_base_seed << std::endl;
+    if (m_config.shard_count > 1 && m_config.seed == 0) {
+        std::cout << "Warning       : shards only partition games when every shard uses the same seed" << std::endl;
+    }
     std::cout << "Depth         : " << m_config.depth << std::endl;
-    std::cout << "Games target  : " << m_config.games << std::endl;
+    std::cout << "Games target  : " << shard_games();
+    if (m_config.shard_count > 1) {
+        std::cout << " (shard " << m_config.shard_index << "/" << m_config.shard_count
+                  << " of " << m_config.games << ")";
+    }
+    std::cout << std::endl;
     std::cout << "Opening book  : " << (m_config.use_book && book_loaded ?
                                         m_config.book_path + " (loaded, depth " + std::to_string(m_config.book_depth) + ")" :
                                         "disabled") << std::endl;
@@ -121,7 +280,7 @@ void DataGenerator::run() {
     std::cout << "Search margin : " << m_config.search_margin << " cp" << std::endl;
     std::cout << "Max score     : " << m_config.max_score << " cp" << std::endl;
     std::cout << "Eval limit    : " << (m_config.eval_limit > 0 ? std::to_string(m_config.eval_limit) + " cp" : "disabled") << std::endl;
-    std::cout << "Format        : binpack" << std::endl;
+    std::cout << "Format        : " << (chained ? "chain" : "binpack") << std::endl;
     std::cout << "Output        : " << m_config.output << std::endl;
     std::cout << "================================\n" << std::endl;
 
@@ -145,7 +304,7 @@ void DataGenerator::run() {
             double games_per_sec = elapsed > 0 ? static_cast<double>(games) / elapsed : 0;
             double pos_per_sec = elapsed > 0 ? static_cast<double>(pos) / elapsed : 0;
 
-            std::cout << "Progress: " << games << "/" << m_config.games << " games"
+            std::cout << "Progress: " << games << "/" << shard_games() << " games"
                       << " | " << pos << " positions"
                       << " | " << std::fixed << std::setprecision(1) << games_per_sec << " games/s"
                       << " | " << std::setprecision(0) << pos_per_sec << " pos/s"
@@ -161,15 +320,25 @@ void DataGenerator::run() {
     running = false;
     progress_thread.join();
 
-    flush_output();
-    if (m_output.is_open()) m_output.close();
+    bool output_ok = m_output.close();
 
     auto end_time = std::chrono::steady_clock::now();
     auto total_time = std::chrono::duration_cast<std::chrono::seconds>(end_time - start_time).count();
 
-    std::cout << "\n=== Data Generation Complete ===" << std::endl;
+    if (output_ok) {
+        std::cout << "\n=== Data Generation Complete ===" << std::endl;
+    } else {
+        std::cout << "\n=== Data Generation Failed ===" << std::endl;
+        std::cout << "Output " << m_config.output << " is incomplete: only "
+                  << m_output.bytes_written() << " bytes were written" << std::endl;
+    }
     std::cout << "Total time: " << total_time << " seconds" << std::endl;
     m_stats.print();
+    uint64_t pos = m_stats.positions_generated.load();
+    if (chained && pos > 0) {
+        std::cout << "Bytes/position: " << std::fixed << std::setprecision(1)
+                  << double(m_output.bytes_written()) / pos << " (raw: " << sizeof(TrainingEntry) << ")" << std::endl;
+    }
 }
 
 void DataGenerator::stop() {
@@ -179,15 +348,22 @@ void DataGenerator::stop() {
 void DataGenerator::worker_thread(int thread_id) {
     std::vector<TrainingEntry> local_entries;
     local_entries.reserve(1000);
-
-    while (!stop_requested.load()) {
-        uint64_t game_num = m_stats.games_started.fetch_add(1);
-        if (game_num >= static_cast<uint64_t>(m_config.games)) {
+    GameRecord record;
+    std::vector<uint8_t> chain;
+
+    while (!stop_requested.load() && !m_output.failed()) {
+        // Shard i plays global games i, i + n, i + 2n, ...; the game number
+        // also seeds the game, so shards sharing a seed never overlap.
+        uint64_t local_num = m_stats.games_started.fetch_add(1);
+        uint64_t game_num = local_num * m_config.shard_count + m_config.shard_index;
+        if (local_num >= shard_games()) {
             break;
         }
 
         local_entries.clear();
-        GameResult result = play_game(local_entries, thread_id);
+        record.clear();
+        begin_game(thread_id, game_num);
+        GameResult result = play_game(local_entries, record, thread_id);
 
         m_stats.games_completed++;
         switch (result) {
@@ -221,13 +397,23 @@ void DataGenerator::worker_thread(int thread_id) {
             }
         }
 
-        if (!local_entries.empty()) {
-            write_entries(local_entries);
+        if (local_entries.empty()) {
+            continue;
+        }
+
+        if (m_config.format == BinpackFormat::chain) {
+            chain.clear();
+            encode_chain_game(local_entries, record, chain);
+            m_output.append(thread_id, chain.data(), chain.size());
+        } else {
+            m_output.append(thread_id, local_entries.data(), local_entries.size() * sizeof(TrainingEntry));
         }
     }
+
+    m_output.flush(thread_id);
 }
 
-GameResult DataGenerator::play_game(std::vector<TrainingEntry>& entries, int thread_id) {
+GameResult DataGenerator::play_game(std::vector<TrainingEntry>& entries, GameRecord& record, int thread_id) {
     StateInfo state_stack[512];
     int state_idx = 0;
 
@@ -238,16 +424,43 @@ GameResult DataGenerator::play_game(std::vector<TrainingEntry>& entries, int thr
     int adjudicate_count = 0;
     int draw_count = 0;
 
-    if (m_config.use_book && Book::book.is_loaded()) {
+    // With shards, a book line belongs to the shard its end position hashes
+    // to; other shards draw again, so no two machines open the same way.
+    for (int attempt = 0; m_config.use_book && Book::book.is_loaded(); ++attempt) {
         while (ply < m_config.book_depth && state_idx < 510) {
-            Move book_move = Book::book.probe(board);
-            if (book_move == MOVE_NONE) {
+            // Weighted pick from the worker's own generator, not the book's,
+            // so the game depends only on the seed.
+            auto book_moves = Book::book.get_moves(board);
+            int total_weight = 0;
+            for (const auto& bm : book_moves) total_weight += bm.second;
+            if (total_weight <= 0) {
                 break;
             }
 
+            int pick = rand_int(thread_id, total_weight);
+            Move book_move = book_moves.back().first;
+            for (const auto& bm : book_moves) {
+                if ((pick -= bm.second) < 0) {
+                    book_move = bm.first;
+                    break;
+                }
+            }
+
             board.do_move(book_move, state_stack[state_idx++]);
+            record.moves.push_back(book_move);
             ply++;
         }
+
+        if (ply == 0 || m_config.shard_count == 1 || attempt >= 16 * m_config.shard_count
+            || (board.key() * 0x9E3779B97F4A7C15ULL >> 32) % uint64_t(m_config.shard_count)
+                   == uint64_t(m_config.shard_index)) {
+            break;
+        }
+
+        state_idx = 0;
+        board.set(Board::StartFEN, &state_stack[state_idx++]);
+        record.moves.clear();
+        ply = 0;
     }
 
     int random_moves_made = 0;
@@ -261,6 +474,7 @@ GameResult DataGenerator::play_game(std::vector<TrainingEntry>& entries, int thr
         }
 
         board.do_move(m, state_stack[state_idx++]);
+        record.moves.push_back(m);
         ply++;
         random_moves_made++;
     }
@@ -290,6 +504,7 @@ GameResult DataGenerator::play_game(std::vector<TrainingEntry>& entries, int thr
 
         if (should_record_position(board, static_eval, static_eval, ply, best_move, thread_id)) {
             entries.push_back(encode_position(board, static_eval, GameResult::ongoing));
+            record.recorded_plies.push_back(int(record.moves.size()));
             m_stats.positions_generated++;
         } else {
             m_stats.positions_filtered++;
@@ -316,6 +531,7 @@ GameResult DataGenerator::play_game(std::vector<TrainingEntry>& entries, int thr
         }
 
         board.do_move(best_move, state_stack[state_idx++]);
+        record.moves.push_back(best_move);
         ply++;
     }
 
@@ -399,40 +615,7 @@ bool DataGenerator::should_record_position(Board& board, int static_eval, int se
 
 TrainingEntry DataGenerator::encode_position(const Board& board, int score, GameResult result) {
     TrainingEntry entry;
-    memset(&entry, 0, sizeof(entry));
-
-    memset(entry.packed_board, 0, sizeof(entry.packed_board));
-
-    for (Square sq = SQ_A1; sq <= SQ_H8; ++sq) {
-        Piece pc = board.piece_on(sq);
-
-        uint8_t piece_code = PTYPE_EMPTY;
-        if (pc != NO_PIECE) {
-            PieceType pt = type_of(pc);
-            Color c = color_of(pc);
-            piece_code = static_cast<uint8_t>(pt - PAWN + 1);
-            if (c == BLACK) {
-                piece_code += 6;
-            }
-        }
-
-        int sq_idx = static_cast<int>(sq);
-        int byte_idx = sq_idx / 2;
-        if (sq_idx % 2 == 0) {
-            entry.packed_board[byte_idx] = (entry.packed_board[byte_idx] & 0xF0) | piece_code;
-        } else {
-            entry.packed_board[byte_idx] = (entry.packed_board[byte_idx] & 0x0F) | (piece_code << 4);
-        }
-    }
-
-    entry.stm = board.side_to_move() == WHITE ? 0 : 1;
-
-    entry.castling = static_cast<uint8_t>(board.castling_rights());
-
-    Square ep = board.en_passant_square();
-    entry.ep_square = (ep == SQ_NONE) ? 64 : static_cast<uint8_t>(ep);
-
-    entry.rule50 = static_cast<uint8_t>(std::min(255, board.halfmove_clock()));
+    pack_board(board, entry);
 
     switch (result) {
         case GameResult::white_wins: entry.result = 2; break;
@@ -452,30 +635,249 @@ TrainingEntry DataGenerator::encode_position(const Board& board, int score, Game
     return entry;
 }
 
-void DataGenerator::write_entries(const std::vector<TrainingEntry>& entries) {
-    std::lock_guard<std::mutex> lock(m_output_mutex);
+void encode_chain_game(const std::vector<TrainingEntry>& entries, const GameRecord& record,
+                       std::vector<uint8_t>& out) {
+    static thread_local std::vector<StateInfo> states;
+    static thread_local std::vector<uint8_t> body;
+
+    static thread_local std::vector<uint16_t> indices;
+
+    int plies = record.recorded_plies.back();
+    states.resize(std::max(states.size(), size_t(plies) + 1));
+
+    Board board;
+    board.set(Board::StartFEN, &states[0]);
+
+    // Indices first: a move missing from the legal list would make the chain
+    // undecodable, so the game is cut before it.
+    uint16_t legal[MoveList::MAX_MOVES];
+    size_t kept = entries.size();
+    indices.clear();
+    for (int ply = 0; ply < plies; ++ply) {
+        int n = sorted_legal_moves(board, legal);
+        Move m = record.moves[ply];
+        int idx = int(std::lower_bound(legal, legal + n, m.raw()) - legal);
+        if (idx == n || legal[idx] != m.raw()) {
+            kept = size_t(std::lower_bound(record.recorded_plies.begin(), record.recorded_plies.end(), ply + 1)
+                          - record.recorded_plies.begin());
+            plies = kept ? record.recorded_plies[kept - 1] : 0;
+            break;
+        }
+        indices.push_back(uint16_t(idx | (index_bits(n) << 8)));
+        board.do_move(m, states[ply + 1]);
+    }
+    if (kept == 0) return;
+
+    body.clear();
+    body.push_back(entries.front().result);
+    put_varint(body, uint64_t(plies));
+    put_varint(body, kept);
+
+    BitWriter bits(body);
+    size_t next = 0;
+    for (int ply = 0; ; ++ply) {
+        bool recorded = next < kept && record.recorded_plies[next] == ply;
+        bits.put(recorded, 1);
+        next += recorded;
+
+        if (ply == plies) break;
+        bits.put(indices[ply] & 0xFF, indices[ply] >> 8);
+    }
+
+    int prev = 0;
+    for (size_t i = 0; i < kept; ++i) {
+        put_varint(body, zigzag(entries[i].score - prev));
+        prev = entries[i].score;
+    }
+
+    put_varint(out, body.size());
+    out.insert(out.end(), body.begin(), body.end());
+}
+
+BinpackFormat detect_format(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    uint8_t magic[sizeof(CHAIN_MAGIC)];
+    if (file.read(reinterpret_cast<char*>(magic), sizeof(magic))
+        && std::memcmp(magic, CHAIN_MAGIC, sizeof(magic)) == 0) {
+        return BinpackFormat::chain;
+    }
+    return BinpackFormat::raw;
+}
+
+bool BinpackWriter::Ring::push(Buffer* b) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == RING_SIZE) return false;
+    items[h % RING_SIZE] = b;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+BinpackWriter::Buffer* BinpackWriter::Ring::pop() {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return nullptr;
+    Buffer* b = items[t % RING_SIZE];
+    tail.store(t + 1, std::memory_order_release);
+    return b;
+}
+
+bool BinpackWriter::open(const std::string& path, int producers, size_t batch_bytes, size_t sync_bytes) {
+    close();
+
+    file = std::fopen(path.c_str(), "ab");
+    if (!file) return false;
+
+    // Every write is already one large batch, so stdio buffering only adds a copy.
+    std::setvbuf(file, nullptr, _IONBF, 0);
+
+    batchBytes = batch_bytes;
+    syncBytes = sync_bytes;
+    unsynced = 0;
+    written = 0;
+    ioError = false;
+    closing = false;
+
+    slots.clear();
+    for (int i = 0; i < producers; ++i) {
+        slots.push_back(std::make_unique<Slot>());
+        slots.back()->filling = new Buffer();
+        slots.back()->filling->reserve(batchBytes + 65536);
+    }
+
+    writer = std::thread(&BinpackWriter::writer_loop, this);
+    return true;
+}
+
+bool BinpackWriter::close() {
+    if (!file) return !failed();
+
+    closing = true;
+    wake.notify_one();
+    writer.join();
+
+    for (auto& slot : slots) {
+        delete slot->filling;
+        while (Buffer* b = slot->full.pop()) delete b;
+        while (Buffer* b = slot->empty.pop()) delete b;
+    }
+    slots.clear();
+
+    if (std::fclose(file) != 0) report_error("close");
+    file = nullptr;
+    return !failed();
+}
+
+void BinpackWriter::append(int producer, const void* data, size_t size) {
+    Slot& slot = *slots[producer];
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    slot.filling->insert(slot.filling->end(), bytes, bytes + size);
+
+    if (slot.filling->size() < batchBytes) return;
+
+    // A full ring means the writer is behind: keep filling this buffer and
+    // retry after the next game rather than wait, until the buffer reaches
+    // its cap. Past that a slow disk holds the producer back.
+    if (hand_over(slot)) {
+        wake.notify_one();
+    } else if (slot.filling->size() >= MAX_FILL_BATCHES * batchBytes) {
+        wait_hand_over(slot);
+    }
+}
+
+void BinpackWriter::flush(int producer) {
+    Slot& slot = *slots[producer];
+    if (slot.filling->empty()) return;
 
-    if (m_output.is_open()) {
-        for (const auto& entry : entries) {
-            m_output.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    wait_hand_over(slot);
+}
+
+void BinpackWriter::wait_hand_over(Slot& slot) {
+    while (!hand_over(slot)) {
+        wake.notify_one();
+        std::this_thread::yield();
+    }
+    wake.notify_one();
+}
+
+bool BinpackWriter::hand_over(Slot& slot) {
+    if (!slot.full.push(slot.filling)) return false;
+
+    Buffer* next = slot.empty.pop();
+    if (!next) {
+        next = new Buffer();
+        next->reserve(batchBytes + 65536);
+    }
+    slot.filling = next;
+    return true;
+}
+
+size_t BinpackWriter::drain() {
+    size_t batches = 0;
+
+    for (auto& slot : slots) {
+        while (Buffer* b = slot->full.pop()) {
+            // After a failed write the rest is dropped, but buffers still
+            // cycle so producers never block on a dead writer.
+            if (!failed()) {
+                size_t n = std::fwrite(b->data(), 1, b->size(), file);
+                written.fetch_add(n, std::memory_order_relaxed);
+                unsynced += n;
+                if (n != b->size()) report_error("write");
+            }
+            ++batches;
+
+            b->clear();
+            if (!slot->empty.push(b)) delete b;
         }
     }
 
-    static std::atomic<uint64_t> write_count{0};
-    write_count += entries.size();
-    if (write_count >= static_cast<uint64_t>(m_config.flush_interval)) {
-        if (m_output.is_open()) m_output.flush();
-        write_count = 0;
+    if (syncBytes && unsynced >= syncBytes && !failed()) {
+#ifdef _WIN32
+        if (_commit(_fileno(file)) != 0) report_error("sync");
+#else
+        if (fdatasync(fileno(file)) != 0) report_error("sync");
+#endif
+        unsynced = 0;
     }
+
+    return batches;
 }
 
-void DataGenerator::flush_output() {
-    std::lock_guard<std::mutex> lock(m_output_mutex);
-    if (m_output.is_open()) {
-        m_output.flush();
+void BinpackWriter::report_error(const char* what) {
+    int err = errno;
+    if (!ioError.exchange(true)) {
+        std::cerr << "Error: training data " << what << " failed: " << std::strerror(err) << std::endl;
     }
 }
 
+void BinpackWriter::writer_loop() {
+    while (true) {
+        // Producers are done before closing is set, so the drain that follows
+        // a closing read sees everything they handed over.
+        bool stopping = closing.load();
+        if (drain() == 0) {
+            if (stopping) break;
+
+            // The timeout covers a notify that lands before we start waiting.
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait_for(lock, std::chrono::milliseconds(50));
+        }
+    }
+}
+
+// Every game starts from a clean search state and a generator seeded from
+// (seed, game number), so its moves do not depend on which worker plays it
+// or what that worker played before.
+void DataGenerator::begin_game(int thread_id, uint64_t game_num) {
+    uint64_t z = m_base_seed + (game_num + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    m_random_seeds[thread_id] = z ? z : 1;
+
+    m_tables[thread_id]->clear();
+    m_searchers[thread_id]->clear_history();
+}
+
 uint64_t DataGenerator::rand_next(int thread_id) {
     uint64_t x = m_random_seeds[thread_id];
     x ^= x << 13;
@@ -558,6 +960,16 @@ DataGenConfig parse_config(std::istringstream& is) {
             config.use_book = false;
         } else if (token == "hash") {
             is >> config.hash_mb;
+        } else if (token == "seed") {
+            is >> config.seed;
+        } else if (token == "shard" || token.rfind("shard=", 0) == 0) {
+            std::string value = token == "shard" ? "" : token.substr(6);
+            if (value.empty()) is >> value;
+            size_t slash = value.find('/');
+            if (slash != std::string::npos) {
+                config.shard_index = std::atoi(value.substr(0, slash).c_str());
+                config.shard_count = std::atoi(value.substr(slash + 1).c_str());
+            }
         } else if (token == "eval_limit" || token == "evallimit") {
             is >> config.eval_limit;
         } else if (token == "qsearch" || token == "qsearch_margin") {
@@ -566,6 +978,14 @@ DataGenConfig parse_config(std::istringstream& is) {
             is >> config.search_margin;
         } else if (token == "max_score" || token == "maxscore") {
             is >> config.max_score;
+        } else if (token == "format" || token.rfind("format=", 0) == 0) {
+            std::string value = token == "format" ? "" : token.substr(7);
+            if (value.empty()) is >> value;
+            config.format = value == "chain" ? BinpackFormat::chain : BinpackFormat::raw;
+        } else if (token == "batch") {
+            is >> config.flush_interval;
+        } else if (token == "sync") {
+            is >> config.sync_mb;
         } else if (token == "no_check_filter") {
             config.skip_in_check = false;
         } else if (token == "no_tactical_filter") {
@@ -576,6 +996,8 @@ DataGenConfig parse_config(std::istringstream& is) {
     config.threads = std::max(1, std::min(config.threads, 128));
     config.depth = std::max(1, std::min(config.depth, 30));
     config.games = std::max(1, config.games);
+    config.shard_count = std::max(1, config.shard_count);
+    config.shard_index = std::clamp(config.shard_index, 0, config.shard_count - 1);
     config.random_plies = std::max(0, std::min(config.random_plies, 20));
     config.book_depth = std::max(0, std::min(config.book_depth, 30));
     config.hash_mb = std::max(1, std::min(config.hash_mb, 32768));
@@ -674,67 +1096,231 @@ std::string entry_to_fen(const TrainingEntry& entry) {
     return fen.str();
 }
 
-bool read_binpack_file(const std::string& path, std::vector<TrainingEntry>& entries, size_t max_entries) {
-    std::ifstream file(path, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "Error: Cannot open file " << path << std::endl;
+bool BinpackView::open(const std::string& path) {
+    close();
+
+#ifdef _WIN32
+    HANDLE fd = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fd == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(fd, &size)) {
+        CloseHandle(fd);
         return false;
     }
+    bytes = static_cast<size_t>(size.QuadPart);
 
-    file.seekg(0, std::ios::end);
-    size_t file_size = file.tellg();
-    file.seekg(0, std::ios::beg);
+    if (bytes > 0) {
+        HANDLE map = CreateFileMapping(fd, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(fd);
+        if (!map) return false;
 
-    size_t total_entries = file_size / sizeof(TrainingEntry);
-    size_t entries_to_read = max_entries > 0 ? std::min(max_entries, total_entries) : total_entries;
+        void* addr = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+        if (!addr) {
+            CloseHandle(map);
+            return false;
+        }
+        mapping = map;
+        entries = static_cast<const TrainingEntry*>(addr);
+    } else {
+        CloseHandle(fd);
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) return false;
 
-    entries.resize(entries_to_read);
-    file.read(reinterpret_cast<char*>(entries.data()), entries_to_read * sizeof(TrainingEntry));
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) != 0) {
+        ::close(fd);
+        return false;
+    }
+    bytes = static_cast<size_t>(statbuf.st_size);
+
+    if (bytes > 0) {
+        void* addr = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) return false;
+#ifdef MADV_SEQUENTIAL
+        madvise(addr, bytes, MADV_SEQUENTIAL);
+#endif
+        entries = static_cast<const TrainingEntry*>(addr);
+    } else {
+        ::close(fd);
+    }
+#endif
+
+    count = entries ? bytes / sizeof(TrainingEntry) : 0;
+    opened = true;
+    return true;
+}
+
+void BinpackView::close() {
+    if (entries) {
+#ifdef _WIN32
+        UnmapViewOfFile(entries);
+        CloseHandle(mapping);
+        mapping = nullptr;
+#else
+        munmap(const_cast<TrainingEntry*>(entries), bytes);
+#endif
+    }
+    entries = nullptr;
+    count = 0;
+    bytes = 0;
+    opened = false;
+}
+
+BinpackReader::BinpackReader(const std::string& path) : view(path) {
+    if (view.file_size() >= sizeof(CHAIN_MAGIC) && std::memcmp(view.data(), CHAIN_MAGIC, sizeof(CHAIN_MAGIC)) == 0) {
+        fileFormat = BinpackFormat::chain;
+        pos = sizeof(CHAIN_MAGIC);
+    }
+}
+
+bool BinpackReader::next(TrainingEntry& entry) {
+    if (fileFormat == BinpackFormat::raw) {
+        if (pos >= view.size()) return false;
+        entry = view[pos++];
+        return true;
+    }
+
+    while (gameIndex == game.size()) {
+        if (!decode_game()) return false;
+    }
+    entry = game[gameIndex++];
+    return true;
+}
+
+uint64_t BinpackReader::count_entries() const {
+    if (fileFormat == BinpackFormat::raw) return view.size();
+
+    const uint8_t* p = view.data() + sizeof(CHAIN_MAGIC);
+    const uint8_t* end = view.data() + view.file_size();
+    uint64_t total = 0;
+    uint64_t size, plies, count;
+    while (p < end && get_varint(p, end, size) && size > 0 && size <= uint64_t(end - p)) {
+        const uint8_t* game_end = p + size;
+        const uint8_t* q = p + 1;
+        if (!get_varint(q, game_end, plies) || !get_varint(q, game_end, count)) break;
+        total += count;
+        p = game_end;
+    }
+    return total;
+}
+
+// A truncated or corrupt record ends the stream; everything before it is kept.
+bool BinpackReader::decode_game() {
+    const uint8_t* p = view.data() + pos;
+    const uint8_t* end = view.data() + view.file_size();
+
+    uint64_t size, plies, count;
+    if (p >= end || !get_varint(p, end, size) || size > uint64_t(end - p)) return false;
+
+    const uint8_t* game_end = p + size;
+    pos = size_t(game_end - view.data());
+
+    uint8_t result = *p++;
+    if (!get_varint(p, game_end, plies) || !get_varint(p, game_end, count) || plies > 1024) return false;
+
+    states.resize(std::max(states.size(), size_t(plies) + 1));
+
+    Board board;
+    board.set(Board::StartFEN, &states[0]);
+
+    game.clear();
+    gameIndex = 0;
+
+    BitReader bits(p, game_end);
+    uint16_t legal[MoveList::MAX_MOVES];
+    uint32_t value;
+
+    for (uint64_t ply = 0; ; ++ply) {
+        if (!bits.get(1, value)) return false;
+        if (value) {
+            TrainingEntry entry;
+            pack_board(board, entry);
+            entry.result = result;
+            game.push_back(entry);
+        }
+
+        if (ply == plies) break;
+
+        int n = sorted_legal_moves(board, legal);
+        if (!bits.get(index_bits(n), value) || int(value) >= n) return false;
+        board.do_move(Move(legal[value]), states[ply + 1]);
+    }
+
+    if (game.size() != count) return false;
+
+    p = bits.position();
+    int prev = 0;
+    for (TrainingEntry& entry : game) {
+        uint64_t delta;
+        if (!get_varint(p, game_end, delta)) return false;
+        prev += unzigzag(delta);
+        entry.score = int16_t(prev);
+    }
+
+    return true;
+}
+
+bool read_binpack_file(const std::string& path, std::vector<TrainingEntry>& entries, size_t max_entries) {
+    BinpackReader reader(path);
+    if (!reader.is_open()) {
+        std::cerr << "Error: Cannot open file " << path << std::endl;
+        return false;
+    }
+
+    entries.clear();
+    TrainingEntry entry;
+    while ((max_entries == 0 || entries.size() < max_entries) && reader.next(entry)) {
+        entries.push_back(entry);
+    }
 
     return true;
 }
 
 void view_binpack_file(const std::string& path, size_t count, size_t offset) {
-    std::ifstream file(path, std::ios::binary);
-    if (!file.is_open()) {
+    BinpackReader reader(path);
+    if (!reader.is_open()) {
         std::cerr << "Error: Cannot open file " << path << std::endl;
         return;
     }
 
-    file.seekg(0, std::ios::end);
-    size_t file_size = file.tellg();
-    size_t total_entries = file_size / sizeof(TrainingEntry);
+    bool chained = reader.format() == BinpackFormat::chain;
 
     std::cout << "\n=== Training Data File: " << path << " ===" << std::endl;
-    std::cout << "File size: " << file_size << " bytes" << std::endl;
-    std::cout << "Total entries: " << total_entries << std::endl;
-    std::cout << "Entry size: " << sizeof(TrainingEntry) << " bytes" << std::endl;
+    std::cout << "File size: " << reader.file_size() << " bytes" << std::endl;
+    std::cout << "Format: " << (chained ? "chain" : "raw") << std::endl;
+    if (!chained) {
+        std::cout << "Total entries: " << reader.file_size() / sizeof(TrainingEntry) << std::endl;
+        std::cout << "Entry size: " << sizeof(TrainingEntry) << " bytes" << std::endl;
+    }
     std::cout << std::endl;
 
-    if (offset >= total_entries) {
+    TrainingEntry entry;
+    size_t i = 0;
+    for (; i < offset && reader.next(entry); ++i) {}
+
+    if (i < offset || !reader.next(entry)) {
         std::cout << "Offset " << offset << " is beyond file end." << std::endl;
         return;
     }
 
-    file.seekg(offset * sizeof(TrainingEntry), std::ios::beg);
-
-    size_t entries_to_show = std::min(count, total_entries - offset);
+    std::cout << "Showing up to " << count << " entries from " << offset << ":\n" << std::endl;
 
-    std::cout << "Showing entries " << offset << " to " << (offset + entries_to_show - 1) << ":\n" << std::endl;
-
-    for (size_t i = 0; i < entries_to_show; ++i) {
-        TrainingEntry entry;
-        file.read(reinterpret_cast<char*>(&entry), sizeof(entry));
-
-        std::cout << "[" << (offset + i) << "] " << entry_to_fen(entry) << std::endl;
+    for (size_t shown = 0; shown < count; ++shown, ++i) {
+        std::cout << "[" << i << "] " << entry_to_fen(entry) << std::endl;
         std::cout << "    " << entry_to_string(entry) << std::endl;
         std::cout << std::endl;
+        if (shown + 1 < count && !reader.next(entry)) break;
     }
 }
 
 bool convert_to_epd(const std::string& binary_path, const std::string& epd_path, size_t max_entries) {
-    std::ifstream in_file(binary_path, std::ios::binary);
-    if (!in_file.is_open()) {
+    BinpackReader reader(binary_path);
+    if (!reader.is_open()) {
         std::cerr << "Error: Cannot open binary file " << binary_path << std::endl;
         return false;
     }
@@ -745,18 +1331,12 @@ bool convert_to_epd(const std::string& binary_path, const std::string& epd_path,
         return false;
     }
 
-    in_file.seekg(0, std::ios::end);
-    size_t file_size = in_file.tellg();
-    in_file.seekg(0, std::ios::beg);
-    size_t total_entries = file_size / sizeof(TrainingEntry);
-
-    size_t entries_to_convert = max_entries > 0 ? std::min(max_entries, total_entries) : total_entries;
-
-    std::cout << "Converting " << entries_to_convert << " entries to EPD format..." << std::endl;
+    std::cout << "Converting " << (max_entries > 0 ? std::to_string(max_entries) : std::string("all"))
+              << " entries to EPD format..." << std::endl;
 
     size_t count = 0;
     TrainingEntry entry;
-    while (count < entries_to_convert && in_file.read(reinterpret_cast<char*>(&entry), sizeof(entry))) {
+    while ((max_entries == 0 || count < max_entries) && reader.next(entry)) {
         std::string fen = entry_to_fen(entry);
         std::istringstream fen_stream(fen);
         std::string field;
@@ -772,26 +1352,77 @@ bool convert_to_epd(const std::string& binary_path, const std::string& epd_path,
 
         count++;
         if (count % 100000 == 0) {
-            std::cout << "  Converted " << count << "/" << entries_to_convert << " entries...\r" << std::flush;
+            std::cout << "  Converted " << count << " entries...\r" << std::flush;
+        }
+    }
+
+    std::cout << "\nConversion complete! " << count << " entries written to " << epd_path << std::endl;
+    return true;
+}
+
+// One CSV row per entry: result, stored score, traced eval from White's
+// side, phase, then White-minus-Black counts of each tuned term and the
+// king danger difference. With the phase these are the tuner's features.
+bool export_features(const std::string& binary_path, const std::string& csv_path, size_t max_entries) {
+    BinpackReader reader(binary_path);
+    if (!reader.is_open()) {
+        std::cerr << "Error: Cannot open binary file " << binary_path << std::endl;
+        return false;
+    }
+
+    std::ofstream out_file(csv_path);
+    if (!out_file.is_open()) {
+        std::cerr << "Error: Cannot create feature file " << csv_path << std::endl;
+        return false;
+    }
+
+    out_file << "result,score,eval,phase";
+    for (int t = 0; t < Eval::TRACE_TERM_NB; ++t) {
+        out_file << ',' << Eval::TraceTermNames[t];
+    }
+    out_file << ",KingDanger\n";
+
+    size_t count = 0;
+    TrainingEntry entry;
+    Board board;
+    StateInfo si;
+    Eval::EvalTrace trace;
+    while ((max_entries == 0 || count < max_entries) && reader.next(entry)) {
+        if (!entry_to_board(entry, board, si)) continue;
+
+        int eval = Eval::trace(board, trace);
+        if (board.side_to_move() == BLACK) eval = -eval;
+
+        out_file << (entry.result * 0.5) << ',' << entry.score << ',' << eval << ',' << trace.phase;
+        for (int t = 0; t < Eval::TRACE_TERM_NB; ++t) {
+            out_file << ',' << trace.terms[t][WHITE] - trace.terms[t][BLACK];
+        }
+        out_file << ',' << trace.kingDanger[WHITE] - trace.kingDanger[BLACK] << '\n';
+
+        count++;
+        if (count % 100000 == 0) {
+            std::cout << "  Exported " << count << " entries...\r" << std::flush;
         }
     }
 
-    std::cout << "\nConversion complete! Written to " << epd_path << std::endl;
+    std::cout << "\nExport complete! " << count << " entries written to " << csv_path << std::endl;
     return true;
 }
 
 bool get_file_stats(const std::string& path, FileStats& stats) {
-    std::ifstream file(path, std::ios::binary);
-    if (!file.is_open()) {
+    BinpackReader reader(path);
+    if (!reader.is_open()) {
         return false;
     }
 
     stats = FileStats{};
     stats.min_score = 32767;
     stats.max_score = -32768;
+    stats.file_size = reader.file_size();
+    stats.chained = reader.format() == BinpackFormat::chain;
 
     TrainingEntry entry;
-    while (file.read(reinterpret_cast<char*>(&entry), sizeof(entry))) {
+    while (reader.next(entry)) {
         stats.total_entries++;
 
         if (entry.result == 2) stats.white_wins++;
@@ -816,13 +1447,79 @@ bool entry_to_board(const TrainingEntry& entry, Board& board, StateInfo& si) {
     }
 }
 
+namespace {
+
+constexpr size_t FILTER_CHUNK = 65536;
+constexpr size_t FILTER_CHUNKS_IN_FLIGHT_PER_THREAD = 4;
+// Filter workers only run qsearch, so a small private table is plenty and
+// keeps them off the engine's global TT.
+constexpr size_t FILTER_HASH_MB = 16;
+
+void filter_chunk(const FilterConfig& config, const BinpackView& input, size_t begin, size_t end,
+                  Search& searcher, FilterStats& stats, std::vector<TrainingEntry>& out) {
+    StateInfo si;
+    Board board;
+
+    for (size_t i = begin; i < end; ++i) {
+        const TrainingEntry& entry = input[i];
+        stats.total_read++;
+
+        if (!entry_to_board(entry, board, si)) {
+            continue;
+        }
+
+        int stored_score = entry.score;
+
+        if (config.skip_in_check && board.in_check()) {
+            stats.filtered_check++;
+            continue;
+        }
+
+        if (std::abs(stored_score) > config.max_score) {
+            stats.filtered_score++;
+            continue;
+        }
+
+        if (config.qsearch_margin > 0) {
+            int static_eval = searcher.evaluate(board);
+
+            int qsearch_score = searcher.qsearch_score(board);
+            int qsearch_diff = std::abs(static_eval - qsearch_score);
+            if (qsearch_diff > config.qsearch_margin) {
+                stats.filtered_qsearch++;
+                continue;
+            }
+        }
+
+        TrainingEntry clamped_entry = entry;
+        if (config.eval_limit > 0) {
+            int16_t clamped_score = static_cast<int16_t>(
+                std::clamp(static_cast<int>(entry.score), -config.eval_limit, config.eval_limit)
+            );
+            if (clamped_score != entry.score) {
+                clamped_entry.score = clamped_score;
+                stats.clamped_eval_limit++;
+            }
+        }
+
+        out.push_back(clamped_entry);
+        stats.passed++;
+    }
+}
+
+}
+
 bool filter_binpack(const FilterConfig& config, FilterStats& stats) {
 
-    std::ifstream input(config.input_path, std::ios::binary);
+    BinpackView input(config.input_path);
     if (!input.is_open()) {
         std::cerr << "Error: Cannot open input file " << config.input_path << std::endl;
         return false;
     }
+    if (detect_format(config.input_path) == BinpackFormat::chain) {
+        std::cerr << "Error: filter reads raw binpack; convert chained files first" << std::endl;
+        return false;
+    }
 
 
     std::ofstream output(config.output_path, std::ios::binary);
@@ -832,15 +1529,15 @@ bool filter_binpack(const FilterConfig& config, FilterStats& stats) {
     }
 
 
-    input.seekg(0, std::ios::end);
-    size_t file_size = input.tellg();
-    input.seekg(0, std::ios::beg);
-    size_t total_entries = file_size / sizeof(TrainingEntry);
+    size_t total_entries = input.size();
+    size_t chunk_count = (total_entries + FILTER_CHUNK - 1) / FILTER_CHUNK;
+    int num_threads = std::max(1, config.threads);
 
     std::cout << "\n=== Filtering Training Data ===" << std::endl;
     std::cout << "Input       : " << config.input_path << std::endl;
     std::cout << "Output      : " << config.output_path << std::endl;
     std::cout << "Total entries: " << total_entries << std::endl;
+    std::cout << "Threads     : " << num_threads << std::endl;
     std::cout << "Filters:" << std::endl;
     std::cout << "  skip_in_check  : " << (config.skip_in_check ? "true" : "false") << std::endl;
     std::cout << "  qsearch_margin : " << config.qsearch_margin << " cp" << std::endl;
@@ -848,86 +1545,117 @@ bool filter_binpack(const FilterConfig& config, FilterStats& stats) {
     std::cout << "  eval_limit     : " << (config.eval_limit > 0 ? std::to_string(config.eval_limit) + " cp" : "disabled") << std::endl;
     std::cout << "==============================" << std::endl;
 
-    std::unique_ptr<Search> searcher = std::make_unique<Search>();
-
     stats = FilterStats{};
     auto start_time = std::chrono::steady_clock::now();
 
-    TrainingEntry entry;
-    StateInfo si;
-    Board board;
-
+    // Workers claim chunks in order and hand them to the writer below, which
+    // emits them in input order. At most `window` chunks are held in memory.
+    std::atomic<size_t> next_chunk{0};
+    std::atomic<bool> failed{false};
+    std::mutex chunk_mutex;
+    std::condition_variable chunk_cv;
+    std::map<size_t, std::vector<TrainingEntry>> ready;
+    size_t written = 0;
+    const size_t window = num_threads * FILTER_CHUNKS_IN_FLIGHT_PER_THREAD;
+
+    std::vector<FilterStats> worker_stats(num_threads);
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < num_threads; ++t) {
+        workers.emplace_back([&, t] {
+            TranspositionTable table(FILTER_HASH_MB);
+            std::unique_ptr<Search> searcher = std::make_unique<Search>(table);
+            searcher->set_silent(true);
+
+            for (size_t c = next_chunk++; c < chunk_count; c = next_chunk++) {
+                {
+                    std::unique_lock<std::mutex> lock(chunk_mutex);
+                    chunk_cv.wait(lock, [&] { return c < written + window; });
+                }
 
-    try {
-        while (input.read(reinterpret_cast<char*>(&entry), sizeof(entry))) {
-            stats.total_read++;
+                std::vector<TrainingEntry> out;
+                out.reserve(FILTER_CHUNK);
+                size_t begin = c * FILTER_CHUNK;
+                size_t end = std::min(begin + FILTER_CHUNK, total_entries);
+
+                try {
+                    filter_chunk(config, input, begin, end, *searcher, worker_stats[t], out);
+                } catch (const std::exception& e) {
+                    std::cerr << "Error during filtering in chunk " << c << ": " << e.what() << std::endl;
+                    failed = true;
+                } catch (...) {
+                    std::cerr << "Unknown error during filtering in chunk " << c << std::endl;
+                    failed = true;
+                }
 
-            if (!entry_to_board(entry, board, si)) {
-                continue;
+                std::lock_guard<std::mutex> lock(chunk_mutex);
+                ready.emplace(c, std::move(out));
+                chunk_cv.notify_all();
             }
+        });
+    }
 
-            int stored_score = entry.score;
+    size_t read_so_far = 0;
+    size_t passed_so_far = 0;
+    size_t next_report = config.report_interval;
+
+    for (size_t c = 0; c < chunk_count; ++c) {
+        std::vector<TrainingEntry> chunk;
+        {
+            std::unique_lock<std::mutex> lock(chunk_mutex);
+            chunk_cv.wait(lock, [&] { return ready.count(c) > 0; });
+            chunk = std::move(ready[c]);
+            ready.erase(c);
+        }
 
-            if (config.skip_in_check && board.in_check()) {
-                stats.filtered_check++;
-                continue;
-            }
+        output.write(reinterpret_cast<const char*>(chunk.data()), chunk.size() * sizeof(TrainingEntry));
 
-            if (std::abs(stored_score) > config.max_score) {
-                stats.filtered_score++;
-                continue;
-            }
+        {
+            std::lock_guard<std::mutex> lock(chunk_mutex);
+            written = c + 1;
+        }
+        chunk_cv.notify_all();
 
-            if (config.qsearch_margin > 0) {
-                int static_eval = searcher->evaluate(board);
+        read_so_far = std::min(total_entries, (c + 1) * FILTER_CHUNK);
+        passed_so_far += chunk.size();
 
-                int qsearch_score = searcher->qsearch_score(board);
-                int qsearch_diff = std::abs(static_eval - qsearch_score);
-                if (qsearch_diff > config.qsearch_margin) {
-                    stats.filtered_qsearch++;
-                    continue;
-                }
-            }
+        if (config.report_interval > 0 && read_so_far >= next_report) {
+            next_report = (read_so_far / config.report_interval + 1) * config.report_interval;
 
-            TrainingEntry clamped_entry = entry;
-            if (config.eval_limit > 0) {
-                int16_t clamped_score = static_cast<int16_t>(
-                    std::clamp(static_cast<int>(entry.score), -config.eval_limit, config.eval_limit)
-                );
-                if (clamped_score != entry.score) {
-                    clamped_entry.score = clamped_score;
-                    stats.clamped_eval_limit++;
-                }
-            }
+            auto now = std::chrono::steady_clock::now();
+            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count();
+            double pct = 100.0 * read_so_far / total_entries;
+            double pass_rate = 100.0 * passed_so_far / read_so_far;
 
-            output.write(reinterpret_cast<const char*>(&clamped_entry), sizeof(clamped_entry));
-            stats.passed++;
-
-            if (stats.total_read % config.report_interval == 0) {
-                auto now = std::chrono::steady_clock::now();
-                auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count();
-                double pct = 100.0 * stats.total_read / total_entries;
-                double pass_rate = 100.0 * stats.passed / stats.total_read;
-
-                std::cout << "Progress: " << stats.total_read << "/" << total_entries
-                          << " (" << std::fixed << std::setprecision(1) << pct << "%)"
-                          << " | Passed: " << stats.passed
-                          << " (" << std::setprecision(1) << pass_rate << "%)"
-                          << " | Time: " << elapsed << "s"
-                          << std::endl;
-            }
+            std::cout << "Progress: " << read_so_far << "/" << total_entries
+                      << " (" << std::fixed << std::setprecision(1) << pct << "%)"
+                      << " | Passed: " << passed_so_far
+                      << " (" << std::setprecision(1) << pass_rate << "%)"
+                      << " | Time: " << elapsed << "s"
+                      << std::endl;
         }
-    } catch (const std::exception& e) {
-        std::cerr << "Error during filtering at entry " << stats.total_read << ": " << e.what() << std::endl;
-        return false;
-    } catch (...) {
-        std::cerr << "Unknown error during filtering at entry " << stats.total_read << std::endl;
-        return false;
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (const FilterStats& ws : worker_stats) {
+        stats.total_read += ws.total_read;
+        stats.passed += ws.passed;
+        stats.filtered_check += ws.filtered_check;
+        stats.filtered_tactical += ws.filtered_tactical;
+        stats.filtered_qsearch += ws.filtered_qsearch;
+        stats.filtered_score += ws.filtered_score;
+        stats.clamped_eval_limit += ws.clamped_eval_limit;
     }
 
     output.flush();
     output.close();
-    input.close();
+
+    if (failed) {
+        return false;
+    }
 
     auto end_time = std::chrono::steady_clock::now();
     auto total_time = std::chrono::duration_cast<std::chrono::seconds>(end_time - start_time).count();
@@ -936,7 +1664,7 @@ bool filter_binpack(const FilterConfig& config, FilterStats& stats) {
     std::cout << "Total time     : " << total_time << " seconds" << std::endl;
     std::cout << "Positions read : " << stats.total_read << std::endl;
     std::cout << "Positions passed: " << stats.passed
-              << " (" << std::setprecision(1) << (100.0 * stats.passed / stats.total_read) << "%)" << std::endl;
+              << " (" << std::setprecision(1) << (stats.total_read ? 100.0 * stats.passed / stats.total_read : 0.0) << "%)" << std::endl;
     std::cout << "Filtered by:" << std::endl;
     std::cout << "  In-check     : " << stats.filtered_check << std::endl;
     std::cout << "  Extreme score: " << stats.filtered_score << std::endl;
@@ -950,6 +1678,197 @@ bool filter_binpack(const FilterConfig& config, FilterStats& stats) {
     return true;
 }
 
+namespace {
+
+uint64_t position_hash(const TrainingEntry& entry) {
+    uint64_t words[5] = {};
+    std::memcpy(words, entry.packed_board, 32);
+    words[4] = uint64_t(entry.stm) | uint64_t(entry.castling) << 8 | uint64_t(entry.ep_square) << 16;
+
+    uint64_t h = 0x9E3779B97F4A7C15ULL;
+    for (uint64_t w : words) {
+        h = (h ^ w) * 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 31;
+    }
+    return h | 1;
+}
+
+// Open-addressed set of position hashes in fixed memory. When a probe run is
+// full the hash replaces whatever sits in its home slot, so the evicted
+// position can later pass as new and very large merges may let duplicates
+// through. A unique position is dropped only if its 64-bit hash matches one
+// already seen.
+class SeenPositions {
+public:
+    explicit SeenPositions(size_t mb) {
+        size_t slots = 1;
+        while (slots * 2 * sizeof(uint64_t) <= (mb << 20)) slots *= 2;
+        table.assign(slots, 0);
+        mask = slots - 1;
+    }
+
+    bool insert(uint64_t h) {
+        for (size_t i = 0; i < PROBES; ++i) {
+            uint64_t& slot = table[(h + i) & mask];
+            if (slot == h) return false;
+            if (slot == 0) {
+                slot = h;
+                return true;
+            }
+        }
+        table[h & mask] = h;
+        return true;
+    }
+
+private:
+    static constexpr size_t PROBES = 8;
+    std::vector<uint64_t> table;
+    size_t mask = 0;
+};
+
+}
+
+bool merge_binpacks(const MergeConfig& config, MergeStats& stats) {
+    stats = MergeStats{};
+
+    std::vector<std::unique_ptr<BinpackReader>> readers;
+    for (const std::string& path : config.inputs) {
+        auto reader = std::make_unique<BinpackReader>(path);
+        if (!reader->is_open()) {
+            std::cerr << "Error: Cannot open input file " << path << std::endl;
+            return false;
+        }
+        readers.push_back(std::move(reader));
+    }
+
+    std::ofstream output(config.output_path, std::ios::binary);
+    if (!output.is_open()) {
+        std::cerr << "Error: Cannot open output file " << config.output_path << std::endl;
+        return false;
+    }
+
+    std::cout << "\n=== Merging Training Data ===" << std::endl;
+    std::cout << "Inputs      : " << readers.size() << std::endl;
+    std::cout << "Output      : " << config.output_path << std::endl;
+    std::cout << "Dedup       : " << (config.dedup ? std::to_string(config.dedup_mb) + " MB" : "off") << std::endl;
+    std::cout << "Shuffle     : " << config.shuffle_size << " entries" << std::endl;
+    std::cout << "=============================\n" << std::endl;
+
+    std::unique_ptr<SeenPositions> seen;
+    if (config.dedup) seen = std::make_unique<SeenPositions>(config.dedup_mb);
+
+    uint64_t rng = config.seed ? config.seed : 0x2545F4914F6CDD1DULL;
+    auto next_random = [&rng]() {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        return rng;
+    };
+
+    std::vector<TrainingEntry> out_chunk;
+    out_chunk.reserve(4096);
+    auto emit = [&](const TrainingEntry& entry) {
+        out_chunk.push_back(entry);
+        if (out_chunk.size() == out_chunk.capacity()) {
+            output.write(reinterpret_cast<const char*>(out_chunk.data()), out_chunk.size() * sizeof(TrainingEntry));
+            out_chunk.clear();
+        }
+        stats.written++;
+    };
+
+    std::vector<TrainingEntry> pool;
+    pool.reserve(config.shuffle_size);
+
+    // Inputs are picked in proportion to the entries they have left, so
+    // shards of any size run out together instead of a small one being
+    // used up early and front-loading the output.
+    std::vector<uint64_t> remaining;
+    uint64_t total_remaining = 0;
+    for (const auto& reader : readers) {
+        remaining.push_back(reader->count_entries());
+        total_remaining += remaining.back();
+    }
+
+    TrainingEntry entry;
+    while (!readers.empty()) {
+        uint64_t pick = total_remaining ? next_random() % total_remaining : 0;
+        size_t r = 0;
+        while (r + 1 < readers.size() && pick >= remaining[r]) pick -= remaining[r++];
+
+        if (!readers[r]->next(entry)) {
+            total_remaining -= remaining[r];
+            readers.erase(readers.begin() + r);
+            remaining.erase(remaining.begin() + r);
+            continue;
+        }
+        if (remaining[r]) {
+            --remaining[r];
+            --total_remaining;
+        }
+
+        if (++stats.total_read % 1000000 == 0) {
+            std::cout << "  Read " << stats.total_read << ", duplicates " << stats.duplicates << "\r" << std::flush;
+        }
+
+        if (seen && !seen->insert(position_hash(entry))) {
+            stats.duplicates++;
+            continue;
+        }
+
+        if (pool.size() < config.shuffle_size) {
+            pool.push_back(entry);
+            continue;
+        }
+        if (pool.empty()) {
+            emit(entry);
+            continue;
+        }
+
+        TrainingEntry& slot = pool[next_random() % pool.size()];
+        emit(slot);
+        slot = entry;
+    }
+
+    for (size_t i = pool.size(); i > 1; --i) {
+        std::swap(pool[i - 1], pool[next_random() % i]);
+    }
+    for (const TrainingEntry& e : pool) emit(e);
+
+    output.write(reinterpret_cast<const char*>(out_chunk.data()), out_chunk.size() * sizeof(TrainingEntry));
+
+    std::cout << "\nMerged " << stats.total_read << " entries: " << stats.duplicates << " duplicates dropped, "
+              << stats.written << " written to " << config.output_path << std::endl;
+    return bool(output);
+}
+
+MergeConfig parse_merge_config(std::istringstream& is) {
+    MergeConfig config;
+    std::string token;
+
+    while (is >> token) {
+        if (token == "output") {
+            is >> config.output_path;
+        } else if (token == "input") {
+            std::string path;
+            if (is >> path) config.inputs.push_back(path);
+        } else if (token == "shuffle") {
+            is >> config.shuffle_size;
+        } else if (token == "nodedup") {
+            config.dedup = false;
+        } else if (token == "dedup_mb") {
+            is >> config.dedup_mb;
+        } else if (token == "seed") {
+            is >> config.seed;
+        } else {
+            config.inputs.push_back(token);
+        }
+    }
+
+    config.dedup_mb = std::max<size_t>(1, config.dedup_mb);
+
+    return config;
+}
+
 FilterConfig parse_filter_config(std::istringstream& is) {
     FilterConfig config;
     std::string token;
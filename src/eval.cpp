@@ -1,10 +1,44 @@
 #include "eval.hpp"
 #include "tuning.hpp"
 #include "profiler.hpp"
+#include "tablebase.hpp"
+#include "bitbase.hpp"
+#include "optimize.hpp"
 
 namespace Eval {
 
-PawnTable pawnTable;
+namespace {
+
+thread_local PawnTable fallbackPawnTable;
+thread_local MaterialTable fallbackMaterialTable;
+thread_local LazyStats fallbackLazyStats;
+
+constexpr int TEMPO = 12;
+constexpr int LazyMarginPawns = 600;
+constexpr int LazyMarginPieces = 400;
+constexpr U64 LazySpotCheckInterval = 1024;
+
+int taper(const EvalScore& score, int phase, Color stm) {
+    int v = (score.mg * phase + score.eg * (TotalPhase - phase)) / TotalPhase;
+    return (stm == WHITE ? v : -v) + TEMPO;
+}
+
+// Written only by Trace instantiations; trace() resets and copies it out.
+thread_local EvalTrace activeTrace;
+
+template<bool Trace>
+inline void trace_add(TraceTerm term, Color c, int count = 1) {
+    if constexpr (Trace) activeTrace.terms[term][c] += count;
+}
+
+}
+
+const char* const TraceTermNames[TRACE_TERM_NB] = {
+    "PawnValue", "KnightValue", "BishopValue", "RookValue", "QueenValue",
+    "BishopPairBonus", "RookOpenFileBonus", "RookSemiOpenFileBonus", "RookOnSeventhBonus",
+    "KnightOutpostBonus", "IsolatedPawnPenalty", "DoubledPawnPenalty", "BackwardPawnPenalty",
+    "ConnectedPawnBonus", "PhalanxBonus"
+};
 
 Square flip_square(Square sq) {
     return Square(sq ^ 56);
@@ -108,16 +142,16 @@ static Bitboard compute_outer_ring(Square kingSq) {
     return outer & ~inner;
 }
 
-void init_eval_context(EvalContext& ctx, const Board& board) {
+void init_eval_context(EvalContext& ctx, const Board& board, const PawnEntry* pawns) {
     ctx.clear();
-    Bitboard occupied = board.pieces();
+    ctx.pawns = pawns;
 
     for (Color c : {WHITE, BLACK}) {
         Color enemy = ~c;
         ctx.kingSquare[c] = board.king_square(c);
 
-        Bitboard ourPawns = board.pieces(c, PAWN);
-        ctx.attackedBy[c][PAWN] = pawn_attacks_bb(c, ourPawns);
+        ctx.attackedBy[c][PAWN] = pawns ? pawns->pawnAttacks[c]
+                                        : pawn_attacks_bb(c, board.pieces(c, PAWN));
         ctx.attackedBy[c][ALL_PIECES] = ctx.attackedBy[c][PAWN];
 
         Square kingSq = ctx.kingSquare[c];
@@ -135,7 +169,8 @@ void init_eval_context(EvalContext& ctx, const Board& board) {
         ctx.attackedBy2[c] = ctx.attackedBy[c][PAWN] & ctx.attackedBy[c][KING];
         ctx.attackedBy[c][ALL_PIECES] |= ctx.attackedBy[c][KING];
 
-        Bitboard enemyPawnAttacks = pawn_attacks_bb(enemy, board.pieces(enemy, PAWN));
+        Bitboard enemyPawnAttacks = pawns ? pawns->pawnAttacks[enemy]
+                                          : pawn_attacks_bb(enemy, board.pieces(enemy, PAWN));
         ctx.mobilityArea[c] = ~(board.pieces(c) | enemyPawnAttacks);
     }
 
@@ -167,7 +202,7 @@ void init_eval_context(EvalContext& ctx, const Board& board) {
         Bitboard bishopAttacks = EMPTY_BB;
         while (bishops) {
             Square sq = pop_lsb(bishops);
-            Bitboard attacks = bishop_attacks_bb(sq, occupied);
+            Bitboard attacks = board.attacks_from(sq);
             bishopAttacks |= attacks;
             ctx.attackedBy2[c] |= ctx.attackedBy[c][ALL_PIECES] & attacks;
             ctx.attackedBy[c][ALL_PIECES] |= attacks;
@@ -188,7 +223,7 @@ void init_eval_context(EvalContext& ctx, const Board& board) {
         Bitboard rookAttacks = EMPTY_BB;
         while (rooks) {
             Square sq = pop_lsb(rooks);
-            Bitboard attacks = rook_attacks_bb(sq, occupied);
+            Bitboard attacks = board.attacks_from(sq);
             rookAttacks |= attacks;
             ctx.attackedBy2[c] |= ctx.attackedBy[c][ALL_PIECES] & attacks;
             ctx.attackedBy[c][ALL_PIECES] |= attacks;
@@ -209,7 +244,7 @@ void init_eval_context(EvalContext& ctx, const Board& board) {
         Bitboard queenAttacks = EMPTY_BB;
         while (queens) {
             Square sq = pop_lsb(queens);
-            Bitboard attacks = queen_attacks_bb(sq, occupied);
+            Bitboard attacks = board.attacks_from(sq);
             queenAttacks |= attacks;
             ctx.attackedBy2[c] |= ctx.attackedBy[c][ALL_PIECES] & attacks;
             ctx.attackedBy[c][ALL_PIECES] |= attacks;
@@ -230,6 +265,7 @@ void init_eval_context(EvalContext& ctx, const Board& board) {
 }
 
 EvalScore eval_material_pst(const Board& board, Color c) {
+    const Tuning::Params& params = Tuning::active();
     EvalScore score;
     Bitboard bb;
 
@@ -237,35 +273,35 @@ EvalScore eval_material_pst(const Board& board, Color c) {
     while (bb) {
         Square sq = pop_lsb(bb);
         Square psq = c == WHITE ? sq : flip_square(sq);
-        score += PawnValue + PawnPST[psq];
+        score += params.PawnValue + PawnPST[psq];
     }
 
     bb = board.pieces(c, KNIGHT);
     while (bb) {
         Square sq = pop_lsb(bb);
         Square psq = c == WHITE ? sq : flip_square(sq);
-        score += KnightValue + KnightPST[psq];
+        score += params.KnightValue + KnightPST[psq];
     }
 
     bb = board.pieces(c, BISHOP);
     while (bb) {
         Square sq = pop_lsb(bb);
         Square psq = c == WHITE ? sq : flip_square(sq);
-        score += BishopValue + BishopPST[psq];
+        score += params.BishopValue + BishopPST[psq];
     }
 
     bb = board.pieces(c, ROOK);
     while (bb) {
         Square sq = pop_lsb(bb);
         Square psq = c == WHITE ? sq : flip_square(sq);
-        score += RookValue + RookPST[psq];
+        score += params.RookValue + RookPST[psq];
     }
 
     bb = board.pieces(c, QUEEN);
     while (bb) {
         Square sq = pop_lsb(bb);
         Square psq = c == WHITE ? sq : flip_square(sq);
-        score += QueenValue + QueenPST[psq];
+        score += params.QueenValue + QueenPST[psq];
     }
 
     Square kingSq = board.king_square(c);
@@ -319,7 +355,9 @@ static bool is_outpost_hole(Color c, Square sq, Bitboard ourPawns) {
     return true;
 }
 
+template<bool Trace>
 EvalScore eval_pawn_structure(const Board& board, Color c) {
+    const Tuning::Params& params = Tuning::active();
     EvalScore score;
     Color enemy = ~c;
     Bitboard ourPawns = board.pieces(c, PAWN);
@@ -459,15 +497,18 @@ EvalScore eval_pawn_structure(const Board& board, Color c) {
         }
 
         if (isIsolated) {
-            score += IsolatedPawnPenalty;
+            score += params.IsolatedPawnPenalty;
+            trace_add<Trace>(TRACE_ISOLATED_PAWN, c);
         }
 
         if (popcount(file_bb(f) & ourPawns) > 1) {
-            score += DoubledPawnPenalty;
+            score += params.DoubledPawnPenalty;
+            trace_add<Trace>(TRACE_DOUBLED_PAWN, c);
         }
 
         if (!isIsolated && !isPassed && is_backward_pawn(c, sq, ourPawns, theirPawns)) {
-            score += BackwardPawnPenalty;
+            score += params.BackwardPawnPenalty;
+            trace_add<Trace>(TRACE_BACKWARD_PAWN, c);
 
             Bitboard fileMask = file_bb(f);
             if (!(fileMask & theirPawns)) {
@@ -478,10 +519,12 @@ EvalScore eval_pawn_structure(const Board& board, Color c) {
         Bitboard adjacentPawns = adjacent_files_bb(f) & ourPawns;
         if (adjacentPawns) {
             if (adjacentPawns & rank_bb_eval(rank_of(sq))) {
-                score += PhalanxBonus;
+                score += params.PhalanxBonus;
                 score += PawnDuoBonus;
+                trace_add<Trace>(TRACE_PHALANX, c);
             } else {
-                score += ConnectedPawnBonus;
+                score += params.ConnectedPawnBonus;
+                trace_add<Trace>(TRACE_CONNECTED_PAWN, c);
             }
 
             Bitboard pawnDefenders = pawn_attacks_bb(c, ourPawns);
@@ -549,6 +592,7 @@ EvalScore eval_pawn_structure(const Board& board, Color c) {
 }
 
 EvalScore eval_pieces(const Board& board, Color c) {
+    const Tuning::Params& params = Tuning::active();
     EvalScore score;
     Color enemy = ~c;
     Bitboard occupied = board.pieces();
@@ -568,7 +612,7 @@ EvalScore eval_pieces(const Board& board, Color c) {
         if ((square_bb(sq) & pawnDefenders)) {
             Rank relativeRank = c == WHITE ? rank_of(sq) : Rank(RANK_8 - rank_of(sq));
             if (relativeRank >= RANK_4 && relativeRank <= RANK_6) {
-                score += KnightOutpostBonus;
+                score += params.KnightOutpostBonus;
             }
         }
 
@@ -582,7 +626,7 @@ EvalScore eval_pieces(const Board& board, Color c) {
     while (bb) {
         bishopCount++;
         Square sq = pop_lsb(bb);
-        Bitboard attacks = bishop_attacks_bb(sq, occupied);
+        Bitboard attacks = board.attacks_from(sq);
         int mobility = popcount(attacks & mobilityArea);
         score += BishopMobility[std::min(mobility, 13)];
 
@@ -596,7 +640,7 @@ EvalScore eval_pieces(const Board& board, Color c) {
         }
     }
     if (bishopCount >= 2) {
-        score += BishopPairBonus;
+        score += params.BishopPairBonus;
     }
 
     bb = board.pieces(c, ROOK);
@@ -610,22 +654,22 @@ EvalScore eval_pieces(const Board& board, Color c) {
         rookCount++;
 
         File f = file_of(sq);
-        Bitboard attacks = rook_attacks_bb(sq, occupied);
+        Bitboard attacks = board.attacks_from(sq);
         int mobility = popcount(attacks & mobilityArea);
         score += RookMobility[std::min(mobility, 14)];
 
         Bitboard filePawns = file_bb(f);
         if (!(filePawns & ourPawns)) {
             if (!(filePawns & theirPawns)) {
-                score += RookOpenFileBonus;
+                score += params.RookOpenFileBonus;
             } else {
-                score += RookSemiOpenFileBonus;
+                score += params.RookSemiOpenFileBonus;
             }
         }
 
         Rank relativeRank = c == WHITE ? rank_of(sq) : Rank(RANK_8 - rank_of(sq));
         if (relativeRank == RANK_7) {
-            score += RookOnSeventhBonus;
+            score += params.RookOnSeventhBonus;
         }
     }
 
@@ -643,7 +687,7 @@ EvalScore eval_pieces(const Board& board, Color c) {
     bb = board.pieces(c, QUEEN);
     while (bb) {
         Square sq = pop_lsb(bb);
-        Bitboard attacks = queen_attacks_bb(sq, occupied);
+        Bitboard attacks = board.attacks_from(sq);
         int mobility = popcount(attacks & mobilityArea);
         score += QueenMobility[std::min(mobility, 27)];
     }
@@ -688,6 +732,7 @@ EvalScore eval_space(const Board& board, Color c) {
 }
 
 EvalScore eval_king_safety(const Board& board, Color c) {
+    const Tuning::Params& params = Tuning::active();
     EvalScore score;
     Color enemy = ~c;
     Square kingSq = board.king_square(c);
@@ -734,7 +779,7 @@ EvalScore eval_king_safety(const Board& board, Color c) {
 
     if (attackCount >= 2) {
         int safetyPenalty = KingSafetyTable[std::min(attackUnits, 99)];
-        safetyPenalty = safetyPenalty * Tuning::KingSafetyWeight / 100;
+        safetyPenalty = safetyPenalty * params.KingSafetyWeight / 100;
         score.mg -= safetyPenalty;
     }
 
@@ -825,7 +870,9 @@ EvalScore eval_threats_with_context(const Board& board, Color c, EvalContext& ct
     return score;
 }
 
+template<bool Trace>
 EvalScore eval_pieces_with_context(const Board& board, Color c, EvalContext& ctx) {
+    const Tuning::Params& params = Tuning::active();
     EvalScore score;
     Color enemy = ~c;
     Bitboard occupied = board.pieces();
@@ -844,7 +891,8 @@ EvalScore eval_pieces_with_context(const Board& board, Color c, EvalContext& ctx
         if (ctx.attackedBy[c][PAWN] & square_bb(sq)) {
             Rank relRank = c == WHITE ? rank_of(sq) : Rank(RANK_8 - rank_of(sq));
             if (relRank >= RANK_4 && relRank <= RANK_6) {
-                score += KnightOutpostBonus;
+                score += params.KnightOutpostBonus;
+                trace_add<Trace>(TRACE_KNIGHT_OUTPOST, c);
             }
         }
 
@@ -858,7 +906,7 @@ EvalScore eval_pieces_with_context(const Board& board, Color c, EvalContext& ctx
     while (bb) {
         bishopCount++;
         Square sq = pop_lsb(bb);
-        Bitboard attacks = bishop_attacks_bb(sq, occupied);
+        Bitboard attacks = board.attacks_from(sq);
         int mobility = popcount(attacks & mobilityArea);
         score += BishopMobility[std::min(mobility, 13)];
 
@@ -870,7 +918,10 @@ EvalScore eval_pieces_with_context(const Board& board, Color c, EvalContext& ctx
             score.eg -= (blocked - 3) * 5;
         }
     }
-    if (bishopCount >= 2) score += BishopPairBonus;
+    if (bishopCount >= 2) {
+        score += params.BishopPairBonus;
+        trace_add<Trace>(TRACE_BISHOP_PAIR, c);
+    }
 
     bb = board.pieces(c, ROOK);
     Square rookSquares[2] = {SQ_NONE, SQ_NONE};
@@ -881,18 +932,38 @@ EvalScore eval_pieces_with_context(const Board& board, Color c, EvalContext& ctx
         rookCount++;
 
         File f = file_of(sq);
-        Bitboard attacks = rook_attacks_bb(sq, occupied);
+        Bitboard attacks = board.attacks_from(sq);
         int mobility = popcount(attacks & mobilityArea);
         score += RookMobility[std::min(mobility, 14)];
 
-        Bitboard filePawns = file_bb(f);
-        if (!(filePawns & ourPawns)) {
-            if (!(filePawns & theirPawns)) score += RookOpenFileBonus;
-            else score += RookSemiOpenFileBonus;
+        if (ctx.pawns) {
+            if (ctx.pawns->semiopen_file(c, f)) {
+                if (ctx.pawns->semiopen_file(enemy, f)) {
+                    score += params.RookOpenFileBonus;
+                    trace_add<Trace>(TRACE_ROOK_OPEN_FILE, c);
+                } else {
+                    score += params.RookSemiOpenFileBonus;
+                    trace_add<Trace>(TRACE_ROOK_SEMI_OPEN_FILE, c);
+                }
+            }
+        } else {
+            Bitboard filePawns = file_bb(f);
+            if (!(filePawns & ourPawns)) {
+                if (!(filePawns & theirPawns)) {
+                    score += params.RookOpenFileBonus;
+                    trace_add<Trace>(TRACE_ROOK_OPEN_FILE, c);
+                } else {
+                    score += params.RookSemiOpenFileBonus;
+                    trace_add<Trace>(TRACE_ROOK_SEMI_OPEN_FILE, c);
+                }
+            }
         }
 
         Rank relRank = c == WHITE ? rank_of(sq) : Rank(RANK_8 - rank_of(sq));
-        if (relRank == RANK_7) score += RookOnSeventhBonus;
+        if (relRank == RANK_7) {
+            score += params.RookOnSeventhBonus;
+            trace_add<Trace>(TRACE_ROOK_ON_SEVENTH, c);
+        }
     }
 
     if (rookCount >= 2 && rookSquares[0] != SQ_NONE && rookSquares[1] != SQ_NONE) {
@@ -909,7 +980,7 @@ EvalScore eval_pieces_with_context(const Board& board, Color c, EvalContext& ctx
     bb = board.pieces(c, QUEEN);
     while (bb) {
         Square sq = pop_lsb(bb);
-        Bitboard attacks = queen_attacks_bb(sq, occupied);
+        Bitboard attacks = board.attacks_from(sq);
         int mobility = popcount(attacks & mobilityArea);
         score += QueenMobility[std::min(mobility, 27)];
     }
@@ -933,7 +1004,9 @@ EvalScore eval_pieces_with_context(const Board& board, Color c, EvalContext& ctx
     return score;
 }
 
+template<bool Trace>
 EvalScore eval_king_safety_with_context(const Board& board, Color c, EvalContext& ctx) {
+    const Tuning::Params& params = Tuning::active();
     EvalScore score;
     Color enemy = ~c;
     Square kingSq = ctx.kingSquare[c];
@@ -956,7 +1029,8 @@ EvalScore eval_king_safety_with_context(const Board& board, Color c, EvalContext
 
     if (attackCount >= 2) {
         int penalty = KingSafetyTable[std::min(attackUnits, 99)];
-        penalty = penalty * Tuning::KingSafetyWeight / 100;
+        if constexpr (Trace) activeTrace.kingDanger[c] = penalty;
+        penalty = penalty * params.KingSafetyWeight / 100;
         score.mg -= penalty;
     }
 
@@ -1193,7 +1267,6 @@ EvalScore eval_minor_coordination(const Board& board, Color c, EvalContext& ctx)
 EvalScore eval_piece_activity(const Board& board, Color c, EvalContext& ctx) {
     EvalScore score;
     Color enemy = ~c;
-    Bitboard occupied = board.pieces();
     Bitboard ourPawns = board.pieces(c, PAWN);
     Bitboard theirPawns = board.pieces(enemy, PAWN);
     Bitboard mobilityArea = ctx.mobilityArea[c];
@@ -1236,7 +1309,7 @@ EvalScore eval_piece_activity(const Board& board, Color c, EvalContext& ctx) {
     Bitboard bishops = board.pieces(c, BISHOP);
     while (bishops) {
         Square sq = pop_lsb(bishops);
-        Bitboard attacks = bishop_attacks_bb(sq, occupied);
+        Bitboard attacks = board.attacks_from(sq);
         int mobility = popcount(attacks & mobilityArea);
 
         int centralIndex = get_centralization_index(sq);
@@ -1295,17 +1368,21 @@ EvalScore eval_piece_activity(const Board& board, Color c, EvalContext& ctx) {
     Bitboard rooks = board.pieces(c, ROOK);
     Bitboard passedPawns = 0;
 
-    Bitboard tempPawns = ourPawns;
-    while (tempPawns) {
-        Square sq = pop_lsb(tempPawns);
-        if (!(passed_pawn_mask(c, sq) & theirPawns)) {
-            passedPawns |= square_bb(sq);
+    if (ctx.pawns) {
+        passedPawns = ctx.pawns->passedPawns[c];
+    } else {
+        Bitboard tempPawns = ourPawns;
+        while (tempPawns) {
+            Square sq = pop_lsb(tempPawns);
+            if (!(passed_pawn_mask(c, sq) & theirPawns)) {
+                passedPawns |= square_bb(sq);
+            }
         }
     }
 
     while (rooks) {
         Square sq = pop_lsb(rooks);
-        Bitboard attacks = rook_attacks_bb(sq, occupied);
+        Bitboard attacks = board.attacks_from(sq);
         int mobility = popcount(attacks & mobilityArea);
         File f = file_of(sq);
 
@@ -1358,7 +1435,7 @@ EvalScore eval_piece_activity(const Board& board, Color c, EvalContext& ctx) {
     Bitboard queens = board.pieces(c, QUEEN);
     while (queens) {
         Square sq = pop_lsb(queens);
-        Bitboard attacks = queen_attacks_bb(sq, occupied);
+        Bitboard attacks = board.attacks_from(sq);
         int mobility = popcount(attacks & mobilityArea);
 
         int centralIndex = get_centralization_index(sq);
@@ -1384,6 +1461,7 @@ EvalScore eval_piece_activity(const Board& board, Color c, EvalContext& ctx) {
 }
 
 EvalScore eval_king_safety_advanced(const Board& board, Color c, EvalContext& ctx) {
+    const Tuning::Params& params = Tuning::active();
     EvalScore score;
     Color enemy = ~c;
     Square kingSq = ctx.kingSquare[c];
@@ -1525,7 +1603,7 @@ EvalScore eval_king_safety_advanced(const Board& board, Color c, EvalContext& ct
 
     if (attackerCount >= MinAttackersForDanger) {
         int penalty = KingSafetyTable[std::min(attackUnits, 99)];
-        penalty = penalty * Tuning::KingSafetyWeight / 100;
+        penalty = penalty * params.KingSafetyWeight / 100;
         penalty = std::min(penalty, MaxKingSafetyPenalty);
         score.mg -= penalty;
     }
@@ -1533,52 +1611,183 @@ EvalScore eval_king_safety_advanced(const Board& board, Color c, EvalContext& ct
     return score;
 }
 
-int evaluate(const Board& board, int alpha, int beta) {
-    PROFILE_SCOPE("Eval::evaluate");
-    EvalScore score;
+PawnEntry* probe_pawns(const Board& board, PawnTable& pawns) {
+    Key pawnKey = board.pawn_key();
+    PawnEntry* e = pawns.probe(pawnKey);
+    if (e->match(pawnKey)) {
+        return e;
+    }
+
+    e->key = pawnKey;
+    e->score = eval_pawn_structure(board, WHITE);
+    e->score -= eval_pawn_structure(board, BLACK);
+
+    for (Color c : {WHITE, BLACK}) {
+        Bitboard ourPawns = board.pieces(c, PAWN);
+        Bitboard theirPawns = board.pieces(~c, PAWN);
+
+        Bitboard passed = 0;
+        Bitboard bb = ourPawns;
+        while (bb) {
+            Square sq = pop_lsb(bb);
+            if (!(passed_pawn_mask(c, sq) & theirPawns)) {
+                passed |= square_bb(sq);
+            }
+        }
+
+        U8 semiopen = 0;
+        for (int f = FILE_A; f <= FILE_H; ++f) {
+            if (!(file_bb(File(f)) & ourPawns)) semiopen |= U8(1 << f);
+        }
+
+        e->passedPawns[c] = passed;
+        e->pawnAttacks[c] = pawn_attacks_bb(c, ourPawns);
+        e->semiopenFiles[c] = semiopen;
+    }
+
+    return e;
+}
+
+MaterialEntry* probe_material(const Board& board, MaterialTable& material) {
+    Key materialKey = board.material_key();
+    MaterialEntry* e = material.probe(materialKey);
+    if (e->match(materialKey)) {
+        return e;
+    }
+
     int phase = 0;
     phase += popcount(board.pieces(KNIGHT)) * PhaseValue[KNIGHT];
     phase += popcount(board.pieces(BISHOP)) * PhaseValue[BISHOP];
     phase += popcount(board.pieces(ROOK)) * PhaseValue[ROOK];
     phase += popcount(board.pieces(QUEEN)) * PhaseValue[QUEEN];
-    phase = std::min(phase, TotalPhase);
 
-    score += board.psqt_score(WHITE);
-    score -= board.psqt_score(BLACK);
+    bool bishopsOnly = !board.pieces(PAWN)
+                    && board.pieces(WHITE) == (board.pieces(WHITE, BISHOP) | board.pieces(WHITE, KING))
+                    && board.pieces(BLACK) == (board.pieces(BLACK, BISHOP) | board.pieces(BLACK, KING))
+                    && board.count(WHITE, BISHOP) == 1 && board.count(BLACK, BISHOP) == 1;
+
+    e->key = materialKey;
+    e->imbalance = eval_material_imbalance(board, WHITE);
+    e->imbalance -= eval_material_imbalance(board, BLACK);
+    e->phase = U8(std::min(phase, TotalPhase));
+    e->scaleFactor = U8(Tablebase::EndgameRules::scale_factor(board));
+    e->draw = bishopsOnly ? MATERIAL_DRAW_OPPOSITE_BISHOPS
+            : Tablebase::EndgameRules::is_known_draw(board) ? MATERIAL_DRAW_ALWAYS
+            : MATERIAL_DRAW_NONE;
+
+    e->endgame = ENDGAME_NONE;
+    e->strongSide = WHITE;
+    for (Color c : {WHITE, BLACK}) {
+        if (board.pieces(~c) != board.pieces(~c, KING)) continue;
+
+        Bitboard strong = board.pieces(c) & ~board.pieces(c, KING);
+        if (strong == board.pieces(c, PAWN) && board.count(c, PAWN) == 1) {
+            e->endgame = ENDGAME_KPK;
+            e->strongSide = c;
+        } else if (strong == (board.pieces(c, BISHOP) | board.pieces(c, KNIGHT))
+                   && board.count(c, BISHOP) == 1 && board.count(c, KNIGHT) == 1) {
+            e->endgame = ENDGAME_KBNK;
+            e->strongSide = c;
+        } else if (board.pieces(c, QUEEN) | board.pieces(c, ROOK)) {
+            e->endgame = ENDGAME_KXK;
+            e->strongSide = c;
+        }
+    }
 
-    Key pawnKey = board.pawn_key();
-    PawnEntry* pawnEntry = pawnTable.probe(pawnKey);
-    EvalScore pawnScore;
+    return e;
+}
+
+static int square_distance(Square a, Square b) {
+    return std::max(std::abs(file_of(a) - file_of(b)), std::abs(rank_of(a) - rank_of(b)));
+}
 
-    if (pawnEntry->match(pawnKey)) {
-        pawnScore = pawnEntry->score;
+int evaluate_endgame(const Board& board, const MaterialEntry& material) {
+    Color strong = material.strongSide;
+    Square strongKing = board.king_square(strong);
+    Square weakKing = board.king_square(~strong);
+    int score = 0;
+
+    if (material.endgame == ENDGAME_KPK) {
+        // The bitbase has White as the side with the pawn.
+        Square pawn = lsb(board.pieces(strong, PAWN));
+        Color stm = strong == WHITE ? board.side_to_move() : ~board.side_to_move();
+        if (!Bitbase::probe_kpk(relative_square(strong, strongKing), relative_square(strong, pawn),
+                                relative_square(strong, weakKing), stm)) {
+            return 0;
+        }
+        score = VALUE_KNOWN_WIN + Tuning::active().PawnValue.eg + 16 * relative_rank(strong, pawn);
+    } else if (material.endgame == ENDGAME_KBNK) {
+        // Mate is only forced in a corner of the bishop's colour; drive the
+        // king there and keep ours close.
+        Square bishop = lsb(board.pieces(strong, BISHOP));
+        bool lightBishop = (file_of(bishop) + rank_of(bishop)) % 2;
+        int corner = lightBishop ? std::min(square_distance(weakKing, SQ_A8), square_distance(weakKing, SQ_H1))
+                                 : std::min(square_distance(weakKing, SQ_A1), square_distance(weakKing, SQ_H8));
+        score = VALUE_KNOWN_WIN + 64 * (7 - corner) + 16 * (7 - square_distance(strongKing, weakKing));
     } else {
-        pawnScore += eval_pawn_structure(board, WHITE);
-        pawnScore -= eval_pawn_structure(board, BLACK);
+        // A queen or rook mates on any edge. Count material too, so that
+        // promoting out of KPK (and keeping material) scores higher.
+        const auto& p = Tuning::active();
+        int f = file_of(weakKing), r = rank_of(weakKing);
+        int centre = std::max(3 - f, f - 4) + std::max(3 - r, r - 4);
+        score = VALUE_KNOWN_WIN
+              + p.QueenValue.eg  * board.count(strong, QUEEN)
+              + p.RookValue.eg   * board.count(strong, ROOK)
+              + p.BishopValue.eg * board.count(strong, BISHOP)
+              + p.KnightValue.eg * board.count(strong, KNIGHT)
+              + p.PawnValue.eg   * board.count(strong, PAWN)
+              + 32 * centre + 16 * (7 - square_distance(strongKing, weakKing));
+    }
+
+    return board.side_to_move() == strong ? score : -score;
+}
 
-        pawnEntry->key = pawnKey;
-        pawnEntry->score = pawnScore;
-    }
-    score += pawnScore;
+int evaluate(const Board& board, PawnTable& pawns, const MaterialEntry& material,
+             int alpha, int beta, LazyStats& lazy) {
+    PROFILE_SCOPE(EVAL_FULL);
+    EvalScore score;
+    int phase = material.phase;
+    Color stm = board.side_to_move();
+
+    // Every LazySpotCheckInterval-th early exit is re-evaluated in full to
+    // count how often the cheap score landed on the wrong side of the window.
+    auto lazy_cutoff = [&](int lazyScore, int margin) {
+        if (lazyScore < beta + margin && lazyScore > alpha - margin) {
+            return false;
+        }
+        if (UNLIKELY(++lazy.exits % LazySpotCheckInterval == 0)) {
+            int full = evaluate(board, pawns, material, -VALUE_INFINITE, VALUE_INFINITE, lazy);
+            ++lazy.spotChecks;
+            if (lazyScore >= beta ? full < beta : full > alpha) {
+                ++lazy.spotCheckMisses;
+            }
+        }
+        return true;
+    };
+
+    score += board.psqt_score(WHITE);
+    score -= board.psqt_score(BLACK);
 
-    {
-        int mg = score.mg;
-        int eg = score.eg;
-        int lazyScore = (mg * phase + eg * (TotalPhase - phase)) / TotalPhase;
-        lazyScore = board.side_to_move() == WHITE ? lazyScore : -lazyScore;
+    PawnEntry* pawnEntry = probe_pawns(board, pawns);
+    score += pawnEntry->score;
+    score += material.imbalance;
 
-        constexpr int LAZY_MARGIN = 600;
-        if (lazyScore >= beta + LAZY_MARGIN || lazyScore <= alpha - LAZY_MARGIN) {
-            return lazyScore;
-        }
+    int lazyScore = taper(score, phase, stm);
+    if (lazy_cutoff(lazyScore, LazyMarginPawns)) {
+        return lazyScore;
     }
 
     EvalContext ctx;
-    init_eval_context(ctx, board);
+    init_eval_context(ctx, board, pawnEntry);
 
     score += eval_pieces_with_context(board, WHITE, ctx);
     score -= eval_pieces_with_context(board, BLACK, ctx);
 
+    lazyScore = taper(score, phase, stm);
+    if (lazy_cutoff(lazyScore, LazyMarginPieces)) {
+        return lazyScore;
+    }
+
     score += eval_king_safety_with_context(board, WHITE, ctx);
     score -= eval_king_safety_with_context(board, BLACK, ctx);
 
@@ -1587,21 +1796,19 @@ int evaluate(const Board& board, int alpha, int beta) {
     score += eval_space(board, WHITE);
     score -= eval_space(board, BLACK);
 
-    score += eval_material_imbalance(board, WHITE);
-    score -= eval_material_imbalance(board, BLACK);
-
-    int mg = score.mg;
-    int eg = score.eg;
-    int finalScore = (mg * phase + eg * (TotalPhase - phase)) / TotalPhase;
+    return taper(score, phase, stm);
+}
 
-    constexpr int TEMPO = 12;
-    return (board.side_to_move() == WHITE ? finalScore : -finalScore) + TEMPO;
+int evaluate(const Board& board, int alpha, int beta) {
+    return evaluate(board, fallbackPawnTable, *probe_material(board, fallbackMaterialTable),
+                    alpha, beta, fallbackLazyStats);
 }
 
 int evaluate(const Board& board) {
-    return evaluate(board, -30000, 30000);
+    return evaluate(board, -VALUE_INFINITE, VALUE_INFINITE);
 }
 
+template<bool Trace>
 int evaluate_no_cache(const Board& board) {
     EvalScore score;
 
@@ -1612,22 +1819,32 @@ int evaluate_no_cache(const Board& board) {
     phase += popcount(board.pieces(QUEEN)) * PhaseValue[QUEEN];
     phase = std::min(phase, TotalPhase);
 
+    // The piece values sit in the incremental PSQT score.
+    if constexpr (Trace) {
+        activeTrace.phase = phase;
+        for (Color c : {WHITE, BLACK}) {
+            for (PieceType pt = PAWN; pt <= QUEEN; ++pt) {
+                trace_add<Trace>(TraceTerm(TRACE_PAWN_VALUE + pt - PAWN), c, popcount(board.pieces(c, pt)));
+            }
+        }
+    }
+
     score += board.psqt_score(WHITE);
     score -= board.psqt_score(BLACK);
 
     EvalScore pawnScore;
-    pawnScore += eval_pawn_structure(board, WHITE);
-    pawnScore -= eval_pawn_structure(board, BLACK);
+    pawnScore += eval_pawn_structure<Trace>(board, WHITE);
+    pawnScore -= eval_pawn_structure<Trace>(board, BLACK);
     score += pawnScore;
 
     EvalContext ctx;
     init_eval_context(ctx, board);
 
-    score += eval_pieces_with_context(board, WHITE, ctx);
-    score -= eval_pieces_with_context(board, BLACK, ctx);
+    score += eval_pieces_with_context<Trace>(board, WHITE, ctx);
+    score -= eval_pieces_with_context<Trace>(board, BLACK, ctx);
 
-    score += eval_king_safety_with_context(board, WHITE, ctx);
-    score -= eval_king_safety_with_context(board, BLACK, ctx);
+    score += eval_king_safety_with_context<Trace>(board, WHITE, ctx);
+    score -= eval_king_safety_with_context<Trace>(board, BLACK, ctx);
 
     score += eval_threats_with_context(board, WHITE, ctx);
     score -= eval_threats_with_context(board, BLACK, ctx);
@@ -1652,23 +1869,40 @@ int evaluate_no_cache(const Board& board) {
     return (board.side_to_move() == WHITE ? finalScore : -finalScore) + TEMPO;
 }
 
+template EvalScore eval_pawn_structure<false>(const Board&, Color);
+template EvalScore eval_pawn_structure<true>(const Board&, Color);
+template EvalScore eval_pieces_with_context<false>(const Board&, Color, EvalContext&);
+template EvalScore eval_pieces_with_context<true>(const Board&, Color, EvalContext&);
+template EvalScore eval_king_safety_with_context<false>(const Board&, Color, EvalContext&);
+template EvalScore eval_king_safety_with_context<true>(const Board&, Color, EvalContext&);
+template int evaluate_no_cache<false>(const Board&);
+template int evaluate_no_cache<true>(const Board&);
+
+int trace(const Board& board, EvalTrace& trace) {
+    activeTrace = EvalTrace{};
+    int v = evaluate_no_cache<true>(board);
+    trace = activeTrace;
+    return v;
+}
+
 int material_balance(const Board& board) {
+    const Tuning::Params& params = Tuning::active();
     int balance = 0;
 
-    balance += popcount(board.pieces(WHITE, PAWN)) * PawnValue.mg;
-    balance -= popcount(board.pieces(BLACK, PAWN)) * PawnValue.mg;
+    balance += popcount(board.pieces(WHITE, PAWN)) * params.PawnValue.mg;
+    balance -= popcount(board.pieces(BLACK, PAWN)) * params.PawnValue.mg;
 
-    balance += popcount(board.pieces(WHITE, KNIGHT)) * KnightValue.mg;
-    balance -= popcount(board.pieces(BLACK, KNIGHT)) * KnightValue.mg;
+    balance += popcount(board.pieces(WHITE, KNIGHT)) * params.KnightValue.mg;
+    balance -= popcount(board.pieces(BLACK, KNIGHT)) * params.KnightValue.mg;
 
-    balance += popcount(board.pieces(WHITE, BISHOP)) * BishopValue.mg;
-    balance -= popcount(board.pieces(BLACK, BISHOP)) * BishopValue.mg;
+    balance += popcount(board.pieces(WHITE, BISHOP)) * params.BishopValue.mg;
+    balance -= popcount(board.pieces(BLACK, BISHOP)) * params.BishopValue.mg;
 
-    balance += popcount(board.pieces(WHITE, ROOK)) * RookValue.mg;
-    balance -= popcount(board.pieces(BLACK, ROOK)) * RookValue.mg;
+    balance += popcount(board.pieces(WHITE, ROOK)) * params.RookValue.mg;
+    balance -= popcount(board.pieces(BLACK, ROOK)) * params.RookValue.mg;
 
-    balance += popcount(board.pieces(WHITE, QUEEN)) * QueenValue.mg;
-    balance -= popcount(board.pieces(BLACK, QUEEN)) * QueenValue.mg;
+    balance += popcount(board.pieces(WHITE, QUEEN)) * params.QueenValue.mg;
+    balance -= popcount(board.pieces(BLACK, QUEEN)) * params.QueenValue.mg;
 
     return balance;
 }
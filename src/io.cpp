@@ -0,0 +1,169 @@
+#include "io.hpp"
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <streambuf>
+#include <thread>
+
+namespace IO {
+
+namespace {
+
+// The calling thread's unfinished output.
+thread_local std::string pending;
+
+class AsyncOutput : public std::streambuf {
+public:
+    void start(std::streambuf* target) {
+        direct = target;
+        writer = std::thread(&AsyncOutput::writer_loop, this);
+    }
+
+    void stop() {
+        publish(true);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            exiting = true;
+            cv.notify_one();
+        }
+        if (writer.joinable()) {
+            writer.join();
+        }
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        if (c != traits_type::eof()) {
+            pending += traits_type::to_char_type(c);
+            if (c == '\n') publish(false);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        pending.append(s, size_t(n));
+        if (std::memchr(s, '\n', size_t(n))) publish(false);
+        return n;
+    }
+
+    int sync() override {
+        publish(true);
+        return 0;
+    }
+
+private:
+    // Queues the pending text up to its last newline, or all of it.
+    void publish(bool all) {
+        size_t end = all ? pending.size() : pending.rfind('\n') + 1;  // npos + 1 == 0
+        if (end == 0) return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.append(pending, 0, end);
+        if (idle) cv.notify_one();
+        pending.erase(0, end);
+    }
+
+    void writer_loop() {
+        std::string batch;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            idle = true;
+            cv.wait(lock, [this] { return !queued.empty() || exiting; });
+            idle = false;
+            if (queued.empty()) break;
+
+            batch.swap(queued);
+            lock.unlock();
+            direct->sputn(batch.data(), std::streamsize(batch.size()));
+            direct->pubsync();
+            batch.clear();
+            lock.lock();
+        }
+    }
+
+    std::streambuf* direct = nullptr;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::string queued;
+    bool idle = false;
+    bool exiting = false;
+};
+
+AsyncOutput* output = nullptr;
+std::streambuf* consoleBuffer = nullptr;
+
+struct InputQueue {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::string> lines;
+    bool closed = false;
+};
+
+InputQueue& input() {
+    static InputQueue queue;
+    return queue;
+}
+
+}
+
+void start_output() {
+    if (output) return;
+
+    static AsyncOutput buffer;
+    output = &buffer;
+    consoleBuffer = std::cout.rdbuf();
+    output->start(consoleBuffer);
+    std::cout.rdbuf(output);
+    std::atexit(stop_output);
+}
+
+void stop_output() {
+    if (!output) return;
+
+    std::cout.flush();
+    output->stop();
+    std::cout.rdbuf(consoleBuffer);
+    output = nullptr;
+}
+
+void start_input(std::function<void(const std::string&)> on_line) {
+    // Detached: at exit the thread may still be blocked reading stdin.
+    std::thread([on_line] {
+        InputQueue& queue = input();
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            on_line(line);
+
+            std::istringstream is(line);
+            std::string token;
+            is >> token;
+
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.lines.push_back(line);
+            queue.cv.notify_one();
+            if (token == "quit") break;
+        }
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.closed = true;
+        queue.cv.notify_one();
+    }).detach();
+}
+
+bool read_line(std::string& line) {
+    InputQueue& queue = input();
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    queue.cv.wait(lock, [&] { return !queue.lines.empty() || queue.closed; });
+    if (queue.lines.empty()) return false;
+
+    line = std::move(queue.lines.front());
+    queue.lines.pop_front();
+    return true;
+}
+
+}
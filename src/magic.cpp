@@ -1,53 +1,110 @@
 #include "magic.hpp"
+#include <algorithm>
+#include <array>
 #include <cstring>
+#include <sstream>
+#include <utility>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
 
 Magic BishopMagics[SQUARE_NB];
 Magic RookMagics[SQUARE_NB];
 
-static Bitboard BishopTable[0x1480];
-static Bitboard RookTable[0x19000];
-
-constexpr Bitboard BishopMagicNumbers[SQUARE_NB] = {
-    0x40040844404084ULL,   0x2004208a004208ULL,   0x10190041080202ULL,   0x108060845042010ULL,
-    0x581104180800210ULL,  0x2112080446200010ULL, 0x1080820820060210ULL, 0x3c0808410220200ULL,
-    0x4050404440404ULL,    0x21001420088ULL,      0x24d0080801082102ULL, 0x1020a0a020400ULL,
-    0x40308200402ULL,      0x4011002100800ULL,    0x401484104104005ULL,  0x801010402020200ULL,
-    0x400210c3880100ULL,   0x404022024108200ULL,  0x810018200204102ULL,  0x4002801a02003ULL,
-    0x85040820080400ULL,   0x810102c808880400ULL, 0xe900410884800ULL,    0x8002020480840102ULL,
-    0x220200865090201ULL,  0x2010100a02021202ULL, 0x152048408022401ULL,  0x20080002081110ULL,
-    0x4001001021004000ULL, 0x800040400a011002ULL, 0xe4004081011002ULL,   0x1c004001012080ULL,
-    0x8004200962a00220ULL, 0x8422100208500202ULL, 0x2000402200300c08ULL, 0x8646020080080080ULL,
-    0x80020a0200100808ULL, 0x2010004880111000ULL, 0x623000a080011400ULL, 0x42008c0340209202ULL,
-    0x209188240001000ULL,  0x400408a884001800ULL, 0x110400a6080400ULL,   0x1840060a44020800ULL,
-    0x90080104000041ULL,   0x201011000808101ULL,  0x1a2208080504f080ULL, 0x8012020600211212ULL,
-    0x500861011240000ULL,  0x180806108200800ULL,  0x4000020e01040044ULL, 0x300000261044000aULL,
-    0x802241102020002ULL,  0x20906061210001ULL,   0x5a84841004010310ULL, 0x4010801011c04ULL,
-    0xa010109502200ULL,    0x4a02012000ULL,       0x500201010098b028ULL, 0x8040002811040900ULL,
-    0x28000010020204ULL,   0x6000020202d0240ULL,  0x8918844842082200ULL, 0x4010011029020020ULL
+namespace Magics {
+
+Backend backend = BLACK_MAGIC;
+
+}
+
+// Black magic numbers with their offsets into BlackMagicAttacks, found by an
+// offline search that lets the tables of different squares overlap. The
+// PEXT layout needs 2^bits entries per square in a table of its own.
+struct BlackMagic {
+    Bitboard magic;
+    int      offset;
+};
+
+constexpr BlackMagic BishopBlackMagics[SQUARE_NB] = {
+    { 0x105010401022003ULL,    55189 }, { 0x44212441100100ULL,     14341 },
+    { 0x8242098a0080008ULL,    13383 }, { 0x4006186010000000ULL,   12308 },
+    { 0x81413a8209000080ULL,   12619 }, { 0x4001214881101000ULL,   13454 },
+    { 0x4908442208020580ULL,   14414 }, { 0x1018208404018080ULL,   55508 },
+    { 0x400409902420a00cULL,   14477 }, { 0xc8c28401020810ULL,     14533 },
+    { 0xa12410a0881002ULL,     13510 }, { 0x1000030300605900ULL,   12366 },
+    { 0x7c00013a8080a201ULL,   12682 }, { 0x112442810080ULL,       13574 },
+    { 0x10004108090188ULL,     14597 }, { 0x252108094014040ULL,    14661 },
+    { 0x2124000988812018ULL,   13642 }, { 0xa12080444409014ULL,    13703 },
+    { 0x4000824282002ULL,     102094 }, { 0x28018686000644ULL,     57878 },
+    { 0xc000c00063008000ULL,  101676 }, { 0xc060611a00c0ULL,      101997 },
+    { 0x4102401880a40128ULL,   13774 }, { 0x41404829112042ULL,     13319 },
+    { 0xa280809432021ULL,      12936 }, { 0x10c0a0004418021ULL,    12746 },
+    { 0x8860003009008ULL,     101438 }, { 0x491044001040200ULL,   100304 },
+    { 0x10010189200804ULL,     99792 }, { 0x406086000300048ULL,   101784 },
+    { 0x4102c00111c04cULL,     12810 }, { 0x300280a048309020ULL,   13006 },
+    { 0x10082888a141402ULL,    13064 }, { 0x160228222180500ULL,    12874 },
+    { 0x82810500060ULL,        58003 }, { 0x288200800810114ULL,    99281 },
+    { 0x9d00203200840060ULL,  100814 }, { 0x4000406c401200c0ULL,  101321 },
+    { 0x200030a8a0018600ULL,   12559 }, { 0x40205050214140ULL,     13128 },
+    { 0x180018809082401ULL,    13830 }, { 0x2000112148801220ULL,   13898 },
+    { 0xc88013404110200ULL,   102183 }, { 0x80318042400ULL,        59789 },
+    { 0x806800a1006020c0ULL,  101558 }, { 0xa00600318060ULL,      101894 },
+    { 0x2141092b0240ULL,       13958 }, { 0x224048480521ULL,       14022 },
+    { 0x8484a08041ULL,         14725 }, { 0x9000100829080a0ULL,    14790 },
+    { 0x62000851244428ULL,     14086 }, { 0x100032018460441ULL,    12428 },
+    { 0x1020000105414040ULL,   13194 }, { 0x108a1412142ULL,        14150 },
+    { 0x281104420888800ULL,    14853 }, { 0x4840481118648040ULL,   14926 },
+    { 0x4100020101480202ULL,   55677 }, { 0x2420c00090880841ULL,   14985 },
+    { 0x880890a440ULL,         14214 }, { 0x2158088218184600ULL,   12496 },
+    { 0x50821001054140ULL,     13256 }, { 0x120040082447120ULL,    14278 },
+    { 0x48020268020090ULL,     15045 }, { 0x4200046882004011ULL,   55361 }
 };
 
-constexpr Bitboard RookMagicNumbers[SQUARE_NB] = {
-    0x8a80104000800020ULL, 0x140002000100040ULL,  0x2801880a0017001ULL,  0x100081001000420ULL,
-    0x200020010080420ULL,  0x3001c0002010008ULL,  0x8480008002000100ULL, 0x2080088004402900ULL,
-    0x800098204000ULL,     0x2024401000200040ULL, 0x100802000801000ULL,  0x120800800801000ULL,
-    0x208808088000400ULL,  0x2802200800400ULL,    0x2200800100020080ULL, 0x801000060821100ULL,
-    0x80044006422000ULL,   0x100808020004000ULL,  0x12108a0010204200ULL, 0x140848010000802ULL,
-    0x481828014002800ULL,  0x8094004002004100ULL, 0x4010040010010802ULL, 0x20008806104ULL,
-    0x100400080208000ULL,  0x2040002120081000ULL, 0x21200680100081ULL,   0x20100080080080ULL,
-    0x2000a00200410ULL,    0x20080800400ULL,      0x80088400100102ULL,   0x80004600042881ULL,
-    0x4040008040800020ULL, 0x440003000200801ULL,  0x4200011004500ULL,    0x188020010100100ULL,
-    0x14800401802800ULL,   0x2080040080800200ULL, 0x124080204001001ULL,  0x200046502000484ULL,
-    0x480400080088020ULL,  0x1000422010034000ULL, 0x30200100110040ULL,   0x100021010009ULL,
-    0x2002080100110004ULL, 0x202008004008002ULL,  0x20020004010100ULL,   0x2048440040820001ULL,
-    0x101002200408200ULL,  0x40802000401080ULL,   0x4008142004410100ULL, 0x2060820c0120200ULL,
-    0x1001004080100ULL,    0x20c020080040080ULL,  0x2935610830022400ULL, 0x44440041009200ULL,
-    0x280001040802101ULL,  0x2100190040002085ULL, 0x80c0084100102001ULL, 0x4024081001000421ULL,
-    0x20030a0244872ULL,    0x12001008414402ULL,   0x2006104900a0804ULL,  0x1004081002402ULL
+constexpr BlackMagic RookBlackMagics[SQUARE_NB] = {
+    { 0x810009020080008ULL,        0 }, { 0xc08020404400003ULL,    34758 },
+    { 0x12000b4200048018ULL,   24527 }, { 0x4100050021100002ULL,   26573 },
+    { 0x8200031060009600ULL,   36801 }, { 0x500018400008900ULL,    28620 },
+    { 0x1c000140b0840028ULL,   40891 }, { 0x200003409420001ULL,     4090 },
+    { 0x800300088001800ULL,    56986 }, { 0x303122400011ULL,       91604 },
+    { 0x10060004c000420ULL,    93528 }, { 0x2000cc0120002ULL,      81472 },
+    { 0x1205400482004001ULL,   87584 }, { 0x2240044a400080ULL,     88589 },
+    { 0x800c000221900025ULL,   85550 }, { 0x40020010640020c2ULL,   30665 },
+    { 0x1040041840200ULL,      18387 }, { 0x1420004018300008ULL,   77402 },
+    { 0x10006014200008ULL,     82492 }, { 0x4001010024b00005ULL,   66173 },
+    { 0x100901000801d002ULL,   67194 }, { 0x1004008002001480ULL,   64126 },
+    { 0x2004001850005aULL,     68217 }, { 0xc220000640011ULL,      20434 },
+    { 0x8202008400410400ULL,   22481 }, { 0x4000101640200040ULL,   69239 },
+    { 0x21000a060020c080ULL,   70259 }, { 0x8400030500100020ULL,   71276 },
+    { 0xe200020200201810ULL,   72299 }, { 0x2040010100080400ULL,   73315 },
+    { 0x100300400028845ULL,    65150 }, { 0x8486200010084ULL,      16340 },
+    { 0x8000100828200200ULL,   38848 }, { 0x200080830100400ULL,    78408 },
+    { 0x480400909002000ULL,    74337 }, { 0x1020020042001060ULL,   75358 },
+    { 0x2100020006001420ULL,   79430 }, { 0x100010089000400ULL,    76379 },
+    { 0x2080020b0200200ULL,    90615 }, { 0x60001850200500ULL,     32711 },
+    { 0x480000818003004ULL,    58810 }, { 0xc0000808302000ULL,     92568 },
+    { 0x8400040014182000ULL,   86573 }, { 0xc40028a020020ULL,      80451 },
+    { 0x30010a00060018ULL,     83512 }, { 0xc280010400030006ULL,   84536 },
+    { 0x400282002c005ULL,      98257 }, { 0x20010009d9008ULL,      55063 },
+    { 0x820011a000300060ULL,   60720 }, { 0x908002e40a0ULL,        95299 },
+    { 0x1040040c00600060ULL,   94545 }, { 0x12024020120ULL,        97515 },
+    { 0x1088156200ULL,         89597 }, { 0x8004140310140ULL,      96028 },
+    { 0x1000402002a0ULL,       96766 }, { 0x414001444a000a0ULL,    62110 },
+    { 0x1118248042ULL,         12244 }, { 0x20001102c104082ULL,    49030 },
+    { 0x28004214088100aULL,    51052 }, { 0x828001c408042012ULL,   53070 },
+    { 0xc0020000c4090212ULL,   46996 }, { 0x4200004162440aULL,     44964 },
+    { 0xa000012844102ULL,      42927 }, { 0x220000088c440622ULL,    8178 }
 };
 
+
+constexpr int BLACK_MAGIC_TABLE_SIZE = 102305;
+constexpr int PEXT_TABLE_SIZE = 0x19000 + 0x1480;
+
 namespace {
 
-Bitboard compute_mask(PieceType pt, Square sq) {
+constexpr Bitboard compute_mask(PieceType pt, Square sq) {
     Bitboard mask = EMPTY_BB;
 
     int rk = rank_of(sq);
@@ -72,107 +129,267 @@ Bitboard compute_mask(PieceType pt, Square sq) {
     return mask;
 }
 
-Bitboard compute_attacks(PieceType pt, Square sq, Bitboard occupied) {
-    Bitboard attacks = EMPTY_BB;
+// Both attack tables are filled at compile time. Walking every ray square by
+// square for all 210k entries exceeds the compilers' constexpr step limits,
+// so each ray is cut at its first blocker using precomputed empty-board
+// rays, and the blocker is found with a de Bruijn multiply that, unlike the
+// bit-scan intrinsics, works in constant expressions.
+enum RayDirection { RAY_N, RAY_E, RAY_NE, RAY_NW, RAY_S, RAY_W, RAY_SW, RAY_SE, RAY_NB };
 
-    int rk = rank_of(sq);
-    int fl = file_of(sq);
+constexpr int RayFile[RAY_NB] = { 0, 1, 1, -1,  0, -1, -1,  1 };
+constexpr int RayRank[RAY_NB] = { 1, 0, 1,  1, -1,  0, -1, -1 };
 
-    if (pt == ROOK) {
-        for (int f = fl + 1; f <= 7; ++f) {
-            Square s = make_square(File(f), Rank(rk));
-            attacks |= square_bb(s);
-            if (occupied & s) break;
-        }
-        for (int f = fl - 1; f >= 0; --f) {
-            Square s = make_square(File(f), Rank(rk));
-            attacks |= square_bb(s);
-            if (occupied & s) break;
-        }
-        for (int r = rk + 1; r <= 7; ++r) {
-            Square s = make_square(File(fl), Rank(r));
-            attacks |= square_bb(s);
-            if (occupied & s) break;
-        }
-        for (int r = rk - 1; r >= 0; --r) {
-            Square s = make_square(File(fl), Rank(r));
-            attacks |= square_bb(s);
-            if (occupied & s) break;
-        }
-    } else {
-        for (int f = fl + 1, r = rk + 1; f <= 7 && r <= 7; ++f, ++r) {
-            Square s = make_square(File(f), Rank(r));
-            attacks |= square_bb(s);
-            if (occupied & s) break;
-        }
-        for (int f = fl - 1, r = rk + 1; f >= 0 && r <= 7; --f, ++r) {
-            Square s = make_square(File(f), Rank(r));
-            attacks |= square_bb(s);
-            if (occupied & s) break;
-        }
-        for (int f = fl + 1, r = rk - 1; f <= 7 && r >= 0; ++f, --r) {
-            Square s = make_square(File(f), Rank(r));
-            attacks |= square_bb(s);
-            if (occupied & s) break;
-        }
-        for (int f = fl - 1, r = rk - 1; f >= 0 && r >= 0; --f, --r) {
-            Square s = make_square(File(f), Rank(r));
-            attacks |= square_bb(s);
-            if (occupied & s) break;
+using Rays = std::array<std::array<Bitboard, SQUARE_NB>, RAY_NB>;
+
+constexpr Rays make_rays() {
+    Rays rays{};
+    for (int d = 0; d < RAY_NB; ++d) {
+        for (Square sq = SQ_A1; sq <= SQ_H8; ++sq) {
+            for (int f = file_of(sq) + RayFile[d], r = rank_of(sq) + RayRank[d];
+                 f >= 0 && f <= 7 && r >= 0 && r <= 7; f += RayFile[d], r += RayRank[d]) {
+                rays[d][sq] |= square_bb(make_square(File(f), Rank(r)));
+            }
         }
     }
+    return rays;
+}
+
+constexpr Rays EmptyRays = make_rays();
+
+constexpr U64 DeBruijn64 = 0x03f79d71b4cb0a89ULL;
+
+constexpr std::array<int, 64> make_debruijn_index() {
+    std::array<int, 64> index{};
+    for (int i = 0; i < 64; ++i) {
+        index[((1ULL << i) * DeBruijn64) >> 58] = i;
+    }
+    return index;
+}
+
+constexpr std::array<int, 64> DeBruijnIndex = make_debruijn_index();
 
+constexpr Square constexpr_lsb(Bitboard b) {
+    return Square(DeBruijnIndex[((b & (0 - b)) * DeBruijn64) >> 58]);
+}
+
+constexpr int constexpr_popcount(Bitboard b) {
+    int count = 0;
+    for (; b; b &= b - 1) ++count;
+    return count;
+}
+
+constexpr Square constexpr_msb(Bitboard b) {
+    b |= b >> 1;
+    b |= b >> 2;
+    b |= b >> 4;
+    b |= b >> 8;
+    b |= b >> 16;
+    b |= b >> 32;
+    return Square(DeBruijnIndex[((b ^ (b >> 1)) * DeBruijn64) >> 58]);
+}
+
+// Rays up to and including the first blocker. The first four directions
+// run towards higher squares, so their nearest blocker is the lowest bit.
+constexpr Bitboard ray_attacks(RayDirection d, Square sq, Bitboard occupied) {
+    Bitboard attacks = EmptyRays[d][sq];
+    Bitboard blockers = attacks & occupied;
+    if (blockers) {
+        Square first = d < RAY_S ? constexpr_lsb(blockers) : constexpr_msb(blockers);
+        attacks ^= EmptyRays[d][first];
+    }
     return attacks;
 }
 
-Bitboard index_to_occupancy(int index, int bits, Bitboard mask) {
+constexpr Bitboard compute_attacks(PieceType pt, Square sq, Bitboard occupied) {
+    if (pt == ROOK) {
+        return ray_attacks(RAY_N, sq, occupied) | ray_attacks(RAY_E, sq, occupied)
+             | ray_attacks(RAY_S, sq, occupied) | ray_attacks(RAY_W, sq, occupied);
+    }
+    return ray_attacks(RAY_NE, sq, occupied) | ray_attacks(RAY_NW, sq, occupied)
+         | ray_attacks(RAY_SE, sq, occupied) | ray_attacks(RAY_SW, sq, occupied);
+}
+
+// Subsets of the mask in increasing order (carry-rippler), which is also
+// the order of their PEXT indices.
+template<typename Visit>
+constexpr void for_each_occupancy(Bitboard mask, Visit visit) {
     Bitboard occupancy = EMPTY_BB;
+    do {
+        visit(occupancy);
+        occupancy = (occupancy - mask) & mask;
+    } while (occupancy);
+}
+
+using BlackMagicTable = std::array<Bitboard, BLACK_MAGIC_TABLE_SIZE>;
+using PextTable = std::array<Bitboard, PEXT_TABLE_SIZE>;
+
+// PEXT: a dense block of 2^bits entries per square, rooks first. Built one
+// rank of one slider at a time, since each constant evaluation has its own
+// step budget and the whole table at once would exceed it.
+constexpr int CHUNK_NB = 16;
+constexpr int MAX_CHUNK_SIZE = 2 * 4096 + 6 * 2048;    // Rooks on the first rank
+
+struct AttackChunk {
+    std::array<Bitboard, MAX_CHUNK_SIZE> attacks{};
+    int size = 0;
+};
 
-    for (int i = 0; i < bits; ++i) {
-        int bit = lsb(mask);
-        mask &= mask - 1;
+constexpr AttackChunk make_chunk(int chunk) {
+    AttackChunk c;
+    PieceType pt = chunk < 8 ? ROOK : BISHOP;
+    for (File f = FILE_A; f <= FILE_H; ++f) {
+        Square sq = make_square(f, Rank(chunk % 8));
+        for_each_occupancy(compute_mask(pt, sq), [&](Bitboard occupancy) {
+            c.attacks[c.size++] = compute_attacks(pt, sq, occupancy);
+        });
+    }
+    return c;
+}
+
+template<int Chunk>
+constexpr AttackChunk PextChunk = make_chunk(Chunk);
 
-        if (index & (1 << i)) {
-            occupancy |= (1ULL << bit);
+template<int... Chunks>
+constexpr PextTable make_pext_table(std::integer_sequence<int, Chunks...>) {
+    PextTable table{};
+    int next = 0;
+    for (const AttackChunk* c : {&PextChunk<Chunks>...}) {
+        for (int i = 0; i < c->size; ++i) {
+            table[next++] = c->attacks[i];
         }
     }
+    return table;
+}
+
+constexpr PextTable PextAttacks = make_pext_table(std::make_integer_sequence<int, CHUNK_NB>{});
 
-    return occupancy;
+// Black magics: the squares' tables overlap in one shared array. The
+// entries are copied from the PEXT table, which enumerates the same
+// occupancies in the same order, to stay within the constexpr step limit.
+constexpr BlackMagicTable make_black_magic_table() {
+    BlackMagicTable table{};
+    int next = 0;
+    for (PieceType pt : {ROOK, BISHOP}) {
+        const BlackMagic* black = pt == ROOK ? RookBlackMagics : BishopBlackMagics;
+        for (Square sq = SQ_A1; sq <= SQ_H8; ++sq) {
+            Bitboard mask = compute_mask(pt, sq);
+            int shift = 64 - constexpr_popcount(mask);
+            for_each_occupancy(mask, [&](Bitboard occupancy) {
+                unsigned index = unsigned(((occupancy | ~mask) * black[sq].magic) >> shift);
+                table[black[sq].offset + index] = PextAttacks[next++];
+            });
+        }
+    }
+    return table;
 }
 
-void init_magics(PieceType pt, Magic magics[], Bitboard table[], const Bitboard magic_numbers[]) {
-    Bitboard* attack_ptr = table;
+constexpr BlackMagicTable BlackMagicAttacks = make_black_magic_table();
 
+// Points each square at its part of the backend's table.
+void init_magics(PieceType pt, Magic magics[], const BlackMagic black[], const Bitboard*& next) {
     for (Square sq = SQ_A1; sq <= SQ_H8; ++sq) {
         Magic& m = magics[sq];
 
         m.mask = compute_mask(pt, sq);
-        m.magic = magic_numbers[sq];
+        m.magic = black[sq].magic;
 
         int bits = popcount(m.mask);
         m.shift = 64 - bits;
 
-        m.attacks = attack_ptr;
+        if (Magics::backend == Magics::PEXT) {
+            m.attacks = next;
+            next += 1 << bits;
+        } else {
+            m.attacks = BlackMagicAttacks.data() + black[sq].offset;
+        }
+    }
+}
 
-        int num_occupancies = 1 << bits;
+struct CpuInfo {
+    bool bmi2 = false;
+    bool slowPext = false;
+};
 
-        for (int i = 0; i < num_occupancies; ++i) {
-            Bitboard occupancy = index_to_occupancy(i, bits, m.mask);
-            unsigned idx = m.index(occupancy);
-            m.attacks[idx] = compute_attacks(pt, sq, occupancy);
-        }
+CpuInfo detect_cpu() {
+    CpuInfo info;
+
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    unsigned regs[4] = {};
+    auto cpuid = [&regs](unsigned leaf, unsigned sub) {
+#if defined(_MSC_VER)
+        int r[4];
+        __cpuidex(r, int(leaf), int(sub));
+        for (int k = 0; k < 4; ++k) regs[k] = unsigned(r[k]);
+#else
+        __cpuid_count(leaf, sub, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    };
+
+    cpuid(0, 0);
+    unsigned maxLeaf = regs[0];
+    char vendor[13] = {};
+    std::memcpy(vendor, &regs[1], 4);
+    std::memcpy(vendor + 4, &regs[3], 4);
+    std::memcpy(vendor + 8, &regs[2], 4);
 
-        attack_ptr += num_occupancies;
+    if (maxLeaf >= 7) {
+        cpuid(7, 0);
+        info.bmi2 = (regs[1] >> 8) & 1;
     }
+
+    // AMD ran PEXT in microcode until Zen 3 (family 19h): tens of cycles,
+    // far slower than a magic multiply.
+    if (!std::strcmp(vendor, "AuthenticAMD") || !std::strcmp(vendor, "HygonGenuine")) {
+        cpuid(1, 0);
+        unsigned family = (regs[0] >> 8) & 0xF;
+        if (family == 0xF) family += (regs[0] >> 20) & 0xFF;
+        info.slowPext = family < 0x19;
+    }
+#endif
+
+    return info;
 }
 
 }
 
 namespace Magics {
 
+bool pext_supported() {
+#ifdef HAS_PEXT_INSTRUCTION
+    static const bool supported = detect_cpu().bmi2;
+    return supported;
+#else
+    return false;
+#endif
+}
+
+bool pext_fast() {
+    static const bool slow = detect_cpu().slowPext;
+    return pext_supported() && !slow;
+}
+
 void init() {
-    init_magics(BISHOP, BishopMagics, BishopTable, BishopMagicNumbers);
-    init_magics(ROOK, RookMagics, RookTable, RookMagicNumbers);
+#ifdef USE_PEXT
+    init(pext_supported() ? PEXT : BLACK_MAGIC);
+#else
+    init(pext_fast() ? PEXT : BLACK_MAGIC);
+#endif
+}
+
+void init(Backend b) {
+    backend = (b == PEXT && pext_supported()) ? PEXT : BLACK_MAGIC;
+
+    const Bitboard* next = PextAttacks.data();
+    init_magics(ROOK, RookMagics, RookBlackMagics, next);
+    init_magics(BISHOP, BishopMagics, BishopBlackMagics, next);
+}
+
+std::string describe() {
+    std::ostringstream ss;
+    int entries = backend == PEXT ? PEXT_TABLE_SIZE : BLACK_MAGIC_TABLE_SIZE;
+    ss << (backend == PEXT ? "pext" : "black magic") << " ("
+       << entries * int(sizeof(Bitboard)) / 1024 << " KB)";
+    return ss.str();
 }
 
 }
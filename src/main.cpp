@@ -5,16 +5,19 @@
 #include "zobrist.hpp"
 #include "tt.hpp"
 #include "uci.hpp"
+#include "io.hpp"
+#include "nnue.hpp"
 
 void init_engine() {
-    Bitboards::init();
     Magics::init();
-    Zobrist::init();
-    Position::init();
+
+    if (NNUE::load_embedded()) {
+        NNUE::set_enabled(true);
+    }
 }
 
 int main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[]) {
-    std::cout.setf(std::ios::unitbuf);
+    IO::start_output();
     init_engine();
 
     UCI::UCIHandler uci;
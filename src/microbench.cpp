@@ -0,0 +1,279 @@
+#include "microbench.hpp"
+#include "bench.hpp"
+#include "board.hpp"
+#include "eval.hpp"
+#include "movegen.hpp"
+#include "moveorder.hpp"
+#include "nnue.hpp"
+#include "profiler.hpp"
+#include "testing.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+namespace MicroBench {
+
+namespace {
+
+// Kernel results are folded into this so the optimiser cannot drop the work.
+volatile uint64_t sink;
+
+struct Position {
+    Board board;
+    std::vector<Move> legal;
+    std::vector<Move> captures;
+};
+
+struct Kernel {
+    const char* name;
+    std::function<uint64_t(std::vector<Position>&)> pass;   // Returns ops done
+};
+
+std::vector<std::string> default_files() {
+    std::vector<std::string> files;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator("tests", ec)) {
+        if (entry.path().extension() == ".epd") files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// Accepts EPD lines and the quoted "name: \"fen\", ..." lines of see-test.epd.
+std::vector<std::string> load_fens(const std::vector<std::string>& files) {
+    std::vector<std::string> fens;
+    for (const std::string& path : files) {
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#') continue;
+
+            size_t q = line.find('"');
+            if (line.substr(0, line.find(' ')).find('/') == std::string::npos && q != std::string::npos) {
+                size_t end = line.find('"', q + 1);
+                if (end != std::string::npos) fens.push_back(line.substr(q + 1, end - q - 1));
+                continue;
+            }
+
+            TacticalPosition pos = TacticalTest::parse_epd_line(line);
+            if (!pos.fen.empty()) fens.push_back(pos.fen);
+        }
+    }
+    return fens;
+}
+
+// States live in a separate array so the boards' StateInfo pointers stay
+// valid while the corpus is held.
+void build_corpus(const std::vector<std::string>& fens, std::vector<StateInfo>& states,
+                  std::vector<Position>& corpus) {
+    states.resize(fens.size());
+    corpus.reserve(fens.size());
+
+    for (size_t i = 0; i < fens.size(); ++i) {
+        Position p;
+        p.board.set(fens[i], &states[i]);
+        if (popcount(p.board.pieces(WHITE, KING)) != 1 || popcount(p.board.pieces(BLACK, KING)) != 1) continue;
+
+        MoveList moves;
+        MoveGen::generate_legal(p.board, moves);
+        for (int j = 0; j < moves.size(); ++j) {
+            Move m = moves[j].move;
+            p.legal.push_back(m);
+            if (p.board.is_capture(m)) p.captures.push_back(m);
+        }
+        corpus.push_back(std::move(p));
+    }
+}
+
+std::vector<Kernel> kernels() {
+    std::vector<Kernel> list = {
+        { "do_undo_move", [](std::vector<Position>& corpus) {
+            uint64_t ops = 0, acc = 0;
+            StateInfo st;
+            for (Position& p : corpus) {
+                for (Move m : p.legal) {
+                    p.board.do_move(m, st);
+                    acc += p.board.key();
+                    p.board.undo_move(m);
+                }
+                ops += p.legal.size();
+            }
+            sink = acc;
+            return ops;
+        }},
+        { "generate_all", [](std::vector<Position>& corpus) {
+            uint64_t acc = 0;
+            for (Position& p : corpus) {
+                MoveList moves;
+                MoveGen::generate_all(p.board, moves);
+                acc += moves.size();
+            }
+            sink = acc;
+            return uint64_t(corpus.size());
+        }},
+        { "generate_legal", [](std::vector<Position>& corpus) {
+            uint64_t acc = 0;
+            for (Position& p : corpus) {
+                MoveList moves;
+                MoveGen::generate_legal(p.board, moves);
+                acc += moves.size();
+            }
+            sink = acc;
+            return uint64_t(corpus.size());
+        }},
+        { "see_ge", [](std::vector<Position>& corpus) {
+            uint64_t ops = 0, acc = 0;
+            for (Position& p : corpus) {
+                for (Move m : p.captures) acc += SEE::see_ge(p.board, m, 0);
+                ops += p.captures.size();
+            }
+            sink = acc;
+            return ops;
+        }},
+        { "eval", [](std::vector<Position>& corpus) {
+            uint64_t acc = 0;
+            for (Position& p : corpus) acc += Eval::evaluate(p.board);
+            sink = acc;
+            return uint64_t(corpus.size());
+        }},
+        { "eval_no_cache", [](std::vector<Position>& corpus) {
+            uint64_t acc = 0;
+            for (Position& p : corpus) acc += Eval::evaluate_no_cache(p.board);
+            sink = acc;
+            return uint64_t(corpus.size());
+        }}
+    };
+
+    // Includes the make/unmake cost; subtract do_undo_move for the
+    // incremental accumulator update plus the output layer.
+    if (NNUE::is_loaded()) {
+        list.push_back({ "do_nnue_undo", [](std::vector<Position>& corpus) {
+            uint64_t ops = 0, acc = 0;
+            StateInfo st;
+            for (Position& p : corpus) {
+                for (Move m : p.legal) {
+                    p.board.do_move(m, st);
+                    acc += NNUE::evaluate(p.board);
+                    p.board.undo_move(m);
+                }
+                ops += p.legal.size();
+            }
+            sink = acc;
+            return ops;
+        }});
+    }
+
+    return list;
+}
+
+Result measure(const Kernel& kernel, std::vector<Position>& corpus, const Config& config) {
+    using Clock = std::chrono::steady_clock;
+
+    Result r;
+    r.kernel = kernel.name;
+    r.opsPerPass = kernel.pass(corpus);
+    if (r.opsPerPass == 0) return r;
+
+    // Warm caches and branch predictors, and size the samples.
+    int passes = 1;
+    while (true) {
+        auto start = Clock::now();
+        for (int i = 0; i < passes; ++i) kernel.pass(corpus);
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+        if (ms >= config.sampleMs || passes >= (1 << 20)) break;
+        passes *= 2;
+    }
+
+    std::vector<double> ns, ticks;
+    for (int s = 0; s < config.samples; ++s) {
+        auto start = Clock::now();
+        uint64_t t0 = Profiler::now_ticks();
+        for (int i = 0; i < passes; ++i) kernel.pass(corpus);
+        uint64_t t1 = Profiler::now_ticks();
+        auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+        double ops = double(r.opsPerPass) * passes;
+        ns.push_back(elapsed / ops);
+        ticks.push_back(double(t1 - t0) / ops);
+    }
+
+    size_t fastest = std::min_element(ns.begin(), ns.end()) - ns.begin();
+    r.nsPerOp = ns[fastest];
+    r.ticksPerOp = ticks[fastest];
+    std::sort(ns.begin(), ns.end());
+    r.medianNsPerOp = ns[ns.size() / 2];
+    return r;
+}
+
+}
+
+std::vector<Result> run(const Config& config) {
+    std::vector<std::string> files = config.files.empty() ? default_files() : config.files;
+    std::vector<std::string> fens = load_fens(files);
+    std::string source = std::to_string(files.size()) + " file(s)";
+    if (fens.empty()) {
+        fens = Bench::positions();
+        source = "the bench set";
+    }
+
+    std::vector<StateInfo> states;
+    std::vector<Position> corpus;
+    build_corpus(fens, states, corpus);
+
+    std::cout << "Corpus: " << corpus.size() << " positions from " << source << ", "
+              << config.samples << " samples of >= " << config.sampleMs << " ms" << std::endl;
+
+    std::vector<Result> results;
+    for (const Kernel& kernel : kernels()) {
+        if (!config.kernels.empty() &&
+            std::find(config.kernels.begin(), config.kernels.end(), kernel.name) == config.kernels.end()) {
+            continue;
+        }
+        results.push_back(measure(kernel, corpus, config));
+    }
+    return results;
+}
+
+void print(const std::vector<Result>& results) {
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    ss << std::left << std::setw(16) << "kernel" << std::right
+       << std::setw(10) << "ops/pass" << std::setw(12) << "ns/op" << std::setw(12) << "median"
+       << std::setw(12) << "ticks/op" << "\n";
+    for (const Result& r : results) {
+        ss << std::left << std::setw(16) << r.kernel << std::right
+           << std::setw(10) << r.opsPerPass << std::setw(12) << r.nsPerOp << std::setw(12) << r.medianNsPerOp
+           << std::setw(12) << r.ticksPerOp << "\n";
+    }
+    std::cout << ss.str() << std::flush;
+}
+
+Config parse_config(std::istringstream& is) {
+    Config config;
+    std::string token;
+
+    while (is >> token) {
+        if (token == "samples") {
+            is >> config.samples;
+        } else if (token == "ms") {
+            is >> config.sampleMs;
+        } else if (token == "kernel") {
+            std::string name;
+            if (is >> name) config.kernels.push_back(name);
+        } else {
+            config.files.push_back(token);
+        }
+    }
+
+    config.samples = std::max(1, config.samples);
+    config.sampleMs = std::max(1, config.sampleMs);
+
+    return config;
+}
+
+}
@@ -177,8 +177,182 @@ void MoveGen::generate_castling(const Board& board, MoveList& moves) {
     }
 }
 
+// Pushes and captures for the given pawns only; en passant is left to the caller.
+template<Color Us>
+void MoveGen::generate_legal_pawns(const Board& board, MoveList& moves, Bitboard pawns, Bitboard target) {
+    constexpr Color Them = (Us == WHITE) ? BLACK : WHITE;
+    constexpr Direction Up = (Us == WHITE) ? NORTH : SOUTH;
+    constexpr Direction UpLeft = (Us == WHITE) ? NORTH_WEST : SOUTH_WEST;
+    constexpr Direction UpRight = (Us == WHITE) ? NORTH_EAST : SOUTH_EAST;
+    constexpr Bitboard Rank3BB = (Us == WHITE) ? RANK_3_BB : RANK_6_BB;
+    constexpr Bitboard Rank7BB = (Us == WHITE) ? RANK_7_BB : RANK_2_BB;
+
+    Bitboard empty = ~board.pieces();
+    Bitboard enemies = board.pieces(Them) & target;
+    Bitboard pawns_on_7 = pawns & Rank7BB;
+    Bitboard pawns_not_7 = pawns & ~Rank7BB;
+
+    Bitboard push1 = shift<Up>(pawns_not_7) & empty;
+    Bitboard push2 = shift<Up>(push1 & Rank3BB) & empty & target;
+    push1 &= target;
+
+    while (push1) {
+        Square to = pop_lsb(push1);
+        moves.add(Move::make(to - Up, to));
+    }
+    while (push2) {
+        Square to = pop_lsb(push2);
+        moves.add(Move::make(to - Up - Up, to));
+    }
+
+    Bitboard cap_left = shift<UpLeft>(pawns_not_7) & enemies;
+    Bitboard cap_right = shift<UpRight>(pawns_not_7) & enemies;
+    while (cap_left) {
+        Square to = pop_lsb(cap_left);
+        moves.add(Move::make(to - UpLeft, to));
+    }
+    while (cap_right) {
+        Square to = pop_lsb(cap_right);
+        moves.add(Move::make(to - UpRight, to));
+    }
+
+    if (pawns_on_7) {
+        Bitboard promo_push = shift<Up>(pawns_on_7) & empty & target;
+        Bitboard promo_left = shift<UpLeft>(pawns_on_7) & enemies;
+        Bitboard promo_right = shift<UpRight>(pawns_on_7) & enemies;
+
+        while (promo_push) {
+            Square to = pop_lsb(promo_push);
+            add_promotions(moves, to - Up, to);
+        }
+        while (promo_left) {
+            Square to = pop_lsb(promo_left);
+            add_promotions(moves, to - UpLeft, to);
+        }
+        while (promo_right) {
+            Square to = pop_lsb(promo_right);
+            add_promotions(moves, to - UpRight, to);
+        }
+    }
+}
+
+template<Color Us, GenType Type>
+void MoveGen::generate_legal_moves(const Board& board, MoveList& moves) {
+    constexpr Color Them = (Us == WHITE) ? BLACK : WHITE;
+
+    const Square ksq = board.king_square(Us);
+    const Bitboard checkers = board.checkers();
+    const Bitboard occupied = board.pieces();
+
+    Bitboard typeMask = Type == CAPTURES ? board.pieces(Them)
+                      : Type == QUIETS   ? ~occupied
+                                         : ~board.pieces(Us);
+
+    // King first: it is the only piece that may move in double check. The
+    // attack map sees the board with the king on it, so the squares a
+    // checking slider would reach through the king are removed separately.
+    Bitboard kingTargets = king_attacks_bb(ksq) & typeMask;
+    Bitboard sliderCheckers = checkers & ~board.pieces(PAWN, KNIGHT);
+    while (sliderCheckers) {
+        Square c = pop_lsb(sliderCheckers);
+        kingTargets &= ~(line_bb(c, ksq) & ~between_bb(c, ksq) & ~square_bb(c));
+    }
+    while (kingTargets) {
+        Square to = pop_lsb(kingTargets);
+        if (!(board.attackers_to(to) & board.pieces(Them))) {
+            moves.add(Move::make(ksq, to));
+        }
+    }
+
+    if (more_than_one(checkers)) return;
+
+    // Blockers may over-approximate pins (snipers are removed from the
+    // occupancy), but staying on the king line is always legal for them.
+    const Bitboard checkMask = checkers ? between_bb(ksq, lsb(checkers)) | checkers : FULL_BB;
+    const Bitboard target = typeMask & checkMask;
+    const Bitboard pinned = board.blockers_for_king(Us) & board.pieces(Us);
+
+    Bitboard pawns = board.pieces(Us, PAWN);
+    generate_legal_pawns<Us>(board, moves, pawns & ~pinned, target);
+    Bitboard pinnedPawns = pawns & pinned;
+    while (pinnedPawns) {
+        Square from = pop_lsb(pinnedPawns);
+        generate_legal_pawns<Us>(board, moves, square_bb(from), target & line_bb(ksq, from));
+    }
+
+    Square ep = board.en_passant_square();
+    if (Type != QUIETS && ep != SQ_NONE) {
+        Square captured = ep - pawn_push(Us);
+        if (!checkers || (checkers & captured) || (checkMask & ep)) {
+            Bitboard epPawns = pawn_attacks_bb(Them, ep) & pawns;
+            while (epPawns) {
+                Square from = pop_lsb(epPawns);
+                Bitboard after = (occupied ^ from ^ captured) | ep;
+                if (!(rook_attacks_bb(ksq, after) & board.pieces(Them, ROOK, QUEEN)) &&
+                    !(bishop_attacks_bb(ksq, after) & board.pieces(Them, BISHOP, QUEEN))) {
+                    moves.add(Move::make_enpassant(from, ep));
+                }
+            }
+        }
+    }
+
+    if (Type != CAPTURES && !checkers) {
+        generate_castling<Us>(board, moves);
+    }
+
+    Bitboard pieces = board.pieces(Us) & ~board.pieces(Us, PAWN, KING);
+    while (pieces) {
+        Square from = pop_lsb(pieces);
+        PieceType pt = type_of(board.piece_on(from));
+        Bitboard attacks = attacks_bb(pt, from, occupied) & target;
+        if (pinned & from) attacks &= line_bb(ksq, from);
+
+        while (attacks) {
+            moves.add(Move::make(from, pop_lsb(attacks)));
+        }
+    }
+}
+
+template<GenType Type>
+void MoveGen::generate(const Board& board, MoveList& moves) {
+    static_assert(Type == CAPTURES || Type == QUIETS || Type == LEGAL, "unsupported GenType");
+#ifdef PROFILING
+    constexpr Profiler::Timer timer = Type == CAPTURES ? Profiler::T_GENERATE_CAPTURES
+                                    : Type == QUIETS   ? Profiler::T_GENERATE_QUIETS
+                                                       : Profiler::T_GENERATE_LEGAL;
+    Profiler::Scope<timer> profilerScope;
+#endif
+    if (board.side_to_move() == WHITE) {
+        generate_legal_moves<WHITE, Type>(board, moves);
+    } else {
+        generate_legal_moves<BLACK, Type>(board, moves);
+    }
+}
+
+template void MoveGen::generate<CAPTURES>(const Board&, MoveList&);
+template void MoveGen::generate<QUIETS>(const Board&, MoveList&);
+template void MoveGen::generate<LEGAL>(const Board&, MoveList&);
+
+U64 MoveGen::perft(Board& board, int depth) {
+    if (depth == 0) return 1;
+
+    MoveList moves;
+    generate<LEGAL>(board, moves);
+    if (depth == 1) return U64(moves.size());
+
+    U64 nodes = 0;
+    for (int i = 0; i < moves.size(); ++i) {
+        Move m = moves[i].move;
+        StateInfo si;
+        board.do_move(m, si);
+        nodes += perft(board, depth - 1);
+        board.undo_move(m);
+    }
+    return nodes;
+}
+
 void MoveGen::generate_all(const Board& board, MoveList& moves) {
-    PROFILE_SCOPE("generate_all");
+    PROFILE_SCOPE(GENERATE_ALL);
     Color us = board.side_to_move();
     Bitboard target = ~board.pieces(us);
 
@@ -198,7 +372,7 @@ void MoveGen::generate_all(const Board& board, MoveList& moves) {
 }
 
 void MoveGen::generate_captures(const Board& board, MoveList& moves) {
-    PROFILE_SCOPE("generate_captures");
+    PROFILE_SCOPE(GENERATE_CAPTURES);
     Color us = board.side_to_move();
     Color them = ~us;
     Bitboard target = board.pieces(them);
@@ -217,7 +391,7 @@ void MoveGen::generate_captures(const Board& board, MoveList& moves) {
 }
 
 void MoveGen::generate_quiets(const Board& board, MoveList& moves) {
-    PROFILE_SCOPE("generate_quiets");
+    PROFILE_SCOPE(GENERATE_QUIETS);
     Color us = board.side_to_move();
     Bitboard target = ~board.pieces();
 
@@ -497,21 +671,7 @@ bool MoveGen::is_legal(const Board& board, Move m) {
 }
 
 void MoveGen::generate_legal(const Board& board, MoveList& moves) {
-    PROFILE_SCOPE("generate_legal");
-    if (board.in_check()) {
-        generate_evasions(board, moves);
-    } else {
-        generate_all(board, moves);
-    }
-
-    int legal_count = 0;
-    for (int i = 0; i < moves.size(); ++i) {
-        if (is_legal(board, moves[i].move)) {
-            moves[legal_count++] = moves[i];
-        }
-    }
-
-    moves.resize(legal_count);
+    generate<LEGAL>(board, moves);
 }
 
 bool MoveGen::gives_check(const Board& board, Move m) {
@@ -572,9 +732,8 @@ bool MoveGen::is_pseudo_legal(const Board& board, Move m) {
         Direction push = pawn_push(us);
         Rank to_rank = rank_of(to);
 
-        if (m.is_promotion()) {
-            if (us == WHITE && to_rank != RANK_8) return false;
-            if (us == BLACK && to_rank != RANK_1) return false;
+        if (m.is_castling() || m.is_promotion() != (to_rank == (us == WHITE ? RANK_8 : RANK_1))) {
+            return false;
         }
 
         if (m.is_enpassant()) {
@@ -612,6 +771,8 @@ bool MoveGen::is_pseudo_legal(const Board& board, Move m) {
         return false;
     }
 
+    if (!m.is_normal()) return false;
+
     Bitboard attacks = attacks_bb(pt, from, board.pieces());
     return attacks & to;
 }
@@ -3,49 +3,40 @@
 #include "magic.hpp"
 #include "profiler.hpp"
 #include "optimize.hpp"
+#include <algorithm>
+#include <memory>
+#include <vector>
 
-PieceType SEE::min_attacker(const Board& board, Color side, Square sq,
-                            Bitboard occupied, Bitboard& attackers) {
-    for (PieceType pt = PAWN; pt <= KING; ++pt) {
-        Bitboard bb;
-
-        switch (pt) {
-            case PAWN:
-                bb = pawn_attacks_bb(~side, sq) & board.pieces(side, PAWN);
-                break;
-            case KNIGHT:
-                bb = knight_attacks_bb(sq) & board.pieces(side, KNIGHT);
-                break;
-            case BISHOP:
-                bb = bishop_attacks_bb(sq, occupied) & board.pieces(side, BISHOP);
-                break;
-            case ROOK:
-                bb = rook_attacks_bb(sq, occupied) & board.pieces(side, ROOK);
-                break;
-            case QUEEN:
-                bb = queen_attacks_bb(sq, occupied) & board.pieces(side, QUEEN);
-                break;
-            case KING:
-                bb = king_attacks_bb(sq) & board.pieces(side, KING);
-                break;
-            default:
-                bb = EMPTY_BB;
-                break;
-        }
-
-        bb &= occupied;
+namespace {
 
-        if (bb) {
-            attackers = bb;
-            return pt;
-        }
+// Sliders behind `sq` that start hitting `to` once `sq` leaves `occupied`.
+inline Bitboard xray_attackers(const Board& board, Square to, Square sq, Bitboard occupied) {
+    if (!line_bb(to, sq)) return EMPTY_BB;
+    if (file_of(to) == file_of(sq) || rank_of(to) == rank_of(sq)) {
+        return rook_attacks_bb(to, occupied) & board.pieces(ROOK, QUEEN);
     }
+    return bishop_attacks_bb(to, occupied) & board.pieces(BISHOP, QUEEN);
+}
+
+}
+
+PieceType SEE::min_attacker(const Board& board, Color side, Square to,
+                            Bitboard& occupied, Bitboard& attackers) {
+    Bitboard ours = attackers & board.pieces(side);
+    if (!ours) return NO_PIECE_TYPE;
+
+    PieceType pt = PAWN;
+    Bitboard bb;
+    while (!(bb = ours & board.pieces(pt))) ++pt;
 
-    return NO_PIECE_TYPE;
+    Square sq = lsb(bb);
+    occupied ^= square_bb(sq);
+    attackers = (attackers | xray_attackers(board, to, sq, occupied)) & occupied;
+    return pt;
 }
 
 int SEE::evaluate(const Board& board, Move m) {
-    PROFILE_SCOPE("SEE::evaluate");
+    PROFILE_SCOPE(SEE);
     Square from = m.from();
     Square to = m.to();
 
@@ -69,13 +60,18 @@ int SEE::evaluate(const Board& board, Move m) {
     occupied ^= square_bb(from);
     occupied |= square_bb(to);
 
+    // Start from the attack map and patch in what moving `from` uncovers;
+    // en passant also clears a second square, so recompute that case.
+    Bitboard attackers;
     if (m.is_enpassant()) {
         Square ep_sq = to - pawn_push(board.side_to_move());
         occupied ^= square_bb(ep_sq);
+        attackers = board.attackers_to(to, occupied) & occupied;
+    } else {
+        attackers = (board.attackers_to(to) | xray_attackers(board, to, from, occupied)) & occupied;
     }
 
     Color side = ~board.side_to_move();
-    Bitboard attackers_bb;
 
     while (true) {
         ++depth;
@@ -85,15 +81,12 @@ int SEE::evaluate(const Board& board, Move m) {
             break;
         }
 
-        attacker = min_attacker(board, side, to, occupied, attackers_bb);
+        attacker = min_attacker(board, side, to, occupied, attackers);
 
         if (attacker == NO_PIECE_TYPE) {
             break;
         }
 
-        Square attacker_sq = lsb(attackers_bb);
-        occupied ^= square_bb(attacker_sq);
-
         side = ~side;
     }
 
@@ -132,19 +125,53 @@ bool SEE::see_ge(const Board& board, Move m, int threshold) {
     return evaluate(board, m) >= threshold;
 }
 
+namespace {
+
+// Pickers nest strictly (one per node, singular/verification searches open
+// another at the same ply), so their buffers form a per-thread stack. The
+// slots are allocated in contiguous chunks once and then reused, keeping
+// the buffers of the current line hot in cache.
+class PickerBufferStack {
+public:
+    MoveList& acquire() {
+        if (top == capacity) {
+            chunks.push_back(std::make_unique<MoveList[]>(CHUNK_SLOTS));
+            capacity += CHUNK_SLOTS;
+        }
+        MoveList& list = chunks[top / CHUNK_SLOTS][top % CHUNK_SLOTS];
+        ++top;
+        list.clear();
+        return list;
+    }
+
+    void release() { --top; }
+
+private:
+    static constexpr int CHUNK_SLOTS = 64;
+    std::vector<std::unique_ptr<MoveList[]>> chunks;
+    int top = 0;
+    int capacity = 0;
+};
+
+thread_local PickerBufferStack pickerBuffers;
+
+}
+
 MovePicker::MovePicker(const Board& b, const Move* tm, int count, int p,
                        const KillerTable& kt, const CounterMoveTable& cm,
                        const HistoryTable& ht, Move prevMove,
                        const ContinuationHistoryEntry* contHist1,
                        const ContinuationHistoryEntry* contHist2,
-                       const CaptureHistory* ch)
+                       const CaptureHistory* ch, int d)
     : board(b), history(ht), killers(&kt), counterMoves(&cm),
       contHist1ply(contHist1), contHist2ply(contHist2),
       captureHist(ch),
-      ttMoveCount(count), ttMoveIdx(0), quietCheckCount(0), currentIdx(0), equalCaptureIdx(0), quietCheckIdx(0),
-      badCaptureIdx(0), ply(p), stage(STAGE_TT_MOVE) {
+      ttMoveCount(count), ttMoveIdx(0), moves(pickerBuffers.acquire()),
+      captureEnd(0), badBegin(0), badEnd(0), checkBegin(0), checkEnd(0), equalEnd(0), quietBegin(0),
+      sortedEnd(0), quietCheckCount(0), currentIdx(0), equalCaptureIdx(0), quietCheckIdx(0),
+      badCaptureIdx(0), ply(p), depth(d), stage(STAGE_TT_MOVE) {
 
-    for (int i = 0; i < 3; ++i) {
+    for (int i = 0; i < MAX_TT_MOVES; ++i) {
         ttMoves[i] = (i < count) ? tm[i] : MOVE_NONE;
     }
 
@@ -163,10 +190,12 @@ MovePicker::MovePicker(const Board& b, const Move* tm, int count, const HistoryT
     : board(b), history(ht), killers(nullptr), counterMoves(nullptr),
       contHist1ply(nullptr), contHist2ply(nullptr), captureHist(nullptr),
       ttMoveCount(count), ttMoveIdx(0), killer1(MOVE_NONE), killer2(MOVE_NONE),
-      counterMove(MOVE_NONE), quietCheckCount(0), currentIdx(0), badCaptureIdx(0), ply(0),
-      stage(STAGE_QS_TT_MOVE) {
+      counterMove(MOVE_NONE), moves(pickerBuffers.acquire()),
+      captureEnd(0), badBegin(0), badEnd(0), checkBegin(0), checkEnd(0), equalEnd(0), quietBegin(0),
+      sortedEnd(0), quietCheckCount(0), currentIdx(0), equalCaptureIdx(0), quietCheckIdx(0), badCaptureIdx(0),
+      ply(0), depth(0), stage(STAGE_QS_TT_MOVE) {
 
-    for (int i = 0; i < 3; ++i) {
+    for (int i = 0; i < MAX_TT_MOVES; ++i) {
         ttMoves[i] = (i < count) ? tm[i] : MOVE_NONE;
     }
 }
@@ -176,14 +205,20 @@ MovePicker::MovePicker(const Board& b, const Move* tm, int count, const HistoryT
     : board(b), history(ht), killers(nullptr), counterMoves(nullptr),
       contHist1ply(nullptr), contHist2ply(nullptr), captureHist(ch),
       ttMoveCount(count), ttMoveIdx(0), killer1(MOVE_NONE), killer2(MOVE_NONE),
-      counterMove(MOVE_NONE), quietCheckCount(0), currentIdx(0), badCaptureIdx(0), ply(0),
-      stage(STAGE_QS_TT_MOVE) {
+      counterMove(MOVE_NONE), moves(pickerBuffers.acquire()),
+      captureEnd(0), badBegin(0), badEnd(0), checkBegin(0), checkEnd(0), equalEnd(0), quietBegin(0),
+      sortedEnd(0), quietCheckCount(0), currentIdx(0), equalCaptureIdx(0), quietCheckIdx(0), badCaptureIdx(0),
+      ply(0), depth(0), stage(STAGE_QS_TT_MOVE) {
 
-    for (int i = 0; i < 3; ++i) {
+    for (int i = 0; i < MAX_TT_MOVES; ++i) {
         ttMoves[i] = (i < count) ? tm[i] : MOVE_NONE;
     }
 }
 
+MovePicker::~MovePicker() {
+    pickerBuffers.release();
+}
+
 bool MovePicker::is_tt_move(Move m) const {
     for (int i = 0; i < ttMoveCount; ++i) {
         if (ttMoves[i] == m) return true;
@@ -199,9 +234,10 @@ bool MovePicker::is_quiet_check(Move m) const {
 }
 
 void MovePicker::score_captures() {
-    PROFILE_SCOPE("score_captures");
+    PROFILE_SCOPE(SCORE_CAPTURES);
 
-    const int moveCount = static_cast<int>(moves.size());
+    const int moveCount = captureEnd;
+    const bool keepBadCaptures = stage < STAGE_QS_TT_MOVE;
 
     for (int idx = 0; idx < moveCount; ++idx) {
         auto& sm = moves[idx];
@@ -295,7 +331,7 @@ void MovePicker::score_captures() {
                 if (captureHist && captured != NO_PIECE) {
                     sm.score += captureHist->get(attacker, m.to(), capturedPt) / 64;
                 }
-                badCaptures.add(m, sm.score);
+                if (keepBadCaptures) moves.add(m, sm.score);
             }
         }
         }
@@ -303,21 +339,48 @@ void MovePicker::score_captures() {
 }
 
 void MovePicker::score_quiets() {
-    PROFILE_SCOPE("score_quiets");
+    PROFILE_SCOPE(SCORE_QUIETS);
     Color us = board.side_to_move();
 
-    const int moveCount = static_cast<int>(moves.size());
+    const int begin = quietBegin;
+    const int count = moves.size() - begin;
 
-    for (int idx = 0; idx < moveCount; ++idx) {
-        auto& sm = moves[idx];
-        Move m = sm.move;
-        Piece pc = board.piece_on(m.from());
-        PieceType pt = type_of(pc);
+    // Gather pass: resolve every table slot first and prefetch it, so the
+    // loads below overlap instead of missing one move at a time.
+    const S16* histSlot[MoveList::MAX_MOVES];
+    const S16* cont1Slot[MoveList::MAX_MOVES];
+    const S16* cont2Slot[MoveList::MAX_MOVES];
+    PieceType movedType[MoveList::MAX_MOVES];
+    static const S16 zeroSlot = 0;
+
+    for (int i = 0; i < count; ++i) {
+        Move m = moves[begin + i].move;
+        PieceType pt = type_of(board.piece_on(m.from()));
         Square to = m.to();
 
-        if (idx + 2 < moveCount) {
-            PREFETCH_READ(&moves[idx + 2]);
-        }
+        movedType[i] = pt;
+        histSlot[i] = history.entry(us, m);
+        cont1Slot[i] = contHist1ply ? contHist1ply->entry(pt, to) : &zeroSlot;
+        cont2Slot[i] = contHist2ply ? contHist2ply->entry(pt, to) : &zeroSlot;
+
+        PREFETCH_READ(histSlot[i]);
+        PREFETCH_READ(cont1Slot[i]);
+        PREFETCH_READ(cont2Slot[i]);
+    }
+
+    // Branch-free combine over the gathered slots.
+    int score[MoveList::MAX_MOVES];
+    for (int i = 0; i < count; ++i) {
+        score[i] = *histSlot[i] + 2 * *cont1Slot[i] + *cont2Slot[i];
+    }
+
+    const Square enemyKingSq = board.king_square(~us);
+    const Bitboard kingTargets = king_attacks_bb(enemyKingSq) | square_bb(enemyKingSq);
+
+    for (int i = 0; i < count; ++i) {
+        auto& sm = moves[begin + i];
+        Move m = sm.move;
+        PieceType pt = movedType[i];
 
         if (m == killer1) {
             sm.score = SCORE_KILLER_1;
@@ -326,29 +389,12 @@ void MovePicker::score_quiets() {
         } else if (m == counterMove) {
             sm.score = SCORE_COUNTER;
         } else {
-            int histScore = history.get(us, m);
-
-            int contHist1Score = 0;
-            int contHist2Score = 0;
-
-            if (contHist1ply) {
-                contHist1Score = contHist1ply->get(pt, to);
-            }
-
-            if (contHist2ply) {
-                contHist2Score = contHist2ply->get(pt, to);
-            }
-
-            sm.score = histScore + 2 * contHist1Score + contHist2Score;
+            sm.score = score[i];
         }
 
         if (pt == QUEEN || pt == ROOK) {
-            Square enemyKingSq = board.king_square(~us);
-            Bitboard kingZone = king_attacks_bb(enemyKingSq);
             Bitboard newOccupied = board.pieces() ^ square_bb(m.from());
-            Bitboard attacksAfter = attacks_bb(pt, to, newOccupied);
-
-            if (attacksAfter & (kingZone | square_bb(enemyKingSq))) {
+            if (attacks_bb(pt, m.to(), newOccupied) & kingTargets) {
                 sm.score += 5000;
             }
         }
@@ -368,10 +414,29 @@ void MovePicker::score_quiets() {
     }
 }
 
+// Sorts, in descending order, only the moves scoring at least `limit` to the
+// front of [begin, end); everything left behind scores below all of them.
+void MovePicker::partial_insertion_sort(int begin, int end, int limit) {
+    sortedEnd = begin;
+    for (int p = begin; p < end; ++p) {
+        if (moves[p].score < limit) continue;
+
+        ScoredMove tmp = moves[p];
+        moves[p] = moves[sortedEnd];
+        int q = sortedEnd;
+        for (; q > begin && moves[q - 1].score < tmp.score; --q) {
+            moves[q] = moves[q - 1];
+        }
+        moves[q] = tmp;
+        ++sortedEnd;
+    }
+}
+
 void MovePicker::score_quiet_checks() {
     Color us = board.side_to_move();
 
-    for (auto& sm : quietChecks) {
+    for (int idx = checkBegin; idx < checkEnd; ++idx) {
+        auto& sm = moves[idx];
         Move m = sm.move;
         Piece pc = board.piece_on(m.from());
         PieceType pt = type_of(pc);
@@ -391,22 +456,32 @@ void MovePicker::score_quiet_checks() {
     }
 }
 
-Move MovePicker::pick_best() {
-    if (currentIdx >= moves.size()) {
+Move MovePicker::pick_best(int end) {
+    if (currentIdx >= end) {
         return MOVE_NONE;
     }
-    return moves.pick_best(currentIdx++);
+
+    int best = currentIdx;
+    for (int i = currentIdx + 1; i < end; ++i) {
+        if (moves[i].score > moves[best].score) {
+            best = i;
+        }
+    }
+    if (best != currentIdx) {
+        std::swap(moves[currentIdx], moves[best]);
+    }
+    return moves[currentIdx++].move;
 }
 
 Move MovePicker::next_move() {
-    PROFILE_SCOPE("next_move");
+    PROFILE_SCOPE(NEXT_MOVE);
     Move m;
 
     switch (stage) {
         case STAGE_TT_MOVE:
             while (ttMoveIdx < ttMoveCount) {
                 m = ttMoves[ttMoveIdx++];
-                if (m && MoveGen::is_pseudo_legal(board, m)) {
+                if (m && MoveGen::is_pseudo_legal(board, m) && MoveGen::is_legal(board, m)) {
                     return m;
                 }
             }
@@ -414,15 +489,17 @@ Move MovePicker::next_move() {
             [[fallthrough]];
 
         case STAGE_GENERATE_CAPTURES:
-            MoveGen::generate_captures(board, moves);
+            MoveGen::generate<CAPTURES>(board, moves);
+            captureEnd = badBegin = moves.size();
             score_captures();
+            badEnd = moves.size();
             currentIdx = 0;
             ++stage;
             [[fallthrough]];
 
         case STAGE_WINNING_CAPTURES:
-            while (currentIdx < moves.size()) {
-                m = pick_best();
+            while (currentIdx < captureEnd) {
+                m = pick_best(captureEnd);
                 if (is_tt_move(m)) continue;
 
                 if (moves[currentIdx - 1].score <= SCORE_EQUAL_CAP + EQUAL_CAP_QUEEN_BONUS) {
@@ -435,31 +512,31 @@ Move MovePicker::next_move() {
 
         case STAGE_GENERATE_QUIET_CHECKS:
             {
-                quietChecks.clear();
                 quietCheckCount = 0;
-                MoveGen::generate_checking_moves(board, quietChecks);
-
-                MoveList filteredChecks;
-                for (size_t i = 0; i < quietChecks.size(); ++i) {
-                    Move qm = quietChecks[i].move;
-                    if (!is_tt_move(qm)) {
-                        filteredChecks.add(qm, 0);
+                checkBegin = moves.size();
+                MoveGen::generate_checking_moves(board, moves);
+
+                checkEnd = checkBegin;
+                for (int i = checkBegin; i < moves.size(); ++i) {
+                    Move qm = moves[i].move;
+                    if (!is_tt_move(qm) && MoveGen::is_legal(board, qm)) {
+                        moves[checkEnd++] = ScoredMove(qm, 0);
                         if (quietCheckCount < MAX_QUIET_CHECKS) {
                             quietCheckMoves[quietCheckCount++] = qm;
                         }
                     }
                 }
-                quietChecks = filteredChecks;
+                moves.resize(checkEnd);
 
                 score_quiet_checks();
-                quietCheckIdx = 0;
+                quietCheckIdx = checkBegin;
             }
             ++stage;
             [[fallthrough]];
 
         case STAGE_QUIET_CHECKS:
-            while (quietCheckIdx < quietChecks.size()) {
-                m = quietChecks[quietCheckIdx++].move;
+            while (quietCheckIdx < checkEnd) {
+                m = moves[quietCheckIdx++].move;
                 if (is_tt_move(m)) continue;
                 if (m == killer1 || m == killer2 || m == counterMove) continue;
                 return m;
@@ -470,7 +547,7 @@ Move MovePicker::next_move() {
         case STAGE_KILLER_1:
             ++stage;
             if (killer1 && !is_tt_move(killer1) &&
-                MoveGen::is_pseudo_legal(board, killer1) &&
+                MoveGen::is_pseudo_legal(board, killer1) && MoveGen::is_legal(board, killer1) &&
                 board.empty(killer1.to())) {
                 return killer1;
             }
@@ -479,7 +556,7 @@ Move MovePicker::next_move() {
         case STAGE_KILLER_2:
             ++stage;
             if (killer2 && !is_tt_move(killer2) &&
-                MoveGen::is_pseudo_legal(board, killer2) &&
+                MoveGen::is_pseudo_legal(board, killer2) && MoveGen::is_legal(board, killer2) &&
                 board.empty(killer2.to())) {
                 return killer2;
             }
@@ -489,34 +566,44 @@ Move MovePicker::next_move() {
             ++stage;
             if (counterMove && !is_tt_move(counterMove) &&
                 counterMove != killer1 && counterMove != killer2 &&
-                MoveGen::is_pseudo_legal(board, counterMove) &&
+                MoveGen::is_pseudo_legal(board, counterMove) && MoveGen::is_legal(board, counterMove) &&
                 board.empty(counterMove.to())) {
                 return counterMove;
             }
             [[fallthrough]];
 
         case STAGE_GENERATE_QUIETS:
-            equalCaptures.clear();
-            for (size_t i = currentIdx; i < moves.size(); ++i) {
-                if (moves[i].score >= SCORE_EQUAL_CAP &&
-                    moves[i].score < SCORE_WINNING_CAP &&
-                    !is_tt_move(moves[i].move)) {
-                    equalCaptures.add(moves[i].move, moves[i].score);
+            {
+                // Repack in place: every write index trails its read index.
+                equalEnd = 0;
+                for (int i = currentIdx; i < captureEnd; ++i) {
+                    if (moves[i].score >= SCORE_EQUAL_CAP &&
+                        moves[i].score < SCORE_WINNING_CAP &&
+                        !is_tt_move(moves[i].move)) {
+                        moves[equalEnd++] = moves[i];
+                    }
                 }
-            }
 
-            moves.clear();
-            MoveGen::generate_quiets(board, moves);
-            score_quiets();
-            currentIdx = 0;
-            equalCaptureIdx = 0;
-            badCaptureIdx = 0;
+                int badCount = badEnd - badBegin;
+                std::copy(&moves[badBegin], &moves[badBegin] + badCount, &moves[equalEnd]);
+                badBegin = equalEnd;
+                badEnd = badBegin + badCount;
+
+                moves.resize(badEnd);
+                quietBegin = badEnd;
+                MoveGen::generate<QUIETS>(board, moves);
+                score_quiets();
+                partial_insertion_sort(quietBegin, moves.size(), QUIET_SORT_LIMIT_PER_DEPTH * depth);
+                currentIdx = quietBegin;
+                equalCaptureIdx = 0;
+                badCaptureIdx = badBegin;
+            }
             ++stage;
             [[fallthrough]];
 
         case STAGE_EQUAL_CAPTURES:
-            while (equalCaptureIdx < equalCaptures.size()) {
-                m = equalCaptures[equalCaptureIdx++].move;
+            while (equalCaptureIdx < equalEnd) {
+                m = moves[equalCaptureIdx++].move;
                 if (is_tt_move(m)) continue;
                 return m;
             }
@@ -525,7 +612,7 @@ Move MovePicker::next_move() {
 
         case STAGE_QUIETS:
             while (currentIdx < moves.size()) {
-                m = pick_best();
+                m = currentIdx < sortedEnd ? moves[currentIdx++].move : pick_best(moves.size());
                 if (is_tt_move(m) || m == killer1 || m == killer2 || m == counterMove) {
                     continue;
                 }
@@ -537,8 +624,8 @@ Move MovePicker::next_move() {
             [[fallthrough]];
 
         case STAGE_BAD_CAPTURES:
-            while (badCaptureIdx < badCaptures.size()) {
-                m = badCaptures[badCaptureIdx++].move;
+            while (badCaptureIdx < badEnd) {
+                m = moves[badCaptureIdx++].move;
                 if (is_tt_move(m)) continue;
                 return m;
             }
@@ -551,7 +638,7 @@ Move MovePicker::next_move() {
         case STAGE_QS_TT_MOVE:
             while (ttMoveIdx < ttMoveCount) {
                 m = ttMoves[ttMoveIdx++];
-                if (m && MoveGen::is_pseudo_legal(board, m)) {
+                if (m && MoveGen::is_pseudo_legal(board, m) && MoveGen::is_legal(board, m)) {
                     return m;
                 }
             }
@@ -559,14 +646,15 @@ Move MovePicker::next_move() {
             [[fallthrough]];
 
         case STAGE_QS_GENERATE_CAPTURES:
-            MoveGen::generate_captures(board, moves);
+            MoveGen::generate<CAPTURES>(board, moves);
+            captureEnd = moves.size();
             score_captures();
             ++stage;
             [[fallthrough]];
 
         case STAGE_QS_CAPTURES:
-            while (currentIdx < moves.size()) {
-                m = pick_best();
+            while (currentIdx < captureEnd) {
+                m = pick_best(captureEnd);
                 if (is_tt_move(m)) continue;
                 return m;
             }
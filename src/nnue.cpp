@@ -0,0 +1,285 @@
+#include "nnue.hpp"
+#include "board.hpp"
+#include "optimize.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#if defined(__AVX512BW__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(NNUE_EMBEDDED_FILE)
+#if defined(_WIN32)
+#define NNUE_SECTION ".section .rdata"
+#else
+#define NNUE_SECTION ".section .rodata"
+#endif
+asm(NNUE_SECTION "\n"
+    ".balign 64\n"
+    ".global gcEmbeddedNet\n"
+    "gcEmbeddedNet:\n"
+    ".incbin \"" NNUE_EMBEDDED_FILE "\"\n"
+    ".global gcEmbeddedNetEnd\n"
+    "gcEmbeddedNetEnd:\n"
+    ".byte 0\n"
+    ".previous\n");
+extern "C" const unsigned char gcEmbeddedNet[];
+extern "C" const unsigned char gcEmbeddedNetEnd[];
+#endif
+
+namespace NNUE {
+
+namespace {
+
+struct Network {
+    alignas(64) int16_t featureWeights[INPUT_SIZE * HIDDEN_SIZE];
+    alignas(64) int16_t featureBias[HIDDEN_SIZE];
+    alignas(64) int16_t outputWeights[2 * HIDDEN_SIZE];
+    int16_t outputBias;
+};
+
+// Raw file size: the struct itself carries alignment padding.
+constexpr size_t NETWORK_BYTES =
+    sizeof(int16_t) * (INPUT_SIZE * HIDDEN_SIZE + HIDDEN_SIZE + 2 * HIDDEN_SIZE + 1);
+
+// Walking further back than this costs more than a refresh.
+constexpr int MAX_UPDATE_PLIES = 16;
+
+std::unique_ptr<Network> net;
+std::string netName;
+bool useNNUE = false;
+
+bool read_network(const unsigned char* data, size_t size) {
+    if (size < NETWORK_BYTES) return false;
+
+    auto n = std::make_unique<Network>();
+    const unsigned char* p = data;
+    auto read = [&p](int16_t* dst, size_t count) {
+        std::memcpy(dst, p, count * sizeof(int16_t));
+        p += count * sizeof(int16_t);
+    };
+    read(n->featureWeights, INPUT_SIZE * HIDDEN_SIZE);
+    read(n->featureBias, HIDDEN_SIZE);
+    read(n->outputWeights, 2 * HIDDEN_SIZE);
+    read(&n->outputBias, 1);
+
+    net = std::move(n);
+    return true;
+}
+
+inline int feature_index(Color perspective, Piece pc, Square sq) {
+    Color c = color_of(pc);
+    int s = perspective == WHITE ? int(sq) : int(sq) ^ 56;
+    return (c == perspective ? 0 : 384) + (type_of(pc) - 1) * 64 + s;
+}
+
+void refresh(const Board& board, Accumulator& acc) {
+    for (Color perspective : {WHITE, BLACK}) {
+        int16_t* out = acc.values[perspective];
+        std::memcpy(out, net->featureBias, sizeof(net->featureBias));
+
+        Bitboard occ = board.pieces();
+        while (occ) {
+            Square sq = pop_lsb(occ);
+            const int16_t* w = net->featureWeights
+                             + feature_index(perspective, board.piece_on(sq), sq) * HIDDEN_SIZE;
+            for (int i = 0; i < HIDDEN_SIZE; ++i) out[i] += w[i];
+        }
+    }
+    acc.computed = true;
+}
+
+// Fused copy-and-apply: reads the parent accumulator once and writes the child once.
+void update(const Accumulator& prev, StateInfo& st) {
+    const DirtyPiece& dp = st.dirtyPiece;
+
+    for (Color perspective : {WHITE, BLACK}) {
+        const int16_t* add[3];
+        const int16_t* sub[3];
+        int addCount = 0, subCount = 0;
+
+        for (int k = 0; k < dp.count; ++k) {
+            if (dp.from[k] != SQ_NONE)
+                sub[subCount++] = net->featureWeights
+                                + feature_index(perspective, dp.piece[k], dp.from[k]) * HIDDEN_SIZE;
+            if (dp.to[k] != SQ_NONE)
+                add[addCount++] = net->featureWeights
+                                + feature_index(perspective, dp.piece[k], dp.to[k]) * HIDDEN_SIZE;
+        }
+
+        const int16_t* in = prev.values[perspective];
+        int16_t* out = st.accumulator.values[perspective];
+
+        if (addCount == 1 && subCount == 1) {
+            for (int i = 0; i < HIDDEN_SIZE; ++i) out[i] = in[i] + add[0][i] - sub[0][i];
+        } else if (addCount == 1 && subCount == 2) {
+            for (int i = 0; i < HIDDEN_SIZE; ++i) out[i] = in[i] + add[0][i] - sub[0][i] - sub[1][i];
+        } else {
+            std::memcpy(out, in, sizeof(int16_t) * HIDDEN_SIZE);
+            for (int a = 0; a < addCount; ++a)
+                for (int i = 0; i < HIDDEN_SIZE; ++i) out[i] += add[a][i];
+            for (int s = 0; s < subCount; ++s)
+                for (int i = 0; i < HIDDEN_SIZE; ++i) out[i] -= sub[s][i];
+        }
+    }
+    st.accumulator.computed = true;
+}
+
+void compute_accumulator(const Board& board) {
+    StateInfo* st = board.state();
+    if (st->accumulator.computed) return;
+
+    StateInfo* chain[MAX_UPDATE_PLIES];
+    int n = 0;
+    StateInfo* s = st;
+    while (!s->accumulator.computed && n < MAX_UPDATE_PLIES && s->previous) {
+        chain[n++] = s;
+        s = s->previous;
+    }
+
+    if (!s->accumulator.computed) {
+        refresh(board, st->accumulator);
+        return;
+    }
+
+    while (n > 0) {
+        StateInfo* next = chain[--n];
+        update(next->previous->accumulator, *next);
+    }
+}
+
+// CReLU(us) . w[0..H) + CReLU(them) . w[H..2H), accumulated in 32 bits.
+int output_layer(const int16_t* us, const int16_t* them, const int16_t* weights) {
+#if defined(__AVX512BW__)
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i qa = _mm512_set1_epi16(QA);
+    __m512i sum = _mm512_setzero_si512();
+    for (int side = 0; side < 2; ++side) {
+        const int16_t* in = side == 0 ? us : them;
+        const int16_t* w = weights + side * HIDDEN_SIZE;
+        for (int i = 0; i < HIDDEN_SIZE; i += 32) {
+            __m512i v = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(in + i));
+            v = _mm512_min_epi16(_mm512_max_epi16(v, zero), qa);
+            __m512i wv = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(w + i));
+            sum = _mm512_add_epi32(sum, _mm512_madd_epi16(v, wv));
+        }
+    }
+    alignas(64) int32_t lanes[16];
+    _mm512_store_si512(reinterpret_cast<__m512i*>(lanes), sum);
+    int total = 0;
+    for (int i = 0; i < 16; ++i) total += lanes[i];
+    return total;
+#elif defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i qa = _mm256_set1_epi16(QA);
+    __m256i sum = _mm256_setzero_si256();
+    for (int side = 0; side < 2; ++side) {
+        const int16_t* in = side == 0 ? us : them;
+        const int16_t* w = weights + side * HIDDEN_SIZE;
+        for (int i = 0; i < HIDDEN_SIZE; i += 16) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            v = _mm256_min_epi16(_mm256_max_epi16(v, zero), qa);
+            __m256i wv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, wv));
+        }
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+    return _mm_cvtsi128_si32(s);
+#elif defined(__ARM_NEON)
+    const int16x8_t zero = vdupq_n_s16(0);
+    const int16x8_t qa = vdupq_n_s16(QA);
+    int32x4_t sum = vdupq_n_s32(0);
+    for (int side = 0; side < 2; ++side) {
+        const int16_t* in = side == 0 ? us : them;
+        const int16_t* w = weights + side * HIDDEN_SIZE;
+        for (int i = 0; i < HIDDEN_SIZE; i += 8) {
+            int16x8_t v = vminq_s16(vmaxq_s16(vld1q_s16(in + i), zero), qa);
+            int16x8_t wv = vld1q_s16(w + i);
+            sum = vmlal_s16(sum, vget_low_s16(v), vget_low_s16(wv));
+            sum = vmlal_s16(sum, vget_high_s16(v), vget_high_s16(wv));
+        }
+    }
+    return vaddvq_s32(sum);
+#else
+    int sum = 0;
+    for (int side = 0; side < 2; ++side) {
+        const int16_t* in = side == 0 ? us : them;
+        const int16_t* w = weights + side * HIDDEN_SIZE;
+        for (int i = 0; i < HIDDEN_SIZE; ++i) {
+            sum += std::clamp<int>(in[i], 0, QA) * w[i];
+        }
+    }
+    return sum;
+#endif
+}
+
+}
+
+bool load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return false;
+
+    std::streamsize size = file.tellg();
+    if (size != std::streamsize(NETWORK_BYTES)) return false;
+
+    std::vector<unsigned char> data(static_cast<size_t>(size));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(data.data()), size)) return false;
+
+    if (!read_network(data.data(), data.size())) return false;
+    netName = path;
+    return true;
+}
+
+bool has_embedded() {
+#if defined(NNUE_EMBEDDED_FILE)
+    return size_t(gcEmbeddedNetEnd - gcEmbeddedNet) == NETWORK_BYTES;
+#else
+    return false;
+#endif
+}
+
+bool load_embedded() {
+#if defined(NNUE_EMBEDDED_FILE)
+    if (!has_embedded() || !read_network(gcEmbeddedNet, NETWORK_BYTES)) return false;
+    netName = "<embedded> " NNUE_EMBEDDED_FILE;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool is_loaded() {
+    return net != nullptr;
+}
+
+const std::string& network_name() {
+    return netName;
+}
+
+void set_enabled(bool on) {
+    useNNUE = on && is_loaded();
+}
+
+bool enabled() {
+    return useNNUE;
+}
+
+int evaluate(const Board& board) {
+    compute_accumulator(board);
+
+    const Accumulator& acc = board.state()->accumulator;
+    Color us = board.side_to_move();
+    int sum = output_layer(acc.values[us], acc.values[~us], net->outputWeights);
+
+    return (sum + net->outputBias) * SCALE / (QA * QB);
+}
+
+}
@@ -0,0 +1,113 @@
+#include "perfcounters.hpp"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+namespace PerfCounters {
+
+namespace {
+
+#if defined(__linux__)
+struct EventConfig {
+    uint32_t type;
+    uint64_t config;
+};
+
+constexpr EventConfig Events[EVENT_NB] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+                        | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES }
+};
+
+int open_event(const EventConfig& ev) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = ev.type;
+    attr.config = ev.config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+#endif
+
+}
+
+bool Sample::any() const {
+    for (bool v : valid) {
+        if (v) return true;
+    }
+    return false;
+}
+
+double Sample::ipc() const {
+    if (!valid[CYCLES] || !valid[INSTRUCTIONS] || values[CYCLES] == 0) return 0.0;
+    return double(values[INSTRUCTIONS]) / double(values[CYCLES]);
+}
+
+Group::Group() {
+    for (int i = 0; i < EVENT_NB; ++i) {
+#if defined(__linux__)
+        fds[i] = open_event(Events[i]);
+#else
+        fds[i] = -1;
+#endif
+    }
+}
+
+Group::~Group() {
+#if defined(__linux__)
+    for (int fd : fds) {
+        if (fd >= 0) close(fd);
+    }
+#endif
+}
+
+bool Group::available() const {
+    for (int fd : fds) {
+        if (fd >= 0) return true;
+    }
+    return false;
+}
+
+void Group::start() {
+#if defined(__linux__)
+    for (int fd : fds) {
+        if (fd < 0) continue;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+Sample Group::stop() {
+    Sample s;
+#if defined(__linux__)
+    for (int i = 0; i < EVENT_NB; ++i) {
+        if (fds[i] < 0) continue;
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+        uint64_t data[3];
+        if (read(fds[i], data, sizeof(data)) != ssize_t(sizeof(data)) || data[2] == 0) continue;
+
+        double scale = double(data[1]) / double(data[2]);
+        s.values[i] = uint64_t(double(data[0]) * scale);
+        s.valid[i] = true;
+    }
+#endif
+    return s;
+}
+
+}
@@ -0,0 +1,109 @@
+#include "perft.hpp"
+#include "movegen.hpp"
+#include <algorithm>
+#include <thread>
+
+namespace Perft {
+
+namespace {
+
+// Mixing the depth into the index lets one position's counts at different
+// depths live side by side instead of evicting each other.
+size_t slot_index(Key key, int depth, size_t mask) {
+    return size_t(key ^ (U64(depth) * 0x9E3779B97F4A7C15ULL)) & mask;
+}
+
+U64 count(Board& board, int depth, PerftTable* table) {
+    U64 cached;
+    if (depth > 1 && table && table->probe(board.key(), depth, cached)) return cached;
+
+    MoveList moves;
+    MoveGen::generate<LEGAL>(board, moves);
+    if (depth == 1) return U64(moves.size());
+
+    U64 nodes = 0;
+    for (int i = 0; i < moves.size(); ++i) {
+        Move m = moves[i].move;
+        StateInfo si;
+        board.do_move(m, si);
+        nodes += count(board, depth - 1, table);
+        board.undo_move(m);
+    }
+
+    if (table) table->store(board.key(), depth, nodes);
+    return nodes;
+}
+
+}
+
+void PerftTable::resize(size_t mb) {
+    slots.reset();
+    mask = 0;
+    if (mb == 0) return;
+
+    size_t n = 1;
+    while (n * 2 * sizeof(Slot) <= (mb << 20)) n *= 2;
+    slots = std::make_unique<Slot[]>(n);
+    mask = n - 1;
+}
+
+bool PerftTable::probe(Key key, int depth, U64& nodes) const {
+    const Slot& s = slots[slot_index(key, depth, mask)];
+    U64 data = s.data.load(std::memory_order_relaxed);
+    U64 check = s.check.load(std::memory_order_relaxed);
+    if ((check ^ data) != key || int(data & 0xFF) != depth) return false;
+    nodes = data >> 8;
+    return true;
+}
+
+void PerftTable::store(Key key, int depth, U64 nodes) {
+    Slot& s = slots[slot_index(key, depth, mask)];
+    U64 data = (nodes << 8) | U64(depth);
+    s.check.store(key ^ data, std::memory_order_relaxed);
+    s.data.store(data, std::memory_order_relaxed);
+}
+
+U64 perft(const Board& board, int depth, int threads, size_t hashMB, std::vector<RootCount>* divide) {
+    if (depth <= 0) return 1;
+
+    Board root = board;
+    MoveList moves;
+    MoveGen::generate<LEGAL>(root, moves);
+    if (depth == 1 && !divide) return U64(moves.size());
+
+    PerftTable table;
+    table.resize(hashMB);
+    PerftTable* tablePtr = table.enabled() ? &table : nullptr;
+
+    std::vector<U64> counts(moves.size(), 0);
+    std::atomic<int> next{0};
+
+    auto worker = [&] {
+        Board b = root;
+        while (true) {
+            int i = next.fetch_add(1);
+            if (i >= moves.size()) break;
+
+            Move m = moves[i].move;
+            StateInfo si;
+            b.do_move(m, si);
+            counts[i] = depth == 1 ? 1 : count(b, depth - 1, tablePtr);
+            b.undo_move(m);
+        }
+    };
+
+    threads = std::max(1, std::min(threads, moves.size()));
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (std::thread& t : pool) t.join();
+
+    U64 total = 0;
+    for (int i = 0; i < moves.size(); ++i) {
+        total += counts[i];
+        if (divide) divide->push_back({ moves[i].move, counts[i] });
+    }
+    return total;
+}
+
+}
@@ -0,0 +1,239 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Profiler {
+
+namespace {
+
+#define PROFILER_NAME(id, name) name,
+constexpr const char* TimerNames[TIMER_NB] = { PROFILER_TIMERS(PROFILER_NAME) };
+#undef PROFILER_NAME
+
+#define PROFILER_KEY(id) #id,
+constexpr const char* CounterKeys[COUNTER_NB] = { PROFILER_COUNTERS(PROFILER_KEY) };
+#undef PROFILER_KEY
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<Block*> live;
+    Block retired;
+
+    // Anchor for converting ticks to wall time.
+    uint64_t startTicks = now_ticks();
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    Registry() { retired.clear(); }
+};
+
+Registry& registry() {
+    static Registry reg;
+    return reg;
+}
+
+// Owns a thread's block; folds it into the retired totals when the thread exits.
+struct LocalHolder {
+    std::unique_ptr<Block> block = std::make_unique<Block>();
+
+    LocalHolder() {
+        block->clear();
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.live.push_back(block.get());
+    }
+
+    ~LocalHolder() {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.retired.merge(*block);
+        reg.live.erase(std::remove(reg.live.begin(), reg.live.end(), block.get()), reg.live.end());
+    }
+};
+
+double ticks_per_ns() {
+#ifdef PROFILER_HAS_TSC
+    Registry& reg = registry();
+    uint64_t ticks = now_ticks() - reg.startTicks;
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - reg.startTime).count();
+    return ns > 0 ? double(ticks) / double(ns) : 1.0;
+#else
+    return 1.0;
+#endif
+}
+
+double percent(uint64_t part, uint64_t whole) {
+    return whole ? part * 100.0 / whole : 0.0;
+}
+
+}
+
+void Block::clear() {
+    std::memset(this, 0, sizeof(Block));
+}
+
+void Block::merge(const Block& other) {
+    for (int i = 0; i < COUNTER_NB; ++i) counters[i] += other.counters[i];
+    for (int i = 0; i < TIMER_NB; ++i) {
+        ticks[i] += other.ticks[i];
+        calls[i] += other.calls[i];
+        maxTicks[i] = std::max(maxTicks[i], other.maxTicks[i]);
+    }
+}
+
+Block& local_slow() {
+    static thread_local LocalHolder holder;
+    return *holder.block;
+}
+
+Block merged() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    Block total = reg.retired;
+    for (const Block* b : reg.live) total.merge(*b);
+    return total;
+}
+
+void reset() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    reg.retired.clear();
+    for (Block* b : reg.live) b->clear();
+}
+
+void print_counters(std::ostream& os) {
+    Block total = merged();
+    const uint64_t* c = total.counters;
+
+    os << "info string profile";
+    for (int i = 0; i < COUNTER_NB; ++i) {
+        std::string key = CounterKeys[i];
+        std::transform(key.begin(), key.end(), key.begin(), [](unsigned char ch) { return char(std::tolower(ch)); });
+        os << " " << key << " " << c[i];
+    }
+    os << std::endl;
+
+    os << std::fixed << std::setprecision(1);
+    os << "Search nodes     : " << c[C_SEARCH_NODES] << std::endl;
+    os << "QSearch nodes    : " << c[C_QSEARCH_NODES] << " ("
+       << percent(c[C_QSEARCH_NODES], c[C_SEARCH_NODES] + c[C_QSEARCH_NODES]) << "% of all)" << std::endl;
+    os << "TT hit rate      : " << percent(c[C_TT_HITS], c[C_TT_PROBES]) << "% ("
+       << c[C_TT_HITS] << "/" << c[C_TT_PROBES] << ")" << std::endl;
+    os << "NMP cutoffs      : " << c[C_NMP_CUTOFFS] << "/" << c[C_NMP_TRIES] << " ("
+       << percent(c[C_NMP_CUTOFFS], c[C_NMP_TRIES]) << "%)" << std::endl;
+    os << "LMR re-searches  : " << c[C_LMR_RESEARCHES] << "/" << c[C_LMR_SEARCHES] << " ("
+       << percent(c[C_LMR_RESEARCHES], c[C_LMR_SEARCHES]) << "%)" << std::endl;
+    os << "Eval calls       : " << c[C_EVAL_CALLS] << " (cache hits "
+       << percent(c[C_EVAL_CACHE_HITS], c[C_EVAL_CALLS]) << "%)" << std::endl;
+}
+
+void print_results() {
+    Block total = merged();
+
+    uint64_t totalTicks = 0;
+    for (int i = 0; i < TIMER_NB; ++i) totalTicks += total.ticks[i];
+
+    if (totalTicks == 0) {
+        std::cout << "\n[Profiler] No profiling data collected.\n";
+        std::cout << "Make sure PROFILING is defined and PROFILE_SCOPE macros are used.\n";
+        return;
+    }
+
+    std::vector<int> order;
+    for (int i = 0; i < TIMER_NB; ++i) {
+        if (total.calls[i]) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(),
+        [&](int a, int b) { return total.ticks[a] > total.ticks[b]; });
+
+    double tpn = ticks_per_ns();
+
+    std::cout << "\n";
+    std::cout << "================================================================================\n";
+    std::cout << "                           PROFILING RESULTS\n";
+    std::cout << "================================================================================\n";
+    std::cout << std::left << std::setw(30) << "Function"
+              << std::right << std::setw(10) << "% Time"
+              << std::setw(12) << "Total(ms)"
+              << std::setw(12) << "Calls"
+              << std::setw(12) << "Avg(us)"
+              << std::setw(12) << "Max(us)"
+              << "\n";
+    std::cout << "--------------------------------------------------------------------------------\n";
+
+    // Scopes nest (search contains eval, movegen...), so percentages are of
+    // the summed scope time rather than of wall time.
+    for (int i : order) {
+        double totalNs = total.ticks[i] / tpn;
+        double maxNs = total.maxTicks[i] / tpn;
+
+        std::cout << std::left << std::setw(30) << TimerNames[i]
+                  << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(9) << percent(total.ticks[i], totalTicks) << "%"
+                  << std::setprecision(1) << std::setw(12) << totalNs / 1e6
+                  << std::setw(12) << total.calls[i]
+                  << std::setprecision(2) << std::setw(12) << totalNs / 1000.0 / total.calls[i]
+                  << std::setprecision(1) << std::setw(12) << maxNs / 1000.0
+                  << "\n";
+    }
+
+    std::cout << "--------------------------------------------------------------------------------\n";
+    std::cout << "Total profiled time: " << std::fixed << std::setprecision(1)
+              << (totalTicks / tpn / 1e9) << " seconds\n";
+    std::cout << "================================================================================\n\n";
+}
+
+}
+
+namespace ProfilerAnalysis {
+
+void analyze_bottlenecks() {
+    std::cout << "\n";
+    std::cout << "================================================================================\n";
+    std::cout << "                         BOTTLENECK ANALYSIS\n";
+    std::cout << "================================================================================\n";
+    std::cout << "\n";
+    std::cout << "Key areas to check for chess engine bottlenecks:\n";
+    std::cout << "\n";
+    std::cout << "1. MOVE GENERATION (generate_*, movegen)\n";
+    std::cout << "   - Target: < 15% of total time\n";
+    std::cout << "   - If high: Consider lazy generation, incremental updates\n";
+    std::cout << "\n";
+    std::cout << "2. EVALUATION (evaluate, eval)\n";
+    std::cout << "   - Target: < 20% of total time\n";
+    std::cout << "   - If high: Implement lazy evaluation, NNUE, or simpler eval\n";
+    std::cout << "\n";
+    std::cout << "3. TRANSPOSITION TABLE (tt_probe, tt_store)\n";
+    std::cout << "   - Target: < 5% of total time\n";
+    std::cout << "   - If high: Check cache alignment, hash function efficiency\n";
+    std::cout << "\n";
+    std::cout << "4. MOVE ORDERING (score_moves, pick_move)\n";
+    std::cout << "   - Target: < 10% of total time\n";
+    std::cout << "   - If high: Use incremental scoring, avoid full sort\n";
+    std::cout << "\n";
+    std::cout << "5. POSITION UPDATES (do_move, undo_move)\n";
+    std::cout << "   - Target: < 10% of total time\n";
+    std::cout << "   - If high: Use incremental updates, copy-make vs make-unmake\n";
+    std::cout << "\n";
+    std::cout << "6. SEE (static_exchange_evaluation)\n";
+    std::cout << "   - Target: < 5% of total time\n";
+    std::cout << "   - If high: Cache SEE results, optimize attacker lookups\n";
+    std::cout << "\n";
+    std::cout << "Expected NPS for modern engines:\n";
+    std::cout << "   - Basic engine: 500K - 1M NPS\n";
+    std::cout << "   - Optimized: 1M - 5M NPS\n";
+    std::cout << "   - Top engines (Stockfish): 10M+ NPS\n";
+    std::cout << "\n";
+    std::cout << "================================================================================\n";
+}
+
+}
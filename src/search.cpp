@@ -1,6 +1,8 @@
 #include "search.hpp"
+#include "thread.hpp"
 #include "movegen.hpp"
 #include "eval.hpp"
+#include "nnue.hpp"
 #include "book.hpp"
 #include "tablebase.hpp"
 #include "uci.hpp"
@@ -53,8 +55,42 @@ int get_contempt(const Board& board) {
     return contempt;
 }
 
-Search::Search() : stopped(false), searching(false), isPondering(false), rootBestMove(MOVE_NONE),
-                   rootPonderMove(MOVE_NONE), previousRootBestMove(MOVE_NONE), previousRootScore(VALUE_NONE),
+namespace {
+
+// Moves some thread is currently searching, for ABDADA-style deferral. A slot
+// holds position key ^ move hash; a collision only costs a missed deferral.
+constexpr size_t SEARCHING_TABLE_SIZE = 1 << 15;
+std::atomic<Key> searchingTable[SEARCHING_TABLE_SIZE];
+
+inline Key searching_key(Key posKey, Move m) {
+    return posKey ^ (Key(m.raw()) * 0x9E3779B97F4A7C15ULL);
+}
+
+inline std::atomic<Key>& searching_slot(Key k) {
+    return searchingTable[k & (SEARCHING_TABLE_SIZE - 1)];
+}
+
+inline bool being_searched(Key k) {
+    return searching_slot(k).load(std::memory_order_relaxed) == k;
+}
+
+inline void mark_searching(Key k) {
+    searching_slot(k).store(k, std::memory_order_relaxed);
+}
+
+inline void unmark_searching(Key k) {
+    Key expected = k;
+    searching_slot(k).compare_exchange_strong(expected, 0, std::memory_order_relaxed);
+}
+
+}
+
+Search::Search(TranspositionTable& table) : Search(table, ownStop, -1) {}
+
+Search::Search(TranspositionTable& table, std::atomic<bool>& stopFlag, int id)
+                 : ownStop(false), stopped(stopFlag), searching(false), isPondering(false), tt(table),
+                   threadId(id), randSeed(U64(id + 2)), rootBestMove(MOVE_NONE), rootPonderMove(MOVE_NONE),
+                   previousRootBestMove(MOVE_NONE), previousRootScore(VALUE_NONE),
                    rootDepth(0), rootPly(0), pvIdx(0),
                    optimumTime(0), maximumTime(0), previousMove(MOVE_NONE) {
     static bool lmr_initialized = false;
@@ -81,7 +117,9 @@ Search::Search() : stopped(false), searching(false), isPondering(false), rootBes
 }
 
 void Search::clear_history() {
-    Eval::pawnTable.clear();
+    pawnTable.clear();
+    materialTable.clear();
+    evalCache.clear();
     killers.clear();
     mateKillers.clear();
     counterMoves.clear();
@@ -97,13 +135,14 @@ void Search::start(Board& board, const SearchLimits& lim) {
     stopped = false;
     searching = true;
     searchStats.reset();
+    lastInfo = SearchInfo{};
 
-    TT.new_search();
+    tt.new_search();
 
     init_time_management(board.side_to_move());
     startTime = std::chrono::steady_clock::now();
 
-    if (!limits.infinite && Book::book.is_loaded()) {
+    if (useBook && !limits.infinite && Book::book.is_loaded()) {
         Move bookMove = Book::book.probe(board);
         if (bookMove != MOVE_NONE) {
             rootBestMove = bookMove;
@@ -117,24 +156,63 @@ void Search::start(Board& board, const SearchLimits& lim) {
         }
     }
 
-    if (Tablebase::TB.is_initialized() && Tablebase::TB.can_probe(board)) {
-        Move tbMove = Tablebase::TB.probe_root(board);
-        if (tbMove != MOVE_NONE) {
-            rootBestMove = tbMove;
-            Tablebase::WDLScore wdl = Tablebase::TB.probe_wdl(board);
-            if (!silentMode) {
-                std::cout << "info string Tablebase hit: " << move_to_string(tbMove) << std::endl;
-                int score = Tablebase::Tablebases::wdl_to_score(wdl, 0);
-                std::cout << "info depth 100 score cp " << score << " nodes 0 time 0 pv "
-                          << move_to_string(tbMove) << std::endl;
-            }
-            searching = false;
-            return;
-        }
+    filter_tablebase_root(board, limits, !silentMode);
+
+    iterative_deepening(board);
+
+    searching = false;
+    isPondering = false;
+}
+
+void Search::filter_tablebase_root(Board& board, SearchLimits& limits, bool verbose) {
+    limits.rootInTB = false;
+    if (!Tablebase::TB.is_initialized() || !Tablebase::TB.can_probe(board)) return;
+
+    std::vector<Move> moves = limits.searchmoves;
+    if (moves.empty()) {
+        MoveList legal;
+        MoveGen::generate_legal(board, legal);
+        for (int i = 0; i < legal.size(); ++i) moves.push_back(legal[i].move);
     }
 
+    size_t total = moves.size();
+    int score;
+    if (!Tablebase::TB.filter_root_moves(board, moves, score)) return;
+
+    limits.searchmoves = moves;
+    limits.rootInTB = true;
+    limits.rootTBScore = score;
+
+    if (verbose) {
+        std::cout << "info string Tablebase root: searching " << moves.size()
+                  << " of " << total << " moves" << std::endl;
+    }
+}
+
+void Search::prepare_worker(const Board& board, const SearchLimits& lim,
+                            std::chrono::steady_clock::time_point start, U64 checkMask,
+                            int groups) {
+    limits = lim;
+    rootGroups = groups;
+    isPondering = lim.ponder;
+    searchStats.reset();
+    lastInfo = SearchInfo{};
+    nodeCheckMask = checkMask;
+
+    init_time_management(board.side_to_move());
+    startTime = start;
+}
+
+void Search::run_worker(Board& board) {
+    searching = true;
     iterative_deepening(board);
 
+    // A split search is over when its last group is; only then are the
+    // merged lines final.
+    if (rootGroups > 1 && !is_helper()) {
+        Threads.wait_for_root_groups();
+        report_root_lines(board);
+    }
     searching = false;
     isPondering = false;
 }
@@ -206,10 +284,18 @@ void Search::init_time_management(Color us) {
     maximumTime = std::max(maximumTime, 100);
 }
 
+// The soft limit is only checked between iterations. A pool thread leaves
+// the hard limit to ThreadPool::timer_loop and never reads the clock here;
+// a standalone search has no timer thread and checks it itself.
 void Search::check_time() {
     if (stopped) return;
 
-    if (limits.infinite || limits.ponder || isPondering) return;
+    if (limits.nodes > 0 && total_nodes() >= limits.nodes) {
+        stopped = true;
+        return;
+    }
+
+    if (threadId >= 0 || limits.infinite || limits.ponder || isPondering) return;
 
     if (limits.depth > 0 && maximumTime == 0 && optimumTime == 0) {
         return;
@@ -222,45 +308,6 @@ void Search::check_time() {
 
     if (elapsed >= maximumTime) {
         stopped = true;
-        return;
-    }
-
-    if (elapsed >= optimumTime) {
-        bool unstable = false;
-
-        if (!rootMoves.empty()) {
-            if (previousRootBestMove != MOVE_NONE && rootBestMove != previousRootBestMove) {
-                unstable = true;
-            }
-
-            if (previousRootScore != VALUE_NONE) {
-                int currentPvScore = rootMoves[0].score;
-
-                bool currentIsMate = std::abs(currentPvScore) >= VALUE_MATE_IN_MAX_PLY;
-                bool previousIsMate = std::abs(previousRootScore) >= VALUE_MATE_IN_MAX_PLY;
-
-                if (currentIsMate && previousIsMate) {
-                    bool sameDirection = (currentPvScore > 0) == (previousRootScore > 0);
-                    if (!sameDirection) {
-                        unstable = true;
-                    }
-                } else if (!currentIsMate && !previousIsMate) {
-                    if (std::abs(currentPvScore - previousRootScore) > 40) {
-                        unstable = true;
-                    }
-                } else {
-                    unstable = true;
-                }
-            }
-        }
-
-        if (!unstable) {
-            stopped = true;
-        }
-    }
-
-    if (limits.nodes > 0 && searchStats.nodes >= limits.nodes) {
-        stopped = true;
     }
 }
 
@@ -268,6 +315,21 @@ bool Search::should_stop() const {
     return stopped;
 }
 
+U64 Search::total_nodes() const {
+    return threadId < 0 ? searchStats.node_count() : Threads.total_nodes();
+}
+
+// Helpers start at staggered depths and drop a quarter of the later
+// iterations, so the pool's threads are spread over different depths.
+bool Search::skip_depth(int depth) {
+    if (is_group_main() || depth <= 4) return false;
+
+    randSeed ^= randSeed << 13;
+    randSeed ^= randSeed >> 7;
+    randSeed ^= randSeed << 17;
+    return randSeed % 4 == 0;
+}
+
 void Search::iterative_deepening(Board& board) {
     rootBestMove = MOVE_NONE;
     rootPonderMove = MOVE_NONE;
@@ -284,15 +346,24 @@ void Search::iterative_deepening(Board& board) {
     }
 
     for (size_t i = 0; i < legalMoves.size(); ++i) {
-        rootMoves.push_back(RootMove(legalMoves[i].move));
+        Move m = legalMoves[i].move;
+        if (!limits.searchmoves.empty() &&
+            std::find(limits.searchmoves.begin(), limits.searchmoves.end(), m) == limits.searchmoves.end()) {
+            continue;
+        }
+        rootMoves.push_back(RootMove(m));
+    }
+    if (rootMoves.empty()) {
+        return;
     }
     rootBestMove = rootMoves[0].move;
+    rootMoveCount = int(rootMoves.size());
 
     if (rootMoves.size() == 1 && !limits.infinite) {
         pvIdx = 0;
         rootDepth = 1;
 
-        int score = search(board, -VALUE_INFINITE, VALUE_INFINITE, 1, false);
+        int score = search<ROOT>(board, -VALUE_INFINITE, VALUE_INFINITE, 1, false);
 
         if (!stopped) {
             rootMoves[0].score = score;
@@ -311,6 +382,18 @@ void Search::iterative_deepening(Board& board) {
         return;
     }
 
+    // A split MultiPV search gives each thread group every rootGroups-th
+    // root move; the group's lines are merged in Threads.rootTable.
+    const bool splitRoot = rootGroups > 1;
+    if (splitRoot) {
+        std::vector<RootMove> own;
+        for (size_t i = threadId % rootGroups; i < rootMoves.size(); i += rootGroups) {
+            own.push_back(rootMoves[i]);
+        }
+        rootMoves.swap(own);
+        rootBestMove = rootMoves[0].move;
+    }
+
     int maxDepth = limits.depth > 0 ? limits.depth : MAX_PLY;
 
     int multiPV = std::min(UCI::options.multiPV, static_cast<int>(rootMoves.size()));
@@ -331,7 +414,9 @@ void Search::iterative_deepening(Board& board) {
     int overallBestScore = -VALUE_INFINITE;
     overallBestPV.clear();
 
-    for (rootDepth = 1; rootDepth <= maxDepth && !stopped; ++rootDepth) {
+    for (rootDepth = is_group_main() ? 1 : 1 + threadId % 3; rootDepth <= maxDepth && !stopped; ++rootDepth) {
+        if (skip_depth(rootDepth)) continue;
+
         for (auto& rm : rootMoves) {
             rm.previousScore = rm.score;
             rm.prevSubtreeNodes = rm.subtreeNodes;
@@ -340,6 +425,11 @@ void Search::iterative_deepening(Board& board) {
 
         std::vector<RootMove> rootMovesBackup = rootMoves;
 
+        // A split search's lines are reported once merged with the other groups'.
+        auto report_line = [&](int score, const PVLine& pv) {
+            if (!splitRoot) report_info(rootBoard, rootDepth, score, pv, pvIdx + 1);
+        };
+
         for (pvIdx = 0; pvIdx < multiPV && !stopped; ++pvIdx) {
             Move analyzedMove = rootMoves[pvIdx].move;
             PVLine previousPVLine = rootMoves[pvIdx].pv;
@@ -362,7 +452,7 @@ void Search::iterative_deepening(Board& board) {
             }
 
             while (true) {
-                score = search(board, alpha, beta, rootDepth, false);
+                score = search<ROOT>(board, alpha, beta, rootDepth, false);
 
                 if (stopped) break;
 
@@ -446,7 +536,7 @@ void Search::iterative_deepening(Board& board) {
                         overallBestScore = rm.score;
                     }
 
-                    report_info(rootBoard, rootDepth, rm.score, rm.pv, pvIdx + 1);
+                    report_line(rm.score, rm.pv);
                 }
                 else {
                     uint16_t moveKey = rm.move.raw();
@@ -455,13 +545,13 @@ void Search::iterative_deepening(Board& board) {
                     if (it != bestKnownPVPerMove.end() && it->second.first.length > 0) {
                         rm.pv = it->second.first;
                         rm.score = it->second.second;
-                        report_info(rootBoard, rootDepth, rm.score, rm.pv, pvIdx + 1);
+                        report_line(rm.score, rm.pv);
                     }
                     else if (overallBestPV.length > 0 && overallBestPV.moves[0] != MOVE_NONE) {
-                        report_info(rootBoard, rootDepth, overallBestScore, overallBestPV, pvIdx + 1);
+                        report_line(overallBestScore, overallBestPV);
                     }
                     else {
-                        report_info(rootBoard, rootDepth, rm.score, rm.pv, pvIdx + 1);
+                        report_line(rm.score, rm.pv);
                     }
                 }
             }
@@ -523,12 +613,24 @@ void Search::iterative_deepening(Board& board) {
 
             pvLines[0] = bestRM.pv;
 
+            if (splitRoot && is_group_main()) {
+                Threads.rootTable.publish(threadId, rootMoves.data(), multiPV, rootDepth);
+                if (!is_helper()) {
+                    report_root_lines(rootBoard);
+                }
+            }
+
+            if (is_helper()) {
+                continue;
+            }
+
             if (!limits.infinite && limits.movetime == 0 && !emergencyMode) {
-                int score = bestRM.score;
+                const RootView view = root_view();
+                int score = view.score;
 
                 if (rootDepth >= 4) {
                     if (previousRootBestMove != MOVE_NONE) {
-                        if (rootBestMove == previousRootBestMove) {
+                        if (view.move == previousRootBestMove) {
                             bestMoveStability = std::min(bestMoveStability + 1, 10);
                         } else {
                             bestMoveStability = 0;
@@ -558,16 +660,14 @@ void Search::iterative_deepening(Board& board) {
                     {
                         int complexity = 50;
 
-                        int numMoves = static_cast<int>(rootMoves.size());
+                        int numMoves = view.moveCount;
                         if (numMoves > 35) complexity += 15;
                         else if (numMoves > 25) complexity += 10;
                         else if (numMoves < 10) complexity -= 15;
                         else if (numMoves < 15) complexity -= 10;
 
-                        if (rootMoves.size() >= 3) {
-                            int topScore = rootMoves[0].score;
-                            int thirdScore = rootMoves[2].score;
-                            int spread = topScore - thirdScore;
+                        if (view.thirdScore != VALUE_NONE) {
+                            int spread = score - view.thirdScore;
 
                             if (spread < 20) complexity += 20;
                             else if (spread < 50) complexity += 10;
@@ -600,8 +700,8 @@ void Search::iterative_deepening(Board& board) {
                         }
                     }
                     bool pvChanged = false;
-                    for (int i = 0; i < 4 && i < bestRM.pv.length; ++i) {
-                        if (bestRM.pv.moves[i] != previousPV[i]) {
+                    for (int i = 0; i < 4 && i < view.pv.length; ++i) {
+                        if (view.pv.moves[i] != previousPV[i]) {
                             pvChanged = true;
                             break;
                         }
@@ -614,7 +714,7 @@ void Search::iterative_deepening(Board& board) {
                     }
 
                     for (int i = 0; i < 4; ++i) {
-                        previousPV[i] = (i < bestRM.pv.length) ? bestRM.pv.moves[i] : MOVE_NONE;
+                        previousPV[i] = (i < view.pv.length) ? view.pv.moves[i] : MOVE_NONE;
                     }
 
                     int maxScore = -VALUE_INFINITE, minScore = VALUE_INFINITE;
@@ -669,10 +769,17 @@ void Search::iterative_deepening(Board& board) {
                             }
                         }
                     }
+
+                    // The soft limit: check_time only enforces the hard one.
+                    // Keep going while the best move or the score is moving.
+                    if (elapsed >= optimumTime && bestMoveStability > 0 && !failingLow
+                        && !limits.ponder && !isPondering) {
+                        break;
+                    }
                 }
 
                 previousRootScore = score;
-                previousRootBestMove = rootBestMove;
+                previousRootBestMove = view.move;
             }
             else if (emergencyMode) {
                 auto now = std::chrono::steady_clock::now();
@@ -691,9 +798,11 @@ void Search::iterative_deepening(Board& board) {
     }
 }
 
+template <NodeType nt>
 int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
-    PROFILE_FUNCTION();
-    const bool pvNode = (beta - alpha) > 1;
+    PROFILE_SCOPE(SEARCH);
+    constexpr bool pvNode = nt != NON_PV;
+    constexpr bool rootNode = nt == ROOT;
 
     int ply = board.game_ply() - rootPly;
 
@@ -704,9 +813,9 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
         searchStats.selDepth = ply;
     }
 
-    TT.prefetch(board.key());
+    tt.prefetch(board.key());
 
-    if (UNLIKELY((searchStats.nodes & 16383) == 0)) {
+    if (UNLIKELY((searchStats.node_count() & nodeCheckMask) == 0)) {
         check_time();
     }
 
@@ -719,16 +828,24 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
     ss->cutoffCnt = 0;
 
     if (depth <= 0) {
-        return qsearch(board, alpha, beta, 0);
+        return qsearch<pvNode ? PV : NON_PV>(board, alpha, beta, 0);
     }
 
-    ++searchStats.nodes;
+    searchStats.count_node();
+    PROFILE_COUNT(SEARCH_NODES);
 
     if (UNLIKELY(ply > 0 && board.is_draw(ply))) {
         int contempt = get_contempt(board);
         return -contempt;
     }
 
+    // A reversible move from here repeats an earlier position, so the side
+    // to move can always settle for the draw score.
+    if (!rootNode && board.has_game_cycle(ply)) {
+        alpha = std::max(alpha, -get_contempt(board));
+        if (alpha >= beta) return alpha;
+    }
+
     alpha = std::max(alpha, -VALUE_MATE + ply);
     beta = std::min(beta, VALUE_MATE - ply - 1);
     if (UNLIKELY(alpha >= beta)) {
@@ -739,11 +856,15 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
         pvLines[ply + 1].clear();
     }
     bool ttHit = false;
-    TTEntry* tte = TT.probe(board.key(), ttHit);
+    TTEntry* tte = tt.probe(board.key(), ttHit);
+    ++searchStats.ttProbes;
+    searchStats.ttHits += ttHit;
+    PROFILE_COUNT(TT_PROBES);
+    if (ttHit) PROFILE_COUNT(TT_HITS);
 
-    Move ttMoves[3];
+    Move ttMoves[MAX_TT_MOVES];
     int ttMoveCount = 0;
-    TT.get_moves(board.key(), ttMoves, ttMoveCount);
+    tt.get_moves(board.key(), ttMoves, ttMoveCount);
 
     Move ttMove = (ttMoveCount > 0) ? ttMoves[0] : MOVE_NONE;
     if (!ttHit && ttMove != MOVE_NONE) {
@@ -795,6 +916,26 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
         }
     }
 
+    if (ply > 0 && board.halfmove_clock() == 0 && Tablebase::TB.can_probe(board)) {
+        Tablebase::ProbeState tbState;
+        Tablebase::WDLScore wdl = Tablebase::TB.probe_wdl(board, tbState);
+
+        if (tbState != Tablebase::PROBE_FAIL) {
+            ++searchStats.tbHits;
+
+            int tbScore = Tablebase::Tablebases::wdl_to_search_score(wdl, ply);
+            Bound tbBound = wdl > Tablebase::WDL_DRAW ? BOUND_LOWER
+                          : wdl < Tablebase::WDL_DRAW ? BOUND_UPPER : BOUND_EXACT;
+
+            if (tbBound == BOUND_EXACT
+                || (tbBound == BOUND_LOWER ? tbScore >= beta : tbScore <= alpha)) {
+                tte->save(board.key(), score_to_tt(tbScore, ply), VALUE_NONE, tbBound,
+                          std::min(MAX_PLY - 1, depth + 6), MOVE_NONE, tt.generation());
+                return tbScore;
+            }
+        }
+    }
+
     int staticEval;
     int correctedStaticEval;
     bool inCheck = board.in_check();
@@ -850,7 +991,7 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
         if (improving) razorMarg += 50;
 
         if (correctedStaticEval + razorMarg <= alpha) {
-            int razorScore = qsearch(board, alpha - razorMarg, alpha - razorMarg + 1);
+            int razorScore = qsearch<NON_PV>(board, alpha - razorMarg, alpha - razorMarg + 1);
             if (razorScore <= alpha - razorMarg) {
                 return razorScore;
             }
@@ -879,10 +1020,11 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
 
         StateInfo si;
         board.do_null_move(si);
+        PROFILE_COUNT(NMP_TRIES);
 
         ss->nullMovePruned = true;
 
-        int nullScore = -search(board, -beta, -beta + 1, depth - R - 1, !cutNode);
+        int nullScore = -search<NON_PV>(board, -beta, -beta + 1, depth - R - 1, !cutNode);
 
         board.undo_null_move();
 
@@ -895,11 +1037,13 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
                 nullScore = beta;
             }
             if (depth >= NULL_MOVE_VERIFY_DEPTH) {
-                int verifyScore = search(board, beta - 1, beta, depth - R - 1, false);
+                int verifyScore = search<NON_PV>(board, beta - 1, beta, depth - R - 1, false);
                 if (verifyScore >= beta) {
+                    PROFILE_COUNT(NMP_CUTOFFS);
                     return nullScore;
                 }
             } else {
+                PROFILE_COUNT(NMP_CUTOFFS);
                 return nullScore;
             }
         }
@@ -917,17 +1061,15 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
         Move m;
 
         while ((m = mcPicker.next_move()) != MOVE_NONE && movesTried < MULTI_CUT_COUNT + 2) {
-            if (!MoveGen::is_legal(board, m)) {
-                continue;
-            }
-
             ++movesTried;
 
+            prefetch_child(board, m);
+
             StateInfo si;
             board.do_move(m, si);
 
             int mcDepth = depth - 1 - MULTI_CUT_DEPTH / 2;
-            int mcScore = -search(board, -beta, -beta + 1, mcDepth, !cutNode);
+            int mcScore = -search<NON_PV>(board, -beta, -beta + 1, mcDepth, !cutNode);
 
             board.undo_move(m);
 
@@ -953,26 +1095,24 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
         int probCutDepth = depth - 4;
 
         MoveList captures;
-        MoveGen::generate_captures(board, captures);
+        MoveGen::generate<CAPTURES>(board, captures);
 
         for (size_t i = 0; i < captures.size(); ++i) {
             Move m = captures[i].move;
 
-            if (!MoveGen::is_legal(board, m)) {
-                continue;
-            }
-
             if (!SEE::see_ge(board, m, 0)) {
                 continue;
             }
 
+            prefetch_child(board, m);
+
             StateInfo si;
             board.do_move(m, si);
 
-            int qScore = -qsearch(board, -probCutBeta, -probCutBeta + 1, 0);
+            int qScore = -qsearch<NON_PV>(board, -probCutBeta, -probCutBeta + 1, 0);
 
             if (qScore >= probCutBeta) {
-                int probCutScore = -search(board, -probCutBeta, -probCutBeta + 1,
+                int probCutScore = -search<NON_PV>(board, -probCutBeta, -probCutBeta + 1,
                                            probCutDepth, !cutNode);
 
                 board.undo_move(m);
@@ -1013,19 +1153,25 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
     int captureCount = 0;
     bool singularSearched = false;
 
-    const bool rootNode = (ply == 0);
-
     const ContinuationHistoryEntry* contHist1ply = (ply >= 1 && ply + 1 < MAX_PLY + 4 && stack[ply + 1].contHistory) ?
                                                     stack[ply + 1].contHistory : nullptr;
     const ContinuationHistoryEntry* contHist2ply = (ply >= 2 && ply < MAX_PLY + 4 && stack[ply].contHistory) ?
                                                     stack[ply].contHistory : nullptr;
 
     MovePicker mp(board, ttMoves, ttMoveCount, ply, killers, counterMoves, history, previousMove,
-                  contHist1ply, contHist2ply, &captureHist);
+                  contHist1ply, contHist2ply, &captureHist, depth);
 
     size_t rootMoveIdx = 0;
     Move m;
 
+    // Moves another pool thread is already searching are put off until the
+    // rest of the list is done, by which time their result is usually in the TT.
+    const bool deferMoves = !rootNode && threadId >= 0 && Threads.abdada && depth >= ABDADA_MIN_DEPTH;
+    Move deferred[MoveList::MAX_MOVES];
+    int deferredCount = 0;
+    int deferredIdx = 0;
+    bool picking = true;
+
     while (true) {
         if (rootNode) {
             if (rootMoveIdx + pvIdx >= rootMoves.size()) {
@@ -1033,19 +1179,30 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
             }
             m = rootMoves[rootMoveIdx + pvIdx].move;
             ++rootMoveIdx;
-        } else {
+        } else if (picking) {
             m = mp.next_move();
             if (m == MOVE_NONE) {
-                break;
+                picking = false;
+                continue;
             }
+        } else if (deferredIdx < deferredCount) {
+            m = deferred[deferredIdx++];
+        } else {
+            break;
         }
 
         if (m == ss->excludedMove) {
             continue;
         }
 
-        if (!MoveGen::is_legal(board, m)) {
-            continue;
+        Key moveKey = 0;
+        if (deferMoves) {
+            moveKey = searching_key(board.key(), m);
+            if (picking && moveCount > 0 && being_searched(moveKey)) {
+                deferred[deferredCount++] = m;
+                ++searchStats.deferredMoves;
+                continue;
+            }
         }
 
         ++moveCount;
@@ -1133,6 +1290,10 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
             }
         }
 
+        // The move survived pruning: start loading the child's TT cluster so
+        // the miss overlaps the extension and reduction work below.
+        prefetch_child(board, m);
+
         int currentExtensions = (ss->ply >= 2 && ply >= 2) ? stack[ply + 1].extensions : 0;
         int doubleExtensions = (ply >= 1) ? stack[ply + 1].doubleExtensions : 0;
         int tripleExtensions = (ply >= 1) ? stack[ply + 1].tripleExtensions : 0;
@@ -1223,7 +1384,7 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
             int singularDepth = (depth - 1) / 2;
 
             ss->excludedMove = m;
-            int singularScore = search(board, singularBeta - 1, singularBeta, singularDepth, cutNode);
+            int singularScore = search<NON_PV>(board, singularBeta - 1, singularBeta, singularDepth, cutNode);
             ss->excludedMove = MOVE_NONE;
 
             if (singularScore < singularBeta) {
@@ -1369,36 +1530,40 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
 
         if (ply + 2 < MAX_PLY + 4) {
             stack[ply + 2].contHistory = contHistory.get_entry(movedPiece, m.to());
+            stack[ply + 2].contHistory->prefetch();
         }
 
+        if (deferMoves) mark_searching(moveKey);
+
         StateInfo si;
         board.do_move(m, si);
 
-        TT.prefetch(board.key());
-
         U64 nodesBefore = 0;
         if (rootNode) {
-            nodesBefore = searchStats.nodes;
+            nodesBefore = searchStats.node_count();
         }
 
         int score;
 
         if (moveCount == 1) {
-            score = -search(board, -beta, -alpha, newDepth, false);
+            score = pvNode ? -search<PV>(board, -beta, -alpha, newDepth, false)
+                           : -search<NON_PV>(board, -beta, -alpha, newDepth, false);
         } else {
             ss->inLMR = (reduction > 0);
             ss->reduction = reduction;
 
-            score = -search(board, -alpha - 1, -alpha, newDepth - reduction, true);
+            score = -search<NON_PV>(board, -alpha - 1, -alpha, newDepth - reduction, true);
+            if (reduction > 0) PROFILE_COUNT(LMR_SEARCHES);
 
             if (score > alpha && reduction > 0) {
+                PROFILE_COUNT(LMR_RESEARCHES);
                 ss->inLMR = false;
                 ss->reduction = 0;
-                score = -search(board, -alpha - 1, -alpha, newDepth, !cutNode);
+                score = -search<NON_PV>(board, -alpha - 1, -alpha, newDepth, !cutNode);
             }
 
-            if (score > alpha && score < beta) {
-                score = -search(board, -beta, -alpha, newDepth, false);
+            if (pvNode && score > alpha && score < beta) {
+                score = -search<PV>(board, -beta, -alpha, newDepth, false);
             }
 
             ss->inLMR = false;
@@ -1407,8 +1572,10 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
 
         board.undo_move(m);
 
+        if (deferMoves) unmark_searching(moveKey);
+
         if (rootNode) {
-            U64 nodesAfter = searchStats.nodes;
+            U64 nodesAfter = searchStats.node_count();
             U64 nodeDiff = nodesAfter - nodesBefore;
 
             for (auto& rm : rootMoves) {
@@ -1441,7 +1608,7 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
             bestMove = m;
 
             if (score > alpha) {
-                if (ply + 1 < MAX_PLY) {
+                if (pvNode && ply + 1 < MAX_PLY) {
                     pvLines[ply].update(m, pvLines[ply + 1]);
                 }
 
@@ -1604,7 +1771,7 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
 
     if (!stopped && tte) {
         tte->save(board.key(), score_to_tt(bestScore, ply), staticEval,
-                  bound, depth, bestMove, TT.generation());
+                  bound, depth, bestMove, tt.generation());
     }
 
     if (!inCheck && staticEval != VALUE_NONE && depth >= 3 &&
@@ -1622,11 +1789,14 @@ int Search::search(Board& board, int alpha, int beta, int depth, bool cutNode) {
     return bestScore;
 }
 
+template <NodeType nt>
 int Search::qsearch(Board& board, int alpha, int beta, int qsDepth, Square recaptureSquare) {
-    PROFILE_FUNCTION();
-    ++searchStats.nodes;
+    constexpr bool pvNode = nt == PV;
+    PROFILE_SCOPE(QSEARCH);
+    PROFILE_COUNT(QSEARCH_NODES);
+    searchStats.count_node();
 
-    if (UNLIKELY((searchStats.nodes & 16383) == 0)) {
+    if (UNLIKELY((searchStats.node_count() & nodeCheckMask) == 0)) {
         check_time();
     }
 
@@ -1638,10 +1808,15 @@ int Search::qsearch(Board& board, int alpha, int beta, int qsDepth, Square recap
         return evaluate(board);
     }
 
-    TT.prefetch(board.key());
+    tt.prefetch(board.key());
 
     pvLines[ply].clear();
 
+    if (board.has_game_cycle(ply)) {
+        alpha = std::max(alpha, -get_contempt(board));
+        if (alpha >= beta) return alpha;
+    }
+
     bool inCheck = board.in_check();
 
     int legalMoveCount = 0;
@@ -1661,21 +1836,23 @@ int Search::qsearch(Board& board, int alpha, int beta, int qsDepth, Square recap
     MoveList quietChecks;
 
     if (inCheck) {
-        MoveGen::generate_evasions(board, moves);
+        MoveGen::generate<LEGAL>(board, moves);
     } else {
-        MoveGen::generate_captures(board, moves);
-
         if (qsDepth >= QSEARCH_CHECK_DEPTH && qsDepth >= 0) {
             MoveGen::generate_checking_moves(board, quietChecks);
         }
     }
 
     bool ttHit = false;
-    TTEntry* tte = TT.probe(board.key(), ttHit);
+    TTEntry* tte = tt.probe(board.key(), ttHit);
+    ++searchStats.ttProbes;
+    searchStats.ttHits += ttHit;
+    PROFILE_COUNT(TT_PROBES);
+    if (ttHit) PROFILE_COUNT(TT_HITS);
 
-    Move ttMoves[3];
+    Move ttMoves[MAX_TT_MOVES];
     int ttMoveCount = 0;
-    TT.get_moves(board.key(), ttMoves, ttMoveCount);
+    tt.get_moves(board.key(), ttMoves, ttMoveCount);
 
     Move ttMove = (ttMoveCount > 0) ? ttMoves[0] : MOVE_NONE;
 
@@ -1714,16 +1891,14 @@ int Search::qsearch(Board& board, int alpha, int beta, int qsDepth, Square recap
         for (size_t i = 0; i < moves.size(); ++i) {
             m = moves[i].move;
 
-            if (!MoveGen::is_legal(board, m)) {
-                continue;
-            }
-
             ++legalMoveCount;
 
+            prefetch_child(board, m);
+
             StateInfo si;
             board.do_move(m, si);
 
-            int score = -qsearch(board, -beta, -alpha, qsDepth, SQ_NONE);
+            int score = -qsearch<nt>(board, -beta, -alpha, qsDepth, SQ_NONE);
 
             board.undo_move(m);
 
@@ -1733,7 +1908,7 @@ int Search::qsearch(Board& board, int alpha, int beta, int qsDepth, Square recap
                 bestScore = score;
 
                 if (score > alpha) {
-                    if (ply + 1 < MAX_PLY) pvLines[ply].update(m, pvLines[ply + 1]);
+                    if (pvNode && ply + 1 < MAX_PLY) pvLines[ply].update(m, pvLines[ply + 1]);
 
                     if (score >= beta) {
                         return score;
@@ -1746,9 +1921,6 @@ int Search::qsearch(Board& board, int alpha, int beta, int qsDepth, Square recap
         MovePicker mp(board, ttMoves, ttMoveCount, history, &captureHist);
 
         while ((m = mp.next_move()) != MOVE_NONE) {
-            if (!MoveGen::is_legal(board, m)) {
-                continue;
-            }
 
             PieceType capturedPt = NO_PIECE_TYPE;
             int captureValue = 0;
@@ -1777,18 +1949,18 @@ int Search::qsearch(Board& board, int alpha, int beta, int qsDepth, Square recap
                 }
             }
 
+            prefetch_child(board, m);
+
             StateInfo si;
             board.do_move(m, si);
 
-            TT.prefetch(board.key());
-
             bool isRecapture = (recaptureSquare != SQ_NONE && m.to() == recaptureSquare);
             bool isCapture = (capturedPt != NO_PIECE_TYPE) || m.is_enpassant();
 
             int newQsDepth = isRecapture ? qsDepth : qsDepth - 1;
             Square newRecaptureSquare = isCapture ? m.to() : SQ_NONE;
 
-            int score = -qsearch(board, -beta, -alpha, newQsDepth, newRecaptureSquare);
+            int score = -qsearch<nt>(board, -beta, -alpha, newQsDepth, newRecaptureSquare);
 
             board.undo_move(m);
 
@@ -1798,7 +1970,7 @@ int Search::qsearch(Board& board, int alpha, int beta, int qsDepth, Square recap
                 bestScore = score;
 
                 if (score > alpha) {
-                    if (ply + 1 < MAX_PLY) pvLines[ply].update(m, pvLines[ply + 1]);
+                    if (pvNode && ply + 1 < MAX_PLY) pvLines[ply].update(m, pvLines[ply + 1]);
 
                     if (score >= beta) {
                         return score;
@@ -1820,10 +1992,12 @@ int Search::qsearch(Board& board, int alpha, int beta, int qsDepth, Square recap
             if (!SEE::see_ge(board, m, 0)) {
                 continue;
             }
+            prefetch_child(board, m);
+
             StateInfo si;
             board.do_move(m, si);
 
-            int score = -qsearch(board, -beta, -alpha, qsDepth - 1, SQ_NONE);
+            int score = -qsearch<nt>(board, -beta, -alpha, qsDepth - 1, SQ_NONE);
 
             board.undo_move(m);
 
@@ -1833,7 +2007,7 @@ int Search::qsearch(Board& board, int alpha, int beta, int qsDepth, Square recap
                 bestScore = score;
 
                 if (score > alpha) {
-                    if (ply + 1 < MAX_PLY) pvLines[ply].update(m, pvLines[ply + 1]);
+                    if (pvNode && ply + 1 < MAX_PLY) pvLines[ply].update(m, pvLines[ply + 1]);
 
                     if (score >= beta) {
                         return score;
@@ -1851,32 +2025,54 @@ int Search::qsearch(Board& board, int alpha, int beta, int qsDepth, Square recap
     return bestScore;
 }
 
-int Search::evaluate(const Board& board) {
-    PROFILE_SCOPE("evaluate");
-    if (Tablebase::EndgameRules::is_known_draw(board)) {
-        return 0;
-    }
-
-    int score = Eval::evaluate(board);
+// Start loading what the child node will probe: its TT cluster and, for the
+// classical eval, its pawn entry when the move changes the pawn key.
+void Search::prefetch_child(const Board& board, Move m) {
+    tt.prefetch(board.key_after(m));
+    if (NNUE::enabled()) return;
 
-    int scaleFactor = Tablebase::EndgameRules::scale_factor(board);
-    if (scaleFactor != 128) {
-        score = score * scaleFactor / 128;
-    }
+    Key pawnKey = board.pawn_key_after(m);
+    if (pawnKey != board.pawn_key()) pawnTable.prefetch(pawnKey);
+}
 
-    return score;
+int Search::evaluate(const Board& board) {
+    PROFILE_SCOPE(EVALUATE);
+    return evaluate(board, -VALUE_INFINITE, VALUE_INFINITE);
 }
 
 int Search::evaluate(const Board& board, int alpha, int beta) {
-    if (Tablebase::EndgameRules::is_known_draw(board)) {
+    int score;
+    PROFILE_COUNT(EVAL_CALLS);
+    ++searchStats.evalCacheProbes;
+    if (evalCache.probe(board.key(), score)) {
+        PROFILE_COUNT(EVAL_CACHE_HITS);
+        ++searchStats.evalCacheHits;
+        return score;
+    }
+
+    Eval::MaterialEntry* material = Eval::probe_material(board, materialTable);
+    if (material->is_draw(board)) {
+        evalCache.store(board.key(), 0);
         return 0;
     }
 
-    int score = Eval::evaluate(board, alpha, beta);
+    if (material->endgame != Eval::ENDGAME_NONE) {
+        score = Eval::evaluate_endgame(board, *material);
+        evalCache.store(board.key(), score);
+        return score;
+    }
+
+    // A lazy exit only bounds the score for this window, so it is not cached.
+    U64 lazyExits = searchStats.lazy.exits;
+    score = NNUE::enabled() ? NNUE::evaluate(board)
+                            : Eval::evaluate(board, pawnTable, *material, alpha, beta, searchStats.lazy);
 
-    int scaleFactor = Tablebase::EndgameRules::scale_factor(board);
-    if (scaleFactor != 128) {
-        score = score * scaleFactor / 128;
+    if (material->scaleFactor != 128) {
+        score = score * material->scaleFactor / 128;
+    }
+
+    if (searchStats.lazy.exits == lazyExits) {
+        evalCache.store(board.key(), score);
     }
 
     return score;
@@ -1890,7 +2086,7 @@ int Search::qsearch_score(Board& board) {
     for (int i = 0; i < MAX_PLY; ++i) {
         pvLines[i].clear();
     }
-    int score = qsearch(board, -VALUE_INFINITE, VALUE_INFINITE, 0, SQ_NONE);
+    int score = qsearch<PV>(board, -VALUE_INFINITE, VALUE_INFINITE, 0, SQ_NONE);
 
     if (board.side_to_move() == BLACK) {
         score = -score;
@@ -1899,11 +2095,37 @@ int Search::qsearch_score(Board& board) {
     return score;
 }
 
-void Search::report_info(Board& board, int depth, int score, const PVLine& pv, int multiPVIdx) {
-    if (silentMode) {
-        return;
+Search::RootView Search::root_view() const {
+    RootView view;
+    if (rootGroups > 1) {
+        auto lines = Threads.rootTable.sorted();
+        view.moveCount = rootMoveCount;
+        if (!lines.empty()) {
+            view.move = lines[0].move;
+            view.score = lines[0].score;
+            view.pv = lines[0].pv;
+        }
+        if (lines.size() >= 3) view.thirdScore = lines[2].score;
+        if (view.move != MOVE_NONE) return view;
+    }
+
+    view.move = rootBestMove;
+    view.score = rootMoves[0].score;
+    view.pv = rootMoves[0].pv;
+    view.moveCount = int(rootMoves.size());
+    if (rootMoves.size() >= 3) view.thirdScore = rootMoves[2].score;
+    return view;
+}
+
+void Search::report_root_lines(Board& board) {
+    auto lines = Threads.rootTable.sorted();
+    int count = std::min(int(lines.size()), UCI::options.multiPV);
+    for (int i = 0; i < count; ++i) {
+        report_info(board, lines[i].depth, lines[i].score, lines[i].pv, i + 1);
     }
+}
 
+void Search::report_info(Board& board, int depth, int score, const PVLine& pv, int multiPVIdx) {
     auto now = std::chrono::steady_clock::now();
     U64 elapsed = static_cast<U64>(
         std::chrono::duration_cast<std::chrono::milliseconds>(now - startTime).count()
@@ -1911,16 +2133,47 @@ void Search::report_info(Board& board, int depth, int score, const PVLine& pv, i
 
     if (elapsed == 0) elapsed = 1;
 
-    U64 nps = searchStats.nodes * 1000 / elapsed;
+    // Pool workers report totals over all of the pool's threads.
+    const bool pooled = threadId >= 0;
+    U64 nodes = total_nodes();
+    U64 nps = nodes * 1000 / elapsed;
+    int selDepth = pooled ? Threads.max_sel_depth() : searchStats.selDepth;
+
+    // A tablebase root shows its TB value unless the search proves a mate.
+    if (limits.rootInTB && std::abs(score) < VALUE_MATE_IN_MAX_PLY) {
+        score = limits.rootTBScore;
+    }
+
+    SearchInfo info;
+    info.depth = depth;
+    info.selDepth = selDepth;
+    info.score = score;
+    info.isMate = std::abs(score) >= VALUE_MATE_IN_MAX_PLY;
+    info.nodes = nodes;
+    info.time = elapsed;
+    info.nps = nps;
+    info.hashfull = silentMode ? 0 : tt.hashfull();
+    info.multiPVIdx = multiPVIdx;
+    info.pv = pv;
+
+    if (multiPVIdx == 1) {
+        lastInfo = info;
+    }
+
+    if (silentMode) {
+        return;
+    }
 
     std::cout << "info";
     std::cout << " depth " << depth;
-    std::cout << " seldepth " << searchStats.selDepth;
+    std::cout << " seldepth " << selDepth;
 
     if (UCI::options.multiPV > 1) {
         std::cout << " multipv " << multiPVIdx;
     }
 
+    // Tablebase wins and losses have no mate distance, so they stay below
+    // the mate range and go out as large cp scores.
     if (std::abs(score) >= VALUE_MATE_IN_MAX_PLY) {
         int mateIn = (score > 0) ?
             (VALUE_MATE - score + 1) / 2 :
@@ -1930,10 +2183,12 @@ void Search::report_info(Board& board, int depth, int score, const PVLine& pv, i
         std::cout << " score cp " << score;
     }
 
-    std::cout << " nodes " << searchStats.nodes;
+    std::cout << " nodes " << nodes;
     std::cout << " nps " << nps;
     std::cout << " time " << elapsed;
-    std::cout << " hashfull " << TT.hashfull();
+    std::cout << " hashfull " << info.hashfull;
+    std::cout << " evalhits " << (pooled ? Threads.eval_cache_hit_rate() : searchStats.eval_cache_hit_rate());
+    std::cout << " tbhits " << (pooled ? Threads.total_tb_hits() : searchStats.tbHits);
 
     std::cout << " pv";
     Board tempBoard = board;
@@ -1957,17 +2212,6 @@ void Search::report_info(Board& board, int depth, int score, const PVLine& pv, i
     std::cout.flush();
 
     if (infoCallback) {
-        SearchInfo info;
-        info.depth = depth;
-        info.selDepth = searchStats.selDepth;
-        info.score = score;
-        info.isMate = std::abs(score) >= VALUE_MATE_IN_MAX_PLY;
-        info.nodes = searchStats.nodes;
-        info.time = elapsed;
-        info.nps = nps;
-        info.hashfull = TT.hashfull();
-        info.multiPVIdx = multiPVIdx;
-        info.pv = pv;
         infoCallback(info);
     }
 }
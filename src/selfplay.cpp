@@ -0,0 +1,435 @@
+#include "selfplay.hpp"
+#include "affinity.hpp"
+#include "book.hpp"
+#include "movegen.hpp"
+#include "nnue.hpp"
+#include "tt.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SelfPlay {
+
+namespace {
+
+enum Side { SIDE_A, SIDE_B };
+
+enum class Outcome { white_wins, black_wins, draw, aborted };
+
+constexpr int MAX_GAME_PLY = 510;
+constexpr int FALLBACK_RANDOM_PLIES = 8;
+
+double score_to_elo(double score) {
+    score = std::clamp(score, 1e-6, 1.0 - 1e-6);
+    return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+double elo_to_score(double elo) {
+    return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+}
+
+// Mean and per-game variance of A's score.
+void score_moments(const SelfPlayStats& stats, double& mean, double& variance) {
+    double n = stats.games();
+    mean = (stats.wins + 0.5 * stats.draws) / n;
+    variance = (stats.wins * (1.0 - mean) * (1.0 - mean)
+              + stats.losses * mean * mean
+              + stats.draws * (0.5 - mean) * (0.5 - mean)) / n;
+}
+
+uint64_t mix_seed(uint64_t seed, uint64_t n) {
+    uint64_t z = seed + (n + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return z ? z : 1;
+}
+
+int rand_int(uint64_t& state, int max) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return max > 0 ? int(state % uint64_t(max)) : 0;
+}
+
+// A book line picked by weight, then random plies; positions the book does
+// not cover get FALLBACK_RANDOM_PLIES instead. Lines that end the game are
+// drawn again so both games of a pair have something to play.
+std::vector<Move> make_opening(const SelfPlayConfig& config, bool use_book, uint64_t& rng) {
+    std::vector<Move> moves;
+    StateInfo states[64];
+
+    for (int attempt = 0; attempt < 16; ++attempt) {
+        moves.clear();
+        int n = 0;
+        Board board;
+        board.set(Board::StartFEN, &states[n++]);
+
+        while (use_book && int(moves.size()) < config.book_depth) {
+            auto book_moves = Book::book.get_moves(board);
+            int total_weight = 0;
+            for (const auto& bm : book_moves) total_weight += bm.second;
+            if (total_weight <= 0) {
+                break;
+            }
+
+            int pick = rand_int(rng, total_weight);
+            Move book_move = book_moves.back().first;
+            for (const auto& bm : book_moves) {
+                if ((pick -= bm.second) < 0) {
+                    book_move = bm.first;
+                    break;
+                }
+            }
+
+            board.do_move(book_move, states[n++]);
+            moves.push_back(book_move);
+        }
+
+        int random_plies = moves.empty() ? std::max(config.random_plies, FALLBACK_RANDOM_PLIES)
+                                         : config.random_plies;
+        MoveList legal;
+        for (int i = 0; i < random_plies; ++i) {
+            legal.clear();
+            MoveGen::generate_legal(board, legal);
+            if (legal.size() == 0) break;
+
+            Move m = legal[rand_int(rng, legal.size())].move;
+            board.do_move(m, states[n++]);
+            moves.push_back(m);
+        }
+
+        legal.clear();
+        MoveGen::generate_legal(board, legal);
+        if (legal.size() > 0 && !board.is_draw(0)) {
+            break;
+        }
+    }
+
+    return moves;
+}
+
+}
+
+double SelfPlayStats::elo() const {
+    if (games() == 0) return 0.0;
+    double mean, variance;
+    score_moments(*this, mean, variance);
+    return score_to_elo(mean);
+}
+
+double SelfPlayStats::elo_error() const {
+    if (games() == 0) return 0.0;
+    double mean, variance;
+    score_moments(*this, mean, variance);
+    double margin = 1.959964 * std::sqrt(variance / games());
+    return (score_to_elo(mean + margin) - score_to_elo(mean - margin)) / 2.0;
+}
+
+// Normal approximation to the trinomial GSPRT log-likelihood ratio.
+double SelfPlayStats::llr(double elo0, double elo1) const {
+    if (games() == 0) return 0.0;
+    double mean, variance;
+    score_moments(*this, mean, variance);
+    if (variance <= 0.0) return 0.0;
+
+    double s0 = elo_to_score(elo0);
+    double s1 = elo_to_score(elo1);
+    return (s1 - s0) * (2.0 * mean - s0 - s1) * games() / (2.0 * variance);
+}
+
+bool run(const SelfPlayConfig& config, SelfPlayStats& stats) {
+    stats = SelfPlayStats{};
+
+    bool book_loaded = false;
+    if (config.use_book) {
+        book_loaded = Book::book.is_loaded() || Book::book.load(config.book_path);
+        if (!book_loaded) {
+            std::cerr << "Warning: Could not load opening book: " << config.book_path << std::endl;
+            std::cerr << "         Falling back to random openings." << std::endl;
+        }
+    }
+
+    if (NNUE::enabled()) {
+        std::cerr << "Warning: NNUE is enabled; parameter overrides only change the classical eval" << std::endl;
+    }
+
+    uint64_t seed = config.seed ? config.seed
+                                : uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+    int pairs = (config.games + 1) / 2;
+    int threads = std::max(1, std::min(config.threads, pairs));
+
+    double lower = std::log(config.beta / (1.0 - config.alpha));
+    double upper = std::log((1.0 - config.beta) / config.alpha);
+
+    std::cout << "\n=== Self-Play Match ===" << std::endl;
+    std::cout << "Games     : " << pairs * 2 << " (" << pairs << " opening pairs)" << std::endl;
+    std::cout << "Threads   : " << threads << " (" << config.hash_mb << " MB hash per side)" << std::endl;
+    std::cout << "Limit     : depth " << config.depth;
+    if (config.nodes > 0) std::cout << ", nodes " << config.nodes;
+    std::cout << std::endl;
+    std::cout << "Book      : " << (book_loaded ? config.book_path + " (depth " + std::to_string(config.book_depth) + ")"
+                                                : std::string("none")) << std::endl;
+    std::cout << "Random    : " << config.random_plies << " plies (" << FALLBACK_RANDOM_PLIES
+              << " when the book has no line)" << std::endl;
+    std::cout << "Seed      : " << seed << std::endl;
+    std::cout << "SPRT      : elo0 " << config.elo0 << " elo1 " << config.elo1
+              << " alpha " << config.alpha << " beta " << config.beta << std::endl;
+    std::cout << "=======================\n" << std::endl;
+
+    SearchLimits limits;
+    limits.depth = config.depth;
+    limits.nodes = U64(std::max(0, config.nodes));
+
+    std::mutex statsMutex;
+    std::condition_variable progress;
+    std::atomic<int> nextPair{0};
+    std::atomic<bool> stop{false};
+    std::atomic<int> running{threads};
+
+    auto print_status = [&](const SelfPlayStats& s) {
+        std::cout << "Games: " << s.games()
+                  << " | W " << s.wins << " L " << s.losses << " D " << s.draws
+                  << " | Elo: " << std::fixed << std::setprecision(1) << s.elo()
+                  << " +/- " << s.elo_error()
+                  << " | LLR: " << std::setprecision(2) << s.llr(config.elo0, config.elo1)
+                  << " [" << lower << ", " << upper << "]" << std::endl;
+    };
+
+    auto worker = [&](int idx) {
+        if (config.bind_threads && threads > 1) {
+            Affinity::bind_current_thread(Affinity::cpu_for_thread(idx));
+        }
+
+        const Tuning::Params* params[2] = {&config.paramsA, &config.paramsB};
+        std::unique_ptr<TranspositionTable> tables[2];
+        std::unique_ptr<Search> searchers[2];
+        for (int side = SIDE_A; side <= SIDE_B; ++side) {
+            tables[side] = std::make_unique<TranspositionTable>(size_t(config.hash_mb));
+            searchers[side] = std::make_unique<Search>(*tables[side]);
+            searchers[side]->set_silent(true);
+            searchers[side]->set_use_book(false);
+        }
+
+        std::vector<StateInfo> states(MAX_GAME_PLY + 2);
+
+        auto play_game = [&](const std::vector<Move>& opening, Side white) {
+            for (int side = SIDE_A; side <= SIDE_B; ++side) {
+                tables[side]->clear();
+                searchers[side]->clear_history();
+            }
+
+            std::vector<Move> moves = opening;
+            int adjudicate_count = 0;
+            int draw_count = 0;
+
+            while (int(moves.size()) < std::min(config.max_ply, MAX_GAME_PLY)) {
+                if (stop) return Outcome::aborted;
+
+                // The incremental PST sums carry material values, so the
+                // board is rebuilt under the mover's parameters every ply.
+                Side mover = moves.size() % 2 == 0 ? white : Side(white ^ 1);
+                Tuning::Active = params[mover];
+
+                int n = 0;
+                Board board;
+                board.set(Board::StartFEN, &states[n++]);
+                for (Move m : moves) {
+                    board.do_move(m, states[n++]);
+                }
+
+                int ply = int(moves.size());
+                MoveList legal;
+                MoveGen::generate_legal(board, legal);
+                if (legal.size() == 0) {
+                    if (!board.in_check()) return Outcome::draw;
+                    return board.side_to_move() == WHITE ? Outcome::black_wins : Outcome::white_wins;
+                }
+                if (board.is_draw(ply)) {
+                    return Outcome::draw;
+                }
+
+                Search& searcher = *searchers[mover];
+                searcher.start(board, limits);
+                Move best = searcher.best_move();
+                int score = searcher.best_score();
+                if (best == MOVE_NONE) {
+                    best = legal[0].move;
+                    score = 0;
+                }
+                if (board.side_to_move() == BLACK) score = -score;
+
+                int abs_score = std::abs(score);
+                if (abs_score >= config.adjudicate_score) {
+                    if (++adjudicate_count >= config.adjudicate_count) {
+                        return score > 0 ? Outcome::white_wins : Outcome::black_wins;
+                    }
+                } else {
+                    adjudicate_count = 0;
+                }
+
+                if (ply >= config.adjudicate_draw_ply && abs_score < config.adjudicate_draw) {
+                    if (++draw_count >= config.adjudicate_draw_count) {
+                        return Outcome::draw;
+                    }
+                } else {
+                    draw_count = 0;
+                }
+
+                moves.push_back(best);
+            }
+
+            return Outcome::draw;
+        };
+
+        while (!stop) {
+            int pair = nextPair.fetch_add(1);
+            if (pair >= pairs) break;
+
+            uint64_t rng = mix_seed(seed, uint64_t(pair));
+            Tuning::Active = &Tuning::Defaults;
+            std::vector<Move> opening = make_opening(config, book_loaded, rng);
+
+            for (int game = 0; game < 2; ++game) {
+                Side white = game == 0 ? SIDE_A : SIDE_B;
+                Outcome outcome = play_game(opening, white);
+                if (outcome == Outcome::aborted) break;
+
+                std::lock_guard<std::mutex> lock(statsMutex);
+                if (outcome == Outcome::draw) {
+                    stats.draws++;
+                } else if ((outcome == Outcome::white_wins) == (white == SIDE_A)) {
+                    stats.wins++;
+                } else {
+                    stats.losses++;
+                }
+
+                double llr = stats.llr(config.elo0, config.elo1);
+                if (config.elo0 < config.elo1 && (llr >= upper || llr <= lower)) {
+                    stop = true;
+                    progress.notify_one();
+                }
+            }
+        }
+
+        Tuning::Active = &Tuning::Defaults;
+        if (--running == 0) {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            progress.notify_one();
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back(worker, i);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(statsMutex);
+        while (running > 0 && !stop) {
+            progress.wait_for(lock, std::chrono::seconds(std::max(1, config.report_seconds)));
+            if (running > 0 && !stop) print_status(stats);
+        }
+    }
+
+    for (auto& t : workers) {
+        t.join();
+    }
+
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now() - start).count();
+    double llr = stats.llr(config.elo0, config.elo1);
+
+    std::cout << "\n=== Self-Play Complete ===" << std::endl;
+    print_status(stats);
+    std::cout << "Time      : " << seconds << " s" << std::endl;
+    if (config.elo0 < config.elo1) {
+        std::cout << "SPRT      : " << (llr >= upper ? "H1 accepted (A is stronger)"
+                                      : llr <= lower ? "H0 accepted"
+                                      : "inconclusive") << std::endl;
+    }
+    std::cout << "==========================" << std::endl;
+
+    return stats.games() > 0;
+}
+
+SelfPlayConfig parse_config(std::istringstream& is) {
+    SelfPlayConfig config;
+    config.paramsA = Tuning::Defaults;
+    config.paramsB = Tuning::Defaults;
+    std::string token;
+
+    while (is >> token) {
+        if (token == "threads") {
+            is >> config.threads;
+        } else if (token == "hash") {
+            is >> config.hash_mb;
+        } else if (token == "games") {
+            is >> config.games;
+        } else if (token == "depth") {
+            is >> config.depth;
+        } else if (token == "nodes") {
+            is >> config.nodes;
+        } else if (token == "seed") {
+            is >> config.seed;
+        } else if (token == "book") {
+            is >> config.book_path;
+            config.use_book = true;
+        } else if (token == "bookdepth") {
+            is >> config.book_depth;
+        } else if (token == "nobook") {
+            config.use_book = false;
+        } else if (token == "random") {
+            is >> config.random_plies;
+        } else if (token == "maxply") {
+            is >> config.max_ply;
+        } else if (token == "resign") {
+            is >> config.adjudicate_score;
+        } else if (token == "drawscore") {
+            is >> config.adjudicate_draw;
+        } else if (token == "elo0") {
+            is >> config.elo0;
+        } else if (token == "elo1") {
+            is >> config.elo1;
+        } else if (token == "alpha") {
+            is >> config.alpha;
+        } else if (token == "beta") {
+            is >> config.beta;
+        } else if (token == "report") {
+            is >> config.report_seconds;
+        } else if (token == "nobind") {
+            config.bind_threads = false;
+        } else if (token.size() > 2 && (token[0] == 'A' || token[0] == 'B') && token[1] == '.') {
+            // A.<Param>=<value> or B.<Param>=<value>, named as in setoption.
+            size_t eq = token.find('=');
+            Tuning::Params& params = token[0] == 'A' ? config.paramsA : config.paramsB;
+            if (eq == std::string::npos
+                || !Tuning::set_param(params, token.substr(2, eq - 2), std::atoi(token.c_str() + eq + 1))) {
+                std::cerr << "Warning: Unknown parameter override " << token << std::endl;
+            }
+        }
+    }
+
+    config.threads = std::max(1, std::min(config.threads, 128));
+    config.hash_mb = std::max(1, std::min(config.hash_mb, 4096));
+    config.games = std::max(2, config.games);
+    config.depth = std::max(1, std::min(config.depth, 30));
+    config.book_depth = std::max(0, std::min(config.book_depth, 30));
+    config.random_plies = std::max(0, std::min(config.random_plies, 20));
+    config.alpha = std::clamp(config.alpha, 1e-6, 0.5);
+    config.beta = std::clamp(config.beta, 1e-6, 0.5);
+
+    return config;
+}
+
+}
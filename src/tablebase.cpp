@@ -1,7 +1,1299 @@
 #include "tablebase.hpp"
+#include "movegen.hpp"
+#include "zobrist.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <type_traits>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace Tablebase {
 
 Tablebases TB;
 
+namespace {
+
+constexpr int TBPIECES = 7;
+
+enum TBType { WDL, DTZ };
+
+enum TBFlag {
+    FLAG_STM         = 1,
+    FLAG_MAPPED      = 2,
+    FLAG_WIN_PLIES   = 4,
+    FLAG_LOSS_PLIES  = 8,
+    FLAG_WIDE        = 16,
+    FLAG_SINGLE_VALUE = 128
+};
+
+const std::string PieceToChar = " PNBRQK  pnbrqk";
+
+int MapPawns[SQUARE_NB];
+int MapB1H1H7[SQUARE_NB];
+int MapA1D1D4[SQUARE_NB];
+int MapKK[10][SQUARE_NB];
+
+int Binomial[6][SQUARE_NB];
+int LeadPawnIdx[6][SQUARE_NB];
+int LeadPawnsSize[6][4];
+
+bool tablesInitialized = false;
+
+inline WDLScore negate(WDLScore wdl) { return WDLScore(-int(wdl)); }
+
+inline Square flip_file(Square s) { return Square(int(s) ^ 7); }
+inline Square flip_rank(Square s) { return Square(int(s) ^ 56); }
+
+inline int off_a1h8(Square s) { return int(rank_of(s)) - int(file_of(s)); }
+
+inline File map_to_queenside(File f) { return std::min(f, File(FILE_H - f)); }
+
+inline int sign_of(int v) { return (v > 0) - (v < 0); }
+
+bool pawns_comp(Square i, Square j) { return MapPawns[i] < MapPawns[j]; }
+
+inline bool is_little_endian() {
+    const uint16_t probe = 1;
+    return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+}
+
+template<typename T>
+inline T read_le(const void* addr) {
+    T v;
+    std::memcpy(&v, addr, sizeof(T));
+    if (!is_little_endian()) {
+        uint8_t* c = reinterpret_cast<uint8_t*>(&v);
+        std::reverse(c, c + sizeof(T));
+    }
+    return v;
+}
+
+template<typename T>
+inline T read_be(const void* addr) {
+    T v;
+    std::memcpy(&v, addr, sizeof(T));
+    if (is_little_endian()) {
+        uint8_t* c = reinterpret_cast<uint8_t*>(&v);
+        std::reverse(c, c + sizeof(T));
+    }
+    return v;
+}
+
+Key material_key(const int counts[COLOR_NB][PIECE_TYPE_NB]) {
+    Key k = 0;
+    for (Color c : {WHITE, BLACK}) {
+        for (PieceType pt = PAWN; pt <= KING; ++pt) {
+            Piece pc = make_piece(c, pt);
+            for (int i = 0; i < counts[c][pt]; ++i) {
+                k ^= Zobrist::PieceSquare[pc][i];
+            }
+        }
+    }
+    return k;
+}
+
+Key material_key(const Board& board) {
+    int counts[COLOR_NB][PIECE_TYPE_NB] = {};
+    for (Color c : {WHITE, BLACK}) {
+        for (PieceType pt = PAWN; pt <= KING; ++pt) {
+            counts[c][pt] = popcount(board.pieces(c, pt));
+        }
+    }
+    return material_key(counts);
+}
+
+struct SparseEntry {
+    char block[4];
+    char offset[2];
+};
+
+static_assert(sizeof(SparseEntry) == 6, "SparseEntry must be 6 bytes");
+
+using Sym = uint16_t;
+
+struct LR {
+    uint8_t lr[3];
+
+    Sym left() const { return Sym(((lr[1] & 0xF) << 8) | lr[0]); }
+    Sym right() const { return Sym((lr[2] << 4) | (lr[1] >> 4)); }
+};
+
+static_assert(sizeof(LR) == 3, "LR tree node must be 3 bytes");
+
+struct PairsData {
+    uint8_t flags = 0;
+    uint8_t maxSymLen = 0;
+    uint8_t minSymLen = 0;
+    uint32_t numBlocks = 0;
+    size_t sizeofBlock = 0;
+    size_t span = 0;
+    Sym* lowestSym = nullptr;
+    LR* btree = nullptr;
+    uint16_t* blockLength = nullptr;
+    uint32_t blockLengthSize = 0;
+    SparseEntry* sparseIndex = nullptr;
+    size_t sparseIndexSize = 0;
+    uint8_t* data = nullptr;
+    std::vector<uint64_t> base64;
+    std::vector<uint8_t> symlen;
+    Piece pieces[TBPIECES] = {};
+    uint64_t groupIdx[TBPIECES + 1] = {};
+    int groupLen[TBPIECES + 1] = {};
+    uint16_t mapIdx[4] = {};
+};
+
+std::vector<std::string> SearchPaths;
+
+class TBFile {
+public:
+    explicit TBFile(const std::string& name) {
+        for (const auto& dir : SearchPaths) {
+            std::string candidate = dir + "/" + name;
+            std::ifstream f(candidate, std::ios::binary);
+            if (f.is_open()) {
+                fname = candidate;
+                return;
+            }
+        }
+    }
+
+    bool exists() const { return !fname.empty(); }
+
+    uint8_t* map(void** baseAddress, uint64_t* mapping, TBType type) {
+        *baseAddress = nullptr;
+        *mapping = 0;
+
+        if (fname.empty()) return nullptr;
+
+#ifdef _WIN32
+        HANDLE fd = CreateFileA(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (fd == INVALID_HANDLE_VALUE) return nullptr;
+
+        DWORD sizeHigh;
+        DWORD sizeLow = GetFileSize(fd, &sizeHigh);
+        uint64_t size = (uint64_t(sizeHigh) << 32) | sizeLow;
+
+        if (size % 64 != 16) {
+            CloseHandle(fd);
+            return nullptr;
+        }
+
+        HANDLE mmap = CreateFileMapping(fd, nullptr, PAGE_READONLY, sizeHigh, sizeLow, nullptr);
+        CloseHandle(fd);
+        if (!mmap) return nullptr;
+
+        *mapping = uint64_t(reinterpret_cast<uintptr_t>(mmap));
+        *baseAddress = MapViewOfFile(mmap, FILE_MAP_READ, 0, 0, 0);
+        if (!*baseAddress) {
+            CloseHandle(mmap);
+            *mapping = 0;
+            return nullptr;
+        }
+#else
+        int fd = ::open(fname.c_str(), O_RDONLY);
+        if (fd == -1) return nullptr;
+
+        struct stat statbuf;
+        if (fstat(fd, &statbuf) != 0 || statbuf.st_size % 64 != 16) {
+            ::close(fd);
+            return nullptr;
+        }
+
+        void* addr = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) return nullptr;
+
+#ifdef MADV_RANDOM
+        madvise(addr, statbuf.st_size, MADV_RANDOM);
+#endif
+        *baseAddress = addr;
+        *mapping = statbuf.st_size;
+#endif
+
+        static const uint8_t Magics[][4] = {
+            { 0xD7, 0x66, 0x0C, 0xA5 },
+            { 0x71, 0xE8, 0x23, 0x5D }
+        };
+
+        uint8_t* data = static_cast<uint8_t*>(*baseAddress);
+        if (std::memcmp(data, Magics[type == WDL], 4)) {
+            unmap(*baseAddress, *mapping);
+            *baseAddress = nullptr;
+            *mapping = 0;
+            return nullptr;
+        }
+
+        return data + 4;
+    }
+
+    static void unmap(void* baseAddress, uint64_t mapping) {
+#ifdef _WIN32
+        UnmapViewOfFile(baseAddress);
+        CloseHandle(reinterpret_cast<HANDLE>(static_cast<uintptr_t>(mapping)));
+#else
+        munmap(baseAddress, mapping);
+#endif
+    }
+
+private:
+    std::string fname;
+};
+
+template<TBType Type>
+struct TBTable {
+    using Ret = typename std::conditional<Type == WDL, WDLScore, int>::type;
+    static constexpr int Sides = Type == WDL ? 2 : 1;
+
+    std::atomic<bool> ready{false};
+    void* baseAddress = nullptr;
+    uint8_t* map = nullptr;
+    uint64_t mapping = 0;
+    Key key = 0;
+    Key key2 = 0;
+    int pieceCount = 0;
+    bool hasPawns = false;
+    bool hasUniquePieces = false;
+    uint8_t pawnCount[2] = {};
+    PairsData items[Sides][4];
+
+    PairsData* get(int stm, int f) { return &items[stm % Sides][hasPawns ? f : 0]; }
+
+    TBTable() = default;
+    explicit TBTable(const std::string& code);
+    explicit TBTable(const TBTable<WDL>& wdl);
+
+    ~TBTable() {
+        if (baseAddress) TBFile::unmap(baseAddress, mapping);
+    }
+};
+
+void parse_code(const std::string& code, Color strongSide, int counts[COLOR_NB][PIECE_TYPE_NB]) {
+    std::memset(counts, 0, sizeof(int) * COLOR_NB * PIECE_TYPE_NB);
+    Color side = strongSide;
+    for (char ch : code) {
+        if (ch == 'v') {
+            side = Color(side ^ 1);
+            continue;
+        }
+        size_t pt = PieceToChar.find(ch);
+        if (pt != std::string::npos && pt >= PAWN && pt <= KING) {
+            counts[side][pt]++;
+        }
+    }
+}
+
+template<>
+TBTable<WDL>::TBTable(const std::string& code) {
+    int counts[COLOR_NB][PIECE_TYPE_NB];
+    parse_code(code, WHITE, counts);
+    key = material_key(counts);
+
+    pieceCount = 0;
+    hasUniquePieces = false;
+    for (Color c : {WHITE, BLACK}) {
+        for (PieceType pt = PAWN; pt <= KING; ++pt) {
+            pieceCount += counts[c][pt];
+            if (pt != KING && counts[c][pt] == 1) hasUniquePieces = true;
+        }
+    }
+    hasPawns = counts[WHITE][PAWN] + counts[BLACK][PAWN] > 0;
+
+    bool c = !counts[BLACK][PAWN]
+          || (counts[WHITE][PAWN] && counts[BLACK][PAWN] >= counts[WHITE][PAWN]);
+    pawnCount[0] = uint8_t(counts[c ? WHITE : BLACK][PAWN]);
+    pawnCount[1] = uint8_t(counts[c ? BLACK : WHITE][PAWN]);
+
+    parse_code(code, BLACK, counts);
+    key2 = material_key(counts);
+}
+
+template<>
+TBTable<DTZ>::TBTable(const TBTable<WDL>& wdl) {
+    key = wdl.key;
+    key2 = wdl.key2;
+    pieceCount = wdl.pieceCount;
+    hasPawns = wdl.hasPawns;
+    hasUniquePieces = wdl.hasUniquePieces;
+    pawnCount[0] = wdl.pawnCount[0];
+    pawnCount[1] = wdl.pawnCount[1];
+}
+
+class TBTables {
+public:
+    template<TBType Type>
+    TBTable<Type>* get(Key key) {
+        for (const Entry* entry = &hashTable[uint32_t(key) & (Size - 1)]; ; ++entry) {
+            if (entry->key == key || !entry->template get<Type>()) {
+                return entry->template get<Type>();
+            }
+        }
+    }
+
+    void clear() {
+        std::memset(static_cast<void*>(hashTable), 0, sizeof(hashTable));
+        wdlTable.clear();
+        dtzTable.clear();
+    }
+
+    size_t size() const { return wdlTable.size(); }
+
+    int add(const std::vector<PieceType>& pieces) {
+        std::string code;
+        for (PieceType pt : pieces) code += PieceToChar[pt];
+        code.insert(code.find('K', 1), "v");
+
+        if (!TBFile(code + ".rtbw").exists()) return 0;
+
+        wdlTable.emplace_back(code);
+        dtzTable.emplace_back(wdlTable.back());
+
+        insert(wdlTable.back().key, &wdlTable.back(), &dtzTable.back());
+        insert(wdlTable.back().key2, &wdlTable.back(), &dtzTable.back());
+
+        return int(pieces.size());
+    }
+
+private:
+    struct Entry {
+        Key key;
+        TBTable<WDL>* wdl;
+        TBTable<DTZ>* dtz;
+
+        template<TBType Type>
+        TBTable<Type>* get() const {
+            return reinterpret_cast<TBTable<Type>*>(Type == WDL ? static_cast<void*>(wdl)
+                                                                : static_cast<void*>(dtz));
+        }
+    };
+
+    static constexpr int Size = 1 << 12;
+    static constexpr int Overflow = 1;
+
+    void insert(Key key, TBTable<WDL>* wdl, TBTable<DTZ>* dtz) {
+        uint32_t homeBucket = uint32_t(key) & (Size - 1);
+        Entry entry{key, wdl, dtz};
+
+        for (uint32_t bucket = homeBucket; bucket < Size + Overflow - 1; ++bucket) {
+            Key otherKey = hashTable[bucket].key;
+            if (otherKey == key || !hashTable[bucket].get<WDL>()) {
+                hashTable[bucket] = entry;
+                return;
+            }
+
+            uint32_t otherHomeBucket = uint32_t(otherKey) & (Size - 1);
+            if (otherHomeBucket > homeBucket) {
+                std::swap(entry, hashTable[bucket]);
+                key = otherKey;
+                homeBucket = otherHomeBucket;
+            }
+        }
+
+        std::cout << "info string Could not insert tablebase into hash table" << std::endl;
+    }
+
+    Entry hashTable[Size + Overflow] = {};
+    std::deque<TBTable<WDL>> wdlTable;
+    std::deque<TBTable<DTZ>> dtzTable;
+};
+
+TBTables Tables;
+
+int decompress_pairs(PairsData* d, uint64_t idx) {
+    if (d->flags & FLAG_SINGLE_VALUE) return d->minSymLen;
+
+    uint32_t k = uint32_t(idx / d->span);
+
+    uint32_t block = read_le<uint32_t>(&d->sparseIndex[k].block);
+    int offset = read_le<uint16_t>(&d->sparseIndex[k].offset);
+
+    int diff = int(idx % d->span) - int(d->span / 2);
+    offset += diff;
+
+    while (offset < 0) offset += d->blockLength[--block] + 1;
+    while (offset > d->blockLength[block]) offset -= d->blockLength[block++] + 1;
+
+    const uint8_t* ptr = d->data + uint64_t(block) * d->sizeofBlock;
+
+    uint64_t buf64 = read_be<uint64_t>(ptr);
+    ptr += 8;
+    int buf64Size = 64;
+    Sym sym;
+
+    while (true) {
+        int len = 0;
+
+        while (buf64 < d->base64[len]) ++len;
+
+        sym = Sym((buf64 - d->base64[len]) >> (64 - len - d->minSymLen));
+        sym += read_le<Sym>(&d->lowestSym[len]);
+
+        if (offset < d->symlen[sym] + 1) break;
+
+        offset -= d->symlen[sym] + 1;
+        len += d->minSymLen;
+        buf64 <<= len;
+        buf64Size -= len;
+
+        if (buf64Size <= 32) {
+            buf64Size += 32;
+            buf64 |= uint64_t(read_be<uint32_t>(ptr)) << (64 - buf64Size);
+            ptr += 4;
+        }
+    }
+
+    while (d->symlen[sym]) {
+        Sym left = d->btree[sym].left();
+
+        if (offset < d->symlen[left] + 1) {
+            sym = left;
+        } else {
+            offset -= d->symlen[left] + 1;
+            sym = d->btree[sym].right();
+        }
+    }
+
+    return d->btree[sym].left();
+}
+
+bool check_dtz_stm(TBTable<WDL>*, int, File) { return true; }
+
+bool check_dtz_stm(TBTable<DTZ>* entry, int stm, File f) {
+    int flags = entry->get(stm, f)->flags;
+    return (flags & FLAG_STM) == stm || ((entry->key == entry->key2) && !entry->hasPawns);
+}
+
+WDLScore map_score(TBTable<WDL>*, File, int value, WDLScore) { return WDLScore(value - 2); }
+
+int map_score(TBTable<DTZ>* entry, File f, int value, WDLScore wdl) {
+    constexpr int WDLMap[] = { 1, 3, 0, 2, 0 };
+
+    int flags = entry->get(0, f)->flags;
+    uint8_t* map = entry->map;
+    uint16_t* idx = entry->get(0, f)->mapIdx;
+
+    if (flags & FLAG_MAPPED) {
+        if (flags & FLAG_WIDE) {
+            value = read_le<uint16_t>(reinterpret_cast<uint16_t*>(map) + idx[WDLMap[wdl + 2]] + value);
+        } else {
+            value = map[idx[WDLMap[wdl + 2]] + value];
+        }
+    }
+
+    if ((wdl == WDL_WIN && !(flags & FLAG_WIN_PLIES))
+        || (wdl == WDL_LOSS && !(flags & FLAG_LOSS_PLIES))
+        || wdl == WDL_CURSED_WIN
+        || wdl == WDL_BLESSED_LOSS) {
+        value *= 2;
+    }
+
+    return value + 1;
+}
+
+template<typename T, typename Ret = typename T::Ret>
+Ret do_probe_table(const Board& board, T* entry, WDLScore wdl, ProbeState& result) {
+    Square squares[TBPIECES];
+    Piece pieces[TBPIECES];
+    uint64_t idx;
+    int next = 0, size = 0, leadPawnsCnt = 0;
+    PairsData* d;
+    Bitboard b, leadPawns = 0;
+    File tbFile = FILE_A;
+
+    bool symmetricBlackToMove = (entry->key == entry->key2 && board.side_to_move() == BLACK);
+    bool blackStronger = (material_key(board) != entry->key);
+
+    int flipColor = (symmetricBlackToMove || blackStronger) * 8;
+    int flipSquares = (symmetricBlackToMove || blackStronger) * 56;
+    int stm = (symmetricBlackToMove || blackStronger) ^ int(board.side_to_move());
+
+    if (entry->hasPawns) {
+        Piece pc = Piece(entry->get(0, 0)->pieces[0] ^ flipColor);
+        leadPawns = b = board.pieces(color_of(pc), PAWN);
+        do {
+            squares[size++] = Square(int(pop_lsb(b)) ^ flipSquares);
+        } while (b);
+
+        leadPawnsCnt = size;
+        std::swap(squares[0], *std::max_element(squares, squares + leadPawnsCnt, pawns_comp));
+        tbFile = map_to_queenside(file_of(squares[0]));
+    }
+
+    if (!check_dtz_stm(entry, stm, tbFile)) {
+        result = PROBE_CHANGE_STM;
+        return Ret();
+    }
+
+    b = board.pieces() ^ leadPawns;
+    do {
+        Square s = pop_lsb(b);
+        squares[size] = Square(int(s) ^ flipSquares);
+        pieces[size++] = Piece(board.piece_on(s) ^ flipColor);
+    } while (b);
+
+    d = entry->get(stm, tbFile);
+
+    for (int i = leadPawnsCnt; i < size - 1; ++i) {
+        for (int j = i + 1; j < size; ++j) {
+            if (d->pieces[i] == pieces[j]) {
+                std::swap(pieces[i], pieces[j]);
+                std::swap(squares[i], squares[j]);
+                break;
+            }
+        }
+    }
+
+    if (file_of(squares[0]) > FILE_D) {
+        for (int i = 0; i < size; ++i) squares[i] = flip_file(squares[i]);
+    }
+
+    if (entry->hasPawns) {
+        idx = LeadPawnIdx[leadPawnsCnt][squares[0]];
+        std::stable_sort(squares + 1, squares + leadPawnsCnt, pawns_comp);
+        for (int i = 1; i < leadPawnsCnt; ++i) {
+            idx += Binomial[i][MapPawns[squares[i]]];
+        }
+    } else {
+        if (rank_of(squares[0]) > RANK_4) {
+            for (int i = 0; i < size; ++i) squares[i] = flip_rank(squares[i]);
+        }
+
+        for (int i = 0; i < d->groupLen[0]; ++i) {
+            if (!off_a1h8(squares[i])) continue;
+
+            if (off_a1h8(squares[i]) > 0) {
+                for (int j = i; j < size; ++j) {
+                    squares[j] = Square(((squares[j] >> 3) | (squares[j] << 3)) & 63);
+                }
+            }
+            break;
+        }
+
+        if (entry->hasUniquePieces) {
+            int adjust1 = (squares[1] > squares[0]);
+            int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+
+            if (off_a1h8(squares[0])) {
+                idx = (MapA1D1D4[squares[0]] * 63
+                       + (squares[1] - adjust1)) * 62
+                       + squares[2] - adjust2;
+            } else if (off_a1h8(squares[1])) {
+                idx = (6 * 63 + rank_of(squares[0]) * 28
+                       + MapB1H1H7[squares[1]]) * 62
+                       + squares[2] - adjust2;
+            } else if (off_a1h8(squares[2])) {
+                idx = 6 * 63 * 62 + 4 * 28 * 62
+                      + rank_of(squares[0]) * 7 * 28
+                      + (rank_of(squares[1]) - adjust1) * 28
+                      + MapB1H1H7[squares[2]];
+            } else {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28
+                      + rank_of(squares[0]) * 7 * 6
+                      + (rank_of(squares[1]) - adjust1) * 6
+                      + (rank_of(squares[2]) - adjust2);
+            }
+        } else {
+            idx = MapKK[MapA1D1D4[squares[0]]][squares[1]];
+        }
+    }
+
+    idx *= d->groupIdx[0];
+    Square* groupSq = squares + d->groupLen[0];
+
+    bool remainingPawns = entry->hasPawns && entry->pawnCount[1];
+
+    while (d->groupLen[++next]) {
+        std::stable_sort(groupSq, groupSq + d->groupLen[next]);
+        uint64_t n = 0;
+
+        for (int i = 0; i < d->groupLen[next]; ++i) {
+            int adjust = int(std::count_if(squares, groupSq,
+                                           [&](Square s) { return groupSq[i] > s; }));
+            n += Binomial[i + 1][groupSq[i] - adjust - 8 * remainingPawns];
+        }
+
+        remainingPawns = false;
+        idx += n * d->groupIdx[next];
+        groupSq += d->groupLen[next];
+    }
+
+    return map_score(entry, tbFile, decompress_pairs(d, idx), wdl);
+}
+
+template<typename T>
+void set_groups(T& e, PairsData* d, int order[], File f) {
+    int n = 0, firstLen = e.hasPawns ? 0 : e.hasUniquePieces ? 3 : 2;
+    d->groupLen[n] = 1;
+
+    for (int i = 1; i < e.pieceCount; ++i) {
+        if (--firstLen > 0 || d->pieces[i] == d->pieces[i - 1]) {
+            d->groupLen[n]++;
+        } else {
+            d->groupLen[++n] = 1;
+        }
+    }
+
+    d->groupLen[++n] = 0;
+
+    bool pp = e.hasPawns && e.pawnCount[1];
+    int next = pp ? 2 : 1;
+    int freeSquares = 64 - d->groupLen[0] - (pp ? d->groupLen[1] : 0);
+    uint64_t idx = 1;
+
+    for (int k = 0; next < n || k == order[0] || k == order[1]; ++k) {
+        if (k == order[0]) {
+            d->groupIdx[0] = idx;
+            idx *= e.hasPawns ? LeadPawnsSize[d->groupLen[0]][f]
+                 : e.hasUniquePieces ? 31332 : 462;
+        } else if (k == order[1]) {
+            d->groupIdx[1] = idx;
+            idx *= Binomial[d->groupLen[1]][48 - d->groupLen[0]];
+        } else {
+            d->groupIdx[next] = idx;
+            idx *= Binomial[d->groupLen[next]][freeSquares];
+            freeSquares -= d->groupLen[next++];
+        }
+    }
+
+    d->groupIdx[n] = idx;
+}
+
+uint8_t set_symlen(PairsData* d, Sym s, std::vector<bool>& visited) {
+    visited[s] = true;
+
+    Sym sr = d->btree[s].right();
+    if (sr == 0xFFF) return 0;
+
+    Sym sl = d->btree[s].left();
+
+    if (!visited[sl]) d->symlen[sl] = set_symlen(d, sl, visited);
+    if (!visited[sr]) d->symlen[sr] = set_symlen(d, sr, visited);
+
+    return d->symlen[sl] + d->symlen[sr] + 1;
+}
+
+uint8_t* set_sizes(PairsData* d, uint8_t* data) {
+    d->flags = *data++;
+
+    if (d->flags & FLAG_SINGLE_VALUE) {
+        d->numBlocks = 0;
+        d->span = 0;
+        d->sparseIndexSize = 0;
+        d->minSymLen = *data++;
+        return data;
+    }
+
+    uint64_t tbSize = d->groupIdx[std::find(d->groupLen, d->groupLen + 7, 0) - d->groupLen];
+
+    d->sizeofBlock = size_t(1) << *data++;
+    d->span = size_t(1) << *data++;
+    d->sparseIndexSize = size_t((tbSize + d->span - 1) / d->span);
+    uint8_t padding = *data++;
+    d->numBlocks = read_le<uint32_t>(data);
+    data += sizeof(uint32_t);
+    d->blockLengthSize = d->numBlocks + padding;
+    d->maxSymLen = *data++;
+    d->minSymLen = *data++;
+    d->lowestSym = reinterpret_cast<Sym*>(data);
+    d->base64.resize(d->maxSymLen - d->minSymLen + 1);
+
+    for (int i = int(d->base64.size()) - 2; i >= 0; --i) {
+        d->base64[i] = (d->base64[i + 1] + read_le<Sym>(&d->lowestSym[i])
+                                         - read_le<Sym>(&d->lowestSym[i + 1])) / 2;
+    }
+
+    for (size_t i = 0; i < d->base64.size(); ++i) {
+        d->base64[i] <<= 64 - i - d->minSymLen;
+    }
+
+    data += d->base64.size() * sizeof(Sym);
+    d->symlen.resize(read_le<uint16_t>(data));
+    data += sizeof(uint16_t);
+    d->btree = reinterpret_cast<LR*>(data);
+
+    std::vector<bool> visited(d->symlen.size());
+    for (size_t sym = 0; sym < d->symlen.size(); ++sym) {
+        if (!visited[sym]) d->symlen[sym] = set_symlen(d, Sym(sym), visited);
+    }
+
+    return data + d->symlen.size() * sizeof(LR) + (d->symlen.size() & 1);
+}
+
+uint8_t* set_dtz_map(TBTable<WDL>&, uint8_t* data, File) { return data; }
+
+uint8_t* set_dtz_map(TBTable<DTZ>& e, uint8_t* data, File maxFile) {
+    e.map = data;
+
+    for (File f = FILE_A; f <= maxFile; ++f) {
+        int flags = e.get(0, f)->flags;
+        if (!(flags & FLAG_MAPPED)) continue;
+
+        if (flags & FLAG_WIDE) {
+            data += reinterpret_cast<uintptr_t>(data) & 1;
+            for (int i = 0; i < 4; ++i) {
+                e.get(0, f)->mapIdx[i] = uint16_t((data - e.map) / 2 + 1);
+                data += 2 * read_le<uint16_t>(data) + 2;
+            }
+        } else {
+            for (int i = 0; i < 4; ++i) {
+                e.get(0, f)->mapIdx[i] = uint16_t(data - e.map + 1);
+                data += *data + 1;
+            }
+        }
+    }
+
+    return data + (reinterpret_cast<uintptr_t>(data) & 1);
+}
+
+template<typename T>
+void set(T& e, uint8_t* data) {
+    data++;
+
+    const int sides = T::Sides == 2 && (e.key != e.key2) ? 2 : 1;
+    const File maxFile = e.hasPawns ? FILE_D : FILE_A;
+
+    bool pp = e.hasPawns && e.pawnCount[1];
+
+    for (File f = FILE_A; f <= maxFile; ++f) {
+        for (int i = 0; i < sides; ++i) *e.get(i, f) = PairsData();
+
+        int order[][2] = { { *data & 0xF, pp ? *(data + 1) & 0xF : 0xF },
+                           { *data >> 4,  pp ? *(data + 1) >> 4  : 0xF } };
+        data += 1 + pp;
+
+        for (int k = 0; k < e.pieceCount; ++k, ++data) {
+            for (int i = 0; i < sides; ++i) {
+                e.get(i, f)->pieces[k] = Piece(i ? *data >> 4 : *data & 0xF);
+            }
+        }
+
+        for (int i = 0; i < sides; ++i) set_groups(e, e.get(i, f), order[i], f);
+    }
+
+    data += reinterpret_cast<uintptr_t>(data) & 1;
+
+    for (File f = FILE_A; f <= maxFile; ++f) {
+        for (int i = 0; i < sides; ++i) data = set_sizes(e.get(i, f), data);
+    }
+
+    data = set_dtz_map(e, data, maxFile);
+
+    for (File f = FILE_A; f <= maxFile; ++f) {
+        for (int i = 0; i < sides; ++i) {
+            PairsData* d = e.get(i, f);
+            d->sparseIndex = reinterpret_cast<SparseEntry*>(data);
+            data += d->sparseIndexSize * sizeof(SparseEntry);
+        }
+    }
+
+    for (File f = FILE_A; f <= maxFile; ++f) {
+        for (int i = 0; i < sides; ++i) {
+            PairsData* d = e.get(i, f);
+            d->blockLength = reinterpret_cast<uint16_t*>(data);
+            data += d->blockLengthSize * sizeof(uint16_t);
+        }
+    }
+
+    for (File f = FILE_A; f <= maxFile; ++f) {
+        for (int i = 0; i < sides; ++i) {
+            data = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(data) + 0x3F) & ~uintptr_t(0x3F));
+            PairsData* d = e.get(i, f);
+            d->data = data;
+            data += uint64_t(d->numBlocks) * d->sizeofBlock;
+        }
+    }
+}
+
+template<TBType Type>
+void* mapped(TBTable<Type>& e, const Board& board) {
+    static std::mutex mutex;
+
+    if (e.ready.load(std::memory_order_acquire)) {
+        return e.baseAddress;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (e.ready.load(std::memory_order_relaxed)) {
+        return e.baseAddress;
+    }
+
+    std::string w, b;
+    for (int pt = KING; pt >= PAWN; --pt) {
+        w += std::string(popcount(board.pieces(WHITE, PieceType(pt))), PieceToChar[pt]);
+        b += std::string(popcount(board.pieces(BLACK, PieceType(pt))), PieceToChar[pt]);
+    }
+
+    std::string fname = (e.key == material_key(board) ? w + 'v' + b : b + 'v' + w)
+                      + (Type == WDL ? ".rtbw" : ".rtbz");
+
+    uint8_t* data = TBFile(fname).map(&e.baseAddress, &e.mapping, Type);
+
+    if (data) set(e, data);
+
+    e.ready.store(true, std::memory_order_release);
+    return e.baseAddress;
+}
+
+template<TBType Type, typename Ret = typename TBTable<Type>::Ret>
+Ret probe_table(const Board& board, ProbeState& result, WDLScore wdl = WDL_DRAW) {
+    if (popcount(board.pieces()) == 2) {
+        return Ret(WDL_DRAW);
+    }
+
+    TBTable<Type>* entry = Tables.get<Type>(material_key(board));
+
+    if (!entry || !mapped(*entry, board)) {
+        result = PROBE_FAIL;
+        return Ret();
+    }
+
+    return do_probe_table(board, entry, wdl, result);
+}
+
+template<bool CheckZeroingMoves>
+WDLScore search(Board& board, ProbeState& result) {
+    WDLScore value, bestValue = WDL_LOSS;
+    StateInfo st;
+
+    MoveList moves;
+    MoveGen::generate_legal(board, moves);
+    int totalCount = moves.size(), moveCount = 0;
+
+    for (int i = 0; i < totalCount; ++i) {
+        Move move = moves[i].move;
+        if (!board.is_capture(move)
+            && (!CheckZeroingMoves || type_of(board.piece_on(move.from())) != PAWN)) {
+            continue;
+        }
+
+        moveCount++;
+
+        board.do_move(move, st);
+        value = negate(search<false>(board, result));
+        board.undo_move(move);
+
+        if (result == PROBE_FAIL) return WDL_DRAW;
+
+        if (value > bestValue) {
+            bestValue = value;
+
+            if (value >= WDL_WIN) {
+                result = PROBE_ZEROING_BEST_MOVE;
+                return value;
+            }
+        }
+    }
+
+    bool noMoreMoves = (moveCount && moveCount == totalCount);
+
+    if (noMoreMoves) {
+        value = bestValue;
+    } else {
+        value = probe_table<WDL>(board, result);
+        if (result == PROBE_FAIL) return WDL_DRAW;
+    }
+
+    if (bestValue >= value) {
+        result = (bestValue > WDL_DRAW || noMoreMoves) ? PROBE_ZEROING_BEST_MOVE : PROBE_OK;
+        return bestValue;
+    }
+
+    result = PROBE_OK;
+    return value;
+}
+
+int dtz_before_zeroing(WDLScore wdl) {
+    return wdl == WDL_WIN          ?  1   :
+           wdl == WDL_CURSED_WIN   ?  101 :
+           wdl == WDL_BLESSED_LOSS ? -101 :
+           wdl == WDL_LOSS         ? -1   : 0;
+}
+
+int probe_dtz_value(Board& board, ProbeState& result) {
+    result = PROBE_OK;
+    WDLScore wdl = search<true>(board, result);
+
+    if (result == PROBE_FAIL || wdl == WDL_DRAW) return 0;
+
+    if (result == PROBE_ZEROING_BEST_MOVE) return dtz_before_zeroing(wdl);
+
+    int dtz = probe_table<DTZ>(board, result, wdl);
+
+    if (result == PROBE_FAIL) return 0;
+
+    if (result != PROBE_CHANGE_STM) {
+        return (dtz + 100 * (wdl == WDL_BLESSED_LOSS || wdl == WDL_CURSED_WIN)) * sign_of(wdl);
+    }
+
+    StateInfo st;
+    int minDTZ = 0xFFFF;
+
+    MoveList moves;
+    MoveGen::generate_legal(board, moves);
+
+    for (int i = 0; i < moves.size(); ++i) {
+        Move move = moves[i].move;
+        bool zeroing = board.is_capture(move) || type_of(board.piece_on(move.from())) == PAWN;
+
+        board.do_move(move, st);
+
+        dtz = zeroing ? -dtz_before_zeroing(search<false>(board, result))
+                      : -probe_dtz_value(board, result);
+
+        if (dtz == 1 && board.in_check()) {
+            MoveList replies;
+            MoveGen::generate_legal(board, replies);
+            if (replies.size() == 0) minDTZ = 1;
+        }
+
+        if (!zeroing) dtz += sign_of(dtz);
+
+        if (dtz < minDTZ && sign_of(dtz) == sign_of(wdl)) minDTZ = dtz;
+
+        board.undo_move(move);
+
+        if (result == PROBE_FAIL) return 0;
+    }
+
+    return minDTZ == 0xFFFF ? -1 : minDTZ;
+}
+
+WDLScore probe_wdl_value(Board& board, ProbeState& result) {
+    result = PROBE_OK;
+    return search<false>(board, result);
+}
+
+// DTZ after a root move, from the mover's point of view: positive wins,
+// zeroing moves take their value from the WDL table and a mate counts 1.
+int root_move_dtz(Board& board, Move move, ProbeState& result) {
+    StateInfo st;
+    int moveDtz;
+
+    result = PROBE_OK;
+    board.do_move(move, st);
+
+    if (board.halfmove_clock() == 0) {
+        moveDtz = dtz_before_zeroing(negate(probe_wdl_value(board, result)));
+    } else if (board.is_draw(1)) {
+        moveDtz = 0;
+    } else {
+        moveDtz = -probe_dtz_value(board, result);
+        moveDtz = moveDtz > 0 ? moveDtz + 1 : moveDtz < 0 ? moveDtz - 1 : moveDtz;
+    }
+
+    if (board.in_check() && moveDtz == 2) {
+        MoveList replies;
+        MoveGen::generate_legal(board, replies);
+        if (replies.size() == 0) moveDtz = 1;
+    }
+
+    board.undo_move(move);
+    return moveDtz;
+}
+
+void init_indices() {
+    if (tablesInitialized) return;
+
+    int code = 0;
+    for (Square s = SQ_A1; s <= SQ_H8; ++s) {
+        if (off_a1h8(s) < 0) MapB1H1H7[s] = code++;
+    }
+
+    std::vector<Square> diagonal;
+    code = 0;
+    for (Square s : { SQ_A1, SQ_B1, SQ_C1, SQ_D1, SQ_A2, SQ_B2, SQ_C2, SQ_D2,
+                      SQ_A3, SQ_B3, SQ_C3, SQ_D3, SQ_A4, SQ_B4, SQ_C4, SQ_D4 }) {
+        if (off_a1h8(s) < 0) {
+            MapA1D1D4[s] = code++;
+        } else if (!off_a1h8(s)) {
+            diagonal.push_back(s);
+        }
+    }
+
+    for (Square s : diagonal) MapA1D1D4[s] = code++;
+
+    std::vector<std::pair<int, Square>> bothOnDiagonal;
+    code = 0;
+    for (int idx = 0; idx < 10; ++idx) {
+        for (Square s1 = SQ_A1; s1 <= SQ_D4; ++s1) {
+            if (MapA1D1D4[s1] != idx || (!idx && s1 != SQ_B1)) continue;
+
+            for (Square s2 = SQ_A1; s2 <= SQ_H8; ++s2) {
+                if ((king_attacks_bb(s1) | square_bb(s1)) & square_bb(s2)) {
+                    continue;
+                } else if (!off_a1h8(s1) && off_a1h8(s2) > 0) {
+                    continue;
+                } else if (!off_a1h8(s1) && !off_a1h8(s2)) {
+                    bothOnDiagonal.emplace_back(idx, s2);
+                } else {
+                    MapKK[idx][s2] = code++;
+                }
+            }
+        }
+    }
+
+    for (const auto& p : bothOnDiagonal) MapKK[p.first][p.second] = code++;
+
+    Binomial[0][0] = 1;
+    for (int n = 1; n < 64; ++n) {
+        for (int k = 0; k < 6 && k <= n; ++k) {
+            Binomial[k][n] = (k > 0 ? Binomial[k - 1][n - 1] : 0)
+                           + (k < n ? Binomial[k][n - 1] : 0);
+        }
+    }
+
+    int availableSquares = 47;
+
+    for (int leadPawnsCnt = 1; leadPawnsCnt <= 5; ++leadPawnsCnt) {
+        for (File f = FILE_A; f <= FILE_D; ++f) {
+            int idx = 0;
+
+            for (Rank r = RANK_2; r <= RANK_7; ++r) {
+                Square sq = make_square(f, r);
+
+                if (leadPawnsCnt == 1) {
+                    MapPawns[sq] = availableSquares--;
+                    MapPawns[flip_file(sq)] = availableSquares--;
+                }
+
+                LeadPawnIdx[leadPawnsCnt][sq] = idx;
+                idx += Binomial[leadPawnsCnt - 1][MapPawns[sq]];
+            }
+
+            LeadPawnsSize[leadPawnsCnt][f] = idx;
+        }
+    }
+
+    tablesInitialized = true;
+}
+
+int register_tables() {
+    int maxCardinality = 0;
+    auto add = [&](std::initializer_list<PieceType> pieces) {
+        maxCardinality = std::max(maxCardinality, Tables.add(pieces));
+    };
+
+    for (PieceType p1 = PAWN; p1 < KING; ++p1) {
+        add({KING, p1, KING});
+
+        for (PieceType p2 = PAWN; p2 <= p1; ++p2) {
+            add({KING, p1, p2, KING});
+            add({KING, p1, KING, p2});
+
+            for (PieceType p3 = PAWN; p3 < KING; ++p3) {
+                add({KING, p1, p2, KING, p3});
+            }
+
+            for (PieceType p3 = PAWN; p3 <= p2; ++p3) {
+                add({KING, p1, p2, p3, KING});
+
+                for (PieceType p4 = PAWN; p4 <= p3; ++p4) {
+                    add({KING, p1, p2, p3, p4, KING});
+
+                    for (PieceType p5 = PAWN; p5 <= p4; ++p5) {
+                        add({KING, p1, p2, p3, p4, p5, KING});
+                    }
+                    for (PieceType p5 = PAWN; p5 < KING; ++p5) {
+                        add({KING, p1, p2, p3, p4, KING, p5});
+                    }
+                }
+
+                for (PieceType p4 = PAWN; p4 < KING; ++p4) {
+                    add({KING, p1, p2, p3, KING, p4});
+
+                    for (PieceType p5 = PAWN; p5 <= p4; ++p5) {
+                        add({KING, p1, p2, p3, KING, p4, p5});
+                    }
+                }
+            }
+
+            for (PieceType p3 = PAWN; p3 <= p1; ++p3) {
+                for (PieceType p4 = PAWN; p4 <= (p1 == p3 ? p2 : p3); ++p4) {
+                    add({KING, p1, p2, KING, p3, p4});
+                }
+            }
+        }
+    }
+
+    return maxCardinality;
+}
+
+}
+
+bool Tablebases::init(const std::string& path) {
+    free();
+    tbPath = path;
+
+    if (path.empty() || path == "<empty>") {
+        return false;
+    }
+
+    init_indices();
+
+#ifdef _WIN32
+    constexpr char Separator = ';';
+#else
+    constexpr char Separator = ':';
+#endif
+
+    std::stringstream ss(path);
+    std::string dir;
+    while (std::getline(ss, dir, Separator)) {
+        if (!dir.empty()) SearchPaths.push_back(dir);
+    }
+
+    maxPieces = register_tables();
+    initialized = Tables.size() > 0;
+
+    std::cout << "info string Found " << Tables.size() << " tablebases" << std::endl;
+
+    return initialized;
+}
+
+void Tablebases::free() {
+    Tables.clear();
+    SearchPaths.clear();
+    initialized = false;
+    maxPieces = 0;
+}
+
+size_t Tablebases::table_count() const {
+    return Tables.size();
+}
+
+WDLScore Tablebases::probe_wdl(Board& board) const {
+    ProbeState state;
+    return probe_wdl(board, state);
+}
+
+WDLScore Tablebases::probe_wdl(Board& board, ProbeState& state) const {
+    if (!can_probe(board)) {
+        state = PROBE_FAIL;
+        return WDL_NONE;
+    }
+
+    WDLScore wdl = probe_wdl_value(board, state);
+    return state == PROBE_FAIL ? WDL_NONE : wdl;
+}
+
+int Tablebases::probe_dtz(Board& board, Move& bestMove) const {
+    bestMove = MOVE_NONE;
+
+    if (!can_probe(board)) {
+        return 0;
+    }
+
+    ProbeState state;
+    int dtz = probe_dtz_value(board, state);
+    if (state == PROBE_FAIL) {
+        return 0;
+    }
+
+    constexpr int MAX_DTZ = 1 << 18;
+
+    MoveList moves;
+    MoveGen::generate_legal(board, moves);
+
+    int cnt50 = board.halfmove_clock();
+    int bestRank = -MAX_DTZ - 1;
+
+    for (int i = 0; i < moves.size(); ++i) {
+        Move move = moves[i].move;
+        ProbeState childState;
+        int moveDtz = root_move_dtz(board, move, childState);
+
+        if (childState == PROBE_FAIL) {
+            bestMove = MOVE_NONE;
+            return 0;
+        }
+
+        int rank = moveDtz > 0 ? (moveDtz + cnt50 <= 100 ? MAX_DTZ - moveDtz : MAX_DTZ / 2 - moveDtz)
+                 : moveDtz < 0 ? (-moveDtz + cnt50 <= 100 ? -MAX_DTZ - moveDtz : -MAX_DTZ / 2 - moveDtz)
+                 : 0;
+
+        if (rank > bestRank) {
+            bestRank = rank;
+            bestMove = move;
+        }
+    }
+
+    return dtz;
+}
+
+Move Tablebases::probe_root(Board& board) const {
+    Move bestMove = MOVE_NONE;
+    probe_dtz(board, bestMove);
+    return bestMove;
+}
+
+bool Tablebases::filter_root_moves(Board& board, std::vector<Move>& moves, int& score) const {
+    if (!can_probe(board) || moves.empty()) return false;
+
+    ProbeState state;
+    int dtz = probe_dtz_value(board, state);
+    if (state == PROBE_FAIL) return false;
+
+    std::vector<int> moveDtz(moves.size());
+    for (size_t i = 0; i < moves.size(); ++i) {
+        moveDtz[i] = root_move_dtz(board, moves[i], state);
+        if (state == PROBE_FAIL) return false;
+    }
+
+    int cnt50 = board.halfmove_clock();
+    int lo, hi;
+
+    if (dtz > 0) {
+        // Keep every move that still wins inside the 50-move rule and let
+        // the search pick among them; a cursed win keeps only the fastest.
+        int best = std::numeric_limits<int>::max();
+        for (int d : moveDtz) {
+            if (d > 0) best = std::min(best, d);
+        }
+        bool inTime = best + cnt50 <= 100;
+        lo = 1;
+        hi = inTime ? 100 - cnt50 : best;
+        score = inTime ? VALUE_TB_WIN : 1;
+    } else if (dtz < 0) {
+        // A loss that the 50-move rule cannot save leaves every move in the
+        // search; a blessed loss keeps only the moves that hold out longest.
+        int best = 0;
+        for (int d : moveDtz) best = std::min(best, d);
+        bool lost = -best + cnt50 <= 100;
+        lo = best;
+        hi = lost ? std::numeric_limits<int>::max() : best;
+        score = lost ? VALUE_TB_LOSS : -1;
+    } else {
+        lo = hi = 0;
+        score = 0;
+    }
+
+    std::vector<Move> kept;
+    for (size_t i = 0; i < moves.size(); ++i) {
+        if (moveDtz[i] >= lo && moveDtz[i] <= hi) kept.push_back(moves[i]);
+    }
+    if (kept.empty()) return false;
+
+    moves.swap(kept);
+    return true;
+}
+
 }
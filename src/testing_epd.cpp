@@ -0,0 +1,111 @@
+#include "testing.hpp"
+#include <cctype>
+
+// The EPD reader is shared by the tactical suites and the batch analyser, so
+// it is built on its own while the rest of TacticalTest stays out of the
+// default build.
+
+namespace TacticalTest {
+
+namespace {
+
+std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r\n");
+    if (b == std::string::npos) return "";
+    size_t e = s.find_last_not_of(" \t\r\n");
+    return s.substr(b, e - b + 1);
+}
+
+bool is_number(const std::string& s) {
+    if (s.empty()) return false;
+    for (char c : s) {
+        if (!std::isdigit(static_cast<unsigned char>(c))) return false;
+    }
+    return true;
+}
+
+std::string unquote(const std::string& s) {
+    if (s.size() >= 2 && s.front() == '"' && s.back() == '"') {
+        return s.substr(1, s.size() - 2);
+    }
+    return s;
+}
+
+}
+
+TacticalPosition parse_epd_line(const std::string& line) {
+    TacticalPosition pos;
+
+    std::istringstream is(line);
+    std::string fields[4];
+    for (std::string& f : fields) {
+        if (!(is >> f)) return pos;
+    }
+
+    std::string rest;
+    std::getline(is, rest);
+    rest = trim(rest);
+
+    // Plain FEN lines carry the move counters instead of EPD operations.
+    std::string halfmove = "0", fullmove = "1";
+    std::istringstream counters(rest);
+    std::string h, f;
+    if (counters >> h >> f && is_number(h) && is_number(f)) {
+        halfmove = h;
+        fullmove = f;
+        std::getline(counters, rest);
+        rest = trim(rest);
+    }
+
+    std::stringstream ops(rest);
+    std::string op;
+    while (std::getline(ops, op, ';')) {
+        std::istringstream os(trim(op));
+        std::string opcode;
+        if (!(os >> opcode)) continue;
+
+        std::string operands;
+        std::getline(os, operands);
+        operands = trim(operands);
+
+        if (opcode == "bm" || opcode == "am") {
+            std::istringstream ms(operands);
+            std::string m;
+            while (ms >> m) {
+                (opcode == "bm" ? pos.bestMoves : pos.avoidMoves).push_back(m);
+            }
+        } else if (opcode == "id") {
+            pos.id = unquote(operands);
+        } else if (opcode == "c0") {
+            pos.description = unquote(operands);
+        } else if (opcode == "hmvc" && is_number(operands)) {
+            halfmove = operands;
+        } else if (opcode == "fmvn" && is_number(operands)) {
+            fullmove = operands;
+        }
+    }
+
+    pos.fen = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3] + " " + halfmove + " " + fullmove;
+    return pos;
+}
+
+std::vector<TacticalPosition> load_epd(const std::string& filename) {
+    std::vector<TacticalPosition> positions;
+    std::ifstream file(filename);
+    if (!file.is_open()) return positions;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#') continue;
+
+        TacticalPosition pos = parse_epd_line(line);
+        if (pos.fen.empty()) continue;
+        if (pos.id.empty()) pos.id = std::to_string(positions.size() + 1);
+        positions.push_back(pos);
+    }
+
+    return positions;
+}
+
+}
@@ -1,34 +1,405 @@
 #include "tt.hpp"
 #include "profiler.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <cstdlib>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 TranspositionTable TT;
 
-TranspositionTable::TranspositionTable()
-    : table(nullptr), clusterCount(0), clusterMask(0), generation8(0) {
-    resize(128);
+namespace {
+
+#ifdef _WIN32
+
+void* alloc_windows_large_pages(size_t& bytes) {
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+        return nullptr;
+    }
+
+    void* mem = nullptr;
+    LUID luid;
+    SIZE_T largePageSize = GetLargePageMinimum();
+
+    if (largePageSize && LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &luid)) {
+        TOKEN_PRIVILEGES tp{};
+        tp.PrivilegeCount = 1;
+        tp.Privileges[0].Luid = luid;
+        tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+        if (AdjustTokenPrivileges(token, FALSE, &tp, 0, nullptr, nullptr)
+            && GetLastError() == ERROR_SUCCESS) {
+            size_t rounded = (bytes + largePageSize - 1) / largePageSize * largePageSize;
+            mem = VirtualAlloc(nullptr, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                               PAGE_READWRITE);
+            if (mem) bytes = rounded;
+        }
+    }
+
+    CloseHandle(token);
+    return mem;
+}
+
+#elif defined(__linux__)
+
+constexpr size_t HUGE_PAGE_2MB = size_t(2) << 20;
+constexpr size_t HUGE_PAGE_1GB = size_t(1) << 30;
+
+void* alloc_hugetlb(size_t& bytes, size_t pageSize, int flags) {
+    size_t rounded = (bytes + pageSize - 1) / pageSize * pageSize;
+    void* mem = mmap(nullptr, rounded, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | flags, -1, 0);
+    if (mem == MAP_FAILED) return nullptr;
+    bytes = rounded;
+    return mem;
+}
+
+#endif
+
+// savehash/loadhash move the table in chunks this large.
+constexpr size_t IO_CHUNK = size_t(64) << 20;
+
+// How long an attaching process waits for the creator of a shared segment
+// to finish sizing it and writing its header.
+constexpr int SHARED_WAIT_MS = 1000;
+
+std::atomic<U8>& shared_generation(TTFileHeader* header) {
+    return *reinterpret_cast<std::atomic<U8>*>(&header->generation);
+}
+
+std::atomic<U32>& attach_count(TTFileHeader* header) {
+    return *reinterpret_cast<std::atomic<U32>*>(&header->attached);
+}
+
+// The magic is published last, so a process that sees it sees the rest.
+std::atomic<U64>& header_magic(TTFileHeader* header) {
+    return *reinterpret_cast<std::atomic<U64>*>(header->magic);
+}
+
+U64 magic_word() {
+    U64 word;
+    std::memcpy(&word, TTFileHeader::MAGIC, sizeof(word));
+    return word;
+}
+
+#ifdef _WIN32
+std::string segment_name(const std::string& name) { return "Local\\gc-engine-" + name; }
+#else
+std::string segment_name(const std::string& name) { return "/gc-engine-" + name; }
+#endif
+
+}
+
+TranspositionTable::TranspositionTable() : TranspositionTable(128) {}
+
+TranspositionTable::TranspositionTable(size_t mb)
+    : table(nullptr), clusterCount(0), clusterMask(0), generation8(0),
+      allocBytes(0), allocMode(TTAllocation::NONE), largePages(true),
+      fileMapping(nullptr), fileRestored(false) {
+    resize(mb);
 }
 
 TranspositionTable::~TranspositionTable() {
-    if (table) {
+    free_table();
+}
+
+const char* TranspositionTable::allocation_name() const {
+    switch (allocMode) {
+        case TTAllocation::DEFAULT_PAGES:          return "default pages";
+        case TTAllocation::TRANSPARENT_HUGE_PAGES: return "transparent huge pages";
+        case TTAllocation::HUGE_PAGES_2MB:         return "huge pages (2MB)";
+        case TTAllocation::HUGE_PAGES_1GB:         return "huge pages (1GB)";
+        case TTAllocation::LARGE_PAGES:            return "large pages";
+        case TTAllocation::FILE_MAPPING:           return "file mapping";
+        case TTAllocation::SHARED_MEMORY:          return "shared memory";
+        default:                                   return "none";
+    }
+}
+
+bool TranspositionTable::allocate(size_t bytes) {
+    if (!sharedName.empty()) {
+        if (map_shared(bytes)) return true;
+        std::cerr << "Failed to attach shared hash " << sharedName << ", using private memory\n";
+    }
+
+    if (!hashFile.empty()) {
+        if (map_file(bytes)) return true;
+        std::cerr << "Failed to map hash file " << hashFile << ", using memory\n";
+    }
+
+    void* mem = nullptr;
+    size_t size = bytes;
+
 #ifdef _WIN32
-        _aligned_free(table);
+    if (largePages && (mem = alloc_windows_large_pages(size))) {
+        allocMode = TTAllocation::LARGE_PAGES;
+    } else {
+        size = bytes;
+        mem = _aligned_malloc(size, 64);
+        allocMode = TTAllocation::DEFAULT_PAGES;
+    }
+#elif defined(__linux__)
+    if (largePages) {
+#ifdef MAP_HUGE_SHIFT
+        if (bytes >= HUGE_PAGE_1GB && (mem = alloc_hugetlb(size, HUGE_PAGE_1GB, 30 << MAP_HUGE_SHIFT))) {
+            allocMode = TTAllocation::HUGE_PAGES_1GB;
+        }
+#endif
+        if (!mem) {
+            size = bytes;
+            if ((mem = alloc_hugetlb(size, HUGE_PAGE_2MB, 0))) {
+                allocMode = TTAllocation::HUGE_PAGES_2MB;
+            }
+        }
+    }
+
+    if (!mem) {
+        size = largePages ? (bytes + HUGE_PAGE_2MB - 1) / HUGE_PAGE_2MB * HUGE_PAGE_2MB : bytes;
+        mem = std::aligned_alloc(largePages ? HUGE_PAGE_2MB : 64, size);
+        allocMode = TTAllocation::DEFAULT_PAGES;
+#ifdef MADV_HUGEPAGE
+        if (mem && largePages && madvise(mem, size, MADV_HUGEPAGE) == 0) {
+            allocMode = TTAllocation::TRANSPARENT_HUGE_PAGES;
+        }
+#endif
+    }
 #else
-        std::free(table);
+    mem = std::aligned_alloc(64, size);
+    allocMode = TTAllocation::DEFAULT_PAGES;
 #endif
+
+    if (!mem) {
+        allocMode = TTAllocation::NONE;
+        return false;
     }
+
+    table = static_cast<TTCluster*>(mem);
+    allocBytes = size;
+    return true;
 }
 
-void TranspositionTable::resize(size_t mb) {
-    if (table) {
+// A file of the wrong size is truncated first, so the mapping starts out
+// zeroed; a file of the right size with a valid header is kept as it is.
+bool TranspositionTable::map_file(size_t bytes) {
+    size_t total = sizeof(TTFileHeader) + bytes;
+    char* base = nullptr;
+
 #ifdef _WIN32
-        _aligned_free(table);
+    HANDLE fd = CreateFileA(hashFile.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                            OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fd == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(fd, &size) && size_t(size.QuadPart) != total) {
+        LARGE_INTEGER zero{};
+        SetFilePointerEx(fd, zero, nullptr, FILE_BEGIN);
+        SetEndOfFile(fd);
+    }
+
+    HANDLE map = CreateFileMapping(fd, nullptr, PAGE_READWRITE,
+                                   DWORD(U64(total) >> 32), DWORD(total), nullptr);
+    void* addr = map ? MapViewOfFile(map, FILE_MAP_ALL_ACCESS, 0, 0, 0) : nullptr;
+    CloseHandle(fd);
+    if (!addr) {
+        if (map) CloseHandle(map);
+        return false;
+    }
+    fileMapping = map;
+    base = static_cast<char*>(addr);
 #else
-        std::free(table);
+    int fd = ::open(hashFile.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd == -1) return false;
+
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) != 0
+        || (size_t(statbuf.st_size) != total && (ftruncate(fd, 0) != 0 || ftruncate(fd, off_t(total)) != 0))) {
+        ::close(fd);
+        return false;
+    }
+
+    void* addr = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) return false;
+    base = static_cast<char*>(addr);
 #endif
+
+    TTFileHeader* header = reinterpret_cast<TTFileHeader*>(base);
+    fileRestored = header->valid(bytes / sizeof(TTCluster));
+    if (fileRestored) {
+        generation8 = header->generation;
+    } else {
+        std::memset(static_cast<void*>(header), 0, sizeof(TTFileHeader));
+        std::memcpy(header->magic, TTFileHeader::MAGIC, sizeof(header->magic));
+        header->clusterCount = bytes / sizeof(TTCluster);
+        header->entrySize = sizeof(TTEntry);
+        header->clusterSize = sizeof(TTCluster);
+    }
+
+    table = reinterpret_cast<TTCluster*>(base + sizeof(TTFileHeader));
+    allocBytes = total;
+    allocMode = TTAllocation::FILE_MAPPING;
+    return true;
+}
+
+// Creates the named segment, or attaches to it if another process already
+// has. The creator sizes it and publishes the header; everyone else waits
+// for that header and refuses a segment of a different size.
+bool TranspositionTable::map_shared(size_t bytes) {
+    size_t total = sizeof(TTFileHeader) + bytes;
+    std::string name = segment_name(sharedName);
+    bool creator = false;
+    char* base = nullptr;
+
+#ifdef _WIN32
+    HANDLE map = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                    DWORD(U64(total) >> 32), DWORD(total), name.c_str());
+    if (!map) return false;
+    creator = GetLastError() != ERROR_ALREADY_EXISTS;
+
+    // Mapping more than an existing, smaller section holds fails here.
+    void* addr = MapViewOfFile(map, FILE_MAP_ALL_ACCESS, 0, 0, total);
+    if (!addr) {
+        CloseHandle(map);
+        return false;
+    }
+    fileMapping = map;
+    base = static_cast<char*>(addr);
+#else
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd != -1) {
+        creator = true;
+        if (ftruncate(fd, off_t(total)) != 0) {
+            ::close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+    } else {
+        if (errno != EEXIST || (fd = shm_open(name.c_str(), O_RDWR, 0600)) == -1) return false;
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SHARED_WAIT_MS);
+        struct stat statbuf;
+        while (fstat(fd, &statbuf) == 0 && statbuf.st_size == 0
+               && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (size_t(statbuf.st_size) != total) {
+            ::close(fd);
+            return false;
+        }
+    }
+
+    void* addr = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        if (creator) shm_unlink(name.c_str());
+        return false;
+    }
+#ifdef MADV_HUGEPAGE
+    if (largePages) madvise(addr, total, MADV_HUGEPAGE);
+#endif
+    base = static_cast<char*>(addr);
+#endif
+
+    TTFileHeader* hdr = reinterpret_cast<TTFileHeader*>(base);
+    table = reinterpret_cast<TTCluster*>(base + sizeof(TTFileHeader));
+    allocBytes = total;
+    allocMode = TTAllocation::SHARED_MEMORY;
+    segmentName = name;
+
+    // A fresh segment is zero-filled, so only the layout needs writing.
+    if (creator) {
+        hdr->clusterCount = bytes / sizeof(TTCluster);
+        hdr->entrySize = sizeof(TTEntry);
+        hdr->clusterSize = sizeof(TTCluster);
+        header_magic(hdr).store(magic_word(), std::memory_order_release);
+    } else {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SHARED_WAIT_MS);
+        while (header_magic(hdr).load(std::memory_order_acquire) != magic_word()
+               && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (!hdr->valid(bytes / sizeof(TTCluster))) {
+            // Detach through the usual path, so a segment nobody holds any
+            // more is removed and the next attach can create it afresh.
+            attach_count(hdr).fetch_add(1);
+            free_table();
+            return false;
+        }
+    }
+
+    attach_count(hdr).fetch_add(1);
+    generation8 = shared_generation(hdr).load();
+    fileRestored = !creator;
+    return true;
+}
+
+void TranspositionTable::free_table() {
+    if (!table) return;
+
+    if (allocMode == TTAllocation::FILE_MAPPING || allocMode == TTAllocation::SHARED_MEMORY) {
+        TTFileHeader* hdr = header();
+        bool last = false;
+        if (allocMode == TTAllocation::FILE_MAPPING) {
+            hdr->generation = generation8;
+        } else {
+            last = attach_count(hdr).fetch_sub(1) == 1;
+        }
+#ifdef _WIN32
+        // The section itself goes away with its last handle.
+        (void)last;
+        UnmapViewOfFile(hdr);
+        CloseHandle(fileMapping);
+        fileMapping = nullptr;
+#else
+        munmap(hdr, allocBytes);
+        if (last) shm_unlink(segmentName.c_str());
+#endif
+        segmentName.clear();
         table = nullptr;
+        allocBytes = 0;
+        allocMode = TTAllocation::NONE;
+        return;
+    }
+
+#ifdef _WIN32
+    if (allocMode == TTAllocation::LARGE_PAGES) {
+        VirtualFree(table, 0, MEM_RELEASE);
+    } else {
+        _aligned_free(table);
+    }
+#elif defined(__linux__)
+    if (allocMode == TTAllocation::HUGE_PAGES_2MB || allocMode == TTAllocation::HUGE_PAGES_1GB) {
+        munmap(table, allocBytes);
+    } else {
+        std::free(table);
     }
+#else
+    std::free(table);
+#endif
+
+    table = nullptr;
+    allocBytes = 0;
+    allocMode = TTAllocation::NONE;
+}
+
+void TranspositionTable::resize(size_t mb, bool clearTable) {
+    free_table();
+    fileRestored = false;
 
     size_t sizeBytes = mb * 1024 * 1024;
     size_t targetCount = sizeBytes / sizeof(TTCluster);
@@ -40,30 +411,164 @@ void TranspositionTable::resize(size_t mb) {
 
     clusterMask = clusterCount - 1;
 
+    if (!allocate(clusterCount * sizeof(TTCluster))) {
+        std::cerr << "Failed to allocate transposition table\n";
+        clusterCount = 0;
+        return;
+    }
+
+    if (clearTable && !fileRestored) {
+        clear();
+    }
+}
+
+// Size of the table stored in the hash file, or 0 if there is no usable one.
+size_t TranspositionTable::hash_file_mb() const {
+    std::FILE* file = hashFile.empty() ? nullptr : std::fopen(hashFile.c_str(), "rb");
+    if (!file) return 0;
+
+    TTFileHeader header;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 && header.valid(header.clusterCount);
+    std::fclose(file);
+    return ok ? size_t(header.clusterCount) * sizeof(TTCluster) >> 20 : 0;
+}
+
+// Size of the table in the named shared segment, or 0 if it does not exist yet.
+size_t TranspositionTable::shared_mb() const {
+    if (sharedName.empty()) return 0;
+    std::string name = segment_name(sharedName);
+    TTFileHeader header;
+
 #ifdef _WIN32
-    table = static_cast<TTCluster*>(_aligned_malloc(clusterCount * sizeof(TTCluster), 64));
+    HANDLE map = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+    void* addr = map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, sizeof(header)) : nullptr;
+    if (map) CloseHandle(map);
+    if (!addr) return 0;
+    std::memcpy(&header, addr, sizeof(header));
+    UnmapViewOfFile(addr);
 #else
-    table = static_cast<TTCluster*>(std::aligned_alloc(64, clusterCount * sizeof(TTCluster)));
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd == -1) return 0;
+    struct stat statbuf;
+    void* addr = fstat(fd, &statbuf) == 0 && size_t(statbuf.st_size) >= sizeof(header)
+        ? mmap(nullptr, sizeof(header), PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (addr == MAP_FAILED) return 0;
+    std::memcpy(&header, addr, sizeof(header));
+    munmap(addr, sizeof(header));
 #endif
 
-    if (!table) {
-        std::cerr << "Failed to allocate transposition table\n";
-        clusterCount = 0;
+    return header.valid(header.clusterCount) ? size_t(header.clusterCount) * sizeof(TTCluster) >> 20 : 0;
+}
+
+bool TranspositionTable::save(const std::string& path) const {
+    if (!table || clusterCount == 0) return false;
+
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    std::setvbuf(file, nullptr, _IONBF, 0);
+
+    TTFileHeader header{};
+    std::memcpy(header.magic, TTFileHeader::MAGIC, sizeof(header.magic));
+    header.clusterCount = clusterCount;
+    header.entrySize = sizeof(TTEntry);
+    header.clusterSize = sizeof(TTCluster);
+    header.generation = generation8;
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    const char* data = reinterpret_cast<const char*>(table);
+    size_t bytes = clusterCount * sizeof(TTCluster);
+    for (size_t done = 0; ok && done < bytes; ) {
+        size_t n = std::min(IO_CHUNK, bytes - done);
+        ok = std::fwrite(data + done, 1, n, file) == n;
+        done += n;
+    }
+
+    return std::fclose(file) == 0 && ok;
+}
+
+bool TranspositionTable::load(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return false;
+    std::setvbuf(file, nullptr, _IONBF, 0);
+#if defined(__linux__)
+    posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    TTFileHeader header;
+    U64 clusters = 0;
+    if (std::fread(&header, sizeof(header), 1, file) == 1) {
+        clusters = header.clusterCount;
+    }
+
+    // Only power-of-two tables of at least 1 MB can be rebuilt by resize().
+    size_t bytes = size_t(clusters) * sizeof(TTCluster);
+    if (clusters == 0 || (clusters & (clusters - 1)) || bytes < (size_t(1) << 20)
+        || !header.valid(clusters)) {
+        std::fclose(file);
+        return false;
+    }
+
+    if (clusters != clusterCount) {
+        resize(bytes >> 20, false);
+        if (clusters != clusterCount) {
+            std::fclose(file);
+            return false;
+        }
+    }
+
+    char* data = reinterpret_cast<char*>(table);
+    bool ok = true;
+    for (size_t done = 0; ok && done < bytes; ) {
+        size_t n = std::min(IO_CHUNK, bytes - done);
+        ok = std::fread(data + done, 1, n, file) == n;
+        done += n;
+    }
+    std::fclose(file);
+
+    if (!ok) {
+        clear();
+        return false;
+    }
+    generation8 = header.generation;
+    fileRestored = true;
+    return true;
+}
+
+// Processes sharing a table advance one common generation: whoever starts a
+// search first moves it on, and the others join that generation instead of
+// ageing the table again, so N processes do not age entries N times as fast.
+void TranspositionTable::new_search() {
+    if (!shared()) {
+        generation8 += GENERATION_DELTA;
         return;
     }
 
-    clear();
+    U8 expected = generation8;
+    if (shared_generation(header()).compare_exchange_strong(expected, U8(generation8 + GENERATION_DELTA))) {
+        generation8 += GENERATION_DELTA;
+    } else {
+        generation8 = expected;
+    }
 }
 
 void TranspositionTable::clear() {
-    if (table && clusterCount > 0) {
-        std::memset(table, 0, clusterCount * sizeof(TTCluster));
-    }
+    clear_range(0, 1);
     generation8 = 0;
 }
 
+void TranspositionTable::clear_range(size_t idx, size_t count) {
+    if (!table || clusterCount == 0 || count == 0 || idx >= count) return;
+
+    size_t stride = clusterCount / count;
+    size_t start = stride * idx;
+    size_t len = (idx + 1 == count) ? clusterCount - start : stride;
+
+    std::memset(static_cast<void*>(&table[start]), 0, len * sizeof(TTCluster));
+}
+
 TTEntry* TranspositionTable::probe(Key key, bool& found) {
-    PROFILE_SCOPE("TT::probe");
+    PROFILE_SCOPE(TT_PROBE);
     if (!table || clusterCount == 0) {
         found = false;
         return nullptr;
@@ -74,6 +579,8 @@ TTEntry* TranspositionTable::probe(Key key, bool& found) {
 
     for (int i = 0; i < TTCluster::ENTRIES_PER_CLUSTER; ++i) {
         if (entry[i].key16 == key16) {
+            // A hit keeps the entry young for this search.
+            entry[i].genBound8 = U8(generation8 | (entry[i].genBound8 & (GENERATION_DELTA - 1)));
             found = true;
             return &entry[i];
         }
@@ -84,15 +591,12 @@ TTEntry* TranspositionTable::probe(Key key, bool& found) {
         }
     }
 
+    // Each search of age is worth GENERATION_DELTA plies of depth, so deep
+    // entries from old searches eventually give way to shallow current ones.
     TTEntry* replace = &entry[0];
-    int best_score = -100000;
-
-    for (int i = 0; i < TTCluster::ENTRIES_PER_CLUSTER; ++i) {
-        int age_diff = (generation8 - entry[i].generation()) & 0xFC;
-        int replace_score = age_diff * 256 - entry[i].depth8;
-
-        if (replace_score > best_score) {
-            best_score = replace_score;
+    for (int i = 1; i < TTCluster::ENTRIES_PER_CLUSTER; ++i) {
+        if (replace->depth8 - replace->relative_age(generation8) >
+            entry[i].depth8 - entry[i].relative_age(generation8)) {
             replace = &entry[i];
         }
     }
@@ -120,7 +624,7 @@ void TranspositionTable::get_moves(Key key, Move* moves, int& count) {
                     }
                 }
 
-                if (!duplicate && count < TTCluster::ENTRIES_PER_CLUSTER) {
+                if (!duplicate && count < MAX_TT_MOVES) {
                     moves[count++] = m;
                 }
             }
@@ -128,20 +632,22 @@ void TranspositionTable::get_moves(Key key, Move* moves, int& count) {
     }
 }
 
+// Permille of sampled entries written or hit during the current search.
 int TranspositionTable::hashfull() const {
     int count = 0;
     const int samples = 1000;
 
     if (!table || clusterCount == 0) return 0;
 
-    for (int i = 0; i < samples && i < static_cast<int>(clusterCount); ++i) {
+    int clusters = std::min(samples, static_cast<int>(clusterCount));
+    for (int i = 0; i < clusters; ++i) {
         const TTEntry* entry = &table[i].entries[0];
         for (int j = 0; j < TTCluster::ENTRIES_PER_CLUSTER; ++j) {
-            if (entry[j].key16 != 0) {
+            if (entry[j].key16 != 0 && entry[j].generation() == generation8) {
                 ++count;
             }
         }
     }
 
-    return count * 1000 / (samples * TTCluster::ENTRIES_PER_CLUSTER);
+    return count * 1000 / (clusters * TTCluster::ENTRIES_PER_CLUSTER);
 }
@@ -2,25 +2,66 @@
 
 namespace Tuning {
 
-    EvalScore PawnValue   = S(100, 100);
-    EvalScore KnightValue = S(320, 330);
-    EvalScore BishopValue = S(330, 340);
-    EvalScore RookValue   = S(500, 520);
-    EvalScore QueenValue  = S(950, 1000);
-
-    EvalScore BishopPairBonus       = S(20, 50);
-    EvalScore RookOpenFileBonus     = S(40, 20);
-    EvalScore RookSemiOpenFileBonus = S(20, 10);
-    EvalScore RookOnSeventhBonus    = S(20, 40);
-    EvalScore KnightOutpostBonus    = S(30, 20);
-
-    EvalScore IsolatedPawnPenalty   = S(-10, -20);
-    EvalScore DoubledPawnPenalty    = S(-10, -20);
-    EvalScore BackwardPawnPenalty   = S(-5,  -10);
-    EvalScore ConnectedPawnBonus    = S(15, 15);
-    EvalScore PhalanxBonus          = S(10, 20);
-
-    int KingSafetyWeight = 90;
+    Params Defaults;
+    thread_local const Params* Active = &Defaults;
+
+    EvalScore& PawnValue   = Defaults.PawnValue;
+    EvalScore& KnightValue = Defaults.KnightValue;
+    EvalScore& BishopValue = Defaults.BishopValue;
+    EvalScore& RookValue   = Defaults.RookValue;
+    EvalScore& QueenValue  = Defaults.QueenValue;
+
+    EvalScore& BishopPairBonus       = Defaults.BishopPairBonus;
+    EvalScore& RookOpenFileBonus     = Defaults.RookOpenFileBonus;
+    EvalScore& RookSemiOpenFileBonus = Defaults.RookSemiOpenFileBonus;
+    EvalScore& RookOnSeventhBonus    = Defaults.RookOnSeventhBonus;
+    EvalScore& KnightOutpostBonus    = Defaults.KnightOutpostBonus;
+
+    EvalScore& IsolatedPawnPenalty   = Defaults.IsolatedPawnPenalty;
+    EvalScore& DoubledPawnPenalty    = Defaults.DoubledPawnPenalty;
+    EvalScore& BackwardPawnPenalty   = Defaults.BackwardPawnPenalty;
+    EvalScore& ConnectedPawnBonus    = Defaults.ConnectedPawnBonus;
+    EvalScore& PhalanxBonus          = Defaults.PhalanxBonus;
+
+    int& KingSafetyWeight = Defaults.KingSafetyWeight;
+
+    bool set_param(Params& params, const std::string& name, int value) {
+        struct Named { const char* name; EvalScore Params::* score; };
+        static const Named scores[] = {
+            {"PawnValue", &Params::PawnValue},
+            {"KnightValue", &Params::KnightValue},
+            {"BishopValue", &Params::BishopValue},
+            {"RookValue", &Params::RookValue},
+            {"QueenValue", &Params::QueenValue},
+            {"BishopPairBonus", &Params::BishopPairBonus},
+            {"RookOpenFileBonus", &Params::RookOpenFileBonus},
+            {"RookSemiOpenFileBonus", &Params::RookSemiOpenFileBonus},
+            {"RookOnSeventhBonus", &Params::RookOnSeventhBonus},
+            {"KnightOutpostBonus", &Params::KnightOutpostBonus},
+            {"IsolatedPawnPenalty", &Params::IsolatedPawnPenalty},
+            {"DoubledPawnPenalty", &Params::DoubledPawnPenalty},
+            {"BackwardPawnPenalty", &Params::BackwardPawnPenalty},
+            {"ConnectedPawnBonus", &Params::ConnectedPawnBonus},
+            {"PhalanxBonus", &Params::PhalanxBonus},
+        };
+
+        if (name == "KingSafetyWeight") {
+            params.KingSafetyWeight = value;
+            return true;
+        }
+
+        for (const Named& n : scores) {
+            if (name == std::string(n.name) + "MG") {
+                (params.*n.score).mg = value;
+                return true;
+            }
+            if (name == std::string(n.name) + "EG") {
+                (params.*n.score).eg = value;
+                return true;
+            }
+        }
+        return false;
+    }
 
     void init() {
     }
@@ -4,7 +4,16 @@
 #include "thread.hpp"
 #include "profiler.hpp"
 #include "datagen.hpp"
+#include "analysis.hpp"
+#include "selfplay.hpp"
+#include "bench.hpp"
+#include "microbench.hpp"
+#include "perft.hpp"
 #include "moveorder.hpp"
+#include "nnue.hpp"
+#include "affinity.hpp"
+#include "magic.hpp"
+#include "io.hpp"
 #include <iostream>
 #include <algorithm>
 #include <chrono>
@@ -25,6 +34,36 @@ const std::string ENGINE_VERSION = "1.2";
 static StateInfo stateInfoStack[512];
 static int stateStackIdx = 0;
 
+namespace {
+
+// Cached static evals and TT entries come from whichever backend was active.
+void set_nnue(bool on) {
+    NNUE::set_enabled(on);
+    if (on && !NNUE::enabled()) {
+        std::cout << "info string No NNUE network loaded, using classical evaluation" << std::endl;
+    }
+    Searcher.clear_history();
+    Threads.clear_all_history();
+}
+
+// A table restored from a hash file or attached to a shared segment keeps
+// its contents. A fresh mapping is cleared here, since clear_tt() leaves
+// mapped tables alone.
+void clear_resized_tt() {
+    if (TT.restored()) return;
+    if (TT.mapped()) TT.clear();
+    else Threads.clear_tt();
+}
+
+void resize_tt(int mb) {
+    TT.resize(mb, false);
+    clear_resized_tt();
+    std::cout << "info string Hash " << mb << " MB allocated with "
+              << TT.allocation_name() << (TT.restored() ? " (restored)" : "") << std::endl;
+}
+
+}
+
 UCIHandler::UCIHandler() : searching(false) {
     stateStackIdx = 0;
     board.set(Board::StartFEN, &stateInfoStack[stateStackIdx]);
@@ -38,8 +77,20 @@ UCIHandler::~UCIHandler() {
 void UCIHandler::loop() {
     std::string line, token;
 
+    // stop and quit are acted on as soon as they are read; the loop still
+    // runs their handlers in order with everything else.
+    IO::start_input([](const std::string& input) {
+        std::istringstream is(input);
+        std::string first;
+        is >> first;
+        if (first == "stop" || first == "quit") {
+            Searcher.stop();
+            Threads.stop();
+        }
+    });
+
     try {
-        while (std::getline(std::cin, line)) {
+        while (IO::read_line(line)) {
             std::istringstream is(line);
             is >> std::skipws >> token;
 
@@ -76,21 +127,18 @@ void UCIHandler::loop() {
                 cmd_bench(is);
             } else if (token == "datagen") {
                 cmd_datagen(is);
-            } else if (token == "threats") {
-                debug_threats(board);
-            } else if (token == "threatmove") {
-                std::string moveStr;
-                if (is >> moveStr) {
-                    Move m = string_to_move(moveStr);
-                    debug_move_threat_score(board, m);
-                }
-            } else if (token == "quietsplit") {
-                debug_quiet_split(board);
-            } else if (token == "killerstats") {
-                g_killerStats.print();
-            } else if (token == "clearstats") {
-                g_killerStats.clear();
-                std::cout << "Killer statistics cleared.\n";
+            } else if (token == "profile") {
+                cmd_profile(is);
+            } else if (token == "analyze") {
+                cmd_analyze(is);
+            } else if (token == "selfplay") {
+                cmd_selfplay(is);
+            } else if (token == "microbench") {
+                cmd_microbench(is);
+            } else if (token == "savehash") {
+                cmd_savehash(is);
+            } else if (token == "loadhash") {
+                cmd_loadhash(is);
             }
         }
     } catch (const std::exception& e) {
@@ -106,14 +154,23 @@ void UCIHandler::cmd_uci() {
     std::cout << std::endl;
 
     std::cout << "option name Hash type spin default 256 min 1 max 4096" << std::endl;
+    std::cout << "option name Large Pages type check default true" << std::endl;
+    std::cout << "option name Hash File type string default <empty>" << std::endl;
+    std::cout << "option name Hash Shared type string default <empty>" << std::endl;
+    std::cout << "option name Pawn Hash type spin default 2 min 1 max 256" << std::endl;
     std::cout << "option name Table Memory type spin default 64 min 1 max 1024" << std::endl;
     std::cout << "option name Threads type spin default 1 min 1 max 128" << std::endl;
+    std::cout << "option name ABDADA type check default false" << std::endl;
+    std::cout << "option name Thread Binding type check default false" << std::endl;
     std::cout << "option name MultiPV type spin default 1 min 1 max 500" << std::endl;
+    std::cout << "option name Split MultiPV type check default false" << std::endl;
     std::cout << "option name Ponder type check default true" << std::endl;
     std::cout << "option name Move Overhead type spin default 10 min 0 max 5000" << std::endl;
     std::cout << "option name OwnBook type check default true" << std::endl;
     std::cout << "option name Book File type string default book.bin" << std::endl;
     std::cout << "option name SyzygyPath type string default <empty>" << std::endl;
+    std::cout << "option name Use NNUE type check default " << (NNUE::has_embedded() ? "true" : "false") << std::endl;
+    std::cout << "option name EvalFile type string default <embedded>" << std::endl;
 
     std::cout << "option name Contempt type spin default 20 min -100 max 100" << std::endl;
     std::cout << "option name Dynamic Contempt type check default true" << std::endl;
@@ -144,12 +201,13 @@ void UCIHandler::cmd_isready() {
 
 void UCIHandler::cmd_ucinewgame() {
     wait_for_search();
-    TT.clear();
     stateStackIdx = 0;
     board.set(Board::StartFEN, &stateInfoStack[stateStackIdx]);
     stateStackIdx++;
     Searcher.clear_history();
-    Threads.clear_all_history();
+    // A file-backed or shared table is kept across games: that is what it
+    // is for.
+    Threads.clear_all_history(!TT.mapped());
 }
 
 void UCIHandler::cmd_position(std::istringstream& is) {
@@ -259,6 +317,9 @@ void UCIHandler::start_search(const SearchLimits& limits) {
 
     std::string searchFen = board.fen();
 
+    // With more than one thread the pool searches; its main thread runs the
+    // same full search as Searcher.
+    pooledSearch = Threads.thread_count() > 1;
     Searcher.set_pondering(limits.ponder);
 
     if (limits.ponder) {
@@ -269,9 +330,14 @@ void UCIHandler::start_search(const SearchLimits& limits) {
         Board searchBoard;
         searchBoard.set(searchFen, &searchSi);
 
-        Searcher.start(searchBoard, limits);
+        if (pooledSearch) {
+            Threads.start_thinking(searchBoard, limits);
+            Threads.wait_for_search_finished();
+        } else {
+            Searcher.start(searchBoard, limits);
+        }
 
-        Move bestMove = Searcher.best_move();
+        Move bestMove = pooledSearch ? Threads.best_move() : Searcher.best_move();
 
         StateInfo validationSi;
         Board validationBoard;
@@ -319,7 +385,7 @@ void UCIHandler::start_search(const SearchLimits& limits) {
 
         std::cout << "bestmove " << move_to_string(bestMove);
 
-        Move ponderMove = Searcher.ponder_move();
+        Move ponderMove = pooledSearch ? Threads.ponder_move() : Searcher.ponder_move();
         if (ponderMove != MOVE_NONE && bestMove != MOVE_NONE && options.ponder) {
             StateInfo si;
             validationBoard.do_move(bestMove, si);
@@ -352,6 +418,7 @@ void UCIHandler::start_search(const SearchLimits& limits) {
 void UCIHandler::wait_for_search() {
     if (searchThread.joinable()) {
         Searcher.stop();
+        Threads.stop();
         searchThread.join();
     }
 }
@@ -360,13 +427,18 @@ void UCIHandler::cmd_stop() {
     isPondering = false;
     Searcher.set_pondering(false);
     Searcher.stop();
+    Threads.stop();
     wait_for_search();
 }
 
 void UCIHandler::cmd_ponderhit() {
-    if (isPondering && Searcher.is_pondering()) {
+    if (isPondering && (pooledSearch || Searcher.is_pondering())) {
         options.ponderHits++;
-        Searcher.on_ponderhit();
+        if (pooledSearch) {
+            Threads.on_ponderhit();
+        } else {
+            Searcher.on_ponderhit();
+        }
         isPondering = false;
     }
 }
@@ -389,12 +461,43 @@ void UCIHandler::cmd_setoption(std::istringstream& is) {
     }
     if (name == "Hash") {
         options.hash = std::stoi(value);
-        TT.resize(options.hash);
+        resize_tt(options.hash);
+    } else if (name == "Large Pages") {
+        TT.set_large_pages(value == "true");
+        resize_tt(options.hash);
+    } else if (name == "Hash File") {
+        // An existing file decides the table size; a later Hash that differs
+        // from it starts the file over.
+        TT.set_hash_file(value == "<empty>" ? "" : value);
+        if (size_t mb = TT.hash_file_mb()) options.hash = int(mb);
+        resize_tt(options.hash);
+    } else if (name == "Hash Shared") {
+        // Joining an existing segment takes its size; a Hash that differs
+        // from it falls back to a private table.
+        TT.set_shared_name(value == "<empty>" ? "" : value);
+        if (size_t mb = TT.shared_mb()) options.hash = int(mb);
+        resize_tt(options.hash);
+    } else if (name == "Pawn Hash") {
+        options.pawnHash = std::stoi(value);
+        Searcher.set_pawn_hash(options.pawnHash);
+        Threads.set_pawn_hash(options.pawnHash);
     } else if (name == "Threads") {
         options.threads = std::stoi(value);
         Threads.set_thread_count(options.threads);
+        if (!TT.restored()) Threads.clear_tt();
+    } else if (name == "Thread Binding") {
+        Threads.set_binding(value == "true");
+        if (!TT.restored()) Threads.clear_tt();
+        if (Threads.binding()) {
+            std::cout << "info string Binding " << Threads.thread_count() << " threads to "
+                      << Affinity::describe() << std::endl;
+        }
+    } else if (name == "ABDADA") {
+        Threads.abdada = (value == "true");
     } else if (name == "MultiPV") {
         options.multiPV = std::stoi(value);
+    } else if (name == "Split MultiPV") {
+        Threads.splitMultiPV = (value == "true");
     } else if (name == "Ponder") {
         options.ponder = (value == "true");
     } else if (name == "Move Overhead") {
@@ -405,6 +508,18 @@ void UCIHandler::cmd_setoption(std::istringstream& is) {
     } else if (name == "SyzygyPath") {
         options.syzygyPath = value;
         Tablebase::TB.init(value);
+    } else if (name == "Use NNUE") {
+        options.useNNUE = (value == "true");
+        set_nnue(options.useNNUE);
+    } else if (name == "EvalFile") {
+        options.evalFile = value;
+        bool ok = (value.empty() || value == "<embedded>") ? NNUE::load_embedded() : NNUE::load(value);
+        if (ok) {
+            std::cout << "info string NNUE network " << NNUE::network_name() << " loaded" << std::endl;
+        } else {
+            std::cout << "info string NNUE network " << value << " could not be loaded" << std::endl;
+        }
+        set_nnue(options.useNNUE);
     }
     else if (name == "PawnValueMG") Tuning::PawnValue.mg = std::stoi(value);
     else if (name == "PawnValueEG") Tuning::PawnValue.eg = std::stoi(value);
@@ -425,9 +540,23 @@ void UCIHandler::cmd_setoption(std::istringstream& is) {
 
 void UCIHandler::cmd_perft(std::istringstream& is) {
     int depth = 6;
+    int threads = options.threads;
+    size_t hashMB = 0;
+    std::string mode, token;
     is >> depth;
+    while (is >> token) {
+        if (token == "threads") {
+            is >> threads;
+        } else if (token == "hash") {
+            is >> hashMB;
+        } else {
+            mode = token;
+        }
+    }
 
-    std::function<U64(Board&, int)> perft = [&](Board& b, int d) -> U64 {
+    // "pseudo" walks every leaf through the pseudo-legal generator plus
+    // is_legal(), for cross-checking the legal generator's bulk counts.
+    std::function<U64(Board&, int)> pseudo_perft = [&](Board& b, int d) -> U64 {
         if (d == 0) return 1;
 
         U64 nodes = 0;
@@ -440,7 +569,7 @@ void UCIHandler::cmd_perft(std::istringstream& is) {
 
             StateInfo si;
             b.do_move(m, si);
-            nodes += perft(b, d - 1);
+            nodes += pseudo_perft(b, d - 1);
             b.undo_move(m);
         }
 
@@ -448,7 +577,7 @@ void UCIHandler::cmd_perft(std::istringstream& is) {
     };
 
     auto start = std::chrono::steady_clock::now();
-    U64 nodes = perft(board, depth);
+    U64 nodes = mode == "pseudo" ? pseudo_perft(board, depth) : Perft::perft(board, depth, threads, hashMB);
     auto end = std::chrono::steady_clock::now();
 
     auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
@@ -460,44 +589,24 @@ void UCIHandler::cmd_perft(std::istringstream& is) {
 }
 
 void UCIHandler::cmd_divide(std::istringstream& is) {
-    int depth;
+    int depth = 1;
+    int threads = options.threads;
+    size_t hashMB = 0;
+    std::string token;
     is >> depth;
+    while (is >> token) {
+        if (token == "threads") is >> threads;
+        else if (token == "hash") is >> hashMB;
+    }
 
     std::cout << "Divide depth " << depth << std::endl;
 
     auto start = std::chrono::steady_clock::now();
-    U64 totalNodes = 0;
-
-    MoveList moves;
-    MoveGen::generate_all(board, moves);
+    std::vector<Perft::RootCount> counts;
+    U64 totalNodes = Perft::perft(board, std::max(1, depth), threads, hashMB, &counts);
 
-    std::function<U64(Board&, int)> perft_recursive = [&](Board& b, int d) -> U64 {
-        if (d == 0) return 1;
-        U64 nodes = 0;
-        MoveList mvs;
-        MoveGen::generate_all(b, mvs);
-        for (int i = 0; i < mvs.size(); ++i) {
-            Move m = mvs[i].move;
-            if (!MoveGen::is_legal(b, m)) continue;
-            StateInfo si;
-            b.do_move(m, si);
-            nodes += perft_recursive(b, d - 1);
-            b.undo_move(m);
-        }
-        return nodes;
-    };
-
-    for (int i = 0; i < moves.size(); ++i) {
-        Move m = moves[i].move;
-        if (!MoveGen::is_legal(board, m)) continue;
-
-        StateInfo si;
-        board.do_move(m, si);
-        U64 nodes = perft_recursive(board, depth - 1);
-        board.undo_move(m);
-
-        std::cout << move_to_string(m) << ": " << nodes << std::endl;
-        totalNodes += nodes;
+    for (const Perft::RootCount& rc : counts) {
+        std::cout << move_to_string(rc.move) << ": " << rc.nodes << std::endl;
     }
 
     auto end = std::chrono::steady_clock::now();
@@ -514,25 +623,146 @@ void UCIHandler::cmd_d() {
 
 void UCIHandler::cmd_eval() {
     int score = Searcher.evaluate(board);
-    std::cout << "Evaluation: " << score << " cp" << std::endl;
+    std::cout << "Evaluation: " << score << " cp ("
+              << (NNUE::enabled() ? "NNUE" : "classical") << ")" << std::endl;
     std::cout << "Side to move: " << (board.side_to_move() == WHITE ? "White" : "Black") << std::endl;
 }
 
+// microbench [kernel <name>]... [samples <n>] [ms <per sample>] [<epd>...]
+void UCIHandler::cmd_microbench(std::istringstream& is) {
+    MicroBench::Config config = MicroBench::parse_config(is);
+
+    wait_for_search();
+    Threads.wait_for_search_finished();
+
+    MicroBench::print(MicroBench::run(config));
+}
+
+void UCIHandler::cmd_savehash(std::istringstream& is) {
+    std::string path;
+    if (!(is >> path)) {
+        std::cerr << "Error: Use 'savehash <file>'" << std::endl;
+        return;
+    }
+
+    wait_for_search();
+    Threads.wait_for_search_finished();
+
+    auto start = std::chrono::steady_clock::now();
+    if (!TT.save(path)) {
+        std::cerr << "Error: Cannot write hash file " << path << std::endl;
+        return;
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "info string Saved " << TT.size_mb() << " MB hash to " << path
+              << " in " << ms << " ms" << std::endl;
+}
+
+void UCIHandler::cmd_loadhash(std::istringstream& is) {
+    std::string path;
+    if (!(is >> path)) {
+        std::cerr << "Error: Use 'loadhash <file>'" << std::endl;
+        return;
+    }
+
+    wait_for_search();
+    Threads.wait_for_search_finished();
+
+    auto start = std::chrono::steady_clock::now();
+    if (!TT.load(path)) {
+        std::cerr << "Error: Cannot load hash file " << path << std::endl;
+        options.hash = int(TT.size_mb());
+        return;
+    }
+    options.hash = int(TT.size_mb());
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "info string Loaded " << options.hash << " MB hash from " << path
+              << " in " << ms << " ms" << std::endl;
+}
+
+void UCIHandler::cmd_analyze(std::istringstream& is) {
+    Analysis::AnalysisConfig config = Analysis::parse_config(is);
+
+    if (config.epd_path.empty()) {
+        std::cerr << "Error: Use 'analyze <epd> depth|nodes|movetime <n> threads <t> output <file>'" << std::endl;
+        return;
+    }
+
+    wait_for_search();
+    Threads.wait_for_search_finished();
+
+    Analysis::AnalysisStats stats;
+    if (!Analysis::run(config, stats)) {
+        std::cerr << "Analysis failed!" << std::endl;
+    }
+}
+
+void UCIHandler::cmd_selfplay(std::istringstream& is) {
+    SelfPlay::SelfPlayConfig config = SelfPlay::parse_config(is);
+
+    wait_for_search();
+    Threads.wait_for_search_finished();
+
+    SelfPlay::SelfPlayStats stats;
+    if (!SelfPlay::run(config, stats)) {
+        std::cerr << "Self-play failed!" << std::endl;
+    }
+}
+
+void UCIHandler::cmd_profile(std::istringstream& is) {
+    std::string token;
+    is >> token;
+
+    wait_for_search();
+    Threads.wait_for_search_finished();
+
+    if (token == "reset") {
+        Profiler::reset();
+        std::cout << "info string profile counters cleared" << std::endl;
+        return;
+    }
+
+#ifdef PROFILING
+    Profiler::print_counters();
+    Profiler::print_results();
+#else
+    std::cout << "info string profile counters are recorded only by make internal-profile builds" << std::endl;
+#endif
+}
+
 void UCIHandler::cmd_bench(std::istringstream& is) {
     int depth = 13;
     int numThreads = 1;
     int hashMB = 16;
     std::string token;
-    if (is >> token) depth = std::stoi(token);
+    if (is >> token) {
+        if (token == "json") {
+            cmd_bench_json(is);
+            return;
+        }
+        depth = std::stoi(token);
+    }
     if (is >> token) numThreads = std::stoi(token);
     if (is >> token) hashMB = std::stoi(token);
 
+    // Optional slider backend override for A/B runs: "pext" or "magic".
+    Magics::Backend oldBackend = Magics::backend;
+    if (is >> token) Magics::init(token == "pext" ? Magics::PEXT : Magics::BLACK_MAGIC);
+
     depth = std::max(1, std::min(depth, 40));
     numThreads = std::max(1, std::min(numThreads, 128));
     hashMB = std::max(1, std::min(hashMB, 4096));
     int oldHash = options.hash;
     int oldThreads = options.threads;
-    TT.resize(hashMB);
+    // Bench runs in private memory so it never touches a mapped hash file
+    // or a table other processes are using.
+    std::string hashFile = TT.hash_file();
+    std::string sharedName = TT.shared_name();
+    TT.set_hash_file("");
+    TT.set_shared_name("");
+    TT.resize(hashMB, false);
     Threads.set_thread_count(numThreads);
 
     std::cout << "\n===============================================" << std::endl;
@@ -541,35 +771,24 @@ void UCIHandler::cmd_bench(std::istringstream& is) {
     std::cout << "Depth: " << depth << std::endl;
     std::cout << "Threads: " << numThreads << std::endl;
     std::cout << "Hash: " << hashMB << " MB" << std::endl;
+    std::cout << "Sliders: " << Magics::describe() << std::endl;
     std::cout << "===============================================\n" << std::endl;
 
-    const char* positions[] = {
-        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
-        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
-        "r1bqk1nr/pppp1ppp/2n5/2b1p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
-        "r1bqkbnr/pp1ppppp/2n5/2p5/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
-        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
-        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
-        "rnbqkb1r/ppp2ppp/4pn2/3p4/2PP4/2N5/PP2PPPP/R1BQKBNR w KQkq - 2 4",
-        "r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4",
-        "r1bqkbnr/pppp1ppp/2n5/1B2p3/4P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 3 3",
-        "8/8/4k3/3p4/3P1K2/8/8/8 w - - 0 1",
-        "r1bqr1k1/pp1nbppp/2p2n2/3p2B1/3P4/2NBP3/PPQ1NPPP/R3K2R w KQ - 3 10",
-        "r1bq1rk1/ppppbppp/2n2n2/4p3/2P5/5NP1/PP1PPPBP/RNBQ1RK1 w - - 5 6"
-    };
-
-    const int numPositions = sizeof(positions) / sizeof(positions[0]);
+    const std::vector<std::string>& positions = Bench::positions();
+    const int numPositions = int(positions.size());
 
     U64 totalNodes = 0;
     U64 totalTbHits = 0;
+    Eval::LazyStats totalLazy;
+    U64 totalDeferred = 0;
     int totalSelDepth = 0;
     int maxSelDepth = 0;
 
     auto startTotal = std::chrono::steady_clock::now();
 
-    TT.clear();
     Searcher.clear_history();
     Threads.clear_all_history();
+    Profiler::reset();
 
     for (int i = 0; i < numPositions; ++i) {
         StateInfo si;
@@ -584,24 +803,44 @@ void UCIHandler::cmd_bench(std::istringstream& is) {
         benchLimits.nodes = 100000000;
 
         auto posStart = std::chrono::steady_clock::now();
-        Searcher.start(benchBoard, benchLimits);
+        U64 posNodes;
+        int posSelDepth;
+
+        // More than one thread benches the Lazy SMP pool (with ABDADA if enabled).
+        if (numThreads > 1) {
+            benchLimits.infinite = true;
+            Threads.start_thinking(benchBoard, benchLimits);
+            Threads.wait_for_search_finished();
+
+            posNodes = Threads.total_nodes();
+            posSelDepth = Threads.max_sel_depth();
+            totalTbHits += Threads.total_tb_hits();
+            totalDeferred += Threads.total_deferred_moves();
+        } else {
+            Searcher.start(benchBoard, benchLimits);
+
+            const SearchStats& stats = Searcher.stats();
+            posNodes = stats.nodes;
+            posSelDepth = stats.selDepth;
+            totalTbHits += stats.tbHits;
+            totalLazy.exits += stats.lazy.exits;
+            totalLazy.spotChecks += stats.lazy.spotChecks;
+            totalLazy.spotCheckMisses += stats.lazy.spotCheckMisses;
+        }
         auto posEnd = std::chrono::steady_clock::now();
 
-        const SearchStats& stats = Searcher.stats();
-
         auto posTime = std::chrono::duration_cast<std::chrono::milliseconds>(posEnd - posStart).count();
-        U64 posNps = posTime > 0 ? stats.nodes * 1000 / posTime : stats.nodes;
+        U64 posNps = posTime > 0 ? posNodes * 1000 / posTime : posNodes;
 
-        std::cout << "  Nodes: " << stats.nodes
+        std::cout << "  Nodes: " << posNodes
                   << " | Time: " << posTime << "ms"
                   << " | NPS: " << posNps
-                  << " | SelDepth: " << stats.selDepth << std::endl;
+                  << " | SelDepth: " << posSelDepth << std::endl;
         std::cout << std::endl;
 
-        totalNodes += stats.nodes;
-        totalTbHits += stats.tbHits;
-        totalSelDepth += stats.selDepth;
-        maxSelDepth = std::max(maxSelDepth, stats.selDepth);
+        totalNodes += posNodes;
+        totalSelDepth += posSelDepth;
+        maxSelDepth = std::max(maxSelDepth, posSelDepth);
     }
 
     auto endTotal = std::chrono::steady_clock::now();
@@ -616,6 +855,12 @@ void UCIHandler::cmd_bench(std::istringstream& is) {
     std::cout << "Total Time    : " << totalTime << " ms" << std::endl;
     std::cout << "Nodes/Second  : " << avgNps << std::endl;
     std::cout << "TB Hits       : " << totalTbHits << std::endl;
+    std::cout << "Lazy Evals    : " << totalLazy.exits << " (spot-check misses "
+              << totalLazy.spotCheckMisses << "/" << totalLazy.spotChecks << ")" << std::endl;
+    if (numThreads > 1) {
+        std::cout << "Deferred Moves: " << totalDeferred
+                  << (Threads.abdada ? "" : " (ABDADA off)") << std::endl;
+    }
     std::cout << "Avg SelDepth  : " << std::fixed << std::setprecision(1) << avgSelDepth << std::endl;
     std::cout << "Max SelDepth  : " << maxSelDepth << std::endl;
     std::cout << "Positions     : " << numPositions << std::endl;
@@ -626,8 +871,101 @@ void UCIHandler::cmd_bench(std::istringstream& is) {
 
     Profiler::print_results();
     ProfilerAnalysis::analyze_bottlenecks();
-    TT.resize(oldHash);
+    TT.set_hash_file(hashFile);
+    TT.set_shared_name(sharedName);
+    TT.resize(oldHash, false);
     Threads.set_thread_count(oldThreads);
+    clear_resized_tt();
+    if (Magics::backend != oldBackend) Magics::init(oldBackend);
+}
+
+// bench json [depth <d>] [runs <n>] [threads <t>] [hash <mb>] [pext|magic] [output <file>]
+void UCIHandler::cmd_bench_json(std::istringstream& is) {
+    Bench::Config config;
+    int hashMB = 16;
+    std::string outputPath, token;
+
+    Magics::Backend oldBackend = Magics::backend;
+    while (is >> token) {
+        if (token == "depth") {
+            is >> config.depth;
+        } else if (token == "runs") {
+            is >> config.runs;
+        } else if (token == "threads") {
+            is >> config.threads;
+        } else if (token == "hash") {
+            is >> hashMB;
+        } else if (token == "output") {
+            is >> outputPath;
+        } else if (token == "pext" || token == "magic") {
+            Magics::init(token == "pext" ? Magics::PEXT : Magics::BLACK_MAGIC);
+        }
+    }
+
+    config.depth = std::max(1, std::min(config.depth, 40));
+    config.runs = std::max(1, std::min(config.runs, 1000));
+    config.threads = std::max(1, std::min(config.threads, 128));
+    hashMB = std::max(1, std::min(hashMB, 4096));
+    config.engine = ENGINE_NAME + " " + ENGINE_VERSION;
+    config.sliders = Magics::describe();
+
+    std::ofstream file;
+    if (!outputPath.empty()) {
+        file.open(outputPath);
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot open output file " << outputPath << std::endl;
+            if (Magics::backend != oldBackend) Magics::init(oldBackend);
+            return;
+        }
+    }
+
+    int oldHash = options.hash;
+    int oldThreads = options.threads;
+    // Bench runs in private memory so it never touches a mapped hash file
+    // or a table other processes are using.
+    std::string hashFile = TT.hash_file();
+    std::string sharedName = TT.shared_name();
+    TT.set_hash_file("");
+    TT.set_shared_name("");
+    TT.resize(hashMB, false);
+    Threads.set_thread_count(config.threads);
+
+    std::unique_ptr<PerfCounters::Group> perf;
+    if (config.threads == 1) {
+        perf = std::make_unique<PerfCounters::Group>();
+        if (!perf->available()) perf.reset();
+    }
+
+    std::vector<Bench::Run> runs;
+    for (int r = 0; r < config.runs; ++r) {
+        // Search info lines would interleave with the JSON, so stdout is
+        // muted for the duration of each run.
+        std::streambuf* coutBuf = std::cout.rdbuf(nullptr);
+        runs.push_back(Bench::run_once(config, perf.get()));
+        std::cout.rdbuf(coutBuf);
+        if (file.is_open()) {
+            U64 nodes = 0;
+            int64_t us = 0;
+            for (const Bench::PositionSample& p : runs.back()) {
+                nodes += p.nodes;
+                us += p.timeUs;
+            }
+            std::cout << "Run " << (r + 1) << "/" << config.runs << ": " << nodes << " nodes "
+                      << (us > 0 ? nodes * 1000000 / us : nodes) << " nps" << std::endl;
+        }
+    }
+
+    Bench::write_json(file.is_open() ? file : std::cout, config, runs);
+    if (file.is_open()) {
+        std::cout << "Wrote " << outputPath << (perf ? "" : " (no hardware counters)") << std::endl;
+    }
+
+    TT.set_hash_file(hashFile);
+    TT.set_shared_name(sharedName);
+    TT.resize(oldHash, false);
+    Threads.set_thread_count(oldThreads);
+    clear_resized_tt();
+    if (Magics::backend != oldBackend) Magics::init(oldBackend);
 }
 
 void UCIHandler::cmd_datagen(std::istringstream& is) {
@@ -698,6 +1036,28 @@ void UCIHandler::cmd_datagen(std::istringstream& is) {
         return;
     }
 
+    if (subcommand == "features") {
+        std::string binpack_path = "data/training.binpack";
+        std::string csv_path = "data/features.csv";
+        size_t max_entries = 0;
+
+        std::string token;
+        while (is >> token) {
+            if (token == "input" || token == "binpack") {
+                is >> binpack_path;
+            } else if (token == "output" || token == "csv") {
+                is >> csv_path;
+            } else if (token == "max" || token == "limit") {
+                is >> max_entries;
+            } else {
+                binpack_path = token;
+            }
+        }
+
+        DataGen::export_features(binpack_path, csv_path, max_entries);
+        return;
+    }
+
     if (subcommand == "stats") {
         std::string path = "data/training.binpack";
         std::string token;
@@ -710,6 +1070,11 @@ void UCIHandler::cmd_datagen(std::istringstream& is) {
             std::cout << "\n=== Training Data Statistics ===" << std::endl;
             std::cout << "File: " << path << std::endl;
             std::cout << "Total entries: " << stats.total_entries << std::endl;
+            std::ostringstream density;
+            density << std::fixed << std::setprecision(1)
+                    << (stats.total_entries > 0 ? double(stats.file_size) / stats.total_entries : 0.0);
+            std::cout << "Format: " << (stats.chained ? "chain" : "raw")
+                      << " (" << density.str() << " bytes/entry)" << std::endl;
             std::cout << "White wins: " << stats.white_wins
                       << " (" << (stats.total_entries > 0 ? stats.white_wins * 100.0 / stats.total_entries : 0) << "%)" << std::endl;
             std::cout << "Black wins: " << stats.black_wins
@@ -742,6 +1107,21 @@ void UCIHandler::cmd_datagen(std::istringstream& is) {
         return;
     }
 
+    if (subcommand == "merge") {
+        DataGen::MergeConfig config = DataGen::parse_merge_config(is);
+
+        if (config.inputs.empty() || config.output_path.empty()) {
+            std::cerr << "Error: Use 'datagen merge output <path> <input> [<input> ...]'" << std::endl;
+            return;
+        }
+
+        DataGen::MergeStats stats;
+        if (!DataGen::merge_binpacks(config, stats)) {
+            std::cerr << "Merge failed!" << std::endl;
+        }
+        return;
+    }
+
     if (subcommand == "help" || subcommand == "?") {
         std::cout << "\n=== Data Generation Commands ===" << std::endl;
         std::cout << "datagen start [options]  - Start data generation" << std::endl;
@@ -750,11 +1130,15 @@ void UCIHandler::cmd_datagen(std::istringstream& is) {
         std::cout << "datagen view [file]      - View binpack file contents" << std::endl;
         std::cout << "datagen stats [file]     - Show file statistics" << std::endl;
         std::cout << "datagen convert [opts]   - Convert binpack to EPD text format" << std::endl;
+        std::cout << "datagen features [opts]  - Export traced eval features as CSV for tuning" << std::endl;
         std::cout << "datagen filter [opts]    - Filter existing data for quiet positions" << std::endl;
+        std::cout << "datagen merge [opts]     - Merge, dedup and shuffle binpacks into one raw file" << std::endl;
 
         std::cout << "\nOptions for 'datagen start':" << std::endl;
         std::cout << "  threads <n>      - Number of worker threads (default: 1)" << std::endl;
-        std::cout << "  hash <mb>        - Hash table size in MB (default: 16)" << std::endl;
+        std::cout << "  hash <mb>        - Hash in MB, split into one private table per thread (default: 64)" << std::endl;
+        std::cout << "  seed <n>         - Base seed; the same seed replays the same games (default: clock)" << std::endl;
+        std::cout << "  shard=<i>/<n>    - Play shard i of an n-machine run; use the same seed everywhere" << std::endl;
         std::cout << "  depth <n>        - Search depth (default: 8)" << std::endl;
         std::cout << "  nodes <n>        - Node limit per move (default: 5000)" << std::endl;
         std::cout << "  games <n>        - Number of games to play (default: 100000)" << std::endl;
@@ -769,6 +1153,9 @@ void UCIHandler::cmd_datagen(std::istringstream& is) {
         std::cout << "  qsearch <cp>     - QSearch quietness margin (default: 60)" << std::endl;
         std::cout << "  search_margin <cp>  - Search margin for quiet detection (default: 70)" << std::endl;
         std::cout << "  max_score <cp>   - Skip positions with |score| > max (default: 2500)" << std::endl;
+        std::cout << "  format=chain     - Write the game-chained compressed format (default: raw)" << std::endl;
+        std::cout << "  batch <n>        - Entries per worker batch handed to the writer (default: 4096)" << std::endl;
+        std::cout << "  sync <mb>        - fdatasync the output every <mb> MB written (default: off)" << std::endl;
 
         std::cout << "\nOptions for 'datagen filter':" << std::endl;
         std::cout << "  input <path>     - Input binpack file (required)" << std::endl;
@@ -777,6 +1164,14 @@ void UCIHandler::cmd_datagen(std::istringstream& is) {
         std::cout << "  max_score <cp>   - Max absolute score to keep (default: 2500)" << std::endl;
         std::cout << "  eval_limit <cp>  - Clamp scores to +/-limit without discarding (default: disabled)" << std::endl;
 
+        std::cout << "\nOptions for 'datagen merge':" << std::endl;
+        std::cout << "  output <path>    - Output raw binpack (required)" << std::endl;
+        std::cout << "  <path> ...       - Input files, raw or chained" << std::endl;
+        std::cout << "  shuffle <n>      - Shuffle buffer in entries (default: 1048576, 0 = off)" << std::endl;
+        std::cout << "  dedup_mb <mb>    - Memory for the position-hash dedup table (default: 256)" << std::endl;
+        std::cout << "  nodedup          - Keep repeated positions" << std::endl;
+        std::cout << "  seed <n>         - Seed for interleaving and shuffling" << std::endl;
+
         std::cout << "\nOptions for 'datagen view':" << std::endl;
         std::cout << "  file <path>      - File to view (default: data/training.binpack)" << std::endl;
         std::cout << "  count <n>        - Number of entries to show (default: 10)" << std::endl;
@@ -787,6 +1182,11 @@ void UCIHandler::cmd_datagen(std::istringstream& is) {
         std::cout << "  output <path>    - EPD output file path" << std::endl;
         std::cout << "  max <n>          - Maximum entries to convert (0 = all)" << std::endl;
 
+        std::cout << "\nOptions for 'datagen features':" << std::endl;
+        std::cout << "  input <path>     - Binpack file to export" << std::endl;
+        std::cout << "  output <path>    - CSV output file path (default: data/features.csv)" << std::endl;
+        std::cout << "  max <n>          - Maximum entries to export (0 = all)" << std::endl;
+
         std::cout << "\nExamples:" << std::endl;
         std::cout << "  datagen start threads 8 depth 8 games 1000000" << std::endl;
         std::cout << "  datagen start threads 8 depth 9 qsearch 60 games 500000" << std::endl;
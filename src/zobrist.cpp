@@ -1,27 +1,21 @@
 #include "zobrist.hpp"
-#include <random>
 
 namespace Zobrist {
 
-Key PieceSquare[PIECE_NB][SQUARE_NB];
-Key Castling[CASTLING_RIGHT_NB];
-Key EnPassant[FILE_NB];
-Key SideToMove;
-
 namespace {
 
 class PRNG {
 public:
-    explicit PRNG(U64 seed) : state(seed) {}
+    constexpr explicit PRNG(U64 seed) : state(seed) {}
 
-    U64 next() {
+    constexpr U64 next() {
         U64 z = (state += 0x9e3779b97f4a7c15ULL);
         z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
         z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
         return z ^ (z >> 31);
     }
 
-    U64 sparse() {
+    constexpr U64 sparse() {
         return next() & next() & next();
     }
 
@@ -29,60 +23,126 @@ private:
     U64 state;
 };
 
-}
-
-void init() {
+constexpr std::array<std::array<Key, SQUARE_NB>, PIECE_NB> make_piece_square() {
+    std::array<std::array<Key, SQUARE_NB>, PIECE_NB> keys{};
     PRNG rng(1070372ULL);
 
     for (Piece pc = NO_PIECE; pc < PIECE_NB; ++pc) {
         for (Square sq = SQ_A1; sq <= SQ_H8; ++sq) {
             if (pc != NO_PIECE && type_of(pc) != NO_PIECE_TYPE) {
-                PieceSquare[pc][sq] = rng.next();
-            } else {
-                PieceSquare[pc][sq] = 0;
+                keys[pc][sq] = rng.next();
             }
         }
     }
 
-    for (int cr = 0; cr < CASTLING_RIGHT_NB; ++cr) {
-        Castling[cr] = 0;
+    return keys;
+}
 
-        Key k = 0;
-        if (cr & WHITE_OO)  k ^= rng.next();
-        else rng.next();
+// Castling, en passant and side to move share a second stream: one key per
+// castling right, then the files, then the side.
+constexpr int CASTLING_STREAM = 0;
+constexpr int EN_PASSANT_STREAM = 4;
+constexpr int SIDE_STREAM = EN_PASSANT_STREAM + FILE_NB;
+
+constexpr std::array<Key, SIDE_STREAM + 1> make_state_stream() {
+    std::array<Key, SIDE_STREAM + 1> keys{};
+    PRNG rng(31337ULL);
+    for (Key& k : keys) {
+        k = rng.next();
+    }
+    return keys;
+}
 
-        if (cr & WHITE_OOO) k ^= rng.next();
-        else rng.next();
+constexpr std::array<Key, SIDE_STREAM + 1> StateStream = make_state_stream();
 
-        if (cr & BLACK_OO)  k ^= rng.next();
-        else rng.next();
+constexpr std::array<Key, CASTLING_RIGHT_NB> make_castling() {
+    std::array<Key, CASTLING_RIGHT_NB> keys{};
+    for (int cr = 0; cr < CASTLING_RIGHT_NB; ++cr) {
+        if (cr & WHITE_OO)  keys[cr] ^= StateStream[CASTLING_STREAM + 0];
+        if (cr & WHITE_OOO) keys[cr] ^= StateStream[CASTLING_STREAM + 1];
+        if (cr & BLACK_OO)  keys[cr] ^= StateStream[CASTLING_STREAM + 2];
+        if (cr & BLACK_OOO) keys[cr] ^= StateStream[CASTLING_STREAM + 3];
+    }
+    return keys;
+}
 
-        if (cr & BLACK_OOO) k ^= rng.next();
-        else rng.next();
+constexpr std::array<Key, FILE_NB> make_en_passant() {
+    std::array<Key, FILE_NB> keys{};
+    for (File f = FILE_A; f <= FILE_H; ++f) {
+        keys[f] = StateStream[EN_PASSANT_STREAM + f];
+    }
+    return keys;
+}
 
-        Castling[cr] = k;
+// Whether a piece of this type reaches s2 from s1 on an empty board; the
+// attack tables themselves live in other translation units.
+constexpr bool reaches(PieceType pt, Square s1, Square s2) {
+    int df = file_of(s2) - file_of(s1);
+    int dr = rank_of(s2) - rank_of(s1);
+    df = df < 0 ? -df : df;
+    dr = dr < 0 ? -dr : dr;
+
+    bool straight = df == 0 || dr == 0;
+    bool diagonal = df == dr;
+    switch (pt) {
+        case KNIGHT: return (df == 1 && dr == 2) || (df == 2 && dr == 1);
+        case BISHOP: return diagonal;
+        case ROOK:   return straight;
+        case QUEEN:  return straight || diagonal;
+        case KING:   return df <= 1 && dr <= 1;
+        default:     return false;
     }
+}
+
+struct CuckooTables {
+    std::array<Key, CUCKOO_SIZE> keys{};
+    std::array<Move, CUCKOO_SIZE> moves{};
+};
 
-    Key castling_right_keys[4];
-    rng = PRNG(31337ULL);
+}
 
-    for (int i = 0; i < 4; ++i) {
-        castling_right_keys[i] = rng.next();
-    }
+constexpr std::array<std::array<Key, SQUARE_NB>, PIECE_NB> PieceSquare = make_piece_square();
+constexpr std::array<Key, CASTLING_RIGHT_NB> Castling = make_castling();
+constexpr std::array<Key, FILE_NB> EnPassant = make_en_passant();
+constexpr Key SideToMove = StateStream[SIDE_STREAM];
 
-    for (int cr = 0; cr < CASTLING_RIGHT_NB; ++cr) {
-        Castling[cr] = 0;
-        if (cr & WHITE_OO)  Castling[cr] ^= castling_right_keys[0];
-        if (cr & WHITE_OOO) Castling[cr] ^= castling_right_keys[1];
-        if (cr & BLACK_OO)  Castling[cr] ^= castling_right_keys[2];
-        if (cr & BLACK_OOO) Castling[cr] ^= castling_right_keys[3];
-    }
+namespace {
 
-    for (File f = FILE_A; f <= FILE_H; ++f) {
-        EnPassant[f] = rng.next();
+constexpr CuckooTables make_cuckoo() {
+    CuckooTables t;
+
+    for (Piece pc = NO_PIECE; pc < PIECE_NB; ++pc) {
+        if (pc == NO_PIECE || type_of(pc) == NO_PIECE_TYPE || type_of(pc) == PAWN) continue;
+
+        for (Square s1 = SQ_A1; s1 <= SQ_H8; ++s1) {
+            for (Square s2 = Square(s1 + 1); s2 <= SQ_H8; ++s2) {
+                if (!reaches(type_of(pc), s1, s2)) continue;
+
+                Move move = Move::make(s1, s2);
+                Key key = PieceSquare[pc][s1] ^ PieceSquare[pc][s2] ^ SideToMove;
+                int i = cuckoo_h1(key);
+                while (true) {
+                    Key k = t.keys[i];
+                    t.keys[i] = key;
+                    key = k;
+                    Move m = t.moves[i];
+                    t.moves[i] = move;
+                    move = m;
+                    if (move == MOVE_NONE) break;
+                    i = (i == cuckoo_h1(key)) ? cuckoo_h2(key) : cuckoo_h1(key);
+                }
+            }
+        }
     }
 
-    SideToMove = rng.next();
+    return t;
 }
 
+constexpr CuckooTables CuckooData = make_cuckoo();
+
+}
+
+constexpr std::array<Key, CUCKOO_SIZE> Cuckoo = CuckooData.keys;
+constexpr std::array<Move, CUCKOO_SIZE> CuckooMove = CuckooData.moves;
+
 }
@@ -1,13 +1,21 @@
 // ============================================================================
 // Texel Tuning Implementation - Ultra-Fast Version (v6)
 // ============================================================================
-// Usage: tuner.exe <epd_file> [max_positions] [iterations] [manual_K]
+// Usage: tuner.exe <epd_file> [max_positions] [iterations] [manual_K] [--gradient]
 //
 // OPTIMIZED APPROACH:
 // 1. Pre-compute base scores for all positions ONCE
 // 2. When testing a parameter change, only recalculate error (not re-evaluate)
 // 3. Use multi-threading to test multiple parameters simultaneously
 // 4. K value minimum clamped to 0.5 to prevent flat sigmoid
+//
+// GRADIENT MODE (--gradient):
+// 1. Linearise the eval around the current parameters once per round with
+//    one traced evaluation per position (Eval::trace), storing one
+//    coefficient column per parameter. These match the central differences
+//    (step 4) they replaced to within the eval's integer truncation
+// 2. Run Adam on the linear model with an AVX2/AVX-512 error+gradient kernel
+// 3. Round, re-linearise and repeat for GRADIENT_ROUNDS rounds
 // ============================================================================
 
 #include <iostream>
@@ -25,6 +33,10 @@
 #include <mutex>
 #include <future>
 
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 #include "../include/board.hpp"
 #include "../include/eval.hpp"
 #include "../include/magic.hpp"
@@ -37,19 +49,29 @@
 
 unsigned int NUM_THREADS = std::thread::hardware_concurrency();
 
+constexpr int GRADIENT_ROUNDS = 3;
+constexpr double ADAM_LR = 1.0;
+constexpr double ADAM_BETA1 = 0.9;
+constexpr double ADAM_BETA2 = 0.999;
+
 // ============================================================================
 // Tunable Parameter Structure
 // ============================================================================
 
+// Coefficient of KingSafetyWeight, which scales the traced king danger
+// rather than counting an S() term.
+constexpr int TRACE_KING_DANGER = Eval::TRACE_TERM_NB;
+
 struct TunableParam {
     std::string name;
     int* value_ptr;
     int min_val;
     int max_val;
     bool is_mg;
+    int trace_term;  // Eval::TraceTerm, or TRACE_KING_DANGER
 
-    TunableParam(const std::string& n, int* ptr, int min_v, int max_v, bool mg = true)
-        : name(n), value_ptr(ptr), min_val(min_v), max_val(max_v), is_mg(mg) {}
+    TunableParam(const std::string& n, int* ptr, int min_v, int max_v, bool mg, int term)
+        : name(n), value_ptr(ptr), min_val(min_v), max_val(max_v), is_mg(mg), trace_term(term) {}
 };
 
 // ============================================================================
@@ -78,43 +100,43 @@ void init_params() {
     params.clear();
 
     // Material Values
-    params.push_back(TunableParam("PawnValue_MG",           &Tuning::PawnValue.mg,            70,  130, true));
-    params.push_back(TunableParam("PawnValue_EG",           &Tuning::PawnValue.eg,           100,  160, false));
-    params.push_back(TunableParam("KnightValue_MG",         &Tuning::KnightValue.mg,         320,  360, true));
-    params.push_back(TunableParam("KnightValue_EG",         &Tuning::KnightValue.eg,         340,  380, false));
-    params.push_back(TunableParam("BishopValue_MG",         &Tuning::BishopValue.mg,         330,  370, true));
-    params.push_back(TunableParam("BishopValue_EG",         &Tuning::BishopValue.eg,         350,  390, false));
-    params.push_back(TunableParam("RookValue_MG",           &Tuning::RookValue.mg,           500,  550, true));
-    params.push_back(TunableParam("RookValue_EG",           &Tuning::RookValue.eg,           550,  600, false));
-    params.push_back(TunableParam("QueenValue_MG",          &Tuning::QueenValue.mg,          950, 1050, true));
-    params.push_back(TunableParam("QueenValue_EG",          &Tuning::QueenValue.eg,          900, 1100, false));
+    params.push_back(TunableParam("PawnValue_MG",           &Tuning::PawnValue.mg,            70,  130, true, Eval::TRACE_PAWN_VALUE));
+    params.push_back(TunableParam("PawnValue_EG",           &Tuning::PawnValue.eg,           100,  160, false, Eval::TRACE_PAWN_VALUE));
+    params.push_back(TunableParam("KnightValue_MG",         &Tuning::KnightValue.mg,         320,  360, true, Eval::TRACE_KNIGHT_VALUE));
+    params.push_back(TunableParam("KnightValue_EG",         &Tuning::KnightValue.eg,         340,  380, false, Eval::TRACE_KNIGHT_VALUE));
+    params.push_back(TunableParam("BishopValue_MG",         &Tuning::BishopValue.mg,         330,  370, true, Eval::TRACE_BISHOP_VALUE));
+    params.push_back(TunableParam("BishopValue_EG",         &Tuning::BishopValue.eg,         350,  390, false, Eval::TRACE_BISHOP_VALUE));
+    params.push_back(TunableParam("RookValue_MG",           &Tuning::RookValue.mg,           500,  550, true, Eval::TRACE_ROOK_VALUE));
+    params.push_back(TunableParam("RookValue_EG",           &Tuning::RookValue.eg,           550,  600, false, Eval::TRACE_ROOK_VALUE));
+    params.push_back(TunableParam("QueenValue_MG",          &Tuning::QueenValue.mg,          950, 1050, true, Eval::TRACE_QUEEN_VALUE));
+    params.push_back(TunableParam("QueenValue_EG",          &Tuning::QueenValue.eg,          900, 1100, false, Eval::TRACE_QUEEN_VALUE));
 
     // Piece Activity Bonuses
-    params.push_back(TunableParam("BishopPairBonus_MG",     &Tuning::BishopPairBonus.mg,       0,  60, true));
-    params.push_back(TunableParam("BishopPairBonus_EG",     &Tuning::BishopPairBonus.eg,       0,  80, false));
-    params.push_back(TunableParam("RookOpenFileBonus_MG",   &Tuning::RookOpenFileBonus.mg,     0,   40, true));
-    params.push_back(TunableParam("RookOpenFileBonus_EG",   &Tuning::RookOpenFileBonus.eg,     0,   50, false));
-    params.push_back(TunableParam("RookSemiOpenFileBonus_MG", &Tuning::RookSemiOpenFileBonus.mg, 0,   30, true));
-    params.push_back(TunableParam("RookSemiOpenFileBonus_EG", &Tuning::RookSemiOpenFileBonus.eg, 0,   40, false));
-    params.push_back(TunableParam("RookOnSeventhBonus_MG",  &Tuning::RookOnSeventhBonus.mg,    0,   50, true));
-    params.push_back(TunableParam("RookOnSeventhBonus_EG",  &Tuning::RookOnSeventhBonus.eg,    0,   60, false));
-    params.push_back(TunableParam("KnightOutpostBonus_MG",  &Tuning::KnightOutpostBonus.mg,    0,   50, true));
-    params.push_back(TunableParam("KnightOutpostBonus_EG",  &Tuning::KnightOutpostBonus.eg,    0,   40, false));
+    params.push_back(TunableParam("BishopPairBonus_MG",     &Tuning::BishopPairBonus.mg,       0,  60, true, Eval::TRACE_BISHOP_PAIR));
+    params.push_back(TunableParam("BishopPairBonus_EG",     &Tuning::BishopPairBonus.eg,       0,  80, false, Eval::TRACE_BISHOP_PAIR));
+    params.push_back(TunableParam("RookOpenFileBonus_MG",   &Tuning::RookOpenFileBonus.mg,     0,   40, true, Eval::TRACE_ROOK_OPEN_FILE));
+    params.push_back(TunableParam("RookOpenFileBonus_EG",   &Tuning::RookOpenFileBonus.eg,     0,   50, false, Eval::TRACE_ROOK_OPEN_FILE));
+    params.push_back(TunableParam("RookSemiOpenFileBonus_MG", &Tuning::RookSemiOpenFileBonus.mg, 0,   30, true, Eval::TRACE_ROOK_SEMI_OPEN_FILE));
+    params.push_back(TunableParam("RookSemiOpenFileBonus_EG", &Tuning::RookSemiOpenFileBonus.eg, 0,   40, false, Eval::TRACE_ROOK_SEMI_OPEN_FILE));
+    params.push_back(TunableParam("RookOnSeventhBonus_MG",  &Tuning::RookOnSeventhBonus.mg,    0,   50, true, Eval::TRACE_ROOK_ON_SEVENTH));
+    params.push_back(TunableParam("RookOnSeventhBonus_EG",  &Tuning::RookOnSeventhBonus.eg,    0,   60, false, Eval::TRACE_ROOK_ON_SEVENTH));
+    params.push_back(TunableParam("KnightOutpostBonus_MG",  &Tuning::KnightOutpostBonus.mg,    0,   50, true, Eval::TRACE_KNIGHT_OUTPOST));
+    params.push_back(TunableParam("KnightOutpostBonus_EG",  &Tuning::KnightOutpostBonus.eg,    0,   40, false, Eval::TRACE_KNIGHT_OUTPOST));
 
     // Pawn Structure
-    params.push_back(TunableParam("IsolatedPawnPenalty_MG", &Tuning::IsolatedPawnPenalty.mg, -70,    0, true));
-    params.push_back(TunableParam("IsolatedPawnPenalty_EG", &Tuning::IsolatedPawnPenalty.eg, -50,    0, false));
-    params.push_back(TunableParam("DoubledPawnPenalty_MG",  &Tuning::DoubledPawnPenalty.mg,  -40,    0, true));
-    params.push_back(TunableParam("DoubledPawnPenalty_EG",  &Tuning::DoubledPawnPenalty.eg,  -50,    0, false));
-    params.push_back(TunableParam("BackwardPawnPenalty_MG", &Tuning::BackwardPawnPenalty.mg, -30,    0, true));
-    params.push_back(TunableParam("BackwardPawnPenalty_EG", &Tuning::BackwardPawnPenalty.eg, -35,    0, false));
-    params.push_back(TunableParam("ConnectedPawnBonus_MG",  &Tuning::ConnectedPawnBonus.mg,    0,   20, true));
-    params.push_back(TunableParam("ConnectedPawnBonus_EG",  &Tuning::ConnectedPawnBonus.eg,    0,   15, false));
-    params.push_back(TunableParam("PhalanxBonus_MG",        &Tuning::PhalanxBonus.mg,          0,   25, true));
-    params.push_back(TunableParam("PhalanxBonus_EG",        &Tuning::PhalanxBonus.eg,          0,   20, false));
+    params.push_back(TunableParam("IsolatedPawnPenalty_MG", &Tuning::IsolatedPawnPenalty.mg, -70,    0, true, Eval::TRACE_ISOLATED_PAWN));
+    params.push_back(TunableParam("IsolatedPawnPenalty_EG", &Tuning::IsolatedPawnPenalty.eg, -50,    0, false, Eval::TRACE_ISOLATED_PAWN));
+    params.push_back(TunableParam("DoubledPawnPenalty_MG",  &Tuning::DoubledPawnPenalty.mg,  -40,    0, true, Eval::TRACE_DOUBLED_PAWN));
+    params.push_back(TunableParam("DoubledPawnPenalty_EG",  &Tuning::DoubledPawnPenalty.eg,  -50,    0, false, Eval::TRACE_DOUBLED_PAWN));
+    params.push_back(TunableParam("BackwardPawnPenalty_MG", &Tuning::BackwardPawnPenalty.mg, -30,    0, true, Eval::TRACE_BACKWARD_PAWN));
+    params.push_back(TunableParam("BackwardPawnPenalty_EG", &Tuning::BackwardPawnPenalty.eg, -35,    0, false, Eval::TRACE_BACKWARD_PAWN));
+    params.push_back(TunableParam("ConnectedPawnBonus_MG",  &Tuning::ConnectedPawnBonus.mg,    0,   20, true, Eval::TRACE_CONNECTED_PAWN));
+    params.push_back(TunableParam("ConnectedPawnBonus_EG",  &Tuning::ConnectedPawnBonus.eg,    0,   15, false, Eval::TRACE_CONNECTED_PAWN));
+    params.push_back(TunableParam("PhalanxBonus_MG",        &Tuning::PhalanxBonus.mg,          0,   25, true, Eval::TRACE_PHALANX));
+    params.push_back(TunableParam("PhalanxBonus_EG",        &Tuning::PhalanxBonus.eg,          0,   20, false, Eval::TRACE_PHALANX));
 
     // King Safety
-    params.push_back(TunableParam("KingSafetyWeight",       &Tuning::KingSafetyWeight,        50,  150, true));
+    params.push_back(TunableParam("KingSafetyWeight",       &Tuning::KingSafetyWeight,        50,  150, true, TRACE_KING_DANGER));
 
     std::cout << "Initialized " << params.size() << " tunable parameters\n";
 }
@@ -184,7 +206,9 @@ bool load_positions(const std::string& filename, size_t max_positions = 0) {
 void precompute_scores_worker(size_t start, size_t end) {
     for (size_t i = start; i < end; ++i) {
         Board board(positions[i].fen);
-        positions[i].base_score = Eval::evaluate_no_cache(board);
+        // Results are from White's point of view, the eval from the side to move's
+        int score = Eval::evaluate_no_cache(board);
+        positions[i].base_score = board.side_to_move() == WHITE ? score : -score;
     }
 }
 
@@ -321,6 +345,36 @@ double find_optimal_k(double manual_k = 0.0) {
     return best_k;
 }
 
+// ============================================================================
+// Print Tuned Values
+// ============================================================================
+
+void print_final_values() {
+    std::cout << "\n=== FINAL TUNED VALUES ===\n\n";
+    std::cout << "// Copy to tuning.cpp:\n\n";
+
+    std::cout << "EvalScore PawnValue           = S(" << std::setw(4) << Tuning::PawnValue.mg << ", " << std::setw(4) << Tuning::PawnValue.eg << ");\n";
+    std::cout << "EvalScore KnightValue         = S(" << std::setw(4) << Tuning::KnightValue.mg << ", " << std::setw(4) << Tuning::KnightValue.eg << ");\n";
+    std::cout << "EvalScore BishopValue         = S(" << std::setw(4) << Tuning::BishopValue.mg << ", " << std::setw(4) << Tuning::BishopValue.eg << ");\n";
+    std::cout << "EvalScore RookValue           = S(" << std::setw(4) << Tuning::RookValue.mg << ", " << std::setw(4) << Tuning::RookValue.eg << ");\n";
+    std::cout << "EvalScore QueenValue          = S(" << std::setw(4) << Tuning::QueenValue.mg << ", " << std::setw(4) << Tuning::QueenValue.eg << ");\n";
+
+    std::cout << "EvalScore BishopPairBonus     = S(" << std::setw(4) << Tuning::BishopPairBonus.mg << ", " << std::setw(4) << Tuning::BishopPairBonus.eg << ");\n";
+    std::cout << "EvalScore RookOpenFileBonus   = S(" << std::setw(4) << Tuning::RookOpenFileBonus.mg << ", " << std::setw(4) << Tuning::RookOpenFileBonus.eg << ");\n";
+    std::cout << "EvalScore RookSemiOpenFileBonus = S(" << std::setw(4) << Tuning::RookSemiOpenFileBonus.mg << ", " << std::setw(4) << Tuning::RookSemiOpenFileBonus.eg << ");\n";
+    std::cout << "EvalScore RookOnSeventhBonus  = S(" << std::setw(4) << Tuning::RookOnSeventhBonus.mg << ", " << std::setw(4) << Tuning::RookOnSeventhBonus.eg << ");\n";
+    std::cout << "EvalScore KnightOutpostBonus  = S(" << std::setw(4) << Tuning::KnightOutpostBonus.mg << ", " << std::setw(4) << Tuning::KnightOutpostBonus.eg << ");\n";
+
+    std::cout << "EvalScore IsolatedPawnPenalty = S(" << std::setw(4) << Tuning::IsolatedPawnPenalty.mg << ", " << std::setw(4) << Tuning::IsolatedPawnPenalty.eg << ");\n";
+    std::cout << "EvalScore DoubledPawnPenalty  = S(" << std::setw(4) << Tuning::DoubledPawnPenalty.mg << ", " << std::setw(4) << Tuning::DoubledPawnPenalty.eg << ");\n";
+    std::cout << "EvalScore BackwardPawnPenalty = S(" << std::setw(4) << Tuning::BackwardPawnPenalty.mg << ", " << std::setw(4) << Tuning::BackwardPawnPenalty.eg << ");\n";
+    std::cout << "EvalScore ConnectedPawnBonus  = S(" << std::setw(4) << Tuning::ConnectedPawnBonus.mg << ", " << std::setw(4) << Tuning::ConnectedPawnBonus.eg << ");\n";
+    std::cout << "EvalScore PhalanxBonus        = S(" << std::setw(4) << Tuning::PhalanxBonus.mg << ", " << std::setw(4) << Tuning::PhalanxBonus.eg << ");\n";
+
+    std::cout << "int KingSafetyWeight          = " << std::setw(4) << Tuning::KingSafetyWeight << ";\n";
+
+}
+
 // ============================================================================
 // Tune Parameters using Local Search with Parallel Evaluation
 // ============================================================================
@@ -421,29 +475,366 @@ void tune_parameters(int iterations = 100) {
         }
     }
 
-    // Print final values
-    std::cout << "\n=== FINAL TUNED VALUES ===\n\n";
-    std::cout << "// Copy to tuning.cpp:\n\n";
+    print_final_values();
 
-    std::cout << "EvalScore PawnValue           = S(" << std::setw(4) << Tuning::PawnValue.mg << ", " << std::setw(4) << Tuning::PawnValue.eg << ");\n";
-    std::cout << "EvalScore KnightValue         = S(" << std::setw(4) << Tuning::KnightValue.mg << ", " << std::setw(4) << Tuning::KnightValue.eg << ");\n";
-    std::cout << "EvalScore BishopValue         = S(" << std::setw(4) << Tuning::BishopValue.mg << ", " << std::setw(4) << Tuning::BishopValue.eg << ");\n";
-    std::cout << "EvalScore RookValue           = S(" << std::setw(4) << Tuning::RookValue.mg << ", " << std::setw(4) << Tuning::RookValue.eg << ");\n";
-    std::cout << "EvalScore QueenValue          = S(" << std::setw(4) << Tuning::QueenValue.mg << ", " << std::setw(4) << Tuning::QueenValue.eg << ");\n";
+    double improvement = (initial_error - best_error) * 100 / initial_error;
+    std::cout << "\n=== Tuning Complete ===\n";
+    std::cout << "Initial error: " << std::setprecision(8) << initial_error << "\n";
+    std::cout << "Final error:   " << best_error << "\n";
+    std::cout << "Improvement:   " << std::setprecision(4) << improvement << "%\n";
+}
 
-    std::cout << "EvalScore BishopPairBonus     = S(" << std::setw(4) << Tuning::BishopPairBonus.mg << ", " << std::setw(4) << Tuning::BishopPairBonus.eg << ");\n";
-    std::cout << "EvalScore RookOpenFileBonus   = S(" << std::setw(4) << Tuning::RookOpenFileBonus.mg << ", " << std::setw(4) << Tuning::RookOpenFileBonus.eg << ");\n";
-    std::cout << "EvalScore RookSemiOpenFileBonus = S(" << std::setw(4) << Tuning::RookSemiOpenFileBonus.mg << ", " << std::setw(4) << Tuning::RookSemiOpenFileBonus.eg << ");\n";
-    std::cout << "EvalScore RookOnSeventhBonus  = S(" << std::setw(4) << Tuning::RookOnSeventhBonus.mg << ", " << std::setw(4) << Tuning::RookOnSeventhBonus.eg << ");\n";
-    std::cout << "EvalScore KnightOutpostBonus  = S(" << std::setw(4) << Tuning::KnightOutpostBonus.mg << ", " << std::setw(4) << Tuning::KnightOutpostBonus.eg << ");\n";
+// ============================================================================
+// Linear Feature Matrix (structure of arrays)
+// ============================================================================
+// eval(pos) ~= base[pos] + sum_p coeffs[p][pos] * (value_p - origin[p])
+// Each coefficient column is contiguous over positions so the kernel below
+// streams it with full-width vector loads.
 
-    std::cout << "EvalScore IsolatedPawnPenalty = S(" << std::setw(4) << Tuning::IsolatedPawnPenalty.mg << ", " << std::setw(4) << Tuning::IsolatedPawnPenalty.eg << ");\n";
-    std::cout << "EvalScore DoubledPawnPenalty  = S(" << std::setw(4) << Tuning::DoubledPawnPenalty.mg << ", " << std::setw(4) << Tuning::DoubledPawnPenalty.eg << ");\n";
-    std::cout << "EvalScore BackwardPawnPenalty = S(" << std::setw(4) << Tuning::BackwardPawnPenalty.mg << ", " << std::setw(4) << Tuning::BackwardPawnPenalty.eg << ");\n";
-    std::cout << "EvalScore ConnectedPawnBonus  = S(" << std::setw(4) << Tuning::ConnectedPawnBonus.mg << ", " << std::setw(4) << Tuning::ConnectedPawnBonus.eg << ");\n";
-    std::cout << "EvalScore PhalanxBonus        = S(" << std::setw(4) << Tuning::PhalanxBonus.mg << ", " << std::setw(4) << Tuning::PhalanxBonus.eg << ");\n";
+struct FeatureMatrix {
+    std::vector<float> base;
+    std::vector<float> result;
+    std::vector<std::vector<float>> coeffs;
+    std::vector<int> origin;
 
-    std::cout << "int KingSafetyWeight          = " << std::setw(4) << Tuning::KingSafetyWeight << ";\n";
+    size_t size() const { return base.size(); }
+};
+
+FeatureMatrix features;
+
+// Coefficient of parameter p in a traced position, from White's point of
+// view: S() terms count White minus Black, weighted by the phase share of
+// their half; KingSafetyWeight scales the mg king danger in percent.
+float trace_coefficient(const TunableParam& param, const Eval::EvalTrace& trace) {
+    float mgShare = float(trace.phase) / Eval::TotalPhase;
+    float share = param.is_mg ? mgShare : 1.0f - mgShare;
+    if (param.trace_term == TRACE_KING_DANGER) {
+        return -float(trace.kingDanger[WHITE] - trace.kingDanger[BLACK]) / 100.0f * share;
+    }
+    const int* counts = trace.terms[param.trace_term];
+    return float(counts[WHITE] - counts[BLACK]) * share;
+}
+
+void extract_features_worker(size_t start, size_t end) {
+    Eval::EvalTrace trace;
+    for (size_t i = start; i < end; ++i) {
+        Board board(positions[i].fen);
+        int score = Eval::trace(board, trace);
+        positions[i].base_score = board.side_to_move() == WHITE ? score : -score;
+
+        features.base[i] = float(positions[i].base_score);
+        features.result[i] = float(positions[i].result);
+        for (size_t p = 0; p < params.size(); ++p) {
+            features.coeffs[p][i] = trace_coefficient(params[p], trace);
+        }
+    }
+}
+
+void extract_features() {
+    std::cout << "Extracting linear features (" << params.size() << " parameters)...\n";
+    auto start = std::chrono::steady_clock::now();
+
+    size_t n = positions.size();
+    features.base.assign(n, 0.0f);
+    features.result.assign(n, 0.0f);
+    features.coeffs.assign(params.size(), std::vector<float>(n, 0.0f));
+    features.origin.assign(params.size(), 0);
+    for (size_t p = 0; p < params.size(); ++p) {
+        features.origin[p] = *params[p].value_ptr;
+    }
+
+    // One traced evaluation per position gives the base score and every
+    // coefficient at once.
+    std::vector<std::thread> threads;
+    size_t chunk_size = n / NUM_THREADS;
+    for (unsigned int t = 0; t < NUM_THREADS; ++t) {
+        size_t s = t * chunk_size;
+        size_t e = (t == NUM_THREADS - 1) ? n : (t + 1) * chunk_size;
+        threads.emplace_back(extract_features_worker, s, e);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(end - start).count();
+    std::cout << "  Done in " << std::fixed << std::setprecision(1) << elapsed << "s\n";
+}
+
+// ============================================================================
+// SIMD Error / Gradient Kernel
+// ============================================================================
+
+#if defined(__AVX512F__)
+
+struct Simd {
+    using V = __m512;
+    static constexpr size_t W = 16;
+    static V zero() { return _mm512_setzero_ps(); }
+    static V set1(float x) { return _mm512_set1_ps(x); }
+    static V load(const float* p) { return _mm512_loadu_ps(p); }
+    static V load_aligned(const float* p) { return _mm512_load_ps(p); }
+    static void store_aligned(float* p, V a) { _mm512_store_ps(p, a); }
+    static V add(V a, V b) { return _mm512_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+    static V fmadd(V a, V b, V c) { return _mm512_fmadd_ps(a, b, c); }
+    static V div(V a, V b) { return _mm512_div_ps(a, b); }
+    // GCC 12 builds the unmasked AVX-512 forms on an undefined pass-through
+    // vector and warns about it (-Wmaybe-uninitialized) once inlined, so the
+    // kernel uses zero-masked forms with a full mask and sums lanes through
+    // memory. hsum runs once per kernel block.
+    static constexpr __mmask16 ALL = 0xFFFF;
+
+    static float hsum(V a) {
+        alignas(64) float lanes[W];
+        _mm512_store_ps(lanes, a);
+        float sum = 0.0f;
+        for (float x : lanes) sum += x;
+        return sum;
+    }
+
+    static V exp(V x) {
+        x = _mm512_maskz_max_ps(ALL, _mm512_maskz_min_ps(ALL, x, set1(88.0f)), set1(-88.0f));
+        V n = _mm512_maskz_roundscale_ps(ALL, mul(x, set1(1.44269504f)), _MM_FROUND_TO_NEAREST_INT);
+        V r = fmadd(n, set1(-0.69314718f), x);
+        V p = poly(r);
+        return _mm512_maskz_scalef_ps(ALL, p, n);
+    }
+
+    static V poly(V r) {
+        V p = set1(1.0f / 120);
+        p = fmadd(p, r, set1(1.0f / 24));
+        p = fmadd(p, r, set1(1.0f / 6));
+        p = fmadd(p, r, set1(0.5f));
+        p = fmadd(p, r, set1(1.0f));
+        return fmadd(p, r, set1(1.0f));
+    }
+};
+
+#elif defined(__AVX2__)
+
+struct Simd {
+    using V = __m256;
+    static constexpr size_t W = 8;
+    static V zero() { return _mm256_setzero_ps(); }
+    static V set1(float x) { return _mm256_set1_ps(x); }
+    static V load(const float* p) { return _mm256_loadu_ps(p); }
+    static V load_aligned(const float* p) { return _mm256_load_ps(p); }
+    static void store_aligned(float* p, V a) { _mm256_store_ps(p, a); }
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+#if defined(__FMA__)
+    static V fmadd(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+    static V fmadd(V a, V b, V c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+    static V div(V a, V b) { return _mm256_div_ps(a, b); }
+
+    static float hsum(V a) {
+        __m128 lo = _mm256_castps256_ps128(a);
+        __m128 hi = _mm256_extractf128_ps(a, 1);
+        lo = _mm_add_ps(lo, hi);
+        lo = _mm_hadd_ps(lo, lo);
+        lo = _mm_hadd_ps(lo, lo);
+        return _mm_cvtss_f32(lo);
+    }
+
+    static V exp(V x) {
+        x = _mm256_max_ps(_mm256_min_ps(x, set1(88.0f)), set1(-88.0f));
+        V n = _mm256_round_ps(mul(x, set1(1.44269504f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        V r = fmadd(n, set1(-0.69314718f), x);
+        V p = set1(1.0f / 120);
+        p = fmadd(p, r, set1(1.0f / 24));
+        p = fmadd(p, r, set1(1.0f / 6));
+        p = fmadd(p, r, set1(0.5f));
+        p = fmadd(p, r, set1(1.0f));
+        p = fmadd(p, r, set1(1.0f));
+        __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+        return mul(p, _mm256_castsi256_ps(e));
+    }
+};
+
+#else
+
+struct Simd {
+    using V = float;
+    static constexpr size_t W = 1;
+    static V zero() { return 0.0f; }
+    static V set1(float x) { return x; }
+    static V load(const float* p) { return *p; }
+    static V load_aligned(const float* p) { return *p; }
+    static void store_aligned(float* p, V a) { *p = a; }
+    static V add(V a, V b) { return a + b; }
+    static V sub(V a, V b) { return a - b; }
+    static V mul(V a, V b) { return a * b; }
+    static V fmadd(V a, V b, V c) { return a * b + c; }
+    static V div(V a, V b) { return a / b; }
+    static float hsum(V a) { return a; }
+    static V exp(V x) { return std::exp(x); }
+};
+
+#endif
+
+// Kernel sums flush into doubles every block so float lanes stay accurate
+// on multi-million position sets.
+constexpr size_t KERNEL_BLOCK = 4096;
+
+// One vector's worth of floats. Per-parameter accumulators are kept as
+// these rather than as Simd::V so the container keeps the alignment.
+struct alignas(64) SimdLanes {
+    float lane[Simd::W];
+};
+
+void gradient_worker(size_t start, size_t end, const std::vector<float>& delta, float k,
+                     double& error, std::vector<double>& grad) {
+    const size_t P = delta.size();
+    const float scale = k * float(std::log(10.0) / 400.0);
+    const float* base = features.base.data();
+    const float* result = features.result.data();
+
+    error = 0.0;
+    grad.assign(P, 0.0);
+
+    std::vector<SimdLanes> gacc(P);
+    std::vector<SimdLanes> dv(P);
+    for (size_t p = 0; p < P; ++p) Simd::store_aligned(dv[p].lane, Simd::set1(delta[p]));
+
+    const Simd::V one = Simd::set1(1.0f);
+    const Simd::V negScale = Simd::set1(-scale);
+
+    size_t i = start;
+    while (i + Simd::W <= end) {
+        size_t blockEnd = std::min(end, i + KERNEL_BLOCK);
+        Simd::V eacc = Simd::zero();
+        for (size_t p = 0; p < P; ++p) Simd::store_aligned(gacc[p].lane, Simd::zero());
+
+        for (; i + Simd::W <= blockEnd; i += Simd::W) {
+            Simd::V s = Simd::load(base + i);
+            for (size_t p = 0; p < P; ++p) {
+                s = Simd::fmadd(Simd::load(features.coeffs[p].data() + i),
+                                Simd::load_aligned(dv[p].lane), s);
+            }
+            Simd::V sig = Simd::div(one, Simd::add(one, Simd::exp(Simd::mul(s, negScale))));
+            Simd::V diff = Simd::sub(Simd::load(result + i), sig);
+            eacc = Simd::fmadd(diff, diff, eacc);
+            Simd::V g = Simd::mul(diff, Simd::mul(sig, Simd::sub(one, sig)));
+            for (size_t p = 0; p < P; ++p) {
+                Simd::store_aligned(gacc[p].lane,
+                                    Simd::fmadd(g, Simd::load(features.coeffs[p].data() + i),
+                                                Simd::load_aligned(gacc[p].lane)));
+            }
+        }
+
+        error += Simd::hsum(eacc);
+        for (size_t p = 0; p < P; ++p) grad[p] += Simd::hsum(Simd::load_aligned(gacc[p].lane));
+    }
+
+    for (; i < end; ++i) {
+        double s = base[i];
+        for (size_t p = 0; p < P; ++p) s += features.coeffs[p][i] * delta[p];
+        double sig = 1.0 / (1.0 + std::exp(-scale * s));
+        double diff = result[i] - sig;
+        error += diff * diff;
+        double g = diff * sig * (1.0 - sig);
+        for (size_t p = 0; p < P; ++p) grad[p] += g * features.coeffs[p][i];
+    }
+
+    // dE/dv_p = -2 * scale * sum(diff * sig * (1 - sig) * coeff_p)
+    for (size_t p = 0; p < P; ++p) grad[p] *= -2.0 * scale;
+}
+
+double linear_error_and_gradient(const std::vector<float>& delta, std::vector<double>& grad) {
+    size_t n = features.size();
+    std::vector<std::thread> threads;
+    std::vector<double> partial_errors(NUM_THREADS, 0.0);
+    std::vector<std::vector<double>> partial_grads(NUM_THREADS);
+    size_t chunk_size = n / NUM_THREADS;
+
+    for (unsigned int t = 0; t < NUM_THREADS; ++t) {
+        size_t s = t * chunk_size;
+        size_t e = (t == NUM_THREADS - 1) ? n : (t + 1) * chunk_size;
+        threads.emplace_back(gradient_worker, s, e, std::cref(delta), float(K),
+                             std::ref(partial_errors[t]), std::ref(partial_grads[t]));
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    double error = 0.0;
+    grad.assign(delta.size(), 0.0);
+    for (unsigned int t = 0; t < NUM_THREADS; ++t) {
+        error += partial_errors[t];
+        for (size_t p = 0; p < delta.size(); ++p) grad[p] += partial_grads[t][p];
+    }
+    for (double& g : grad) g /= n;
+    return error / n;
+}
+
+// ============================================================================
+// Tune Parameters using Gradient Descent on the Linear Model
+// ============================================================================
+
+void tune_gradient(int epochs = 1000) {
+    std::cout << "\n=== Starting Texel Tuning (Gradient Descent) ===\n";
+    std::cout << "Threads: " << NUM_THREADS << "\n";
+    std::cout << "SIMD width: " << Simd::W << " floats\n";
+    std::cout << "Rounds: " << GRADIENT_ROUNDS << " x " << epochs << " epochs\n";
+    std::cout << "Positions: " << positions.size() << "\n";
+    std::cout << "Parameters: " << params.size() << "\n\n";
+
+    double initial_error = calculate_error_fast(K);
+    double best_error = initial_error;
+    std::cout << "Initial error: " << std::fixed << std::setprecision(8) << initial_error << "\n\n";
+
+    const size_t P = params.size();
+
+    for (int round = 1; round <= GRADIENT_ROUNDS; ++round) {
+        extract_features();
+
+        std::vector<double> value(P), m(P, 0.0), v(P, 0.0), grad;
+        std::vector<float> delta(P, 0.0f);
+        for (size_t p = 0; p < P; ++p) value[p] = features.origin[p];
+
+        auto start_time = std::chrono::steady_clock::now();
+        double error = 0.0;
+
+        for (int epoch = 1; epoch <= epochs; ++epoch) {
+            error = linear_error_and_gradient(delta, grad);
+
+            double b1 = 1.0 - std::pow(ADAM_BETA1, epoch);
+            double b2 = 1.0 - std::pow(ADAM_BETA2, epoch);
+            for (size_t p = 0; p < P; ++p) {
+                m[p] = ADAM_BETA1 * m[p] + (1.0 - ADAM_BETA1) * grad[p];
+                v[p] = ADAM_BETA2 * v[p] + (1.0 - ADAM_BETA2) * grad[p] * grad[p];
+                value[p] -= ADAM_LR * (m[p] / b1) / (std::sqrt(v[p] / b2) + 1e-12);
+                value[p] = std::clamp(value[p], double(params[p].min_val), double(params[p].max_val));
+                delta[p] = float(value[p] - features.origin[p]);
+            }
+
+            if (epoch % 100 == 0) {
+                std::cout << "Round " << round << " | Epoch " << std::setw(5) << epoch
+                          << " | Linear error: " << std::setprecision(8) << error << "\n";
+            }
+        }
+
+        for (size_t p = 0; p < P; ++p) {
+            *params[p].value_ptr = int(std::lround(value[p]));
+        }
+        reevaluate_all_scores();
+        best_error = calculate_error_fast(K);
+
+        auto end_time = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(end_time - start_time).count();
+        std::cout << "Round " << round
+                  << " | Linear error: " << std::setprecision(8) << error
+                  << " | Eval error: " << best_error
+                  << " | Time: " << std::setprecision(1) << elapsed << "s\n\n";
+    }
+
+    print_final_values();
 
     double improvement = (initial_error - best_error) * 100 / initial_error;
     std::cout << "\n=== Tuning Complete ===\n";
@@ -457,21 +848,31 @@ void tune_parameters(int iterations = 100) {
 // ============================================================================
 
 int main(int argc, char* argv[]) {
+    bool gradient = false;
+    std::vector<char*> args;
+    for (int i = 0; i < argc; ++i) {
+        if (std::string(argv[i]) == "--gradient") gradient = true;
+        else args.push_back(argv[i]);
+    }
+    argc = int(args.size());
+    argv = args.data();
+
     std::cout << "=================================\n";
     std::cout << "  GC-Engine Texel Tuner v6\n";
     std::cout << "  (Ultra-Fast Version)\n";
     std::cout << "=================================\n\n";
-    std::cout << "Usage: tuner.exe <epd_file> [max_positions] [iterations] [manual_K]\n";
+    std::cout << "Usage: tuner.exe <epd_file> [max_positions] [iterations] [manual_K] [--gradient]\n";
     std::cout << "  epd_file      : Path to labeled EPD file\n";
     std::cout << "  max_positions : Maximum positions to load (0 = all)\n";
     std::cout << "  iterations    : Number of tuning iterations (default: 100)\n";
-    std::cout << "  manual_K      : Optional manual K value (default: auto-find)\n\n";
+    std::cout << "  manual_K      : Optional manual K value (default: auto-find)\n";
+    std::cout << "  --gradient    : Gradient descent on extracted linear features\n";
+    std::cout << "                  (iterations = epochs per round, default: 1000)\n\n";
 
     if (NUM_THREADS == 0) NUM_THREADS = 1;
     std::cout << "Using " << NUM_THREADS << " threads\n\n";
 
     Magics::init();
-    Zobrist::init();
 
     std::string epd_file = "tuner/quiet-labeled.epd";
     if (argc > 1) epd_file = argv[1];
@@ -495,10 +896,14 @@ int main(int argc, char* argv[]) {
     K = find_optimal_k(manual_k);
 
     // Run tuning
-    int iterations = 100;
+    int iterations = gradient ? 1000 : 100;
     if (argc > 3) iterations = std::stoi(argv[3]);
 
-    tune_parameters(iterations);
+    if (gradient) {
+        tune_gradient(iterations);
+    } else {
+        tune_parameters(iterations);
+    }
 
     return 0;
 }